@@ -17,6 +17,9 @@
 #ifndef ALLOC_H
 #define ALLOC_H
 #include <stdlib.h>
+#ifdef NUMA
+#include <numa.h>
+#endif
 
 void aligned_malloc(void** p, size_t alignment, size_t size) {
   *p = NULL;
@@ -50,4 +53,29 @@ void aligned_free(void* p) {
 #endif
 }
 
+// Page aligned memory bound to a NUMA node, plain aligned memory without NUMA. Free with the same size.
+void aligned_malloc_onnode(void** p, size_t size, size_t node) {
+#ifdef NUMA
+  if (numa_available() >= 0) {
+    *p = numa_alloc_onnode(size, node);
+    if (*p == NULL) {
+      fprintf(stderr, "Failed to Allocate Memory.\n");
+      exit(-1);
+    }
+    return;
+  }
+#endif
+  aligned_malloc(p, 4096, size);
+}
+
+void aligned_free_onnode(void* p, size_t size) {
+#ifdef NUMA
+  if (numa_available() >= 0) {
+    numa_free(p, size);
+    return;
+  }
+#endif
+  aligned_free(p);
+}
+
 #endif
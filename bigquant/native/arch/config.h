@@ -51,4 +51,7 @@ typedef enum CPU_FEATURE { SSE4_2 = 0, AVX2_FMA = 1, AVX_512 = 2 } CPU_FEATURE;
 #define FC_SHUFFLE_KERNEL_K GEMM_SHUFFLE_KERNEL_K
 #endif
 
+// FC batches up to this size run as a GEMV over the packed weights instead of padding the batch to FC_SHUFFLE_KERNEL_N
+#define FC_GEMV_MAX_BATCH 4
+
 #endif
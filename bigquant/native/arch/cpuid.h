@@ -55,6 +55,7 @@ struct cache_info {
   int cache_level;
   size_t cache_size;
   size_t logic_cores_per_package;
+  size_t shared_logic_cores;
   bool hyper_threading;
   bool inclusive;
 };
@@ -78,16 +79,19 @@ static int cpuid_caches(int cache_id, struct cache_info& info) {
   size_t cache_ways = ((ebx >> 22) & 0x3ff) + 1;
   size_t cache_size = cache_ways * cacheline_partitions * cacheline_size * cache_sets;
   bool inclusive = (edx >> 1) & 1;
+  size_t shared_logic_cores = ((eax >> 14) & 0xfff) + 1;
 
   info.cache_id = cache_id;
   info.cache_level = cache_level;
   info.cache_size = cache_size;
   info.inclusive = inclusive;
+  info.shared_logic_cores = shared_logic_cores;
 
   eax = 0xb;
   ecx = 1;
   __asm__("cpuid" : "+a"(eax), "=b"(ebx), "+c"(ecx), "=d"(edx));
   info.logic_cores_per_package = ebx;
+  return 0;
 }
 
 #endif
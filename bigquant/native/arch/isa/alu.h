@@ -23,11 +23,17 @@
 #define MIN_PS _mm512_min_ps
 #define ADD_PS _mm512_add_ps
 #define SUB_PS _mm512_sub_ps
+#define MAX_PS_HALF _mm256_max_ps
+#define ADD_PS_HALF _mm256_add_ps
+#define SUB_PS_HALF _mm256_sub_ps
 #elif defined(__AVX2__)
 #define MAX_PS _mm256_max_ps
 #define MIN_PS _mm256_min_ps
 #define ADD_PS _mm256_add_ps
 #define SUB_PS _mm256_sub_ps
+#define MAX_PS_HALF _mm_max_ps
+#define ADD_PS_HALF _mm_add_ps
+#define SUB_PS_HALF _mm_sub_ps
 #else  // __SSE4_2__
 #define MAX_PS _mm_max_ps
 #define MIN_PS _mm_min_ps
@@ -97,6 +103,7 @@
 #else  // __SSE4_2__
 #define CVTSS_PS _mm_cvtss_f32
 #define CVTEPI32_PS _mm_cvtepi32_ps
+#define EPI32TOPS CVTEPI32_PS
 #define EPI16TOEPI32 _mm_cvtepi16_epi32
 #define PSTOEPI32 _mm_cvttps_epi32
 #endif
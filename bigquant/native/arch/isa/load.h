@@ -51,6 +51,18 @@
 #define LOADU_PS LOADU128_PS
 #endif
 
+// Widen PS_OPERAND_WIDTH bytes into int32 lanes
+#if defined(AVX512)
+#define LOADU_EPU8_EPI32(p) _mm512_cvtepu8_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i *>(p)))
+#define LOADU_EPI8_EPI32(p) _mm512_cvtepi8_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i *>(p)))
+#elif defined(__AVX2__)
+#define LOADU_EPU8_EPI32(p) _mm256_cvtepu8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i *>(p)))
+#define LOADU_EPI8_EPI32(p) _mm256_cvtepi8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i *>(p)))
+#else  // __SSE4_2__
+#define LOADU_EPU8_EPI32(p) _mm_cvtepu8_epi32(_mm_cvtsi32_si128(*reinterpret_cast<const int *>(p)))
+#define LOADU_EPI8_EPI32(p) _mm_cvtepi8_epi32(_mm_cvtsi32_si128(*reinterpret_cast<const int *>(p)))
+#endif
+
 // Broadcast
 #if defined(AVX512)
 
@@ -31,12 +31,14 @@
 #define SET_EPI8 _mm512_set_epi8
 #define SET_EPI32 _mm512_set_epi32
 #define SET_EPI64 _mm512_set_epi64
+#define SET1_EPI64 _mm512_set1_epi64
 #define ZERO_PS _mm512_setzero_ps
 #elif defined(__AVX2__)
 #define ZEROS _mm256_setzero_si256
 #define INIT(X) SIMDSITYPE X = ZEROS()
 #define SET1_EPI16 _mm256_set1_epi16
 #define SET1_EPI32 _mm256_set1_epi32
+#define SET1_EPI64 _mm256_set1_epi64x
 #define SET_EPI32 _mm256_set_epi32
 #define SET_EPI32_HALF _mm_set_epi32
 #define SET_EPI8 _mm256_set_epi8
@@ -21,6 +21,7 @@
 #define STOREU512_PS _mm512_storeu_ps
 #define STOREU_PS STOREU512_PS
 #define STOREU_PS_HALF _mm256_storeu_ps
+#define STREAMSTORE_PS _mm512_stream_ps
 #elif defined(__AVX2__)  // store sp
 #define STOREU256_PS _mm256_storeu_ps
 #define STOREU_PS STOREU256_PS
@@ -34,9 +35,12 @@
 #define STOREU_PS STOREU128_PS
 #define STORE128_PS _mm_store_ps
 #define STORE_PS STORE128_PS
+#define STREAMSTORE_PS _mm_stream_ps
 #endif
 
 #if defined(AVX512)
+#define STOREU_SI512 _mm512_storeu_si512
+#define STOREU_SI STOREU_SI512
 #define STOREU_SI_QUARTER _mm_storeu_si128
 #define STORELO_EPI64_QUARTER _mm_storel_epi64
 #elif defined(__AVX2__)  // store integer
@@ -0,0 +1,235 @@
+/*
+ * Copyright 2016 The BigDL Authors.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ARCH_TOPOLOGY_H
+#define ARCH_TOPOLOGY_H
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
+#include <string>
+#include <vector>
+#ifdef NUMA
+#include <numa.h>
+#include <sched.h>
+#endif
+#include "cpuid.h"
+
+// Cache hierarchy as seen by the GEMM blocking, probed once per process. sysfs is preferred since it also reports
+// which logical CPUs share a cache; cpuid leaf 4 is the fallback and the only source of L3 inclusiveness.
+//
+// With an exclusive (non-inclusive) LLC, each thread keeps its own slice of L3 next to its L2, so the L3 blocks are
+// partitioned statically between threads. With an inclusive LLC all threads cooperate on one L3 block at a time.
+//
+// Overrides, mostly for containers whose cpuset only gets part of a shared L3:
+//   BIGQUANT_L1_SIZE, BIGQUANT_L2_SIZE, BIGQUANT_L3_SIZE  cache sizes in bytes, K/M suffixes allowed, L3 may be 0
+//   BIGQUANT_L3_SHARED_CPUS                             logical CPUs competing for one L3
+//   BIGQUANT_LLC_MODE                                   SHARED or EXCLUSIVE
+struct CacheTopology {
+  size_t l1_size_;
+  size_t l2_size_;
+  size_t l3_size_;  // 0 without an L3
+  size_t l3_shared_cpus_;
+  bool llc_exclusive_;
+};
+
+static size_t ParseCacheSize(const std::string &text) {
+  char *end = NULL;
+  size_t size = strtoull(text.c_str(), &end, 10);
+  if ((end != NULL) && ((*end == 'K') || (*end == 'k'))) {
+    size <<= 10;
+  } else if ((end != NULL) && ((*end == 'M') || (*end == 'm'))) {
+    size <<= 20;
+  }
+  return size;
+}
+
+// "0-3,8-11" -> 8
+static size_t CountCPUList(const std::string &list) {
+  size_t count = 0;
+  const char *p = list.c_str();
+  while (*p != '\0') {
+    char *end = NULL;
+    size_t first = strtoul(p, &end, 10);
+    if (end == p) {
+      break;
+    }
+    size_t last = first;
+    p = end;
+    if (*p == '-') {
+      last = strtoul(p + 1, &end, 10);
+      p = end;
+    }
+    count += last - first + 1;
+    if (*p == ',') {
+      ++p;
+    }
+  }
+  return count;
+}
+
+static bool ReadSysfsLine(const std::string &path, std::string &line) {
+  std::ifstream in(path.c_str());
+  return static_cast<bool>(std::getline(in, line));
+}
+
+static bool ProbeSysfsCaches(CacheTopology &topology) {
+  bool found = false;
+  for (int index = 0; index < 16; ++index) {
+    std::string dir = "/sys/devices/system/cpu/cpu0/cache/index" + std::to_string(index) + "/";
+    std::string level, type, size, shared;
+    if (!ReadSysfsLine(dir + "level", level) || !ReadSysfsLine(dir + "type", type) ||
+        !ReadSysfsLine(dir + "size", size)) {
+      break;
+    }
+    if (type == "Instruction") {
+      continue;
+    }
+    found = true;
+    if (level == "1") {
+      topology.l1_size_ = ParseCacheSize(size);
+    } else if (level == "2") {
+      topology.l2_size_ = ParseCacheSize(size);
+    } else if (level == "3") {
+      topology.l3_size_ = ParseCacheSize(size);
+      if (ReadSysfsLine(dir + "shared_cpu_list", shared)) {
+        topology.l3_shared_cpus_ = std::max(CountCPUList(shared), static_cast<size_t>(1));
+      }
+    }
+  }
+  return found;
+}
+
+static void ProbeCPUIDCaches(CacheTopology &topology, bool sizes) {
+  struct cache_info info;
+  if (sizes) {
+    if (cpuid_caches(0, info) == 0) {
+      topology.l1_size_ = info.cache_size;
+    }
+    if (cpuid_caches(2, info) == 0) {
+      topology.l2_size_ = info.cache_size;
+    }
+  }
+  if (cpuid_caches(3, info) == 0) {
+    if (sizes) {
+      topology.l3_size_ = info.cache_size;
+      topology.l3_shared_cpus_ = info.shared_logic_cores;
+    }
+    topology.llc_exclusive_ = !info.inclusive;
+  }
+}
+
+static CacheTopology ProbeCacheTopology() {
+  // a machine without L3 (or cpuid leaf 4) takes the old LLC_EXCLUSIVE fallback of blocking for L2
+  CacheTopology topology = {32 << 10, 1 << 20, 0, 1, true};
+  bool sysfs = ProbeSysfsCaches(topology);
+  ProbeCPUIDCaches(topology, !sysfs);
+  if (topology.l3_size_ == 0) {
+    topology.llc_exclusive_ = true;
+  }
+  const char *value;
+  if ((value = getenv("BIGQUANT_L1_SIZE")) != NULL) {
+    topology.l1_size_ = ParseCacheSize(value);
+  }
+  if ((value = getenv("BIGQUANT_L2_SIZE")) != NULL) {
+    topology.l2_size_ = ParseCacheSize(value);
+  }
+  if ((value = getenv("BIGQUANT_L3_SIZE")) != NULL) {
+    topology.l3_size_ = ParseCacheSize(value);
+  }
+  if ((value = getenv("BIGQUANT_L3_SHARED_CPUS")) != NULL) {
+    topology.l3_shared_cpus_ = std::max(static_cast<size_t>(strtoul(value, NULL, 10)), static_cast<size_t>(1));
+  }
+  if ((value = getenv("BIGQUANT_LLC_MODE")) != NULL) {
+    topology.llc_exclusive_ = (std::string(value) != "SHARED");
+  }
+  topology.l1_size_ = std::max(topology.l1_size_, static_cast<size_t>(1024));
+  topology.l2_size_ = std::max(topology.l2_size_, topology.l1_size_);
+#if defined(DEBUG)
+  std::cerr << "topology l1:" << topology.l1_size_ << " l2:" << topology.l2_size_ << " l3:" << topology.l3_size_
+            << " l3 cpus:" << topology.l3_shared_cpus_ << " llc " << (topology.llc_exclusive_ ? "exclusive" : "shared")
+            << (sysfs ? " (sysfs)" : " (cpuid)") << std::endl;
+#endif
+  return topology;
+}
+
+static const CacheTopology &GetCacheTopology() {
+  static const CacheTopology topology = ProbeCacheTopology();
+  return topology;
+}
+
+// The NUMA nodes the process may allocate on, in ascending order: node ids need not be contiguous and a cpuset or
+// numactl --membind may exclude some. Builds without NUMA (libnuma) see node 0 only.
+static const std::vector<int> &GetAllowedNodes() {
+  static const std::vector<int> nodes = [] {
+    std::vector<int> allowed;
+#ifdef NUMA
+    if (numa_available() >= 0) {
+      struct bitmask *mems = numa_get_mems_allowed();
+      for (int node = 0; node <= numa_max_node(); ++node) {
+        if (numa_bitmask_isbitset(mems, node)) {
+          allowed.push_back(node);
+        }
+      }
+      numa_bitmask_free(mems);
+    }
+#endif
+    if (allowed.empty()) {
+      allowed.push_back(0);
+    }
+    return allowed;
+  }();
+  return nodes;
+}
+
+// Sockets are the allowed NUMA nodes numbered from 0, see GetSocketNode
+INLINE_SPECIFIER size_t GetSocketNum() {
+  return GetAllowedNodes().size();
+}
+
+// NUMA node id of a socket, for allocating on it
+INLINE_SPECIFIER int GetSocketNode(size_t socket) {
+  return GetAllowedNodes()[socket];
+}
+
+// Socket of the CPU the calling thread is running on, 0 if its node is not an allowed one
+INLINE_SPECIFIER size_t GetCurrentSocket() {
+#ifdef NUMA
+  if (numa_available() >= 0) {
+    const std::vector<int> &nodes = GetAllowedNodes();
+    auto iter = std::find(nodes.begin(), nodes.end(), numa_node_of_cpu(sched_getcpu()));
+    if (iter != nodes.end()) {
+      return iter - nodes.begin();
+    }
+  }
+#endif
+  return 0;
+}
+
+// NUMA mode: packed weights are replicated per node and the planned GEMMs give every node its own share of the output
+// columns, see NumaReplicas and shuffle::BuildGemmPlan. On by default with more than one node; BIGQUANT_NUMA=0 turns
+// it off, BIGQUANT_NUMA=1 forces it on a single node.
+static bool NumaEnabled() {
+  static const bool enabled = [] {
+    const char *value = getenv("BIGQUANT_NUMA");
+    if (value != NULL) {
+      return strtol(value, NULL, 10) != 0;
+    }
+    return GetSocketNum() > 1;
+  }();
+  return enabled;
+}
+
+#endif
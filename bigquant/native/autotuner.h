@@ -0,0 +1,203 @@
+/*
+ * Copyright 2016 The BigDL Authors.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef AUTOTUNER_H
+#define AUTOTUNER_H
+
+#include <cstdlib>
+#include <fstream>
+#include <map>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include "base.h"
+#include "common.h"
+
+// Winner of one AUTO_SELECT_* search: the algorithm and, for GEMM based ones, the loop nest overrides
+struct TuningRecord {
+  int algo_;  // CONV_ALGORITHM or FC_ALGORITHM
+  GemmTuning gemm_;
+};
+
+// Results only transfer between runs with the same ISA build and thread count
+INLINE_SPECIFIER std::string TuningKeyPrefix(const char *op) {
+  std::ostringstream key;
+  key << op << ":" << GetISAName() << ":t" << GetThreadsNumWrapper();
+  return key.str();
+}
+
+// Process wide cache of tuning results, keyed by layer shape, input shape, thread count and ISA.
+// If BIGQUANT_TUNING_FILE is set it is loaded on first use and every new result is appended to it, so a fleet of
+// identical nodes can tune once and ship the file. One "key algo loop_order shift_l1 shift_l2 shift_l3 schedule chunk"
+// record per line; later lines win.
+struct Autotuner {
+  static Autotuner &Instance() {
+    static Autotuner tuner;
+    return tuner;
+  }
+
+  Autotuner(const Autotuner&) = delete;
+
+  Autotuner& operator=(const Autotuner&) = delete;
+
+  bool Lookup(const std::string &key, TuningRecord &record) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto iter = records_.find(key);
+    if (iter == records_.end()) {
+      return false;
+    }
+    record = iter->second;
+    return true;
+  }
+
+  void Record(const std::string &key, const TuningRecord &record) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    records_[key] = record;
+    if (!file_.empty()) {
+      std::ofstream out(file_.c_str(), std::ios::app);
+      out << Format(key, record) << std::endl;
+    }
+  }
+
+  // Returns the number of records read, or -1 if the file cannot be opened
+  int Load(const char *path) {
+    std::ifstream in(path);
+    if (!in) {
+      return -1;
+    }
+    std::lock_guard<std::mutex> lock(mutex_);
+    int count = 0;
+    std::string line;
+    while (std::getline(in, line)) {
+      std::string key;
+      TuningRecord record;
+      if (Parse(line, key, record)) {
+        records_[key] = record;
+        ++count;
+      }
+    }
+    return count;
+  }
+
+  // Returns the number of records written, or -1 if the file cannot be opened
+  int Save(const char *path) {
+    std::ofstream out(path, std::ios::trunc);
+    if (!out) {
+      return -1;
+    }
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (auto iter = records_.begin(); iter != records_.end(); ++iter) {
+      out << Format(iter->first, iter->second) << std::endl;
+    }
+    return static_cast<int>(records_.size());
+  }
+
+ private:
+  Autotuner() {
+    const char *path = getenv("BIGQUANT_TUNING_FILE");
+    if (path != NULL) {
+      Load(path);
+      file_ = path;
+    }
+  }
+
+  static std::string Format(const std::string &key, const TuningRecord &record) {
+    std::ostringstream line;
+    line << key << " " << record.algo_ << " " << record.gemm_.loop_order_ << " " << record.gemm_.block_shift_[0] << " "
+         << record.gemm_.block_shift_[1] << " " << record.gemm_.block_shift_[2] << " " << record.gemm_.schedule_ << " "
+         << record.gemm_.chunk_;
+    return line.str();
+  }
+
+  static bool Parse(const std::string &line, std::string &key, TuningRecord &record) {
+    if (line.empty() || (line[0] == '#')) {
+      return false;
+    }
+    std::istringstream fields(line);
+    record = TuningRecord();
+    fields >> key >> record.algo_ >> record.gemm_.loop_order_ >> record.gemm_.block_shift_[0] >>
+        record.gemm_.block_shift_[1] >> record.gemm_.block_shift_[2] >> record.gemm_.schedule_ >> record.gemm_.chunk_;
+    return !fields.fail() && Valid(record.gemm_);
+  }
+
+  // The file is not trusted: out of range overrides are dropped like unparsable lines, SearchGemmTuning never emits
+  // them and ShiftBlock would shift by them
+  static bool Valid(const GemmTuning &tuning) {
+    for (size_t i = 0; i < 3; ++i) {
+      if ((tuning.block_shift_[i] < -1) || (tuning.block_shift_[i] > 1)) {
+        return false;
+      }
+    }
+    return (tuning.loop_order_ >= 0) && (tuning.loop_order_ <= 2) && (tuning.schedule_ >= GEMM_SCHEDULE_DEFAULT) &&
+           (tuning.schedule_ <= GEMM_SCHEDULE_GUIDED) && (tuning.chunk_ >= 0);
+  }
+
+  std::mutex mutex_;
+  std::map<std::string, TuningRecord> records_;
+  std::string file_;
+};
+
+// Best of a few runs after a warm-up, in microseconds
+template <typename Run>
+double TimeRun(Run run, size_t repeat = 3) {
+  run();
+  double best = DBL_MAX;
+  for (size_t i = 0; i < repeat; ++i) {
+    auto start = std::chrono::steady_clock::now();
+    run();
+    auto end = std::chrono::steady_clock::now();
+    best = std::min(best, std::chrono::duration<double, std::micro>(end - start).count());
+  }
+  return best;
+}
+
+// Coordinate descent over the GemmTuning knobs, starting from the built-in heuristics: loop order, then the L3, L2
+// and L1 block sizes, then the OpenMP schedule. run(tuning) executes the layer once with the given overrides.
+template <typename Run>
+GemmTuning SearchGemmTuning(Run run, double &best_time) {
+  GemmTuning best = GemmTuning();
+  best_time = TimeRun([&] { run(best); });
+  auto try_candidate = [&](const GemmTuning &candidate) {
+    double time = TimeRun([&] { run(candidate); });
+    if (time < best_time) {
+      best_time = time;
+      best = candidate;
+    }
+  };
+  for (int order = 1; order <= 2; ++order) {
+    GemmTuning candidate = best;
+    candidate.loop_order_ = order;
+    try_candidate(candidate);
+  }
+  for (int level = 2; level >= 0; --level) {
+    for (int shift = -1; shift <= 1; shift += 2) {
+      GemmTuning candidate = best;
+      candidate.block_shift_[level] = shift;
+      try_candidate(candidate);
+    }
+  }
+  int schedules[][2] = {{GEMM_SCHEDULE_STATIC, 0}, {GEMM_SCHEDULE_DYNAMIC, 1}, {GEMM_SCHEDULE_DYNAMIC, 4},
+                        {GEMM_SCHEDULE_GUIDED, 1}};
+  for (size_t i = 0; i < sizeof(schedules) / sizeof(schedules[0]); ++i) {
+    GemmTuning candidate = best;
+    candidate.schedule_ = schedules[i][0];
+    candidate.chunk_ = schedules[i][1];
+    try_candidate(candidate);
+  }
+  return best;
+}
+
+#endif
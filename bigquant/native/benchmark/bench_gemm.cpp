@@ -0,0 +1,702 @@
+// Micro-benchmark of the int8 GEMM and convolution paths, written as JSON so runs can be diffed across commits and
+// machines. Every case is timed at each thread count as the median of --repeat runs after one warmup run.
+//
+//   gemm       the (m, n, k) shapes of tests/test_gemm.cpp run as FC layers, weight m x k and batch n
+//   googlenet  the GoogleNet v1 subset of those shapes
+//   resnet50   the convolutions and the classifier of ResNet-50 at 224x224
+//   mobilenet  the convolutions and the classifier of MobileNet v1 at 224x224
+//   winograd   the 3x3 stride 1 convolutions of resnet50 run end to end as SHUFFLE_CONV and as WINOGRAD_CONV
+//   layout     TransformLayout both ways on ResNet activations; m, n and k are batch, channels and pixels and only
+//              total and its bytes apply
+//
+// The quantize and im2col of the input are one fused pass in the library and the epilogue is fused into the GEMM
+// tiles, so the phases are timed as separate runs of the same kernels the layers call:
+//   quantize   PadQuantizeShuffle2D of the input, one row per pixel (per batch row for FC)
+//   im2col     the fused PadQuantizeShuffleIm2colWrapper minus quantize, 0 for pointwise layers
+//   gemm       ConvShuffleGEMM without bias or fusions
+//   epilogue   ConvShuffleGEMM with the bias, relu and residual of the layer minus gemm
+//   total      ConvOp/FCOp::Execute, which also reserves its workspace and picks its GEMM plan
+// bytes are the analytic traffic of each phase: every operand read once and every result written once.
+//
+// Build with make -f Makefile.base benchmark, which links OpenBLAS for the fp32 cblas_sgemm baseline of the same
+// (m, n, k); SGEMM=0 builds without it.
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <chrono>
+#include <random>
+#include <cstdlib>
+#include <cstring>
+#ifdef BENCHMARK_SGEMM
+#include <cblas.h>
+#endif
+#include "../base.h"
+#include "../common.h"
+#include "../ops/ops.h"
+#include "../nn/convolution_op.h"
+#include "../nn/fc_op.h"
+
+#ifdef BENCHMARK_SGEMM
+extern "C" void openblas_set_num_threads(int num_threads);
+#endif
+
+struct BenchOptions {
+  std::vector<size_t> threads;
+  std::vector<std::string> suites;
+  size_t repeat;
+  size_t batch;
+  double max_gflop;
+  std::string out;
+};
+
+struct ConvLayer {
+  const char *name;
+  size_t channel_in;
+  size_t size;
+  size_t channel_out;
+  size_t groups;
+  size_t kernel;
+  size_t stride;
+  size_t pad;
+};
+
+// One measurement, times in ms. A negative phase time is a phase that doesn't exist on the path of the case.
+struct BenchResult {
+  std::string suite;
+  std::string name;
+  std::string algo;
+  size_t threads;
+  size_t batch;
+  size_t m;
+  size_t n;
+  size_t k;
+  double quantize_ms;
+  double im2col_ms;
+  double gemm_ms;
+  double epilogue_ms;
+  double total_ms;
+  double sgemm_ms;
+  double quantize_bytes;
+  double im2col_bytes;
+  double gemm_bytes;
+  double epilogue_bytes;
+  double total_bytes;
+};
+
+// ResNet-50 v1 at 224x224, each distinct shape once: the first block of a stage carries the stride and the projection
+static const ConvLayer kResNet50[] = {
+    {"conv1", 3, 224, 64, 1, 7, 2, 3},
+    {"res2a_branch1", 64, 56, 256, 1, 1, 1, 0},
+    {"res2a_branch2a", 64, 56, 64, 1, 1, 1, 0},
+    {"res2a_branch2b", 64, 56, 64, 1, 3, 1, 1},
+    {"res2a_branch2c", 64, 56, 256, 1, 1, 1, 0},
+    {"res2b_branch2a", 256, 56, 64, 1, 1, 1, 0},
+    {"res3a_branch1", 256, 56, 512, 1, 1, 2, 0},
+    {"res3a_branch2a", 256, 56, 128, 1, 1, 2, 0},
+    {"res3a_branch2b", 128, 28, 128, 1, 3, 1, 1},
+    {"res3a_branch2c", 128, 28, 512, 1, 1, 1, 0},
+    {"res3b_branch2a", 512, 28, 128, 1, 1, 1, 0},
+    {"res4a_branch1", 512, 28, 1024, 1, 1, 2, 0},
+    {"res4a_branch2a", 512, 28, 256, 1, 1, 2, 0},
+    {"res4a_branch2b", 256, 14, 256, 1, 3, 1, 1},
+    {"res4a_branch2c", 256, 14, 1024, 1, 1, 1, 0},
+    {"res4b_branch2a", 1024, 14, 256, 1, 1, 1, 0},
+    {"res5a_branch1", 1024, 14, 2048, 1, 1, 2, 0},
+    {"res5a_branch2a", 1024, 14, 512, 1, 1, 2, 0},
+    {"res5a_branch2b", 512, 7, 512, 1, 3, 1, 1},
+    {"res5a_branch2c", 512, 7, 2048, 1, 1, 1, 0},
+    {"res5b_branch2a", 2048, 7, 512, 1, 1, 1, 0},
+    {"fc1000", 2048, 1, 1000, 1, 1, 1, 0},
+};
+
+// MobileNet v1 (width 1.0) at 224x224
+static const ConvLayer kMobileNet[] = {
+    {"conv1", 3, 224, 32, 1, 3, 2, 1},
+    {"conv2_1_dw", 32, 112, 32, 32, 3, 1, 1},
+    {"conv2_1_pw", 32, 112, 64, 1, 1, 1, 0},
+    {"conv2_2_dw", 64, 112, 64, 64, 3, 2, 1},
+    {"conv2_2_pw", 64, 56, 128, 1, 1, 1, 0},
+    {"conv3_1_dw", 128, 56, 128, 128, 3, 1, 1},
+    {"conv3_1_pw", 128, 56, 128, 1, 1, 1, 0},
+    {"conv3_2_dw", 128, 56, 128, 128, 3, 2, 1},
+    {"conv3_2_pw", 128, 28, 256, 1, 1, 1, 0},
+    {"conv4_1_dw", 256, 28, 256, 256, 3, 1, 1},
+    {"conv4_1_pw", 256, 28, 256, 1, 1, 1, 0},
+    {"conv4_2_dw", 256, 28, 256, 256, 3, 2, 1},
+    {"conv4_2_pw", 256, 14, 512, 1, 1, 1, 0},
+    {"conv5_dw", 512, 14, 512, 512, 3, 1, 1},
+    {"conv5_pw", 512, 14, 512, 1, 1, 1, 0},
+    {"conv5_6_dw", 512, 14, 512, 512, 3, 2, 1},
+    {"conv5_6_pw", 512, 7, 1024, 1, 1, 1, 0},
+    {"conv6_dw", 1024, 7, 1024, 1024, 3, 1, 1},
+    {"conv6_pw", 1024, 7, 1024, 1, 1, 1, 0},
+    {"fc7", 1024, 1, 1000, 1, 1, 1, 0},
+};
+
+static std::vector<std::vector<size_t>> GemmShapes(bool googlenet_only) {
+  std::vector<std::vector<size_t>> shapes;
+  if (!googlenet_only) {
+    //  the random cases of tests/test_gemm.cpp
+    size_t random_cases[][3] = {{1, 1, 15},       {2, 1, 15},         {2, 2, 15},         {2, 2, 16},
+                                {3, 4, 15},       {4, 4, 8},          {4, 4, 31},         {4, 4, 32},
+                                {4, 8, 8},        {4, 8, 16},         {4, 5, 32},         {5, 5, 32},
+                                {4, 4, 64},       {32, 1024, 1024},   {32, 4096, 4096},   {32, 311, 393},
+                                {127, 311, 393},  {128, 4096, 4096},  {128, 2048, 2048},  {128, 1024, 1024},
+                                {128, 256, 256},  {128, 128, 128},    {255, 255, 255},    {255, 127, 127},
+                                {1023, 1023, 1023}, {4090, 4090, 4090}, {4096, 4096, 4096}, {8192, 8192, 8192}};
+    for (size_t i = 0; i < sizeof(random_cases) / sizeof(random_cases[0]); ++i) {
+      shapes.push_back(std::vector<size_t>(random_cases[i], random_cases[i] + 3));
+    }
+  }
+  //  Googlenet v1
+  size_t googlenet[][3] = {{64, 12544, 152}, {64, 3136, 64},  {192, 3136, 576}, {64, 784, 192},  {96, 784, 192},
+                           {128, 784, 864},  {16, 784, 192},  {32, 784, 400},   {32, 784, 192},  {128, 784, 256},
+                           {192, 784, 1152}, {32, 784, 256},  {96, 784, 800},   {64, 784, 256},  {192, 200, 480},
+                           {96, 200, 480},   {208, 200, 864}, {16, 200, 480},   {48, 200, 400},  {64, 200, 480},
+                           {160, 200, 512},  {112, 200, 512}, {224, 200, 1008}, {24, 200, 512},  {64, 200, 600},
+                           {64, 200, 512},   {128, 200, 512}, {256, 200, 1152}};
+  for (size_t i = 0; i < sizeof(googlenet) / sizeof(googlenet[0]); ++i) {
+    shapes.push_back(std::vector<size_t>(googlenet[i], googlenet[i] + 3));
+  }
+  return shapes;
+}
+
+// 64-byte aligned buffer filled with uniform values in [low, high)
+class BenchBuffer {
+ public:
+  BenchBuffer(size_t size, float low = -1.0f, float high = 1.0f) : data_(NULL) {
+    aligned_malloc(reinterpret_cast<void **>(&data_), 64, (size == 0 ? 1 : size) * sizeof(float));
+    std::mt19937 gen(static_cast<unsigned>(size));
+    std::uniform_real_distribution<float> dist(low, high);
+    for (size_t i = 0; i < size; ++i) {
+      data_[i] = dist(gen);
+    }
+  }
+
+  ~BenchBuffer() {
+    aligned_free(data_);
+  }
+
+  BenchBuffer(const BenchBuffer&) = delete;
+
+  BenchBuffer& operator=(const BenchBuffer&) = delete;
+
+  template <typename T>
+  T *As() {
+    return reinterpret_cast<T *>(data_);
+  }
+
+  float *data_;
+};
+
+template <typename F>
+static double MedianMs(F func, size_t repeat) {
+  func();
+  std::vector<double> times(repeat);
+  for (size_t r = 0; r < repeat; ++r) {
+    auto start = std::chrono::steady_clock::now();
+    func();
+    auto end = std::chrono::steady_clock::now();
+    times[r] = std::chrono::duration<double, std::milli>(end - start).count();
+  }
+  std::sort(times.begin(), times.end());
+  return times[repeat / 2];
+}
+
+static void SetThreads(size_t threads) {
+#ifdef _OPENMP
+  omp_set_num_threads(static_cast<int>(threads));
+#endif
+#ifdef BENCHMARK_SGEMM
+  openblas_set_num_threads(static_cast<int>(threads));
+#endif
+}
+
+static double SgemmMs(size_t m, size_t n, size_t k, size_t repeat) {
+#ifdef BENCHMARK_SGEMM
+  BenchBuffer a(m * k);
+  BenchBuffer b(n * k);
+  BenchBuffer c(m * n);
+  return MedianMs(
+      [&]() {
+        cblas_sgemm(CblasRowMajor, CblasNoTrans, CblasTrans, m, n, k, 1.0f, a.data_, k, b.data_, k, 0.0f, c.data_,
+                    n);
+      },
+      repeat);
+#else
+  return -1.0;
+#endif
+}
+
+static double QuantizeBytes(size_t rows, size_t cols, size_t aligned_rows, size_t aligned_cols) {
+  return 4.0 * rows * cols + 1.0 * aligned_rows * aligned_cols + 12.0 * rows;
+}
+
+static double GemmBytes(size_t aligned_m, size_t aligned_n, size_t aligned_k, size_t m, size_t n) {
+  return 1.0 * aligned_m * aligned_k + 1.0 * aligned_n * aligned_k + 4.0 * m * n;
+}
+
+static BenchResult NewResult(const std::string &suite, const std::string &name, const std::string &algo,
+                             size_t threads, size_t batch, size_t m, size_t n, size_t k) {
+  BenchResult result;
+  result.suite = suite;
+  result.name = name;
+  result.algo = algo;
+  result.threads = threads;
+  result.batch = batch;
+  result.m = m;
+  result.n = n;
+  result.k = k;
+  result.quantize_ms = result.im2col_ms = result.gemm_ms = result.epilogue_ms = result.total_ms = -1.0;
+  result.sgemm_ms = -1.0;
+  result.quantize_bytes = result.im2col_bytes = result.gemm_bytes = result.epilogue_bytes = 0.0;
+  result.total_bytes = 0.0;
+  return result;
+}
+
+// FC layer of weight m x k on a batch of n rows
+static BenchResult BenchFC(const std::string &suite, const std::string &name, size_t m, size_t n, size_t k,
+                           size_t threads, size_t repeat) {
+  size_t aligned_m = GetAlignmentLength(m, FC_SHUFFLE_KERNEL_M);
+  size_t aligned_n = GetAlignmentLength(n, FC_SHUFFLE_KERNEL_N);
+  size_t aligned_k = GetAlignmentLength(k, FC_SHUFFLE_KERNEL_K);
+  bool gemv = (n <= FC_GEMV_MAX_BATCH);
+  BenchResult result = NewResult(suite, name, gemv ? "shuffle_fc_gemv" : "shuffle_fc", threads, n, m, n, k);
+  BenchBuffer weight(m * k);
+  BenchBuffer data(n * k, 0.0f, 4.0f);
+  BenchBuffer bias(m);
+  BenchBuffer out(m * n);
+
+  FCOp op;
+  op.SetupFCKernelParameter(NCHW, m, k, SHUFFLE_FC);
+  op.InitWeight(weight.data_);
+  result.total_ms = MedianMs([&]() { op.Execute(out.data_, data.data_, bias.data_, n, k); }, repeat);
+  result.sgemm_ms = SgemmMs(m, n, k, repeat);
+
+  // the GEMV path quantizes the batch rows unpadded and never runs ConvShuffleGEMM, so it has no phases to split
+  if (!gemv) {
+    BenchBuffer quantized_weight((aligned_m * aligned_k + 3) / 4);
+    BenchBuffer weight_min(aligned_m), weight_max(aligned_m), weight_ratio(aligned_m);
+    BenchBuffer kernel_sum(aligned_m);
+    shuffle::PadQuantizeShuffle2D<float, FC_SHUFFLE_KERNEL_M, FC_SHUFFLE_KERNEL_K>(
+        quantized_weight.As<int8_t>(), m, k, aligned_m, aligned_k, weight.data_, weight_min.data_, weight_max.data_,
+        weight_ratio.data_, 64.0f);
+    ComputeMatrixSumPerRow<float>(kernel_sum.data_, weight.data_, m, k);
+    BenchBuffer quantized_data((aligned_n * aligned_k + 3) / 4);
+    BenchBuffer data_min(aligned_n), data_max(aligned_n), data_ratio(aligned_n);
+    result.quantize_ms = MedianMs(
+        [&]() {
+          shuffle::PadQuantizeShuffle2D<float, FC_SHUFFLE_KERNEL_N, FC_SHUFFLE_KERNEL_K>(
+              quantized_data.As<uint8_t>(), n, k, aligned_n, aligned_k, data.data_, data_min.data_, data_max.data_,
+              data_ratio.data_, 127.0f);
+        },
+        repeat);
+    result.im2col_ms = 0.0;
+    result.gemm_ms = MedianMs(
+        [&]() {
+          shuffle::ConvShuffleGEMM<FC_SHUFFLE_KERNEL_M, FC_SHUFFLE_KERNEL_N, FC_SHUFFLE_KERNEL_K, NCHW>(
+              quantized_weight.As<int8_t>(), quantized_data.As<uint8_t>(), out.data_, aligned_m, aligned_n, aligned_k,
+              weight_ratio.data_, data_ratio.data_, kernel_sum.data_, data_min.data_, NULL, n, 1, m, 0, 1, 1, 0.5,
+              aligned_m - m, aligned_n - n);
+        },
+        repeat);
+    double fused_ms = MedianMs(
+        [&]() {
+          shuffle::ConvShuffleGEMM<FC_SHUFFLE_KERNEL_M, FC_SHUFFLE_KERNEL_N, FC_SHUFFLE_KERNEL_K, NCHW>(
+              quantized_weight.As<int8_t>(), quantized_data.As<uint8_t>(), out.data_, aligned_m, aligned_n, aligned_k,
+              weight_ratio.data_, data_ratio.data_, kernel_sum.data_, data_min.data_, bias.data_, n, 1, m, 0, 1, 1,
+              0.5, aligned_m - m, aligned_n - n);
+        },
+        repeat);
+    result.epilogue_ms = std::max(0.0, fused_ms - result.gemm_ms);
+  }
+  result.quantize_bytes = QuantizeBytes(n, k, gemv ? n : aligned_n, aligned_k);
+  result.gemm_bytes = GemmBytes(aligned_m, gemv ? n : aligned_n, aligned_k, m, n);
+  result.epilogue_bytes = 4.0 * m;
+  result.total_bytes = result.quantize_bytes + result.gemm_bytes + result.epilogue_bytes;
+  return result;
+}
+
+// NHWC convolution with the bias, relu and residual sum of a ResNet block
+static BenchResult BenchConv(const std::string &suite, const ConvLayer &layer, size_t batch, size_t threads,
+                             size_t repeat) {
+  size_t out_size = GetConvOutSize(layer.size, layer.kernel, layer.stride, layer.pad, 1);
+  size_t m = layer.channel_out / layer.groups;
+  size_t n = batch * out_size * out_size;
+  size_t k = layer.channel_in / layer.groups * layer.kernel * layer.kernel;
+  size_t pixels = batch * layer.size * layer.size;
+  bool depthwise = (layer.groups > 1);
+  BenchResult result = NewResult(suite, layer.name, depthwise ? "depthwise" : "shuffle", threads, batch, m, n, k);
+  BenchBuffer weight(layer.channel_out * k);
+  BenchBuffer data(pixels * layer.channel_in, 0.0f, 4.0f);
+  BenchBuffer bias(layer.channel_out);
+  BenchBuffer residual(n * layer.channel_out);
+  BenchBuffer out(n * layer.channel_out);
+
+  size_t fusion = depthwise ? FUSION_RELU : (FUSION_RELU | FUSION_SUM);
+  ConvOp op;
+  op.SetupConvolutionParameter(NHWC, layer.channel_out, layer.channel_in, layer.groups, layer.kernel, layer.kernel,
+                               layer.stride, layer.stride, layer.pad, layer.pad, 1, 1, fusion,
+                               depthwise ? DEPTHWISE_CONV : SHUFFLE_CONV);
+  op.InitWeight(weight.data_);
+  result.total_ms = MedianMs(
+      [&]() {
+        op.Execute(out.data_, data.data_, bias.data_, residual.data_, batch, layer.channel_in, layer.size, layer.size);
+      },
+      repeat);
+
+  if (depthwise) {
+    // direct convolution, no GEMM to split or to compare with sgemm
+    result.total_bytes = 4.0 * pixels * layer.channel_in + 4.0 * n * layer.channel_out + 4.0 * layer.channel_out * k;
+    return result;
+  }
+  result.sgemm_ms = SgemmMs(m, n, k, repeat);
+
+  size_t aligned_m = GetAlignmentLength(m, CONV_SHUFFLE_KERNEL_M);
+  size_t aligned_n = GetAlignmentLength(n, CONV_SHUFFLE_KERNEL_N);
+  size_t aligned_k = GetAlignmentLength(k, CONV_SHUFFLE_KERNEL_K);
+  BenchBuffer quantized_weight((aligned_m * aligned_k + 3) / 4);
+  BenchBuffer weight_min(aligned_m), weight_max(aligned_m), weight_ratio(aligned_m);
+  BenchBuffer kernel_sum(aligned_m);
+  shuffle::PadQuantizeShuffle2D<float, CONV_SHUFFLE_KERNEL_M, CONV_SHUFFLE_KERNEL_K>(
+      quantized_weight.As<int8_t>(), m, k, aligned_m, aligned_k, weight.data_, weight_min.data_, weight_max.data_,
+      weight_ratio.data_, 64.0f);
+  ComputeMatrixSumPerRow<float>(kernel_sum.data_, weight.data_, m, k);
+
+  size_t aligned_pixels = GetAlignmentLength(pixels, CONV_SHUFFLE_KERNEL_N);
+  size_t aligned_channel_in = GetAlignmentLength(layer.channel_in, CONV_SHUFFLE_KERNEL_K);
+  BenchBuffer quantized_pixels((aligned_pixels * aligned_channel_in + 3) / 4);
+  BenchBuffer pixel_min(aligned_pixels), pixel_max(aligned_pixels), pixel_ratio(aligned_pixels);
+  result.quantize_ms = MedianMs(
+      [&]() {
+        shuffle::PadQuantizeShuffle2D<float, CONV_SHUFFLE_KERNEL_N, CONV_SHUFFLE_KERNEL_K>(
+            quantized_pixels.As<uint8_t>(), pixels, layer.channel_in, aligned_pixels, aligned_channel_in, data.data_,
+            pixel_min.data_, pixel_max.data_, pixel_ratio.data_, 127.0f);
+      },
+      repeat);
+
+  BenchBuffer quantized_data((aligned_n * aligned_k + 3) / 4);
+  BenchBuffer data_min(aligned_n), data_max(aligned_n), data_ratio(aligned_n);
+  bool pointwise = (layer.kernel == 1) && (layer.stride == 1) && (layer.pad == 0);
+  if (pointwise) {
+    // the fused pass is the quantize itself, so its columns are the quantized pixels
+    result.im2col_ms = 0.0;
+    std::memcpy(quantized_data.data_, quantized_pixels.data_, aligned_n * aligned_k);
+    std::memcpy(data_min.data_, pixel_min.data_, n * sizeof(float));
+    std::memcpy(data_ratio.data_, pixel_ratio.data_, n * sizeof(float));
+  } else {
+    size_t scratch_size = shuffle::PadQuantizeShuffleNHWCIm2colScratchSize<float>(
+        batch, layer.channel_in, 1, layer.size, layer.size, layer.kernel, layer.pad, layer.stride, 1, false);
+    std::vector<float *> scratch(GetThreadsNumWrapper());
+    for (size_t t = 0; t < scratch.size(); ++t) {
+      aligned_malloc(reinterpret_cast<void **>(&scratch[t]), 64, std::max<size_t>(1, scratch_size) * sizeof(float));
+    }
+    uint8_t *data_col[] = {quantized_data.As<uint8_t>()};
+    float *min[] = {data_min.data_};
+    float *max[] = {data_max.data_};
+    float *ratio[] = {data_ratio.data_};
+    double fused_ms = MedianMs(
+        [&]() {
+          shuffle::PadQuantizeShuffleIm2colWrapper<float, NHWC>(
+              data.data_, batch, layer.channel_in, 1, layer.size, layer.size, layer.kernel, layer.kernel, layer.pad,
+              layer.pad, layer.stride, layer.stride, 1, 1, data_col, min, max, ratio, scratch.data(), 127.0f, false);
+        },
+        repeat);
+    result.im2col_ms = std::max(0.0, fused_ms - result.quantize_ms);
+    for (size_t t = 0; t < scratch.size(); ++t) {
+      aligned_free(scratch[t]);
+    }
+  }
+
+  result.gemm_ms = MedianMs(
+      [&]() {
+        shuffle::ConvShuffleGEMM<CONV_SHUFFLE_KERNEL_M, CONV_SHUFFLE_KERNEL_N, CONV_SHUFFLE_KERNEL_K, NHWC>(
+            quantized_weight.As<int8_t>(), quantized_data.As<uint8_t>(), out.data_, aligned_m, aligned_n, aligned_k,
+            weight_ratio.data_, data_ratio.data_, kernel_sum.data_, data_min.data_, NULL, batch, 1, m, 0, out_size,
+            out_size, 0.5, aligned_m - m, aligned_n - n);
+      },
+      repeat);
+  double fused_ms = MedianMs(
+      [&]() {
+        shuffle::ConvShuffleGEMM<CONV_SHUFFLE_KERNEL_M, CONV_SHUFFLE_KERNEL_N, CONV_SHUFFLE_KERNEL_K, NHWC>(
+            quantized_weight.As<int8_t>(), quantized_data.As<uint8_t>(), out.data_, aligned_m, aligned_n, aligned_k,
+            weight_ratio.data_, data_ratio.data_, kernel_sum.data_, data_min.data_, bias.data_, batch, 1, m, 0,
+            out_size, out_size, 0.5, aligned_m - m, aligned_n - n, true, false, false, false, NULL, NULL, NULL, NULL,
+            residual.data_);
+      },
+      repeat);
+  result.epilogue_ms = std::max(0.0, fused_ms - result.gemm_ms);
+
+  result.quantize_bytes = QuantizeBytes(pixels, layer.channel_in, aligned_pixels, aligned_channel_in);
+  result.im2col_bytes = pointwise ? 0.0 : 4.0 * pixels * layer.channel_in + 1.0 * aligned_n * aligned_k + 12.0 * n;
+  result.gemm_bytes = GemmBytes(aligned_m, aligned_n, aligned_k, m, n);
+  result.epilogue_bytes = 4.0 * m + 4.0 * m * n;
+  result.total_bytes = (pointwise ? result.quantize_bytes : result.im2col_bytes) + result.gemm_bytes +
+                       result.epilogue_bytes;
+  return result;
+}
+
+// ConvOp::Execute alone with the bias, relu and residual sum of a ResNet block, for comparing whole algorithms
+static BenchResult BenchConvAlgo(const std::string &suite, const ConvLayer &layer, CONV_ALGORITHM algo,
+                                 const char *algo_name, size_t batch, size_t threads, size_t repeat) {
+  size_t out_size = GetConvOutSize(layer.size, layer.kernel, layer.stride, layer.pad, 1);
+  size_t m = layer.channel_out;
+  size_t n = batch * out_size * out_size;
+  size_t k = layer.channel_in * layer.kernel * layer.kernel;
+  size_t pixels = batch * layer.size * layer.size;
+  BenchResult result = NewResult(suite, layer.name, algo_name, threads, batch, m, n, k);
+  BenchBuffer weight(m * k);
+  BenchBuffer data(pixels * layer.channel_in, 0.0f, 4.0f);
+  BenchBuffer bias(m);
+  BenchBuffer residual(n * m);
+  BenchBuffer out(n * m);
+  ConvOp op;
+  op.SetupConvolutionParameter(NHWC, layer.channel_out, layer.channel_in, 1, layer.kernel, layer.kernel, layer.stride,
+                               layer.stride, layer.pad, layer.pad, 1, 1, FUSION_RELU | FUSION_SUM, algo);
+  op.InitWeight(weight.data_);
+  result.total_ms = MedianMs(
+      [&]() {
+        op.Execute(out.data_, data.data_, bias.data_, residual.data_, batch, layer.channel_in, layer.size, layer.size);
+      },
+      repeat);
+  result.total_bytes = 4.0 * pixels * layer.channel_in + 8.0 * n * m + 4.0 * m * k;
+  return result;
+}
+
+// TransformLayout of a batch x channels x pixels activation into a 64B aligned buffer like the op workspaces
+static BenchResult BenchLayout(const std::string &suite, LAYOUT dst_layout, size_t batch, size_t channels,
+                               size_t pixels, size_t threads, size_t repeat) {
+  LAYOUT src_layout = (dst_layout == NHWC) ? NCHW : NHWC;
+  std::stringstream name;
+  name << batch << "x" << channels << "x" << pixels;
+  BenchResult result = NewResult(suite, name.str(), (dst_layout == NHWC) ? "nchw_to_nhwc" : "nhwc_to_nchw", threads,
+                                 batch, batch, channels, pixels);
+  BenchBuffer src(batch * channels * pixels);
+  BenchBuffer dst(batch * channels * pixels);
+  result.total_ms = MedianMs(
+      [&]() { TransformLayout<float>(dst_layout, src_layout, dst.data_, src.data_, batch, channels, pixels); },
+      repeat);
+  result.total_bytes = 8.0 * batch * channels * pixels;
+  return result;
+}
+
+static void WriteTime(std::ostream &os, const char *key, double ms) {
+  os << "\"" << key << "\": ";
+  if (ms < 0.0) {
+    os << "null";
+  } else {
+    os << ms;
+  }
+}
+
+static void WriteResult(std::ostream &os, const BenchResult &r) {
+  double gop = 2.0 * r.m * r.n * r.k * 1.0e-9;
+  os << "    {\"suite\": \"" << r.suite << "\", \"name\": \"" << r.name << "\", \"algo\": \"" << r.algo
+     << "\", \"threads\": " << r.threads << ", \"batch\": " << r.batch << ", \"m\": " << r.m << ", \"n\": " << r.n
+     << ", \"k\": " << r.k << ",\n     \"time_ms\": {";
+  WriteTime(os, "quantize", r.quantize_ms);
+  os << ", ";
+  WriteTime(os, "im2col", r.im2col_ms);
+  os << ", ";
+  WriteTime(os, "gemm", r.gemm_ms);
+  os << ", ";
+  WriteTime(os, "epilogue", r.epilogue_ms);
+  os << ", ";
+  WriteTime(os, "total", r.total_ms);
+  os << "},\n     \"bytes\": {\"quantize\": " << static_cast<uint64_t>(r.quantize_bytes)
+     << ", \"im2col\": " << static_cast<uint64_t>(r.im2col_bytes)
+     << ", \"gemm\": " << static_cast<uint64_t>(r.gemm_bytes)
+     << ", \"epilogue\": " << static_cast<uint64_t>(r.epilogue_bytes)
+     << ", \"total\": " << static_cast<uint64_t>(r.total_bytes)
+     << "},\n     \"gops\": " << gop / (r.total_ms * 1.0e-3) << ", \"gemm_gops\": ";
+  if (r.gemm_ms > 0.0) {
+    os << gop / (r.gemm_ms * 1.0e-3);
+  } else {
+    os << "null";
+  }
+  os << ", \"gbytes_per_s\": " << r.total_bytes * 1.0e-9 / (r.total_ms * 1.0e-3) << ", ";
+  WriteTime(os, "sgemm_ms", r.sgemm_ms);
+  os << ", \"sgemm_gops\": ";
+  if (r.sgemm_ms > 0.0) {
+    os << gop / (r.sgemm_ms * 1.0e-3);
+  } else {
+    os << "null";
+  }
+  os << "}";
+}
+
+static std::vector<size_t> ParseSizes(const std::string &list) {
+  std::vector<size_t> sizes;
+  std::stringstream ss(list);
+  std::string item;
+  while (std::getline(ss, item, ',')) {
+    if (!item.empty()) {
+      sizes.push_back(std::strtoul(item.c_str(), NULL, 10));
+    }
+  }
+  return sizes;
+}
+
+static std::vector<std::string> ParseNames(const std::string &list) {
+  std::vector<std::string> names;
+  std::stringstream ss(list);
+  std::string item;
+  while (std::getline(ss, item, ',')) {
+    if (item == "all") {
+      names.push_back("gemm");
+      names.push_back("resnet50");
+      names.push_back("mobilenet");
+      names.push_back("winograd");
+      names.push_back("layout");
+    } else if (!item.empty()) {
+      names.push_back(item);
+    }
+  }
+  return names;
+}
+
+static void Usage(const char *prog) {
+  std::cerr << "usage: " << prog << " [--suite=gemm,googlenet,resnet50,mobilenet,winograd,layout,all]"
+            << " [--threads=1,N] [--repeat=5] [--batch=1] [--max-gflop=50] [--out=file.json]" << std::endl
+            << "  --max-gflop skips the GEMM shapes above that many GFLOP, 0 keeps them all" << std::endl;
+}
+
+static bool ParseOptions(int argc, char *argv[], BenchOptions &options) {
+  size_t max_threads = GetThreadsNumWrapper();
+  options.threads.push_back(1);
+  if (max_threads > 1) {
+    options.threads.push_back(max_threads);
+  }
+  options.suites = ParseNames("all");
+  options.repeat = 5;
+  options.batch = 1;
+  options.max_gflop = 50.0;
+  for (int i = 1; i < argc; ++i) {
+    std::string arg(argv[i]);
+    size_t eq = arg.find('=');
+    std::string key = arg.substr(0, eq);
+    std::string value = (eq == std::string::npos) ? "" : arg.substr(eq + 1);
+    if (key == "--threads") {
+      options.threads = ParseSizes(value);
+    } else if (key == "--suite") {
+      options.suites = ParseNames(value);
+    } else if (key == "--repeat") {
+      options.repeat = std::max<size_t>(1, std::strtoul(value.c_str(), NULL, 10));
+    } else if (key == "--batch") {
+      options.batch = std::max<size_t>(1, std::strtoul(value.c_str(), NULL, 10));
+    } else if (key == "--max-gflop") {
+      options.max_gflop = std::strtod(value.c_str(), NULL);
+    } else if (key == "--out") {
+      options.out = value;
+    } else {
+      Usage(argv[0]);
+      return false;
+    }
+  }
+  return !options.threads.empty();
+}
+
+static void RunNetwork(const std::string &suite, const ConvLayer *layers, size_t count, const BenchOptions &options,
+                       size_t threads, std::vector<BenchResult> &results) {
+  for (size_t i = 0; i < count; ++i) {
+    const ConvLayer &layer = layers[i];
+    if (layer.size == 1) {
+      results.push_back(BenchFC(suite, layer.name, layer.channel_out, options.batch, layer.channel_in, threads,
+                                options.repeat));
+    } else {
+      results.push_back(BenchConv(suite, layer, options.batch, threads, options.repeat));
+    }
+    std::cerr << suite << " " << layer.name << " threads " << threads << ": " << results.back().total_ms << "ms"
+              << std::endl;
+  }
+}
+
+int main(int argc, char *argv[]) {
+  BenchOptions options;
+  size_t max_threads = GetThreadsNumWrapper();
+  if (!ParseOptions(argc, argv, options)) {
+    return 1;
+  }
+  std::vector<BenchResult> results;
+  for (size_t t = 0; t < options.threads.size(); ++t) {
+    size_t threads = options.threads[t];
+    SetThreads(threads);
+    for (size_t s = 0; s < options.suites.size(); ++s) {
+      const std::string &suite = options.suites[s];
+      if (suite == "gemm" || suite == "googlenet") {
+        std::vector<std::vector<size_t>> shapes = GemmShapes(suite == "googlenet");
+        for (size_t i = 0; i < shapes.size(); ++i) {
+          size_t m = shapes[i][0], n = shapes[i][1], k = shapes[i][2];
+          if (options.max_gflop > 0.0 && 2.0 * m * n * k * 1.0e-9 > options.max_gflop) {
+            continue;
+          }
+          std::stringstream name;
+          name << m << "x" << n << "x" << k;
+          results.push_back(BenchFC(suite, name.str(), m, n, k, threads, options.repeat));
+          std::cerr << suite << " " << name.str() << " threads " << threads << ": " << results.back().total_ms
+                    << "ms" << std::endl;
+        }
+      } else if (suite == "resnet50") {
+        RunNetwork(suite, kResNet50, sizeof(kResNet50) / sizeof(kResNet50[0]), options, threads, results);
+      } else if (suite == "mobilenet") {
+        RunNetwork(suite, kMobileNet, sizeof(kMobileNet) / sizeof(kMobileNet[0]), options, threads, results);
+      } else if (suite == "winograd") {
+        for (size_t i = 0; i < sizeof(kResNet50) / sizeof(kResNet50[0]); ++i) {
+          const ConvLayer &layer = kResNet50[i];
+          if ((layer.kernel != 3) || (layer.stride != 1) || (layer.groups != 1)) {
+            continue;
+          }
+          results.push_back(BenchConvAlgo(suite, layer, SHUFFLE_CONV, "shuffle", options.batch, threads,
+                                          options.repeat));
+          results.push_back(BenchConvAlgo(suite, layer, WINOGRAD_CONV, "winograd", options.batch, threads,
+                                          options.repeat));
+          std::cerr << suite << " " << layer.name << " threads " << threads << ": shuffle "
+                    << results[results.size() - 2].total_ms << "ms, winograd " << results.back().total_ms << "ms"
+                    << std::endl;
+        }
+      } else if (suite == "layout") {
+        size_t shapes[][3] = {{1, 3, 224 * 224}, {1, 64, 56 * 56}, {1, 128, 28 * 28}, {1, 256, 14 * 14},
+                              {1, 512, 7 * 7},   {32, 64, 56 * 56}, {32, 256, 14 * 14}};
+        for (size_t i = 0; i < sizeof(shapes) / sizeof(shapes[0]); ++i) {
+          for (size_t direction = 0; direction < 2; ++direction) {
+            results.push_back(BenchLayout(suite, (direction == 0) ? NHWC : NCHW, shapes[i][0], shapes[i][1],
+                                          shapes[i][2], threads, options.repeat));
+            std::cerr << suite << " " << results.back().name << " " << results.back().algo << " threads " << threads
+                      << ": " << results.back().total_ms << "ms" << std::endl;
+          }
+        }
+      } else {
+        std::cerr << "unknown suite " << suite << std::endl;
+        Usage(argv[0]);
+        return 1;
+      }
+    }
+  }
+
+  std::ofstream file;
+  if (!options.out.empty()) {
+    file.open(options.out.c_str());
+  }
+  std::ostream &os = options.out.empty() ? std::cout : file;
+  os << "{\n  \"build\": {\"isa\": \"" << GetISAName() << "\", \"version\": \"";
+#ifdef GIT_VERSION
+  os << GIT_VERSION;
+#endif
+  os << "\", \"max_threads\": " << max_threads << ", \"repeat\": " << options.repeat
+     << ", \"sgemm\": " <<
+#ifdef BENCHMARK_SGEMM
+      "\"openblas\""
+#else
+      "null"
+#endif
+     << "},\n  \"results\": [\n";
+  for (size_t i = 0; i < results.size(); ++i) {
+    WriteResult(os, results[i]);
+    os << (i + 1 < results.size() ? ",\n" : "\n");
+  }
+  os << "  ]\n}\n";
+  return 0;
+}
@@ -20,8 +20,33 @@
 #include <stdint.h>
 
 typedef enum LAYOUT { NCHW = 0, NHWC = 1 } LAYOUT;
-typedef enum CONV_ALGORITHM { AUTO_SELECT_CONV = 0, SHUFFLE_CONV = 1 } CONV_ALGORITHM;
+typedef enum CONV_ALGORITHM {
+  AUTO_SELECT_CONV = 0,
+  SHUFFLE_CONV = 1,
+  DEPTHWISE_CONV = 2,
+  WINOGRAD_CONV = 3,      // F(2x2, 3x3), 3x3 stride 1 dilation 1 group 1 only
+  // 4 is not used: an int8 F(4x4, 3x3) is off by tens of percent of the largest output
+  IMPLICIT_GEMM_CONV = 5  // SHUFFLE_CONV quantizing im2col panels per thread, workspace independent of the input size
+} CONV_ALGORITHM;
 typedef enum FC_ALGORITHM { AUTO_SELECT_FC = 0, SHUFFLE_FC = 1 } FC_ALGORITHM;
+// Bits of the convolution fusion_mask. The fused epilogue runs conv + bias -> BN -> residual sum -> ReLU.
+typedef enum FUSION_MASK { FUSION_NONE = 0, FUSION_RELU = 1, FUSION_BN = 2, FUSION_SUM = 4 } FUSION_MASK;
+typedef enum POOL_MODE { MAX_POOL = 0, AVG_POOL = 1 } POOL_MODE;
+// How calibration derives the static input range of a layer from the inputs it observed
+typedef enum CALIBRATION_MODE { CALIBRATION_MINMAX = 0, CALIBRATION_PERCENTILE = 1 } CALIBRATION_MODE;
+// Performance counters: whole ops first, then the phases they run. A phase is counted wherever it runs, e.g. PERF_GEMM
+// covers the GEMMs of convolutions, FCs and MixPrecisionGEMM alike.
+typedef enum PERF_COUNTER {
+  PERF_CONV_OP = 0,
+  PERF_FC_OP = 1,
+  PERF_GRAPH = 2,
+  PERF_MIX_PRECISION_GEMM = 3,
+  PERF_QUANTIZE = 4,
+  PERF_IM2COL = 5,
+  PERF_GEMM = 6,
+  PERF_LAYOUT_TRANSFORM = 7,
+  PERF_COUNTER_NUM = 8
+} PERF_COUNTER;
 
 struct FPTensorDesc {
   void *data;
@@ -42,12 +67,25 @@ struct QuantizedTensorDesc {
   size_t workspace_size;
 };
 
+// Totals of one PERF_COUNTER since the counters were last reset. ops counts every multiply-add of a GEMM as two
+// operations, so ops / nanoseconds is GOPS. bytes is the quantized output of PERF_QUANTIZE and PERF_IM2COL and the
+// float data moved by PERF_LAYOUT_TRANSFORM.
+struct PerfCounterValue {
+  uint64_t calls;
+  uint64_t nanoseconds;
+  uint64_t ops;
+  uint64_t bytes;
+};
+
 struct QuantizedConvOp;
 typedef struct QuantizedConvOp QuantizedConvOp;
 
 struct QuantizedFCOp;
 typedef struct QuantizedFCOp QuantizedFCOp;
 
+struct QuantizedGraph;
+typedef struct QuantizedGraph QuantizedGraph;
+
 #ifdef WINDOWS
 #define API_PREFIX __declspec(dllexport)
 #else
@@ -70,9 +108,80 @@ API_PREFIX void QuantizedConvOpSetupConvParameter(QuantizedConvOp *p, LAYOUT lay
 
 API_PREFIX void QuantizedConvOpInitWeight(QuantizedConvOp *p, float *weight);
 
+API_PREFIX void QuantizedConvOpSetupBNParameter(QuantizedConvOp *p, float *mean, float *variance, float *scale,
+                                                float *shift, float eps);
+
+// Execute may be called from several threads on the same op; each calling thread keeps its own workspace and GEMM
+// plans, freed when the thread exits, while the packed weights are shared. Setup and InitWeight must not run
+// concurrently with it.
 API_PREFIX void QuantizedConvOpExecute(QuantizedConvOp *p, float *dst, float *data, float *bias, size_t batch_size,
                                        size_t channel_in, size_t height_in, size_t width_in);
 
+// residual has the shape and layout of dst and may alias it. Requires FUSION_SUM in the fusion_mask.
+API_PREFIX void QuantizedConvOpExecuteWithResidual(QuantizedConvOp *p, float *dst, float *data, float *bias,
+                                                   float *residual, size_t batch_size, size_t channel_in,
+                                                   size_t height_in, size_t width_in);
+
+// Stores saturate(round(y / scale) + zero_point) as uint8 for every element y of the fused float output, in the layout
+// of that output, so the next layer doesn't have to find the range of a float tensor and quantize it again. residual
+// may be NULL without FUSION_SUM. SHUFFLE_CONV and IMPLICIT_GEMM_CONV requantize in their epilogue; the other
+// algorithms write the float output to a per-thread buffer and requantize it in a separate pass.
+API_PREFIX void QuantizedConvOpExecuteRequantized(QuantizedConvOp *p, uint8_t *dst, float scale, float zero_point,
+                                                  float *data, float *bias, float *residual, size_t batch_size,
+                                                  size_t channel_in, size_t height_in, size_t width_in);
+
+// Bytes dst needs for QuantizedConvOpExecuteRequantized, one per element of the float output.
+API_PREFIX size_t QuantizedConvOpGetRequantizedOutputSize(QuantizedConvOp *p, size_t batch_size, size_t height_in,
+                                                          size_t width_in);
+
+// Runs the op once on synthetic input of the given shape. Workspace, GEMM plans and (AUTO_SELECT_CONV) the tuning
+// result are then ready before the first Execute of that shape on the calling thread. Call it for every layer of a
+// model after InitWeight.
+API_PREFIX void QuantizedConvOpWarmUp(QuantizedConvOp *p, size_t batch_size, size_t channel_in, size_t height_in,
+                                      size_t width_in);
+
+// Static input quantization. After StartCalibration every Execute also records its input, e.g. over a few sample
+// batches, until FinishCalibration turns them into one range: all of them, or with CALIBRATION_PERCENTILE without the
+// (100 - percentile)% most extreme values at either end. SHUFFLE_CONV then quantizes every input with that range
+// instead of finding the range of every pixel; values outside it saturate.
+API_PREFIX void QuantizedConvOpStartCalibration(QuantizedConvOp *p, CALIBRATION_MODE mode, float percentile);
+
+API_PREFIX void QuantizedConvOpFinishCalibration(QuantizedConvOp *p);
+
+// The static input range, e.g. of a saved calibration. It is widened to contain 0; min == max means dynamic
+// quantization again. Get returns 0 and leaves min and max alone when the op quantizes dynamically.
+API_PREFIX void QuantizedConvOpSetInputRange(QuantizedConvOp *p, float min, float max);
+
+API_PREFIX int QuantizedConvOpGetInputRange(QuantizedConvOp *p, float *min, float *max);
+
+// Packed model files. Save writes the layer descriptor, static input range, BN parameters and the quantized, padded
+// and shuffled weights with their ranges and kernel sums. Load maps the file and executes from those weights in place,
+// so nothing is quantized again and processes loading the same file share its pages. Only a library of the same ISA
+// and format version as the saving one loads the file. Biases are passed to Execute and not saved. Save returns 0 or
+// -1, Load NULL when the file cannot be read or was written by another build.
+API_PREFIX int QuantizedConvOpSavePacked(QuantizedConvOp *p, const char *path);
+
+API_PREFIX QuantizedConvOp *QuantizedConvOpLoadPacked(const char *path);
+
+// Frees the workspace of the calling thread, the only one it can know is not in use. Saved bytes count the reuse on
+// that thread.
+API_PREFIX void QuantizedConvOpShrinkWorkspace(QuantizedConvOp *p);
+
+API_PREFIX size_t QuantizedConvOpGetWorkspaceSavedBytes(QuantizedConvOp *p);
+
+// Bytes of workspace ExecuteWithWorkspace needs for an input shape at the current OpenMP thread count.
+// ExecuteWithWorkspace carves the temporaries out of workspace instead of the op's own buffers, which it releases; it
+// returns -1 without executing when workspace_size is too small, else 0. Concurrent callers need a buffer each. It is
+// not free of heap allocations: the first call on a thread allocates the thread's context, and the first call for an
+// input shape its GEMM plan and tuning. QuantizedConvOpWarmUp on the same thread makes them ahead of time.
+API_PREFIX size_t QuantizedConvOpGetWorkspaceSize(QuantizedConvOp *p, size_t batch_size, size_t channel_in,
+                                                  size_t height_in, size_t width_in);
+
+API_PREFIX int QuantizedConvOpExecuteWithWorkspace(QuantizedConvOp *p, void *workspace, size_t workspace_size,
+                                                   float *dst, float *data, float *bias, float *residual,
+                                                   size_t batch_size, size_t channel_in, size_t height_in,
+                                                   size_t width_in);
+
 API_PREFIX void QuantizedConvOpFree(QuantizedConvOp *p);
 
 API_PREFIX QuantizedFCOp *QuantizedFCOpCreate();
@@ -82,14 +191,140 @@ API_PREFIX void QuantizedFCOpSetupFCParameter(QuantizedFCOp *p, LAYOUT layout, s
 
 API_PREFIX void QuantizedFCOpInitWeight(QuantizedFCOp *p, float *weight);
 
+// Thread-safe like QuantizedConvOpExecute
 API_PREFIX void QuantizedFCOpExecute(QuantizedFCOp *p, float *dst, float *data, float *bias, size_t batch_size,
                                      size_t channel_in);
 
+API_PREFIX void QuantizedFCOpWarmUp(QuantizedFCOp *p, size_t batch_size, size_t channel_in);
+
+// Static input quantization of SHUFFLE_FC, see QuantizedConvOpStartCalibration
+API_PREFIX void QuantizedFCOpStartCalibration(QuantizedFCOp *p, CALIBRATION_MODE mode, float percentile);
+
+API_PREFIX void QuantizedFCOpFinishCalibration(QuantizedFCOp *p);
+
+API_PREFIX void QuantizedFCOpSetInputRange(QuantizedFCOp *p, float min, float max);
+
+API_PREFIX int QuantizedFCOpGetInputRange(QuantizedFCOp *p, float *min, float *max);
+
+// See QuantizedConvOpSavePacked
+API_PREFIX int QuantizedFCOpSavePacked(QuantizedFCOp *p, const char *path);
+
+API_PREFIX QuantizedFCOp *QuantizedFCOpLoadPacked(const char *path);
+
+// See QuantizedConvOpShrinkWorkspace
+API_PREFIX void QuantizedFCOpShrinkWorkspace(QuantizedFCOp *p);
+
+API_PREFIX size_t QuantizedFCOpGetWorkspaceSavedBytes(QuantizedFCOp *p);
+
+// See QuantizedConvOpGetWorkspaceSize
+API_PREFIX size_t QuantizedFCOpGetWorkspaceSize(QuantizedFCOp *p, size_t batch_size, size_t channel_in);
+
+API_PREFIX int QuantizedFCOpExecuteWithWorkspace(QuantizedFCOp *p, void *workspace, size_t workspace_size, float *dst,
+                                                 float *data, float *bias, size_t batch_size, size_t channel_in);
+
 API_PREFIX void QuantizedFCOpFree(QuantizedFCOp *p);
 
+// A sequence of layers executed in one call, intermediate activations live in a few buffers reused according to their
+// liveness. Tensor 0 is the input of shape channel x height x width per image, every Add* returns the id of the tensor
+// it produces, and the last one added is the output of the graph. Weights and biases are copied. Once the
+// convolutions have static input ranges, e.g. after calibration, a convolution whose output is read only by the next
+// convolution, as its data, hands it over as uint8 requantized by the GEMM epilogue instead of as float.
+API_PREFIX QuantizedGraph *QuantizedGraphCreate(LAYOUT layout, size_t channel, size_t height, size_t width);
+
+// residual is the tensor summed in with FUSION_SUM, or -1
+API_PREFIX size_t QuantizedGraphAddConv(QuantizedGraph *p, size_t input, int residual, size_t channel_out,
+                                        size_t group, size_t kernel_h, size_t kernel_w, size_t stride_h,
+                                        size_t stride_w, size_t pad_h, size_t pad_w, size_t dilation_h,
+                                        size_t dilation_w, size_t fusion_mask, float *weight, float *bias,
+                                        CONV_ALGORITHM algo);
+
+// tensor is the output of a convolution added with FUSION_BN
+API_PREFIX void QuantizedGraphSetupConvBNParameter(QuantizedGraph *p, size_t tensor, float *mean, float *variance,
+                                                   float *scale, float *shift, float eps);
+
+// The input is flattened in the layout of the graph
+API_PREFIX size_t QuantizedGraphAddFC(QuantizedGraph *p, size_t input, size_t channel_out, float *weight, float *bias,
+                                      FC_ALGORITHM algo);
+
+API_PREFIX size_t QuantizedGraphAddPool(QuantizedGraph *p, size_t input, POOL_MODE mode, size_t kernel_h,
+                                        size_t kernel_w, size_t stride_h, size_t stride_w, size_t pad_h, size_t pad_w);
+
+API_PREFIX size_t QuantizedGraphAddSum(QuantizedGraph *p, size_t a, size_t b, int relu);
+
+API_PREFIX size_t QuantizedGraphAddReLU(QuantizedGraph *p, size_t input);
+
+// Elements of one image of the graph output
+API_PREFIX size_t QuantizedGraphGetOutputSize(QuantizedGraph *p);
+
+// Bytes of intermediate activations a batch of batch_size needs after buffer reuse, a byte per element of uint8 edges
+API_PREFIX size_t QuantizedGraphGetActivationBytes(QuantizedGraph *p, size_t batch_size);
+
+// Thread-safe like QuantizedConvOpExecute
+API_PREFIX void QuantizedGraphExecute(QuantizedGraph *p, float *dst, float *data, size_t batch_size);
+
+// Calibrates every convolution and FC of the graph on the batches executed in between, see
+// QuantizedConvOpStartCalibration
+API_PREFIX void QuantizedGraphStartCalibration(QuantizedGraph *p, CALIBRATION_MODE mode, float percentile);
+
+API_PREFIX void QuantizedGraphFinishCalibration(QuantizedGraph *p);
+
+// Save writes the static input ranges of the layers as text, a "tensor min max" line per layer keyed by the tensor it
+// produces. Load applies such a file to a graph built by the same Add* calls. Both return the layer count or -1.
+API_PREFIX int QuantizedGraphSaveCalibration(QuantizedGraph *p, const char *path);
+
+API_PREFIX int QuantizedGraphLoadCalibration(QuantizedGraph *p, const char *path);
+
+// Packed layers of the whole graph, including the topology and biases, see QuantizedConvOpSavePacked
+API_PREFIX int QuantizedGraphSavePacked(QuantizedGraph *p, const char *path);
+
+API_PREFIX QuantizedGraph *QuantizedGraphLoadPacked(const char *path);
+
+API_PREFIX void QuantizedGraphFree(QuantizedGraph *p);
+
+// AUTO_SELECT_CONV / AUTO_SELECT_FC tune on the first Execute of every input shape and cache the winner per process.
+// A convolution then frees the weights of the candidates that won no shape; later shapes choose among the rest.
+// Load merges a tuning file into that cache, Save writes the cache out; both return the record count or -1.
+// Setting BIGQUANT_TUNING_FILE loads the file at startup and appends new results to it.
+API_PREFIX int BigQuantLoadTuningFile(const char *path);
+
+API_PREFIX int BigQuantSaveTuningFile(const char *path);
+
+// Performance counters, see PERF_COUNTER and PerfCounterValue. They are off unless enabled here or by setting
+// BIGQUANT_PERF_COUNTERS=1; while off an instrumented call costs one relaxed atomic load. The totals are process
+// wide and updated atomically, so Executes running concurrently all add to them. Get returns 0, or -1 for a counter
+// outside PERF_COUNTER; GetName returns the metric name of a counter, e.g. "gemm", or NULL.
+API_PREFIX void BigQuantEnablePerfCounters(int enable);
+
+API_PREFIX int BigQuantPerfCountersEnabled();
+
+API_PREFIX void BigQuantResetPerfCounters();
+
+API_PREFIX int BigQuantGetPerfCounter(PERF_COUNTER counter, struct PerfCounterValue *value);
+
+API_PREFIX const char *BigQuantGetPerfCounterName(PERF_COUNTER counter);
+
+// Execution timeline: spans of the ops, their phases and the work each thread took, written as Chrome trace JSON
+// for chrome://tracing or Perfetto. Start drops what was recorded before; Stop ends tracing and writes the timeline
+// to path, or drops it when path is NULL, and returns the number of events written or -1 if the file cannot be
+// opened. Setting BIGQUANT_TRACE to a file traces from load and writes the file at exit.
+API_PREFIX void BigQuantStartTrace();
+
+API_PREFIX int BigQuantStopTrace(const char *path);
+
+// Instruction set the kernels run with: "avx512", "avx2" or "sse42". The runtime picks the widest one the CPU
+// supports when it is loaded; BIGQUANT_ISA set to one of these names picks a narrower one instead.
+API_PREFIX const char *BigQuantGetISA();
+
 API_PREFIX void QuantizedConvKernelDescInit(QuantizedTensorDesc *quantized_tensor, size_t c_out, size_t c_in,
                                             size_t kernel_h, size_t kernel_w);
 
+// The *DescInitWithWorkspace variants place the buffers of the descriptor in workspace, of at least
+// QuantizedTensorDescGetWorkspaceSize / FPTensorDescGetWorkspaceSize bytes, instead of allocating them. With a NULL
+// workspace they only set the shape for that query. Such descriptors must not be passed to FreeQuantizedTensor or
+// FreeFPTensor.
+API_PREFIX void QuantizedConvKernelDescInitWithWorkspace(QuantizedTensorDesc *quantized_tensor, void *workspace,
+                                                         size_t c_out, size_t c_in, size_t kernel_h, size_t kernel_w);
+
 API_PREFIX void QuantizedConvKernelInit(QuantizedTensorDesc *quantized_tensor, float *src, size_t c_out, size_t c_in,
                                         size_t kernel_h, size_t kernel_w, float threshold, LAYOUT layout);
 
@@ -102,15 +337,37 @@ API_PREFIX void QuantizedConvDataDescInit(QuantizedTensorDesc *quantized_tensor,
                                           size_t dilation_h, size_t dilation_w, size_t batch_size, size_t h_in,
                                           size_t w_in);
 
+API_PREFIX void QuantizedConvDataDescInitWithWorkspace(QuantizedTensorDesc *quantized_tensor, void *workspace,
+                                                       size_t c_in, size_t kernel_h, size_t kernel_w, size_t stride_h,
+                                                       size_t stride_w, size_t pad_h, size_t pad_w, size_t dilation_h,
+                                                       size_t dilation_w, size_t batch_size, size_t h_in, size_t w_in);
+
 API_PREFIX void QuantizedConvDataInit(QuantizedTensorDesc *quantized_tensor, float *src, size_t c_in, size_t kernel_h,
                                       size_t kernel_w, size_t stride_h, size_t stride_w, size_t pad_h, size_t pad_w,
                                       size_t dilation_h, size_t dilation_w, size_t batch_size, size_t h_in, size_t w_in,
                                       float threshold, LAYOUT layout);
 
+// QuantizedConvDataInit with the im2col scratch in workspace, of GetWorkspaceSize bytes at the current thread count
+API_PREFIX size_t QuantizedConvDataInitGetWorkspaceSize(size_t c_in, size_t kernel_h, size_t kernel_w, size_t stride_h,
+                                                        size_t stride_w, size_t pad_h, size_t pad_w, size_t dilation_h,
+                                                        size_t dilation_w, size_t batch_size, size_t h_in, size_t w_in,
+                                                        LAYOUT layout);
+
+API_PREFIX void QuantizedConvDataInitWithWorkspace(QuantizedTensorDesc *quantized_tensor, void *workspace, float *src,
+                                                   size_t c_in, size_t kernel_h, size_t kernel_w, size_t stride_h,
+                                                   size_t stride_w, size_t pad_h, size_t pad_w, size_t dilation_h,
+                                                   size_t dilation_w, size_t batch_size, size_t h_in, size_t w_in,
+                                                   float threshold, LAYOUT layout);
+
 API_PREFIX void QuantizedConvKernelSumDescInit(FPTensorDesc *fp_tensor, size_t c_out);
 
+API_PREFIX void QuantizedConvKernelSumDescInitWithWorkspace(FPTensorDesc *fp_tensor, void *workspace, size_t c_out);
+
 API_PREFIX void QuantizedConvKernelSumInit(FPTensorDesc *fp_tensor, float *src, size_t n, size_t c, size_t h, size_t w);
 
+API_PREFIX void QuantizedConvKernelSumLoadFromModel(FPTensorDesc *fp_tensor, int8_t *src, float *min, float *max,
+                                                    size_t c_out, size_t c_in, size_t kernel_h, size_t kernel_w);
+
 API_PREFIX void MixPrecisionGEMM(LAYOUT layout, int8_t *pa, uint8_t *pb, float *pc, size_t m, size_t n, size_t k,
                                  float *ratio_a, float *ratio_b, float *kernel_sum, float *min_b, float *bias,
                                  size_t batch_size, size_t channel_per_group, size_t height_out, size_t width_out,
@@ -118,6 +375,9 @@ API_PREFIX void MixPrecisionGEMM(LAYOUT layout, int8_t *pa, uint8_t *pb, float *
 
 API_PREFIX void QuantizedFCKernelDescInit(QuantizedTensorDesc *quantized_tensor, size_t c_out, size_t c_in);
 
+API_PREFIX void QuantizedFCKernelDescInitWithWorkspace(QuantizedTensorDesc *quantized_tensor, void *workspace,
+                                                       size_t c_out, size_t c_in);
+
 API_PREFIX void QuantizedFCKernelInit(QuantizedTensorDesc *quantized_tensor, float *src, size_t c_out, size_t c_in,
                                       float threshold, LAYOUT layout);
 
@@ -126,13 +386,26 @@ API_PREFIX void QuantizedFCKernelLoadFromModel(QuantizedTensorDesc *quantized_te
 
 API_PREFIX void QuantizedFCDataDescInit(QuantizedTensorDesc *quantized_tensor, size_t batch_size, size_t channel);
 
+API_PREFIX void QuantizedFCDataDescInitWithWorkspace(QuantizedTensorDesc *quantized_tensor, void *workspace,
+                                                     size_t batch_size, size_t channel);
+
 API_PREFIX void QuantizedFCDataInit(QuantizedTensorDesc *quantized_tensor, float *src, size_t batch_size,
                                     size_t channel, float threshold, LAYOUT layout);
 
 API_PREFIX void QuantizedFCKernelSumDescInit(FPTensorDesc *fp_tensor, size_t c_out);
 
+API_PREFIX void QuantizedFCKernelSumDescInitWithWorkspace(FPTensorDesc *fp_tensor, void *workspace, size_t c_out);
+
 API_PREFIX void QuantizedFCKernelSumInit(FPTensorDesc *fp_tensor, float *src, size_t c_out, size_t c_in);
 
+API_PREFIX void QuantizedFCKernelSumLoadFromModel(FPTensorDesc *fp_tensor, int8_t *src, float *min, float *max,
+                                                  size_t c_out, size_t c_in);
+
+// Bytes of workspace for a descriptor set up by a *DescInitWithWorkspace variant
+API_PREFIX size_t QuantizedTensorDescGetWorkspaceSize(const QuantizedTensorDesc *quantized_tensor);
+
+API_PREFIX size_t FPTensorDescGetWorkspaceSize(const FPTensorDesc *fp_tensor);
+
 API_PREFIX void FreeFPTensor(struct FPTensorDesc *p);
 
 API_PREFIX void FreeQuantizedTensor(struct QuantizedTensorDesc *p);
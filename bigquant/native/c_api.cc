@@ -19,9 +19,12 @@
 #include "common.h"
 #include "alloc.h"
 #include "model.h"
+#include "perf_counters.h"
+#include "trace.h"
 #include "ops/ops.h"
 #include "nn/convolution_op.h"
 #include "nn/fc_op.h"
+#include "nn/graph.h"
 
 // The following is Descriptor based APU
 QuantizedConvOp *InternalQuantizedConvOpCreate() {
@@ -42,10 +45,105 @@ void InternalQuantizedConvOpInitWeight(QuantizedConvOp *p, float *weight) {
   reinterpret_cast<ConvOp *>(p)->InitWeight(weight);
 }
 
+void InternalQuantizedConvOpSetupBNParameter(QuantizedConvOp *p, float *mean, float *variance, float *scale,
+                                             float *shift, float eps) {
+  reinterpret_cast<ConvOp *>(p)->SetupBNParameter(mean, variance, scale, shift, eps);
+}
+
 void InternalQuantizedConvOpExecute(QuantizedConvOp *p, float *dst, float *data, float *bias, size_t batch_size,
                                     size_t channel_in, size_t height_in, size_t width_in) {
-  reinterpret_cast<ConvOp *>(p)->Execute(dst, data, bias, batch_size, channel_in, height_in, width_in);
+  reinterpret_cast<ConvOp *>(p)->Execute(dst, data, bias, NULL, batch_size, channel_in, height_in, width_in);
+}
+
+void InternalQuantizedConvOpExecuteWithResidual(QuantizedConvOp *p, float *dst, float *data, float *bias,
+                                                float *residual, size_t batch_size, size_t channel_in,
+                                                size_t height_in, size_t width_in) {
+  reinterpret_cast<ConvOp *>(p)->Execute(dst, data, bias, residual, batch_size, channel_in, height_in, width_in);
+}
+
+void InternalQuantizedConvOpExecuteRequantized(QuantizedConvOp *p, uint8_t *dst, float scale, float zero_point,
+                                               float *data, float *bias, float *residual, size_t batch_size,
+                                               size_t channel_in, size_t height_in, size_t width_in) {
+  reinterpret_cast<ConvOp *>(p)->ExecuteRequantized(dst, scale, zero_point, data, bias, residual, batch_size,
+                                                    channel_in, height_in, width_in);
+}
+
+size_t InternalQuantizedConvOpGetRequantizedOutputSize(QuantizedConvOp *p, size_t batch_size, size_t height_in,
+                                                       size_t width_in) {
+  return reinterpret_cast<ConvOp *>(p)->RequantizedOutputSize(batch_size, height_in, width_in);
 }
+
+void InternalQuantizedConvOpWarmUp(QuantizedConvOp *p, size_t batch_size, size_t channel_in, size_t height_in,
+                                   size_t width_in) {
+  reinterpret_cast<ConvOp *>(p)->WarmUp(batch_size, channel_in, height_in, width_in);
+}
+
+void InternalQuantizedConvOpStartCalibration(QuantizedConvOp *p, CALIBRATION_MODE mode, float percentile) {
+  reinterpret_cast<ConvOp *>(p)->StartCalibration(mode, percentile);
+}
+
+void InternalQuantizedConvOpFinishCalibration(QuantizedConvOp *p) {
+  reinterpret_cast<ConvOp *>(p)->FinishCalibration();
+}
+
+void InternalQuantizedConvOpSetInputRange(QuantizedConvOp *p, float min, float max) {
+  reinterpret_cast<ConvOp *>(p)->SetInputRange(StaticRange(min, max));
+}
+
+int InternalQuantizedConvOpGetInputRange(QuantizedConvOp *p, float *min, float *max) {
+  const StaticRange &range = reinterpret_cast<ConvOp *>(p)->input_range_;
+  if (!range.Enabled()) {
+    return 0;
+  }
+  *min = range.min_;
+  *max = range.max_;
+  return 1;
+}
+
+int InternalQuantizedConvOpSavePacked(QuantizedConvOp *p, const char *path) {
+  PackedWriter writer;
+  if (!writer.Open(path, PACKED_CONV)) {
+    return -1;
+  }
+  reinterpret_cast<ConvOp *>(p)->SavePacked(writer);
+  return writer.Close() ? 0 : -1;
+}
+
+QuantizedConvOp *InternalQuantizedConvOpLoadPacked(const char *path) {
+  PackedReader reader;
+  if (!reader.Open(path, PACKED_CONV)) {
+    return NULL;
+  }
+  ConvOp *p = new ConvOp();
+  if (!p->LoadPacked(reader)) {
+    delete p;
+    return NULL;
+  }
+  return reinterpret_cast<QuantizedConvOp *>(p);
+}
+
+void InternalQuantizedConvOpShrinkWorkspace(QuantizedConvOp *p) {
+  reinterpret_cast<ConvOp *>(p)->ShrinkWorkspace();
+}
+
+size_t InternalQuantizedConvOpGetWorkspaceSize(QuantizedConvOp *p, size_t batch_size, size_t channel_in,
+                                               size_t height_in, size_t width_in) {
+  return reinterpret_cast<ConvOp *>(p)->WorkspaceSize(batch_size, channel_in, height_in, width_in);
+}
+
+int InternalQuantizedConvOpExecuteWithWorkspace(QuantizedConvOp *p, void *workspace, size_t workspace_size, float *dst,
+                                                float *data, float *bias, float *residual, size_t batch_size,
+                                                size_t channel_in, size_t height_in, size_t width_in) {
+  return reinterpret_cast<ConvOp *>(p)->ExecuteWithWorkspace(workspace, workspace_size, dst, data, bias, residual,
+                                                             batch_size, channel_in, height_in, width_in)
+             ? 0
+             : -1;
+}
+
+size_t InternalQuantizedConvOpGetWorkspaceSavedBytes(QuantizedConvOp *p) {
+  return reinterpret_cast<ConvOp *>(p)->WorkspaceSavedBytes();
+}
+
 void InternalQuantizedConvOpFree(QuantizedConvOp *p) {
   delete reinterpret_cast<ConvOp *>(p);
 }
@@ -69,13 +167,246 @@ void InternalQuantizedFCOpExecute(QuantizedFCOp *p, float *dst, float *data, flo
   reinterpret_cast<FCOp *>(p)->Execute(dst, data, bias, batch_size, channel_in);
 }
 
+void InternalQuantizedFCOpWarmUp(QuantizedFCOp *p, size_t batch_size, size_t channel_in) {
+  reinterpret_cast<FCOp *>(p)->WarmUp(batch_size, channel_in);
+}
+
+void InternalQuantizedFCOpStartCalibration(QuantizedFCOp *p, CALIBRATION_MODE mode, float percentile) {
+  reinterpret_cast<FCOp *>(p)->StartCalibration(mode, percentile);
+}
+
+void InternalQuantizedFCOpFinishCalibration(QuantizedFCOp *p) {
+  reinterpret_cast<FCOp *>(p)->FinishCalibration();
+}
+
+void InternalQuantizedFCOpSetInputRange(QuantizedFCOp *p, float min, float max) {
+  reinterpret_cast<FCOp *>(p)->SetInputRange(StaticRange(min, max));
+}
+
+int InternalQuantizedFCOpGetInputRange(QuantizedFCOp *p, float *min, float *max) {
+  const StaticRange &range = reinterpret_cast<FCOp *>(p)->input_range_;
+  if (!range.Enabled()) {
+    return 0;
+  }
+  *min = range.min_;
+  *max = range.max_;
+  return 1;
+}
+
+int InternalQuantizedFCOpSavePacked(QuantizedFCOp *p, const char *path) {
+  PackedWriter writer;
+  if (!writer.Open(path, PACKED_FC)) {
+    return -1;
+  }
+  reinterpret_cast<FCOp *>(p)->SavePacked(writer);
+  return writer.Close() ? 0 : -1;
+}
+
+QuantizedFCOp *InternalQuantizedFCOpLoadPacked(const char *path) {
+  PackedReader reader;
+  if (!reader.Open(path, PACKED_FC)) {
+    return NULL;
+  }
+  FCOp *p = new FCOp();
+  if (!p->LoadPacked(reader)) {
+    delete p;
+    return NULL;
+  }
+  return reinterpret_cast<QuantizedFCOp *>(p);
+}
+
+void InternalQuantizedFCOpShrinkWorkspace(QuantizedFCOp *p) {
+  reinterpret_cast<FCOp *>(p)->ShrinkWorkspace();
+}
+
+size_t InternalQuantizedFCOpGetWorkspaceSize(QuantizedFCOp *p, size_t batch_size, size_t channel_in) {
+  return reinterpret_cast<FCOp *>(p)->WorkspaceSize(batch_size, channel_in);
+}
+
+int InternalQuantizedFCOpExecuteWithWorkspace(QuantizedFCOp *p, void *workspace, size_t workspace_size, float *dst,
+                                              float *data, float *bias, size_t batch_size, size_t channel_in) {
+  return reinterpret_cast<FCOp *>(p)->ExecuteWithWorkspace(workspace, workspace_size, dst, data, bias, batch_size,
+                                                           channel_in)
+             ? 0
+             : -1;
+}
+
+size_t InternalQuantizedFCOpGetWorkspaceSavedBytes(QuantizedFCOp *p) {
+  return reinterpret_cast<FCOp *>(p)->WorkspaceSavedBytes();
+}
+
 void InternalQuantizedFCOpFree(QuantizedFCOp *p) {
   delete reinterpret_cast<FCOp *>(p);
 }
 
+QuantizedGraph *InternalQuantizedGraphCreate(LAYOUT layout, size_t channel, size_t height, size_t width) {
+  Graph *p = new Graph(layout, channel, height, width);
+  return reinterpret_cast<QuantizedGraph *>(p);
+}
+
+size_t InternalQuantizedGraphAddConv(QuantizedGraph *p, size_t input, int residual, size_t channel_out, size_t group,
+                                     size_t kernel_h, size_t kernel_w, size_t stride_h, size_t stride_w, size_t pad_h,
+                                     size_t pad_w, size_t dilation_h, size_t dilation_w, size_t fusion_mask,
+                                     float *weight, float *bias, CONV_ALGORITHM algo) {
+  return reinterpret_cast<Graph *>(p)->AddConv(input, residual, channel_out, group, kernel_h, kernel_w, stride_h,
+                                               stride_w, pad_h, pad_w, dilation_h, dilation_w, fusion_mask, weight,
+                                               bias, algo);
+}
+
+void InternalQuantizedGraphSetupConvBNParameter(QuantizedGraph *p, size_t tensor, float *mean, float *variance,
+                                                float *scale, float *shift, float eps) {
+  reinterpret_cast<Graph *>(p)->SetupConvBNParameter(tensor, mean, variance, scale, shift, eps);
+}
+
+size_t InternalQuantizedGraphAddFC(QuantizedGraph *p, size_t input, size_t channel_out, float *weight, float *bias,
+                                   FC_ALGORITHM algo) {
+  return reinterpret_cast<Graph *>(p)->AddFC(input, channel_out, weight, bias, algo);
+}
+
+size_t InternalQuantizedGraphAddPool(QuantizedGraph *p, size_t input, POOL_MODE mode, size_t kernel_h, size_t kernel_w,
+                                     size_t stride_h, size_t stride_w, size_t pad_h, size_t pad_w) {
+  return reinterpret_cast<Graph *>(p)->AddPool(input, mode == MAX_POOL, kernel_h, kernel_w, stride_h, stride_w, pad_h,
+                                               pad_w);
+}
+
+size_t InternalQuantizedGraphAddSum(QuantizedGraph *p, size_t a, size_t b, int relu) {
+  return reinterpret_cast<Graph *>(p)->AddSum(a, b, relu != 0);
+}
+
+size_t InternalQuantizedGraphAddReLU(QuantizedGraph *p, size_t input) {
+  return reinterpret_cast<Graph *>(p)->AddReLU(input);
+}
+
+size_t InternalQuantizedGraphGetOutputSize(QuantizedGraph *p) {
+  return reinterpret_cast<Graph *>(p)->OutputCount();
+}
+
+size_t InternalQuantizedGraphGetActivationBytes(QuantizedGraph *p, size_t batch_size) {
+  return reinterpret_cast<Graph *>(p)->ActivationBytes(batch_size);
+}
+
+void InternalQuantizedGraphExecute(QuantizedGraph *p, float *dst, float *data, size_t batch_size) {
+  reinterpret_cast<Graph *>(p)->Execute(dst, data, batch_size);
+}
+
+void InternalQuantizedGraphStartCalibration(QuantizedGraph *p, CALIBRATION_MODE mode, float percentile) {
+  reinterpret_cast<Graph *>(p)->StartCalibration(mode, percentile);
+}
+
+void InternalQuantizedGraphFinishCalibration(QuantizedGraph *p) {
+  reinterpret_cast<Graph *>(p)->FinishCalibration();
+}
+
+int InternalQuantizedGraphSaveCalibration(QuantizedGraph *p, const char *path) {
+  return reinterpret_cast<Graph *>(p)->SaveCalibration(path);
+}
+
+int InternalQuantizedGraphLoadCalibration(QuantizedGraph *p, const char *path) {
+  return reinterpret_cast<Graph *>(p)->LoadCalibration(path);
+}
+
+int InternalQuantizedGraphSavePacked(QuantizedGraph *p, const char *path) {
+  PackedWriter writer;
+  if (!writer.Open(path, PACKED_GRAPH)) {
+    return -1;
+  }
+  reinterpret_cast<Graph *>(p)->SavePacked(writer);
+  return writer.Close() ? 0 : -1;
+}
+
+QuantizedGraph *InternalQuantizedGraphLoadPacked(const char *path) {
+  PackedReader reader;
+  if (!reader.Open(path, PACKED_GRAPH)) {
+    return NULL;
+  }
+  return reinterpret_cast<QuantizedGraph *>(Graph::LoadPacked(reader));
+}
+
+void InternalQuantizedGraphFree(QuantizedGraph *p) {
+  delete reinterpret_cast<Graph *>(p);
+}
+
+int InternalBigQuantLoadTuningFile(const char *path) {
+  return Autotuner::Instance().Load(path);
+}
+
+int InternalBigQuantSaveTuningFile(const char *path) {
+  return Autotuner::Instance().Save(path);
+}
+
+void InternalBigQuantEnablePerfCounters(int enable) {
+  PerfCounters::Instance().Enable(enable != 0);
+}
+
+int InternalBigQuantPerfCountersEnabled() {
+  return PerfCounters::Instance().Enabled() ? 1 : 0;
+}
+
+void InternalBigQuantResetPerfCounters() {
+  PerfCounters::Instance().Reset();
+}
+
+int InternalBigQuantGetPerfCounter(PERF_COUNTER counter, PerfCounterValue *value) {
+  return PerfCounters::Instance().Read(counter, value) ? 0 : -1;
+}
+
+const char *InternalBigQuantGetPerfCounterName(PERF_COUNTER counter) {
+  return PerfCounters::Name(counter);
+}
+
+void InternalBigQuantStartTrace() {
+  Tracer::Instance().Start();
+}
+
+int InternalBigQuantStopTrace(const char *path) {
+  return Tracer::Instance().Stop(path);
+}
+
+const char *InternalBigQuantGetISA() {
+  return GetISAName();
+}
+
 // The following is  tensor based APU
-void InternalQuantizedConvKernelDescInit(QuantizedTensorDesc *quantized_tensor, size_t c_out, size_t c_in,
-                                         size_t kernel_h, size_t kernel_w) {
+// A descriptor either allocates its buffers or, initialized by a *WithWorkspace variant, carves them out of one caller
+// block at 64-byte boundaries. A NULL workspace only sets the shape, so the block can be sized by the
+// *DescGetWorkspaceSize functions first.
+static void AllocateQuantizedTensor(QuantizedTensorDesc *quantized_tensor) {
+  aligned_malloc(&(quantized_tensor->min), 64, quantized_tensor->workspace_size_per_meta_info);
+  aligned_malloc(&(quantized_tensor->max), 64, quantized_tensor->workspace_size_per_meta_info);
+  aligned_malloc(&(quantized_tensor->ratio), 64, quantized_tensor->workspace_size_per_meta_info);
+  aligned_malloc(&(quantized_tensor->data), 64, quantized_tensor->workspace_size);
+}
+
+static void AttachQuantizedTensor(QuantizedTensorDesc *quantized_tensor, void *workspace) {
+  if (workspace == NULL) {
+    quantized_tensor->data = quantized_tensor->min = quantized_tensor->max = quantized_tensor->ratio = NULL;
+    return;
+  }
+  size_t meta_size = Workspace::AlignedSize(quantized_tensor->workspace_size_per_meta_info);
+  int8_t *p = reinterpret_cast<int8_t *>(Workspace::AlignedSize(reinterpret_cast<size_t>(workspace)));
+  quantized_tensor->min = p;
+  quantized_tensor->max = p + meta_size;
+  quantized_tensor->ratio = p + 2 * meta_size;
+  quantized_tensor->data = p + 3 * meta_size;
+}
+
+static void AttachFPTensor(FPTensorDesc *fp_tensor, void *workspace) {
+  fp_tensor->data = (workspace == NULL)
+                        ? NULL
+                        : reinterpret_cast<void *>(Workspace::AlignedSize(reinterpret_cast<size_t>(workspace)));
+}
+
+size_t InternalQuantizedTensorDescGetWorkspaceSize(const QuantizedTensorDesc *quantized_tensor) {
+  return 3 * Workspace::AlignedSize(quantized_tensor->workspace_size_per_meta_info) +
+         Workspace::AlignedSize(quantized_tensor->workspace_size) + 64;
+}
+
+size_t InternalFPTensorDescGetWorkspaceSize(const FPTensorDesc *fp_tensor) {
+  return Workspace::AlignedSize(fp_tensor->workspace_size) + 64;
+}
+
+static void SetConvKernelShape(QuantizedTensorDesc *quantized_tensor, size_t c_out, size_t c_in, size_t kernel_h,
+                               size_t kernel_w) {
   quantized_tensor->dim = 2;
   quantized_tensor->ori_shape[0] = c_out;
   quantized_tensor->ori_shape[1] = c_in * kernel_h * kernel_w;
@@ -83,10 +414,18 @@ void InternalQuantizedConvKernelDescInit(QuantizedTensorDesc *quantized_tensor,
   quantized_tensor->shape[1] = GetAlignmentLength(quantized_tensor->ori_shape[1], CONV_SHUFFLE_KERNEL_K);
   quantized_tensor->workspace_size = sizeof(int8_t) * quantized_tensor->shape[0] * quantized_tensor->shape[1];
   quantized_tensor->workspace_size_per_meta_info = sizeof(float) * quantized_tensor->shape[0];
-  aligned_malloc(&(quantized_tensor->min), 64, quantized_tensor->workspace_size_per_meta_info);
-  aligned_malloc(&(quantized_tensor->max), 64, quantized_tensor->workspace_size_per_meta_info);
-  aligned_malloc(&(quantized_tensor->ratio), 64, quantized_tensor->workspace_size_per_meta_info);
-  aligned_malloc(&(quantized_tensor->data), 64, quantized_tensor->workspace_size);
+}
+
+void InternalQuantizedConvKernelDescInit(QuantizedTensorDesc *quantized_tensor, size_t c_out, size_t c_in,
+                                         size_t kernel_h, size_t kernel_w) {
+  SetConvKernelShape(quantized_tensor, c_out, c_in, kernel_h, kernel_w);
+  AllocateQuantizedTensor(quantized_tensor);
+}
+
+void InternalQuantizedConvKernelDescInitWithWorkspace(QuantizedTensorDesc *quantized_tensor, void *workspace,
+                                                      size_t c_out, size_t c_in, size_t kernel_h, size_t kernel_w) {
+  SetConvKernelShape(quantized_tensor, c_out, c_in, kernel_h, kernel_w);
+  AttachQuantizedTensor(quantized_tensor, workspace);
 }
 
 void InternalQuantizedConvKernelInit(QuantizedTensorDesc *quantized_tensor, float *src, size_t c_out, size_t c_in,
@@ -112,19 +451,17 @@ void InternalQuantizedConvKernelInit(QuantizedTensorDesc *quantized_tensor, floa
 void InternalQuantizedConvKernelLoadFromModel(QuantizedTensorDesc *quantized_tensor, int8_t *src, float *min,
                                               float *max, size_t c_out, size_t c_in, size_t kernel_h, size_t kernel_w,
                                               float threshold, LAYOUT layout) {
-  std::vector<float> fp_model(c_out * c_in * kernel_h * kernel_w);
-  DequantizeModel(fp_model.data(), src, min, max, c_out, c_in, kernel_h, kernel_w);
-  float *tmp;
+  int8_t *tmp;
   if (layout == NHWC) {
-    tmp = fp_model.data();
+    tmp = src;
   } else {
-    aligned_malloc(reinterpret_cast<void **>(&tmp), 64, sizeof(float) * c_out * c_in * kernel_h * kernel_w);
-    TransformLayout<float>(NHWC, NCHW, tmp, fp_model.data(), c_out, c_in, kernel_h * kernel_w);
+    aligned_malloc(reinterpret_cast<void **>(&tmp), 64, sizeof(int8_t) * c_out * c_in * kernel_h * kernel_w);
+    TransformLayout<int8_t>(NHWC, NCHW, tmp, src, c_out, c_in, kernel_h * kernel_w);
   }
-  shuffle::PadQuantizeShuffle2D<float, CONV_SHUFFLE_KERNEL_M, CONV_SHUFFLE_KERNEL_K>(
+  shuffle::PadRescaleShuffle2D<CONV_SHUFFLE_KERNEL_M, CONV_SHUFFLE_KERNEL_K>(
       reinterpret_cast<int8_t *>(quantized_tensor->data), quantized_tensor->ori_shape[0],
       quantized_tensor->ori_shape[1], GetAlignmentLength(quantized_tensor->ori_shape[0], CONV_SHUFFLE_KERNEL_M),
-      GetAlignmentLength(quantized_tensor->ori_shape[1], CONV_SHUFFLE_KERNEL_K), tmp,
+      GetAlignmentLength(quantized_tensor->ori_shape[1], CONV_SHUFFLE_KERNEL_K), tmp, min, max,
       reinterpret_cast<float *>(quantized_tensor->min), reinterpret_cast<float *>(quantized_tensor->max),
       reinterpret_cast<float *>(quantized_tensor->ratio), threshold);
   if (layout == NCHW) {
@@ -132,10 +469,9 @@ void InternalQuantizedConvKernelLoadFromModel(QuantizedTensorDesc *quantized_ten
   }
 }
 
-void InternalQuantizedConvDataDescInit(QuantizedTensorDesc *quantized_tensor, size_t c_in, size_t kernel_h,
-                                       size_t kernel_w, size_t stride_h, size_t stride_w, size_t pad_h, size_t pad_w,
-                                       size_t dilation_h, size_t dilation_w, size_t batch_size, size_t h_in,
-                                       size_t w_in) {
+static void SetConvDataShape(QuantizedTensorDesc *quantized_tensor, size_t c_in, size_t kernel_h, size_t kernel_w,
+                             size_t stride_h, size_t stride_w, size_t pad_h, size_t pad_w, size_t dilation_h,
+                             size_t dilation_w, size_t batch_size, size_t h_in, size_t w_in) {
   size_t h_out = GetConvOutSize(h_in, kernel_h, stride_h, pad_h, dilation_h);
   size_t w_out = GetConvOutSize(w_in, kernel_w, stride_w, pad_w, dilation_w);
   quantized_tensor->dim = 2;
@@ -145,44 +481,107 @@ void InternalQuantizedConvDataDescInit(QuantizedTensorDesc *quantized_tensor, si
   quantized_tensor->shape[1] = GetAlignmentLength(quantized_tensor->ori_shape[1], CONV_SHUFFLE_KERNEL_K);
   quantized_tensor->workspace_size = sizeof(uint8_t) * quantized_tensor->shape[0] * quantized_tensor->shape[1];
   quantized_tensor->workspace_size_per_meta_info = sizeof(float) * quantized_tensor->ori_shape[0];
-  aligned_malloc(&(quantized_tensor->min), 64, quantized_tensor->workspace_size_per_meta_info);
-  aligned_malloc(&(quantized_tensor->max), 64, quantized_tensor->workspace_size_per_meta_info);
-  aligned_malloc(&(quantized_tensor->ratio), 64, quantized_tensor->workspace_size_per_meta_info);
-  aligned_malloc(&(quantized_tensor->data), 64, quantized_tensor->workspace_size);
 }
 
-void InternalQuantizedConvDataInit(QuantizedTensorDesc *quantized_tensor, float *src, size_t c_in, size_t kernel_h,
-                                   size_t kernel_w, size_t stride_h, size_t stride_w, size_t pad_h, size_t pad_w,
-                                   size_t dilation_h, size_t dilation_w, size_t batch_size, size_t h_in, size_t w_in,
-                                   float threshold, LAYOUT layout) {
-  size_t h_out = GetConvOutSize(h_in, kernel_h, stride_h, pad_h, dilation_h);
-  size_t w_out = GetConvOutSize(w_in, kernel_w, stride_w, pad_w, dilation_w);
+void InternalQuantizedConvDataDescInit(QuantizedTensorDesc *quantized_tensor, size_t c_in, size_t kernel_h,
+                                       size_t kernel_w, size_t stride_h, size_t stride_w, size_t pad_h, size_t pad_w,
+                                       size_t dilation_h, size_t dilation_w, size_t batch_size, size_t h_in,
+                                       size_t w_in) {
+  SetConvDataShape(quantized_tensor, c_in, kernel_h, kernel_w, stride_h, stride_w, pad_h, pad_w, dilation_h,
+                   dilation_w, batch_size, h_in, w_in);
+  AllocateQuantizedTensor(quantized_tensor);
+}
+
+void InternalQuantizedConvDataDescInitWithWorkspace(QuantizedTensorDesc *quantized_tensor, void *workspace,
+                                                    size_t c_in, size_t kernel_h, size_t kernel_w, size_t stride_h,
+                                                    size_t stride_w, size_t pad_h, size_t pad_w, size_t dilation_h,
+                                                    size_t dilation_w, size_t batch_size, size_t h_in, size_t w_in) {
+  SetConvDataShape(quantized_tensor, c_in, kernel_h, kernel_w, stride_h, stride_w, pad_h, pad_w, dilation_h,
+                   dilation_w, batch_size, h_in, w_in);
+  AttachQuantizedTensor(quantized_tensor, workspace);
+}
+
+// scratch is the per-thread im2col scratch, allocated by the im2col when NULL
+static void ConvDataInit(QuantizedTensorDesc *quantized_tensor, float *src, float **scratch, size_t c_in,
+                         size_t kernel_h, size_t kernel_w, size_t stride_h, size_t stride_w, size_t pad_h,
+                         size_t pad_w, size_t dilation_h, size_t dilation_w, size_t batch_size, size_t h_in,
+                         size_t w_in, float threshold, LAYOUT layout) {
   uint8_t *im2coled_data[] = {reinterpret_cast<uint8_t *>(quantized_tensor->data)};
   float *im2coled_min[] = {reinterpret_cast<float *>(quantized_tensor->min)};
   float *im2coled_max[] = {reinterpret_cast<float *>(quantized_tensor->max)};
   float *im2coled_ratio[] = {reinterpret_cast<float *>(quantized_tensor->ratio)};
-  if (layout == NCHW) {
-    shuffle::PadQuantizeShuffleIm2colWrapper<float, NHWC>(
-        src, batch_size, c_in, 1, h_in, w_in, kernel_h, kernel_w, pad_h, pad_w, stride_h, stride_w, dilation_h,
-        dilation_w, im2coled_data, im2coled_min, im2coled_max, im2coled_ratio, NULL, threshold, true);
-  } else {
-    shuffle::PadQuantizeShuffleIm2colWrapper<float, NHWC>(
-        src, batch_size, c_in, 1, h_in, w_in, kernel_h, kernel_w, pad_h, pad_w, stride_h, stride_w, dilation_h,
-        dilation_w, im2coled_data, im2coled_min, im2coled_max, im2coled_ratio, NULL, threshold, false);
+  shuffle::PadQuantizeShuffleIm2colWrapper<float, NHWC>(
+      src, batch_size, c_in, 1, h_in, w_in, kernel_h, kernel_w, pad_h, pad_w, stride_h, stride_w, dilation_h,
+      dilation_w, im2coled_data, im2coled_min, im2coled_max, im2coled_ratio, scratch, threshold, layout == NCHW);
+}
+
+void InternalQuantizedConvDataInit(QuantizedTensorDesc *quantized_tensor, float *src, size_t c_in, size_t kernel_h,
+                                   size_t kernel_w, size_t stride_h, size_t stride_w, size_t pad_h, size_t pad_w,
+                                   size_t dilation_h, size_t dilation_w, size_t batch_size, size_t h_in, size_t w_in,
+                                   float threshold, LAYOUT layout) {
+  ConvDataInit(quantized_tensor, src, NULL, c_in, kernel_h, kernel_w, stride_h, stride_w, pad_h, pad_w, dilation_h,
+               dilation_w, batch_size, h_in, w_in, threshold, layout);
+}
+
+// Per-thread im2col scratch of InternalQuantizedConvDataInitWithWorkspace at the current thread count
+static size_t ConvDataInitScratchSize(size_t c_in, size_t kernel_h, size_t stride_h, size_t pad_h, size_t dilation_h,
+                                      size_t batch_size, size_t h_in, size_t w_in, LAYOUT layout) {
+  return Workspace::AlignedSize(sizeof(float) * shuffle::PadQuantizeShuffleNHWCIm2colScratchSize<float>(
+                                                    batch_size, c_in, 1, h_in, w_in, kernel_h, pad_h, stride_h,
+                                                    dilation_h, layout == NCHW));
+}
+
+size_t InternalQuantizedConvDataInitGetWorkspaceSize(size_t c_in, size_t kernel_h, size_t kernel_w, size_t stride_h,
+                                                     size_t stride_w, size_t pad_h, size_t pad_w, size_t dilation_h,
+                                                     size_t dilation_w, size_t batch_size, size_t h_in, size_t w_in,
+                                                     LAYOUT layout) {
+  return GetThreadsNumWrapper() * ConvDataInitScratchSize(c_in, kernel_h, stride_h, pad_h, dilation_h, batch_size,
+                                                          h_in, w_in, layout) +
+         64;
+}
+
+void InternalQuantizedConvDataInitWithWorkspace(QuantizedTensorDesc *quantized_tensor, void *workspace, float *src,
+                                                size_t c_in, size_t kernel_h, size_t kernel_w, size_t stride_h,
+                                                size_t stride_w, size_t pad_h, size_t pad_w, size_t dilation_h,
+                                                size_t dilation_w, size_t batch_size, size_t h_in, size_t w_in,
+                                                float threshold, LAYOUT layout) {
+  size_t threads = GetThreadsNumWrapper();
+  size_t scratch_size = ConvDataInitScratchSize(c_in, kernel_h, stride_h, pad_h, dilation_h, batch_size, h_in, w_in,
+                                                layout);
+  int8_t *p = reinterpret_cast<int8_t *>(Workspace::AlignedSize(reinterpret_cast<size_t>(workspace)));
+  std::vector<float *> scratch(threads);
+  for (size_t t = 0; t < threads; ++t) {
+    scratch[t] = reinterpret_cast<float *>(p + t * scratch_size);
   }
+  ConvDataInit(quantized_tensor, src, scratch.data(), c_in, kernel_h, kernel_w, stride_h, stride_w, pad_h, pad_w,
+               dilation_h, dilation_w, batch_size, h_in, w_in, threshold, layout);
 }
 
-void InternalQuantizedConvKernelSumDescInit(FPTensorDesc *fp_tensor, size_t c_out) {
+static void SetKernelSumShape(FPTensorDesc *fp_tensor, size_t c_out) {
   fp_tensor->dim = 1;
   fp_tensor->shape[0] = c_out;
   fp_tensor->workspace_size = sizeof(float) * c_out;
+}
+
+void InternalQuantizedConvKernelSumDescInit(FPTensorDesc *fp_tensor, size_t c_out) {
+  SetKernelSumShape(fp_tensor, c_out);
   aligned_malloc(&(fp_tensor->data), 64, fp_tensor->workspace_size);
 }
 
+void InternalQuantizedConvKernelSumDescInitWithWorkspace(FPTensorDesc *fp_tensor, void *workspace, size_t c_out) {
+  SetKernelSumShape(fp_tensor, c_out);
+  AttachFPTensor(fp_tensor, workspace);
+}
+
 void InternalQuantizedConvKernelSumInit(FPTensorDesc *fp_tensor, float *src, size_t n, size_t c, size_t h, size_t w) {
   ComputeMatrixSumPerRow<float>(reinterpret_cast<float *>(fp_tensor->data), src, n, c * h * w);
 }
 
+void InternalQuantizedConvKernelSumLoadFromModel(FPTensorDesc *fp_tensor, int8_t *src, float *min, float *max,
+                                                 size_t c_out, size_t c_in, size_t kernel_h, size_t kernel_w) {
+  ComputeModelSumPerRow(reinterpret_cast<float *>(fp_tensor->data), src, min, max, c_out, c_in * kernel_h * kernel_w);
+}
+
 void InternalMixPrecisionGEMM(LAYOUT layout, int8_t *pa, uint8_t *pb, float *pc, size_t m, size_t n, size_t k,
                               float *ratio_a, float *ratio_b, float *kernel_sum, float *min_b, float *bias,
                               size_t batch_size, size_t channel_per_group, size_t height_out, size_t width_out,
@@ -198,7 +597,7 @@ void InternalMixPrecisionGEMM(LAYOUT layout, int8_t *pa, uint8_t *pb, float *pc,
   }
 }
 
-void InternalQuantizedFCKernelDescInit(QuantizedTensorDesc *quantized_tensor, size_t c_out, size_t c_in) {
+static void SetFCKernelShape(QuantizedTensorDesc *quantized_tensor, size_t c_out, size_t c_in) {
   quantized_tensor->dim = 2;
   quantized_tensor->ori_shape[0] = c_out;
   quantized_tensor->ori_shape[1] = c_in;
@@ -206,10 +605,17 @@ void InternalQuantizedFCKernelDescInit(QuantizedTensorDesc *quantized_tensor, si
   quantized_tensor->shape[1] = GetAlignmentLength(quantized_tensor->ori_shape[1], FC_SHUFFLE_KERNEL_K);
   quantized_tensor->workspace_size = sizeof(int8_t) * quantized_tensor->shape[0] * quantized_tensor->shape[1];
   quantized_tensor->workspace_size_per_meta_info = sizeof(float) * quantized_tensor->ori_shape[0];
-  aligned_malloc(&(quantized_tensor->min), 64, quantized_tensor->workspace_size_per_meta_info);
-  aligned_malloc(&(quantized_tensor->max), 64, quantized_tensor->workspace_size_per_meta_info);
-  aligned_malloc(&(quantized_tensor->ratio), 64, quantized_tensor->workspace_size_per_meta_info);
-  aligned_malloc(&(quantized_tensor->data), 64, quantized_tensor->workspace_size);
+}
+
+void InternalQuantizedFCKernelDescInit(QuantizedTensorDesc *quantized_tensor, size_t c_out, size_t c_in) {
+  SetFCKernelShape(quantized_tensor, c_out, c_in);
+  AllocateQuantizedTensor(quantized_tensor);
+}
+
+void InternalQuantizedFCKernelDescInitWithWorkspace(QuantizedTensorDesc *quantized_tensor, void *workspace,
+                                                    size_t c_out, size_t c_in) {
+  SetFCKernelShape(quantized_tensor, c_out, c_in);
+  AttachQuantizedTensor(quantized_tensor, workspace);
 }
 
 void InternalQuantizedFCKernelInit(QuantizedTensorDesc *quantized_tensor, float *src, size_t c_out, size_t c_in,
@@ -226,17 +632,15 @@ void InternalQuantizedFCKernelInit(QuantizedTensorDesc *quantized_tensor, float
 void InternalQuantizedFCKernelLoadFromModel(QuantizedTensorDesc *quantized_tensor, int8_t *src, float *min, float *max,
                                             size_t c_out, size_t c_in, float threshold, LAYOUT layout) {
   assert((layout == NCHW) || (layout == NHWC));
-  std::vector<float> fp_model(c_out * c_in);
-  DequantizeModel(fp_model.data(), src, min, max, c_out, c_in, 1, 1);
-  shuffle::PadQuantizeShuffle2D<float, FC_SHUFFLE_KERNEL_M, FC_SHUFFLE_KERNEL_K>(
+  shuffle::PadRescaleShuffle2D<FC_SHUFFLE_KERNEL_M, FC_SHUFFLE_KERNEL_K>(
       reinterpret_cast<int8_t *>(quantized_tensor->data), quantized_tensor->ori_shape[0],
       quantized_tensor->ori_shape[1], GetAlignmentLength(quantized_tensor->ori_shape[0], FC_SHUFFLE_KERNEL_M),
-      GetAlignmentLength(quantized_tensor->ori_shape[1], FC_SHUFFLE_KERNEL_K), fp_model.data(),
+      GetAlignmentLength(quantized_tensor->ori_shape[1], FC_SHUFFLE_KERNEL_K), src, min, max,
       reinterpret_cast<float *>(quantized_tensor->min), reinterpret_cast<float *>(quantized_tensor->max),
       reinterpret_cast<float *>(quantized_tensor->ratio), threshold);
 }
 
-void InternalQuantizedFCDataDescInit(QuantizedTensorDesc *quantized_tensor, size_t batch_size, size_t channel) {
+static void SetFCDataShape(QuantizedTensorDesc *quantized_tensor, size_t batch_size, size_t channel) {
   quantized_tensor->dim = 2;
   quantized_tensor->ori_shape[0] = batch_size;
   quantized_tensor->ori_shape[1] = channel;
@@ -244,15 +648,24 @@ void InternalQuantizedFCDataDescInit(QuantizedTensorDesc *quantized_tensor, size
   quantized_tensor->shape[1] = GetAlignmentLength(quantized_tensor->ori_shape[1], FC_SHUFFLE_KERNEL_K);
   quantized_tensor->workspace_size = sizeof(uint8_t) * quantized_tensor->shape[0] * quantized_tensor->shape[1];
   quantized_tensor->workspace_size_per_meta_info = sizeof(float) * quantized_tensor->ori_shape[0];
-  aligned_malloc(&(quantized_tensor->min), 64, quantized_tensor->workspace_size_per_meta_info);
-  aligned_malloc(&(quantized_tensor->max), 64, quantized_tensor->workspace_size_per_meta_info);
-  aligned_malloc(&(quantized_tensor->ratio), 64, quantized_tensor->workspace_size_per_meta_info);
-  aligned_malloc(&(quantized_tensor->data), 64, quantized_tensor->workspace_size);
+}
+
+void InternalQuantizedFCDataDescInit(QuantizedTensorDesc *quantized_tensor, size_t batch_size, size_t channel) {
+  SetFCDataShape(quantized_tensor, batch_size, channel);
+  AllocateQuantizedTensor(quantized_tensor);
+}
+
+void InternalQuantizedFCDataDescInitWithWorkspace(QuantizedTensorDesc *quantized_tensor, void *workspace,
+                                                  size_t batch_size, size_t channel) {
+  SetFCDataShape(quantized_tensor, batch_size, channel);
+  AttachQuantizedTensor(quantized_tensor, workspace);
 }
 
 void InternalQuantizedFCDataInit(QuantizedTensorDesc *quantized_tensor, float *src, size_t batch_size, size_t channel,
                                  float threshold, LAYOUT layout) {
   assert((layout == NCHW) || (layout == NHWC));
+  size_t aligned_batch = GetAlignmentLength(batch_size, FC_SHUFFLE_KERNEL_N);
+  PerfScope perf(PERF_QUANTIZE, 0, aligned_batch * GetAlignmentLength(channel, FC_SHUFFLE_KERNEL_K));
   shuffle::PadQuantizeShuffle2D<float, FC_SHUFFLE_KERNEL_N, FC_SHUFFLE_KERNEL_K>(
       reinterpret_cast<uint8_t *>(quantized_tensor->data), batch_size, channel,
       GetAlignmentLength(batch_size, FC_SHUFFLE_KERNEL_N), GetAlignmentLength(channel, FC_SHUFFLE_KERNEL_K), src,
@@ -261,16 +674,24 @@ void InternalQuantizedFCDataInit(QuantizedTensorDesc *quantized_tensor, float *s
 }
 
 void InternalQuantizedFCKernelSumDescInit(FPTensorDesc *fp_tensor, size_t c_out) {
-  fp_tensor->dim = 1;
-  fp_tensor->shape[0] = c_out;
-  fp_tensor->workspace_size = sizeof(float) * c_out;
+  SetKernelSumShape(fp_tensor, c_out);
   aligned_malloc(&(fp_tensor->data), 64, fp_tensor->workspace_size);
 }
 
+void InternalQuantizedFCKernelSumDescInitWithWorkspace(FPTensorDesc *fp_tensor, void *workspace, size_t c_out) {
+  SetKernelSumShape(fp_tensor, c_out);
+  AttachFPTensor(fp_tensor, workspace);
+}
+
 void InternalQuantizedFCKernelSumInit(FPTensorDesc *fp_tensor, float *src, size_t c_out, size_t c_in) {
   ComputeMatrixSumPerRow<float>(reinterpret_cast<float *>(fp_tensor->data), src, c_out, c_in);
 }
 
+void InternalQuantizedFCKernelSumLoadFromModel(FPTensorDesc *fp_tensor, int8_t *src, float *min, float *max,
+                                               size_t c_out, size_t c_in) {
+  ComputeModelSumPerRow(reinterpret_cast<float *>(fp_tensor->data), src, min, max, c_out, c_in);
+}
+
 void InternalFreeFPTensor(struct FPTensorDesc *p) {
   aligned_free(p->data);
 }
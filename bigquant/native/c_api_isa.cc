@@ -0,0 +1,175 @@
+/*
+ * Copyright 2016 The BigDL Authors.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// One ISA's build of c_api.cc for the single runtime library. The Makefile compiles this file once per ISA with its
+// -march flags and ISA_NAMESPACE set to avx512, avx2 or sse42: every kernel, op, singleton and Internal* function of
+// the build then lives in that namespace, so the three builds link into one library without their templates and
+// inline functions being folded across ISAs. The runtime binds the functions through IsaSymbols, see c_api_rt.cc.
+#if !defined(ISA_NAMESPACE)
+#error "c_api_isa.cc is built once per ISA with -DISA_NAMESPACE=avx512, avx2 or sse42"
+#endif
+
+// the system headers come first, so that their include guards keep them out of the namespace below
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cassert>
+#include <chrono>
+#include <cmath>
+#include <cstdarg>
+#include <cstddef>
+#include <cstdlib>
+#include <cstring>
+#include <float.h>
+#include <fstream>
+#include <immintrin.h>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <thread>
+#include <vector>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+#ifdef NUMA
+#include <numa.h>
+#include <sched.h>
+#endif
+#if !defined(_MSC_VER) && !defined(__MINGW32__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+#include "bigquant.h"
+#include "isa_dispatch.h"
+
+namespace ISA_NAMESPACE {
+
+#include "c_api.cc"
+
+#define ISA_SYMBOL(name) \
+  { #name, reinterpret_cast<void *>(name) }
+
+const IsaSymbol *IsaSymbols() {
+  static const IsaSymbol symbols[] = {
+      ISA_SYMBOL(InternalQuantizedConvOpCreate),
+      ISA_SYMBOL(InternalQuantizedConvOpSetupConvParameter),
+      ISA_SYMBOL(InternalQuantizedConvOpInitWeight),
+      ISA_SYMBOL(InternalQuantizedConvOpSetupBNParameter),
+      ISA_SYMBOL(InternalQuantizedConvOpExecute),
+      ISA_SYMBOL(InternalQuantizedConvOpExecuteWithResidual),
+      ISA_SYMBOL(InternalQuantizedConvOpExecuteRequantized),
+      ISA_SYMBOL(InternalQuantizedConvOpGetRequantizedOutputSize),
+      ISA_SYMBOL(InternalQuantizedConvOpWarmUp),
+      ISA_SYMBOL(InternalQuantizedConvOpStartCalibration),
+      ISA_SYMBOL(InternalQuantizedConvOpFinishCalibration),
+      ISA_SYMBOL(InternalQuantizedConvOpSetInputRange),
+      ISA_SYMBOL(InternalQuantizedConvOpGetInputRange),
+      ISA_SYMBOL(InternalQuantizedConvOpSavePacked),
+      ISA_SYMBOL(InternalQuantizedConvOpLoadPacked),
+      ISA_SYMBOL(InternalQuantizedConvOpShrinkWorkspace),
+      ISA_SYMBOL(InternalQuantizedConvOpGetWorkspaceSavedBytes),
+      ISA_SYMBOL(InternalQuantizedConvOpGetWorkspaceSize),
+      ISA_SYMBOL(InternalQuantizedConvOpExecuteWithWorkspace),
+      ISA_SYMBOL(InternalQuantizedConvOpFree),
+      ISA_SYMBOL(InternalQuantizedFCOpCreate),
+      ISA_SYMBOL(InternalQuantizedFCOpSetupFCParameter),
+      ISA_SYMBOL(InternalQuantizedFCOpInitWeight),
+      ISA_SYMBOL(InternalQuantizedFCOpExecute),
+      ISA_SYMBOL(InternalQuantizedFCOpWarmUp),
+      ISA_SYMBOL(InternalQuantizedFCOpStartCalibration),
+      ISA_SYMBOL(InternalQuantizedFCOpFinishCalibration),
+      ISA_SYMBOL(InternalQuantizedFCOpSetInputRange),
+      ISA_SYMBOL(InternalQuantizedFCOpGetInputRange),
+      ISA_SYMBOL(InternalQuantizedFCOpSavePacked),
+      ISA_SYMBOL(InternalQuantizedFCOpLoadPacked),
+      ISA_SYMBOL(InternalQuantizedFCOpShrinkWorkspace),
+      ISA_SYMBOL(InternalQuantizedFCOpGetWorkspaceSavedBytes),
+      ISA_SYMBOL(InternalQuantizedFCOpGetWorkspaceSize),
+      ISA_SYMBOL(InternalQuantizedFCOpExecuteWithWorkspace),
+      ISA_SYMBOL(InternalQuantizedFCOpFree),
+      ISA_SYMBOL(InternalQuantizedGraphCreate),
+      ISA_SYMBOL(InternalQuantizedGraphAddConv),
+      ISA_SYMBOL(InternalQuantizedGraphSetupConvBNParameter),
+      ISA_SYMBOL(InternalQuantizedGraphAddFC),
+      ISA_SYMBOL(InternalQuantizedGraphAddPool),
+      ISA_SYMBOL(InternalQuantizedGraphAddSum),
+      ISA_SYMBOL(InternalQuantizedGraphAddReLU),
+      ISA_SYMBOL(InternalQuantizedGraphGetOutputSize),
+      ISA_SYMBOL(InternalQuantizedGraphGetActivationBytes),
+      ISA_SYMBOL(InternalQuantizedGraphExecute),
+      ISA_SYMBOL(InternalQuantizedGraphStartCalibration),
+      ISA_SYMBOL(InternalQuantizedGraphFinishCalibration),
+      ISA_SYMBOL(InternalQuantizedGraphSaveCalibration),
+      ISA_SYMBOL(InternalQuantizedGraphLoadCalibration),
+      ISA_SYMBOL(InternalQuantizedGraphSavePacked),
+      ISA_SYMBOL(InternalQuantizedGraphLoadPacked),
+      ISA_SYMBOL(InternalQuantizedGraphFree),
+      ISA_SYMBOL(InternalBigQuantLoadTuningFile),
+      ISA_SYMBOL(InternalBigQuantSaveTuningFile),
+      ISA_SYMBOL(InternalBigQuantEnablePerfCounters),
+      ISA_SYMBOL(InternalBigQuantPerfCountersEnabled),
+      ISA_SYMBOL(InternalBigQuantResetPerfCounters),
+      ISA_SYMBOL(InternalBigQuantGetPerfCounter),
+      ISA_SYMBOL(InternalBigQuantGetPerfCounterName),
+      ISA_SYMBOL(InternalBigQuantStartTrace),
+      ISA_SYMBOL(InternalBigQuantStopTrace),
+      ISA_SYMBOL(InternalBigQuantGetISA),
+      ISA_SYMBOL(InternalQuantizedConvKernelDescInit),
+      ISA_SYMBOL(InternalQuantizedConvKernelDescInitWithWorkspace),
+      ISA_SYMBOL(InternalQuantizedConvKernelInit),
+      ISA_SYMBOL(InternalQuantizedConvKernelLoadFromModel),
+      ISA_SYMBOL(InternalQuantizedConvDataDescInit),
+      ISA_SYMBOL(InternalQuantizedConvDataDescInitWithWorkspace),
+      ISA_SYMBOL(InternalQuantizedConvDataInit),
+      ISA_SYMBOL(InternalQuantizedConvDataInitGetWorkspaceSize),
+      ISA_SYMBOL(InternalQuantizedConvDataInitWithWorkspace),
+      ISA_SYMBOL(InternalQuantizedConvKernelSumDescInit),
+      ISA_SYMBOL(InternalQuantizedConvKernelSumDescInitWithWorkspace),
+      ISA_SYMBOL(InternalQuantizedConvKernelSumInit),
+      ISA_SYMBOL(InternalQuantizedConvKernelSumLoadFromModel),
+      ISA_SYMBOL(InternalMixPrecisionGEMM),
+      ISA_SYMBOL(InternalQuantizedFCKernelDescInit),
+      ISA_SYMBOL(InternalQuantizedFCKernelDescInitWithWorkspace),
+      ISA_SYMBOL(InternalQuantizedFCKernelInit),
+      ISA_SYMBOL(InternalQuantizedFCKernelLoadFromModel),
+      ISA_SYMBOL(InternalQuantizedFCDataDescInit),
+      ISA_SYMBOL(InternalQuantizedFCDataDescInitWithWorkspace),
+      ISA_SYMBOL(InternalQuantizedFCDataInit),
+      ISA_SYMBOL(InternalQuantizedFCKernelSumDescInit),
+      ISA_SYMBOL(InternalQuantizedFCKernelSumDescInitWithWorkspace),
+      ISA_SYMBOL(InternalQuantizedFCKernelSumInit),
+      ISA_SYMBOL(InternalQuantizedFCKernelSumLoadFromModel),
+      ISA_SYMBOL(InternalQuantizedTensorDescGetWorkspaceSize),
+      ISA_SYMBOL(InternalFPTensorDescGetWorkspaceSize),
+      ISA_SYMBOL(InternalFreeFPTensor),
+      ISA_SYMBOL(InternalFreeQuantizedTensor),
+      {NULL, NULL}};
+  return symbols;
+}
+
+#undef ISA_SYMBOL
+
+}  // namespace ISA_NAMESPACE
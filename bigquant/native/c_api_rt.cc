@@ -14,7 +14,10 @@
  * limitations under the License.
  */
 
-#if defined(WINDOWS)
+#if defined(SINGLE_LIBRARY)
+#include <stdlib.h>
+#include "isa_dispatch.h"
+#elif defined(WINDOWS)
 #include <windows.h>
 #else
 #include <dlfcn.h>
@@ -25,7 +28,9 @@
 #include "base.h"
 #include "common.h"
 
-#if defined(WINDOWS)
+#if defined(SINGLE_LIBRARY)
+const IsaSymbol *handler = NULL;
+#elif defined(WINDOWS)
 HINSTANCE handler = NULL;
 #else
 void *handler = NULL;
@@ -40,9 +45,48 @@ void (*QuantizedConvOpSetupConvParameterRT)(QuantizedConvOp *p, LAYOUT layout, s
 
 void (*QuantizedConvOpInitWeightRT)(QuantizedConvOp *p, float *weight);
 
+void (*QuantizedConvOpSetupBNParameterRT)(QuantizedConvOp *p, float *mean, float *variance, float *scale, float *shift,
+                                          float eps);
+
 void (*QuantizedConvOpExecuteRT)(QuantizedConvOp *p, float *dst, float *data, float *bias, size_t batch_size,
                                  size_t channel_in, size_t height_in, size_t width_in);
 
+void (*QuantizedConvOpExecuteWithResidualRT)(QuantizedConvOp *p, float *dst, float *data, float *bias, float *residual,
+                                             size_t batch_size, size_t channel_in, size_t height_in, size_t width_in);
+
+void (*QuantizedConvOpExecuteRequantizedRT)(QuantizedConvOp *p, uint8_t *dst, float scale, float zero_point,
+                                            float *data, float *bias, float *residual, size_t batch_size,
+                                            size_t channel_in, size_t height_in, size_t width_in);
+
+size_t (*QuantizedConvOpGetRequantizedOutputSizeRT)(QuantizedConvOp *p, size_t batch_size, size_t height_in,
+                                                    size_t width_in);
+
+void (*QuantizedConvOpWarmUpRT)(QuantizedConvOp *p, size_t batch_size, size_t channel_in, size_t height_in,
+                                size_t width_in);
+
+void (*QuantizedConvOpStartCalibrationRT)(QuantizedConvOp *p, CALIBRATION_MODE mode, float percentile);
+
+void (*QuantizedConvOpFinishCalibrationRT)(QuantizedConvOp *p);
+
+void (*QuantizedConvOpSetInputRangeRT)(QuantizedConvOp *p, float min, float max);
+
+int (*QuantizedConvOpGetInputRangeRT)(QuantizedConvOp *p, float *min, float *max);
+
+int (*QuantizedConvOpSavePackedRT)(QuantizedConvOp *p, const char *path);
+
+QuantizedConvOp *(*QuantizedConvOpLoadPackedRT)(const char *path);
+
+void (*QuantizedConvOpShrinkWorkspaceRT)(QuantizedConvOp *p);
+
+size_t (*QuantizedConvOpGetWorkspaceSavedBytesRT)(QuantizedConvOp *p);
+
+size_t (*QuantizedConvOpGetWorkspaceSizeRT)(QuantizedConvOp *p, size_t batch_size, size_t channel_in, size_t height_in,
+                                            size_t width_in);
+
+int (*QuantizedConvOpExecuteWithWorkspaceRT)(QuantizedConvOp *p, void *workspace, size_t workspace_size, float *dst,
+                                             float *data, float *bias, float *residual, size_t batch_size,
+                                             size_t channel_in, size_t height_in, size_t width_in);
+
 void (*QuantizedConvOpFreeRT)(QuantizedConvOp *p);
 
 QuantizedFCOp *(*QuantizedFCOpCreateRT)();
@@ -55,11 +99,97 @@ void (*QuantizedFCOpInitWeightRT)(QuantizedFCOp *p, float *weight);
 void (*QuantizedFCOpExecuteRT)(QuantizedFCOp *p, float *dst, float *data, float *bias, size_t batch_size,
                                size_t channel_in);
 
+void (*QuantizedFCOpWarmUpRT)(QuantizedFCOp *p, size_t batch_size, size_t channel_in);
+
+void (*QuantizedFCOpStartCalibrationRT)(QuantizedFCOp *p, CALIBRATION_MODE mode, float percentile);
+
+void (*QuantizedFCOpFinishCalibrationRT)(QuantizedFCOp *p);
+
+void (*QuantizedFCOpSetInputRangeRT)(QuantizedFCOp *p, float min, float max);
+
+int (*QuantizedFCOpGetInputRangeRT)(QuantizedFCOp *p, float *min, float *max);
+
+int (*QuantizedFCOpSavePackedRT)(QuantizedFCOp *p, const char *path);
+
+QuantizedFCOp *(*QuantizedFCOpLoadPackedRT)(const char *path);
+
+void (*QuantizedFCOpShrinkWorkspaceRT)(QuantizedFCOp *p);
+
+size_t (*QuantizedFCOpGetWorkspaceSavedBytesRT)(QuantizedFCOp *p);
+
+size_t (*QuantizedFCOpGetWorkspaceSizeRT)(QuantizedFCOp *p, size_t batch_size, size_t channel_in);
+
+int (*QuantizedFCOpExecuteWithWorkspaceRT)(QuantizedFCOp *p, void *workspace, size_t workspace_size, float *dst,
+                                           float *data, float *bias, size_t batch_size, size_t channel_in);
+
 void (*QuantizedFCOpFreeRT)(QuantizedFCOp *p);
 
+QuantizedGraph *(*QuantizedGraphCreateRT)(LAYOUT layout, size_t channel, size_t height, size_t width);
+
+size_t (*QuantizedGraphAddConvRT)(QuantizedGraph *p, size_t input, int residual, size_t channel_out, size_t group,
+                                  size_t kernel_h, size_t kernel_w, size_t stride_h, size_t stride_w, size_t pad_h,
+                                  size_t pad_w, size_t dilation_h, size_t dilation_w, size_t fusion_mask, float *weight,
+                                  float *bias, CONV_ALGORITHM algo);
+
+void (*QuantizedGraphSetupConvBNParameterRT)(QuantizedGraph *p, size_t tensor, float *mean, float *variance,
+                                             float *scale, float *shift, float eps);
+
+size_t (*QuantizedGraphAddFCRT)(QuantizedGraph *p, size_t input, size_t channel_out, float *weight, float *bias,
+                                FC_ALGORITHM algo);
+
+size_t (*QuantizedGraphAddPoolRT)(QuantizedGraph *p, size_t input, POOL_MODE mode, size_t kernel_h, size_t kernel_w,
+                                  size_t stride_h, size_t stride_w, size_t pad_h, size_t pad_w);
+
+size_t (*QuantizedGraphAddSumRT)(QuantizedGraph *p, size_t a, size_t b, int relu);
+
+size_t (*QuantizedGraphAddReLURT)(QuantizedGraph *p, size_t input);
+
+size_t (*QuantizedGraphGetOutputSizeRT)(QuantizedGraph *p);
+
+size_t (*QuantizedGraphGetActivationBytesRT)(QuantizedGraph *p, size_t batch_size);
+
+void (*QuantizedGraphExecuteRT)(QuantizedGraph *p, float *dst, float *data, size_t batch_size);
+
+void (*QuantizedGraphStartCalibrationRT)(QuantizedGraph *p, CALIBRATION_MODE mode, float percentile);
+
+void (*QuantizedGraphFinishCalibrationRT)(QuantizedGraph *p);
+
+int (*QuantizedGraphSaveCalibrationRT)(QuantizedGraph *p, const char *path);
+
+int (*QuantizedGraphLoadCalibrationRT)(QuantizedGraph *p, const char *path);
+
+int (*QuantizedGraphSavePackedRT)(QuantizedGraph *p, const char *path);
+
+QuantizedGraph *(*QuantizedGraphLoadPackedRT)(const char *path);
+
+void (*QuantizedGraphFreeRT)(QuantizedGraph *p);
+
+int (*BigQuantLoadTuningFileRT)(const char *path);
+
+int (*BigQuantSaveTuningFileRT)(const char *path);
+
+void (*BigQuantEnablePerfCountersRT)(int enable);
+
+int (*BigQuantPerfCountersEnabledRT)();
+
+void (*BigQuantResetPerfCountersRT)();
+
+int (*BigQuantGetPerfCounterRT)(PERF_COUNTER counter, struct PerfCounterValue *value);
+
+const char *(*BigQuantGetPerfCounterNameRT)(PERF_COUNTER counter);
+
+void (*BigQuantStartTraceRT)();
+
+int (*BigQuantStopTraceRT)(const char *path);
+
+const char *(*BigQuantGetISART)();
+
 void (*QuantizedConvKernelDescInitRT)(QuantizedTensorDesc *quantized_tensor, size_t c_out, size_t c_in, size_t kernel_h,
                                       size_t kernel_w);
 
+void (*QuantizedConvKernelDescInitWithWorkspaceRT)(QuantizedTensorDesc *quantized_tensor, void *workspace, size_t c_out,
+                                                   size_t c_in, size_t kernel_h, size_t kernel_w);
+
 void (*QuantizedConvKernelInitRT)(QuantizedTensorDesc *quantized_tensor, float *src, size_t c_out, size_t c_in,
                                   size_t kernel_h, size_t kernel_w, float threshold, LAYOUT layout);
 
@@ -71,15 +201,36 @@ void (*QuantizedConvDataDescInitRT)(QuantizedTensorDesc *quantized_tensor, size_
                                     size_t kernel_w, size_t stride_h, size_t stride_w, size_t pad_h, size_t pad_w,
                                     size_t dilation_h, size_t dilation_w, size_t batch_size, size_t h_in, size_t w_in);
 
+void (*QuantizedConvDataDescInitWithWorkspaceRT)(QuantizedTensorDesc *quantized_tensor, void *workspace, size_t c_in,
+                                                 size_t kernel_h, size_t kernel_w, size_t stride_h, size_t stride_w,
+                                                 size_t pad_h, size_t pad_w, size_t dilation_h, size_t dilation_w,
+                                                 size_t batch_size, size_t h_in, size_t w_in);
+
 void (*QuantizedConvDataInitRT)(QuantizedTensorDesc *quantized_tensor, float *src, size_t c_in, size_t kernel_h,
                                 size_t kernel_w, size_t stride_h, size_t stride_w, size_t pad_h, size_t pad_w,
                                 size_t dilation_h, size_t dilation_w, size_t batch_size, size_t h_in, size_t w_in,
                                 float threshold, LAYOUT layout);
 
+size_t (*QuantizedConvDataInitGetWorkspaceSizeRT)(size_t c_in, size_t kernel_h, size_t kernel_w, size_t stride_h,
+                                                  size_t stride_w, size_t pad_h, size_t pad_w, size_t dilation_h,
+                                                  size_t dilation_w, size_t batch_size, size_t h_in, size_t w_in,
+                                                  LAYOUT layout);
+
+void (*QuantizedConvDataInitWithWorkspaceRT)(QuantizedTensorDesc *quantized_tensor, void *workspace, float *src,
+                                             size_t c_in, size_t kernel_h, size_t kernel_w, size_t stride_h,
+                                             size_t stride_w, size_t pad_h, size_t pad_w, size_t dilation_h,
+                                             size_t dilation_w, size_t batch_size, size_t h_in, size_t w_in,
+                                             float threshold, LAYOUT layout);
+
 void (*QuantizedConvKernelSumDescInitRT)(FPTensorDesc *fp_tensor, size_t c_out);
 
+void (*QuantizedConvKernelSumDescInitWithWorkspaceRT)(FPTensorDesc *fp_tensor, void *workspace, size_t c_out);
+
 void (*QuantizedConvKernelSumInitRT)(FPTensorDesc *fp_tensor, float *src, size_t n, size_t c, size_t h, size_t w);
 
+void (*QuantizedConvKernelSumLoadFromModelRT)(FPTensorDesc *fp_tensor, int8_t *src, float *min, float *max,
+                                              size_t c_out, size_t c_in, size_t kernel_h, size_t kernel_w);
+
 void (*MixPrecisionGEMMRT)(LAYOUT layout, int8_t *pa, uint8_t *pb, float *pc, size_t m, size_t n, size_t k,
                            float *ratio_a, float *ratio_b, float *kernel_sum, float *min_b, float *bias,
                            size_t batch_size, size_t channel_per_group, size_t height_out, size_t width_out,
@@ -87,6 +238,9 @@ void (*MixPrecisionGEMMRT)(LAYOUT layout, int8_t *pa, uint8_t *pb, float *pc, si
 
 void (*QuantizedFCKernelDescInitRT)(QuantizedTensorDesc *quantized_tensor, size_t c_out, size_t c_in);
 
+void (*QuantizedFCKernelDescInitWithWorkspaceRT)(QuantizedTensorDesc *quantized_tensor, void *workspace, size_t c_out,
+                                                 size_t c_in);
+
 void (*QuantizedFCKernelInitRT)(QuantizedTensorDesc *quantized_tensor, float *src, size_t c_out, size_t c_in,
                                 float threshold, LAYOUT layout);
 
@@ -95,19 +249,46 @@ void (*QuantizedFCKernelLoadFromModelRT)(QuantizedTensorDesc *quantized_tensor,
 
 void (*QuantizedFCDataDescInitRT)(QuantizedTensorDesc *quantized_tensor, size_t batch_size, size_t channel);
 
+void (*QuantizedFCDataDescInitWithWorkspaceRT)(QuantizedTensorDesc *quantized_tensor, void *workspace,
+                                               size_t batch_size, size_t channel);
+
 void (*QuantizedFCDataInitRT)(QuantizedTensorDesc *quantized_tensor, float *src, size_t batch_size, size_t channel,
                               float threshold, LAYOUT layout);
 
 void (*QuantizedFCKernelSumDescInitRT)(FPTensorDesc *fp_tensor, size_t c_out);
 
+void (*QuantizedFCKernelSumDescInitWithWorkspaceRT)(FPTensorDesc *fp_tensor, void *workspace, size_t c_out);
+
 void (*QuantizedFCKernelSumInitRT)(FPTensorDesc *fp_tensor, float *src, size_t c_out, size_t c_in);
 
+void (*QuantizedFCKernelSumLoadFromModelRT)(FPTensorDesc *fp_tensor, int8_t *src, float *min, float *max,
+                                            size_t c_out, size_t c_in);
+
+size_t (*QuantizedTensorDescGetWorkspaceSizeRT)(const QuantizedTensorDesc *quantized_tensor);
+
+size_t (*FPTensorDescGetWorkspaceSizeRT)(const FPTensorDesc *fp_tensor);
+
 void (*FreeFPTensorRT)(struct FPTensorDesc *p);
 
 void (*FreeQuantizedTensorRT)(struct QuantizedTensorDesc *p);
 
+#if defined(SINGLE_LIBRARY)
+// stands in for dlsym on the table of the selected ISA
+static void *FindIsaSymbol(const IsaSymbol *symbols, const char *name) {
+  for (const IsaSymbol *symbol = symbols; symbol->name != NULL; symbol++) {
+    if (strcmp(symbol->name, name) == 0) {
+      return symbol->address;
+    }
+  }
+  fprintf(stderr, "%s is missing from the ISA table in c_api_isa.cc.\n", name);
+  return NULL;
+}
+#endif  // SINGLE_LIBRARY
+
 void BindSymbol() {
-#if defined(WINDOWS)
+#if defined(SINGLE_LIBRARY)
+#define BINDSYMBOL FindIsaSymbol
+#elif defined(WINDOWS)
 #define BINDSYMBOL GetProcAddress
 #else
 #define BINDSYMBOL dlsym
@@ -120,9 +301,46 @@ void BindSymbol() {
           BINDSYMBOL(handler, "InternalQuantizedConvOpSetupConvParameter"));
   QuantizedConvOpInitWeightRT =
       reinterpret_cast<void (*)(QuantizedConvOp *, float *)>(BINDSYMBOL(handler, "InternalQuantizedConvOpInitWeight"));
+  QuantizedConvOpSetupBNParameterRT =
+      reinterpret_cast<void (*)(QuantizedConvOp *, float *, float *, float *, float *, float)>(
+          BINDSYMBOL(handler, "InternalQuantizedConvOpSetupBNParameter"));
   QuantizedConvOpExecuteRT =
       reinterpret_cast<void (*)(QuantizedConvOp *, float *, float *, float *, size_t, size_t, size_t, size_t)>(
           BINDSYMBOL(handler, "InternalQuantizedConvOpExecute"));
+  QuantizedConvOpExecuteWithResidualRT =
+      reinterpret_cast<void (*)(QuantizedConvOp *, float *, float *, float *, float *, size_t, size_t, size_t, size_t)>(
+          BINDSYMBOL(handler, "InternalQuantizedConvOpExecuteWithResidual"));
+  QuantizedConvOpExecuteRequantizedRT =
+      reinterpret_cast<void (*)(QuantizedConvOp *, uint8_t *, float, float, float *, float *, float *, size_t, size_t,
+                                size_t, size_t)>(
+          BINDSYMBOL(handler, "InternalQuantizedConvOpExecuteRequantized"));
+  QuantizedConvOpGetRequantizedOutputSizeRT =
+      reinterpret_cast<size_t (*)(QuantizedConvOp *, size_t, size_t, size_t)>(
+          BINDSYMBOL(handler, "InternalQuantizedConvOpGetRequantizedOutputSize"));
+  QuantizedConvOpWarmUpRT = reinterpret_cast<void (*)(QuantizedConvOp *, size_t, size_t, size_t, size_t)>(
+      BINDSYMBOL(handler, "InternalQuantizedConvOpWarmUp"));
+  QuantizedConvOpStartCalibrationRT = reinterpret_cast<void (*)(QuantizedConvOp *, CALIBRATION_MODE, float)>(
+      BINDSYMBOL(handler, "InternalQuantizedConvOpStartCalibration"));
+  QuantizedConvOpFinishCalibrationRT =
+      reinterpret_cast<void (*)(QuantizedConvOp *)>(BINDSYMBOL(handler, "InternalQuantizedConvOpFinishCalibration"));
+  QuantizedConvOpSetInputRangeRT = reinterpret_cast<void (*)(QuantizedConvOp *, float, float)>(
+      BINDSYMBOL(handler, "InternalQuantizedConvOpSetInputRange"));
+  QuantizedConvOpGetInputRangeRT = reinterpret_cast<int (*)(QuantizedConvOp *, float *, float *)>(
+      BINDSYMBOL(handler, "InternalQuantizedConvOpGetInputRange"));
+  QuantizedConvOpSavePackedRT = reinterpret_cast<int (*)(QuantizedConvOp *, const char *)>(
+      BINDSYMBOL(handler, "InternalQuantizedConvOpSavePacked"));
+  QuantizedConvOpLoadPackedRT =
+      reinterpret_cast<QuantizedConvOp *(*)(const char *)>(BINDSYMBOL(handler, "InternalQuantizedConvOpLoadPacked"));
+  QuantizedConvOpShrinkWorkspaceRT =
+      reinterpret_cast<void (*)(QuantizedConvOp *)>(BINDSYMBOL(handler, "InternalQuantizedConvOpShrinkWorkspace"));
+  QuantizedConvOpGetWorkspaceSavedBytesRT = reinterpret_cast<size_t (*)(QuantizedConvOp *)>(
+      BINDSYMBOL(handler, "InternalQuantizedConvOpGetWorkspaceSavedBytes"));
+  QuantizedConvOpGetWorkspaceSizeRT = reinterpret_cast<size_t (*)(QuantizedConvOp *, size_t, size_t, size_t, size_t)>(
+      BINDSYMBOL(handler, "InternalQuantizedConvOpGetWorkspaceSize"));
+  QuantizedConvOpExecuteWithWorkspaceRT =
+      reinterpret_cast<int (*)(QuantizedConvOp *, void *, size_t, float *, float *, float *, float *, size_t, size_t,
+                               size_t, size_t)>(
+          BINDSYMBOL(handler, "InternalQuantizedConvOpExecuteWithWorkspace"));
   QuantizedConvOpFreeRT =
       reinterpret_cast<void (*)(QuantizedConvOp *)>(BINDSYMBOL(handler, "InternalQuantizedConvOpFree"));
   QuantizedFCOpCreateRT = reinterpret_cast<QuantizedFCOp *(*)()>(BINDSYMBOL(handler, "InternalQuantizedFCOpCreate"));
@@ -132,9 +350,90 @@ void BindSymbol() {
       reinterpret_cast<void (*)(QuantizedFCOp *, float *)>(BINDSYMBOL(handler, "InternalQuantizedFCOpInitWeight"));
   QuantizedFCOpExecuteRT = reinterpret_cast<void (*)(QuantizedFCOp *, float *, float *, float *, size_t, size_t)>(
       BINDSYMBOL(handler, "InternalQuantizedFCOpExecute"));
+  QuantizedFCOpWarmUpRT = reinterpret_cast<void (*)(QuantizedFCOp *, size_t, size_t)>(
+      BINDSYMBOL(handler, "InternalQuantizedFCOpWarmUp"));
+  QuantizedFCOpStartCalibrationRT = reinterpret_cast<void (*)(QuantizedFCOp *, CALIBRATION_MODE, float)>(
+      BINDSYMBOL(handler, "InternalQuantizedFCOpStartCalibration"));
+  QuantizedFCOpFinishCalibrationRT =
+      reinterpret_cast<void (*)(QuantizedFCOp *)>(BINDSYMBOL(handler, "InternalQuantizedFCOpFinishCalibration"));
+  QuantizedFCOpSetInputRangeRT = reinterpret_cast<void (*)(QuantizedFCOp *, float, float)>(
+      BINDSYMBOL(handler, "InternalQuantizedFCOpSetInputRange"));
+  QuantizedFCOpGetInputRangeRT = reinterpret_cast<int (*)(QuantizedFCOp *, float *, float *)>(
+      BINDSYMBOL(handler, "InternalQuantizedFCOpGetInputRange"));
+  QuantizedFCOpSavePackedRT = reinterpret_cast<int (*)(QuantizedFCOp *, const char *)>(
+      BINDSYMBOL(handler, "InternalQuantizedFCOpSavePacked"));
+  QuantizedFCOpLoadPackedRT =
+      reinterpret_cast<QuantizedFCOp *(*)(const char *)>(BINDSYMBOL(handler, "InternalQuantizedFCOpLoadPacked"));
+  QuantizedFCOpShrinkWorkspaceRT =
+      reinterpret_cast<void (*)(QuantizedFCOp *)>(BINDSYMBOL(handler, "InternalQuantizedFCOpShrinkWorkspace"));
+  QuantizedFCOpGetWorkspaceSavedBytesRT = reinterpret_cast<size_t (*)(QuantizedFCOp *)>(
+      BINDSYMBOL(handler, "InternalQuantizedFCOpGetWorkspaceSavedBytes"));
+  QuantizedFCOpGetWorkspaceSizeRT = reinterpret_cast<size_t (*)(QuantizedFCOp *, size_t, size_t)>(
+      BINDSYMBOL(handler, "InternalQuantizedFCOpGetWorkspaceSize"));
+  QuantizedFCOpExecuteWithWorkspaceRT =
+      reinterpret_cast<int (*)(QuantizedFCOp *, void *, size_t, float *, float *, float *, size_t, size_t)>(
+          BINDSYMBOL(handler, "InternalQuantizedFCOpExecuteWithWorkspace"));
   QuantizedFCOpFreeRT = reinterpret_cast<void (*)(QuantizedFCOp *)>(BINDSYMBOL(handler, "InternalQuantizedFCOpFree"));
+  QuantizedGraphCreateRT = reinterpret_cast<QuantizedGraph *(*)(LAYOUT, size_t, size_t, size_t)>(
+      BINDSYMBOL(handler, "InternalQuantizedGraphCreate"));
+  QuantizedGraphAddConvRT =
+      reinterpret_cast<size_t (*)(QuantizedGraph *, size_t, int, size_t, size_t, size_t, size_t, size_t, size_t, size_t,
+                                  size_t, size_t, size_t, size_t, float *, float *, CONV_ALGORITHM)>(
+          BINDSYMBOL(handler, "InternalQuantizedGraphAddConv"));
+  QuantizedGraphSetupConvBNParameterRT =
+      reinterpret_cast<void (*)(QuantizedGraph *, size_t, float *, float *, float *, float *, float)>(
+          BINDSYMBOL(handler, "InternalQuantizedGraphSetupConvBNParameter"));
+  QuantizedGraphAddFCRT =
+      reinterpret_cast<size_t (*)(QuantizedGraph *, size_t, size_t, float *, float *, FC_ALGORITHM)>(
+          BINDSYMBOL(handler, "InternalQuantizedGraphAddFC"));
+  QuantizedGraphAddPoolRT =
+      reinterpret_cast<size_t (*)(QuantizedGraph *, size_t, POOL_MODE, size_t, size_t, size_t, size_t, size_t, size_t)>(
+          BINDSYMBOL(handler, "InternalQuantizedGraphAddPool"));
+  QuantizedGraphAddSumRT = reinterpret_cast<size_t (*)(QuantizedGraph *, size_t, size_t, int)>(
+      BINDSYMBOL(handler, "InternalQuantizedGraphAddSum"));
+  QuantizedGraphAddReLURT = reinterpret_cast<size_t (*)(QuantizedGraph *, size_t)>(
+      BINDSYMBOL(handler, "InternalQuantizedGraphAddReLU"));
+  QuantizedGraphGetOutputSizeRT = reinterpret_cast<size_t (*)(QuantizedGraph *)>(
+      BINDSYMBOL(handler, "InternalQuantizedGraphGetOutputSize"));
+  QuantizedGraphGetActivationBytesRT = reinterpret_cast<size_t (*)(QuantizedGraph *, size_t)>(
+      BINDSYMBOL(handler, "InternalQuantizedGraphGetActivationBytes"));
+  QuantizedGraphExecuteRT = reinterpret_cast<void (*)(QuantizedGraph *, float *, float *, size_t)>(
+      BINDSYMBOL(handler, "InternalQuantizedGraphExecute"));
+  QuantizedGraphStartCalibrationRT = reinterpret_cast<void (*)(QuantizedGraph *, CALIBRATION_MODE, float)>(
+      BINDSYMBOL(handler, "InternalQuantizedGraphStartCalibration"));
+  QuantizedGraphFinishCalibrationRT =
+      reinterpret_cast<void (*)(QuantizedGraph *)>(BINDSYMBOL(handler, "InternalQuantizedGraphFinishCalibration"));
+  QuantizedGraphSaveCalibrationRT = reinterpret_cast<int (*)(QuantizedGraph *, const char *)>(
+      BINDSYMBOL(handler, "InternalQuantizedGraphSaveCalibration"));
+  QuantizedGraphLoadCalibrationRT = reinterpret_cast<int (*)(QuantizedGraph *, const char *)>(
+      BINDSYMBOL(handler, "InternalQuantizedGraphLoadCalibration"));
+  QuantizedGraphSavePackedRT = reinterpret_cast<int (*)(QuantizedGraph *, const char *)>(
+      BINDSYMBOL(handler, "InternalQuantizedGraphSavePacked"));
+  QuantizedGraphLoadPackedRT =
+      reinterpret_cast<QuantizedGraph *(*)(const char *)>(BINDSYMBOL(handler, "InternalQuantizedGraphLoadPacked"));
+  QuantizedGraphFreeRT =
+      reinterpret_cast<void (*)(QuantizedGraph *)>(BINDSYMBOL(handler, "InternalQuantizedGraphFree"));
+  BigQuantLoadTuningFileRT =
+      reinterpret_cast<int (*)(const char *)>(BINDSYMBOL(handler, "InternalBigQuantLoadTuningFile"));
+  BigQuantSaveTuningFileRT =
+      reinterpret_cast<int (*)(const char *)>(BINDSYMBOL(handler, "InternalBigQuantSaveTuningFile"));
+  BigQuantEnablePerfCountersRT =
+      reinterpret_cast<void (*)(int)>(BINDSYMBOL(handler, "InternalBigQuantEnablePerfCounters"));
+  BigQuantPerfCountersEnabledRT =
+      reinterpret_cast<int (*)()>(BINDSYMBOL(handler, "InternalBigQuantPerfCountersEnabled"));
+  BigQuantResetPerfCountersRT = reinterpret_cast<void (*)()>(BINDSYMBOL(handler, "InternalBigQuantResetPerfCounters"));
+  BigQuantGetPerfCounterRT = reinterpret_cast<int (*)(PERF_COUNTER, struct PerfCounterValue *)>(
+      BINDSYMBOL(handler, "InternalBigQuantGetPerfCounter"));
+  BigQuantGetPerfCounterNameRT =
+      reinterpret_cast<const char *(*)(PERF_COUNTER)>(BINDSYMBOL(handler, "InternalBigQuantGetPerfCounterName"));
+  BigQuantStartTraceRT = reinterpret_cast<void (*)()>(BINDSYMBOL(handler, "InternalBigQuantStartTrace"));
+  BigQuantStopTraceRT = reinterpret_cast<int (*)(const char *)>(BINDSYMBOL(handler, "InternalBigQuantStopTrace"));
+  BigQuantGetISART = reinterpret_cast<const char *(*)()>(BINDSYMBOL(handler, "InternalBigQuantGetISA"));
   QuantizedConvKernelDescInitRT = reinterpret_cast<void (*)(QuantizedTensorDesc *, size_t, size_t, size_t, size_t)>(
       BINDSYMBOL(handler, "InternalQuantizedConvKernelDescInit"));
+  QuantizedConvKernelDescInitWithWorkspaceRT =
+      reinterpret_cast<void (*)(QuantizedTensorDesc *, void *, size_t, size_t, size_t, size_t)>(
+          BINDSYMBOL(handler, "InternalQuantizedConvKernelDescInitWithWorkspace"));
   QuantizedConvKernelInitRT =
       reinterpret_cast<void (*)(QuantizedTensorDesc *, float *, size_t, size_t, size_t, size_t, float, LAYOUT)>(
           BINDSYMBOL(handler, "InternalQuantizedConvKernelInit"));
@@ -144,20 +443,39 @@ void BindSymbol() {
   QuantizedConvDataDescInitRT = reinterpret_cast<void (*)(QuantizedTensorDesc *, size_t, size_t, size_t, size_t, size_t,
                                                           size_t, size_t, size_t, size_t, size_t, size_t, size_t)>(
       BINDSYMBOL(handler, "InternalQuantizedConvDataDescInit"));
+  QuantizedConvDataDescInitWithWorkspaceRT =
+      reinterpret_cast<void (*)(QuantizedTensorDesc *, void *, size_t, size_t, size_t, size_t, size_t, size_t, size_t,
+                                size_t, size_t, size_t, size_t, size_t)>(
+          BINDSYMBOL(handler, "InternalQuantizedConvDataDescInitWithWorkspace"));
   QuantizedConvDataInitRT =
       reinterpret_cast<void (*)(QuantizedTensorDesc *, float *, size_t, size_t, size_t, size_t, size_t, size_t, size_t,
                                 size_t, size_t, size_t, size_t, size_t, float, LAYOUT)>(
           BINDSYMBOL(handler, "InternalQuantizedConvDataInit"));
+  QuantizedConvDataInitGetWorkspaceSizeRT =
+      reinterpret_cast<size_t (*)(size_t, size_t, size_t, size_t, size_t, size_t, size_t, size_t, size_t, size_t,
+                                  size_t, size_t, LAYOUT)>(
+          BINDSYMBOL(handler, "InternalQuantizedConvDataInitGetWorkspaceSize"));
+  QuantizedConvDataInitWithWorkspaceRT =
+      reinterpret_cast<void (*)(QuantizedTensorDesc *, void *, float *, size_t, size_t, size_t, size_t, size_t, size_t,
+                                size_t, size_t, size_t, size_t, size_t, size_t, float, LAYOUT)>(
+          BINDSYMBOL(handler, "InternalQuantizedConvDataInitWithWorkspace"));
   QuantizedConvKernelSumDescInitRT =
       reinterpret_cast<void (*)(FPTensorDesc *, size_t)>(BINDSYMBOL(handler, "InternalQuantizedConvKernelSumDescInit"));
+  QuantizedConvKernelSumDescInitWithWorkspaceRT = reinterpret_cast<void (*)(FPTensorDesc *, void *, size_t)>(
+      BINDSYMBOL(handler, "InternalQuantizedConvKernelSumDescInitWithWorkspace"));
   QuantizedConvKernelSumInitRT = reinterpret_cast<void (*)(FPTensorDesc *, float *, size_t, size_t, size_t, size_t)>(
       BINDSYMBOL(handler, "InternalQuantizedConvKernelSumInit"));
+  QuantizedConvKernelSumLoadFromModelRT =
+      reinterpret_cast<void (*)(FPTensorDesc *, int8_t *, float *, float *, size_t, size_t, size_t, size_t)>(
+          BINDSYMBOL(handler, "InternalQuantizedConvKernelSumLoadFromModel"));
   MixPrecisionGEMMRT =
       reinterpret_cast<void (*)(LAYOUT, int8_t *, uint8_t *, float *, size_t, size_t, size_t, float *, float *, float *,
                                 float *, float *, size_t, size_t, size_t, size_t, float, size_t, size_t)>(
           BINDSYMBOL(handler, "InternalMixPrecisionGEMM"));
   QuantizedFCKernelDescInitRT = reinterpret_cast<void (*)(QuantizedTensorDesc *, size_t, size_t)>(
       BINDSYMBOL(handler, "InternalQuantizedFCKernelDescInit"));
+  QuantizedFCKernelDescInitWithWorkspaceRT = reinterpret_cast<void (*)(QuantizedTensorDesc *, void *, size_t, size_t)>(
+      BINDSYMBOL(handler, "InternalQuantizedFCKernelDescInitWithWorkspace"));
   QuantizedFCKernelInitRT = reinterpret_cast<void (*)(QuantizedTensorDesc *, float *, size_t, size_t, float, LAYOUT)>(
       BINDSYMBOL(handler, "InternalQuantizedFCKernelInit"));
   QuantizedFCKernelLoadFromModelRT =
@@ -165,46 +483,93 @@ void BindSymbol() {
           BINDSYMBOL(handler, "InternalQuantizedFCKernelLoadFromModel"));
   QuantizedFCDataDescInitRT = reinterpret_cast<void (*)(QuantizedTensorDesc *, size_t, size_t)>(
       BINDSYMBOL(handler, "InternalQuantizedFCDataDescInit"));
+  QuantizedFCDataDescInitWithWorkspaceRT = reinterpret_cast<void (*)(QuantizedTensorDesc *, void *, size_t, size_t)>(
+      BINDSYMBOL(handler, "InternalQuantizedFCDataDescInitWithWorkspace"));
   QuantizedFCDataInitRT = reinterpret_cast<void (*)(QuantizedTensorDesc *, float *, size_t, size_t, float, LAYOUT)>(
       BINDSYMBOL(handler, "InternalQuantizedFCDataInit"));
   QuantizedFCKernelSumDescInitRT =
       reinterpret_cast<void (*)(FPTensorDesc *, size_t)>(BINDSYMBOL(handler, "InternalQuantizedFCKernelSumDescInit"));
+  QuantizedFCKernelSumDescInitWithWorkspaceRT = reinterpret_cast<void (*)(FPTensorDesc *, void *, size_t)>(
+      BINDSYMBOL(handler, "InternalQuantizedFCKernelSumDescInitWithWorkspace"));
   QuantizedFCKernelSumInitRT = reinterpret_cast<void (*)(FPTensorDesc *, float *, size_t, size_t)>(
       BINDSYMBOL(handler, "InternalQuantizedFCKernelSumInit"));
+  QuantizedFCKernelSumLoadFromModelRT =
+      reinterpret_cast<void (*)(FPTensorDesc *, int8_t *, float *, float *, size_t, size_t)>(
+          BINDSYMBOL(handler, "InternalQuantizedFCKernelSumLoadFromModel"));
+  QuantizedTensorDescGetWorkspaceSizeRT = reinterpret_cast<size_t (*)(const QuantizedTensorDesc *)>(
+      BINDSYMBOL(handler, "InternalQuantizedTensorDescGetWorkspaceSize"));
+  FPTensorDescGetWorkspaceSizeRT = reinterpret_cast<size_t (*)(const FPTensorDesc *)>(
+      BINDSYMBOL(handler, "InternalFPTensorDescGetWorkspaceSize"));
   FreeFPTensorRT = reinterpret_cast<void (*)(FPTensorDesc *)>(BINDSYMBOL(handler, "InternalFreeFPTensor"));
   FreeQuantizedTensorRT =
       reinterpret_cast<void (*)(QuantizedTensorDesc *)>(BINDSYMBOL(handler, "InternalFreeQuantizedTensor"));
 #undef BINDSYMBOL
 }
 
+// The widest ISA the CPU supports, or the narrower one BIGQUANT_ISA names. NULL if the CPU lacks SSE4.2.
+static const char *SelectISA() {
+  bool support_avx512 = false;
+#if !defined(WINDOWS) && !defined(__APPLE__)
+  support_avx512 = cpuid_support_feature(AVX_512);
+#endif
+  bool support_avx2 = cpuid_support_feature(AVX2_FMA);
+  bool support_sse42 = cpuid_support_feature(SSE4_2);
+  const char *isa = getenv("BIGQUANT_ISA");
+  if (isa != NULL) {
+    if ((strcmp(isa, "avx512") == 0 && support_avx512) || (strcmp(isa, "avx2") == 0 && support_avx2) ||
+        (strcmp(isa, "sse42") == 0 && support_sse42)) {
+      return isa;
+    }
+    fprintf(stderr, "BIGQUANT_ISA=%s is not supported on this CPU and is ignored.\n", isa);
+  }
+  if (support_avx512) {
+    return "avx512";
+  } else if (support_avx2) {
+    return "avx2";
+  } else if (support_sse42) {
+    return "sse42";
+  }
+  return NULL;
+}
+
+#if defined(SINGLE_LIBRARY)
+static const IsaSymbol *SelectIsaSymbols(const char *isa) {
+#if !defined(WINDOWS) && !defined(__APPLE__)
+  if (strcmp(isa, "avx512") == 0) {
+    return avx512::IsaSymbols();
+  }
+#endif
+  if (strcmp(isa, "avx2") == 0) {
+    return avx2::IsaSymbols();
+  }
+  return sse42::IsaSymbols();
+}
+#endif  // SINGLE_LIBRARY
+
 int ManualRuntimeLoadLib(char *path) {
-#if defined(MANUAL_LOAD)
+#if defined(SINGLE_LIBRARY)
+  // every ISA is linked in and bound when the library is loaded
+  return 0;
+#elif defined(MANUAL_LOAD)
   char lib_path[300];
   strncpy(lib_path, path, 200);
+  lib_path[200] = '\0';
 #if defined(WINDOWS)
-  char *ext = ".dll";
+  const char *ext = ".dll";
 #elif defined(__APPLE__)
-  char *ext = ".dylib";
+  const char *ext = ".dylib";
 #else
   const char *ext = ".so";
 #endif
   if (handler == NULL) {
-    if (cpuid_support_feature(AVX2_FMA)) {
-      strncat(lib_path, "/libbigquant_avx2", 100);
-    } else if (cpuid_support_feature(SSE4_2)) {
-      strncat(lib_path, "/libbigquant_sse42", 100);
-    }
-    #if ! defined(WINDOWS) && ! defined(__APPLE__)
-    if (cpuid_support_feature(AVX_512)) {
-      lib_path[strlen(path)] = '\0';
-      strncat(lib_path, "/libbigquant_avx512", 100);
-    }
-    #endif
-    if (lib_path[strlen(path)] == '\0') {
+    const char *isa = SelectISA();
+    if (isa == NULL) {
       fprintf(stderr, "Unsupported ISA. Bigquant supports Instruction Set from SSE42 to AVX512.\n");
       return -1;
     }
-    strncat(lib_path, ext, 100);
+    strncat(lib_path, "/libbigquant_", 20);
+    strncat(lib_path, isa, 10);
+    strncat(lib_path, ext, 10);
 #if defined(WINDOWS)
     handler = LoadLibrary(lib_path);
 #else   // WINSOWS
@@ -230,7 +595,15 @@ int ManualRuntimeLoadLib(char *path) {
 }
 
 void __attribute__((constructor)) init_shared_library() {
-#ifndef MANUAL_LOAD
+#if defined(SINGLE_LIBRARY)
+  const char *isa = SelectISA();
+  if (isa == NULL) {
+    fprintf(stderr, "Unsupported ISA. Bigquant supports Instruction Set from SSE42 to AVX512.\n");
+    exit(-1);
+  }
+  handler = SelectIsaSymbols(isa);
+  BindSymbol();
+#elif !defined(MANUAL_LOAD)
   std::string lib_path;
 #if defined(WINDOWS)
   std::string ext = ".dll";
@@ -240,21 +613,12 @@ void __attribute__((constructor)) init_shared_library() {
   std::string ext = ".so";
 #endif
   if (handler == NULL) {
-    if (cpuid_support_feature(AVX2_FMA)) {
-      lib_path = "libbigquant_avx2";
-    } else if (cpuid_support_feature(SSE4_2)) {
-      lib_path = "libbigquant_sse42";
-    }
-    #if ! defined(WINDOWS) && ! defined(__APPLE__)
-    if (cpuid_support_feature(AVX_512)) {
-      lib_path = "libbigquant_avx512";
-    }
-    #endif
-    if (lib_path.empty()) {
+    const char *isa = SelectISA();
+    if (isa == NULL) {
       std::cerr << "Unsupported ISA. Bigquant supports Instruction Set from SSE42 to AVX512.\n" << std::endl;
       exit(-1);
     }
-    lib_path += ext;
+    lib_path = std::string("libbigquant_") + isa + ext;
 #if defined(WINDOWS)
     handler = LoadLibrary(lib_path.c_str());
 #else   // WINSOWS
@@ -276,7 +640,7 @@ void __attribute__((constructor)) init_shared_library() {
 }
 
 void __attribute__((destructor)) free_shared_library() {
-#ifndef MANUAL_LOAD
+#if !defined(MANUAL_LOAD) && !defined(SINGLE_LIBRARY)
   if (handler != NULL) {
 #if defined(WINDOWS)
     FreeLibrary(handler);
@@ -303,11 +667,82 @@ void QuantizedConvOpInitWeight(QuantizedConvOp *p, float *weight) {
   QuantizedConvOpInitWeightRT(p, weight);
 }
 
+void QuantizedConvOpSetupBNParameter(QuantizedConvOp *p, float *mean, float *variance, float *scale, float *shift,
+                                     float eps) {
+  QuantizedConvOpSetupBNParameterRT(p, mean, variance, scale, shift, eps);
+}
+
 void QuantizedConvOpExecute(QuantizedConvOp *p, float *dst, float *data, float *bias, size_t batch_size,
                             size_t channel_in, size_t height_in, size_t width_in) {
   QuantizedConvOpExecuteRT(p, dst, data, bias, batch_size, channel_in, height_in, width_in);
 }
 
+void QuantizedConvOpExecuteWithResidual(QuantizedConvOp *p, float *dst, float *data, float *bias, float *residual,
+                                        size_t batch_size, size_t channel_in, size_t height_in, size_t width_in) {
+  QuantizedConvOpExecuteWithResidualRT(p, dst, data, bias, residual, batch_size, channel_in, height_in, width_in);
+}
+
+void QuantizedConvOpExecuteRequantized(QuantizedConvOp *p, uint8_t *dst, float scale, float zero_point, float *data,
+                                       float *bias, float *residual, size_t batch_size, size_t channel_in,
+                                       size_t height_in, size_t width_in) {
+  QuantizedConvOpExecuteRequantizedRT(p, dst, scale, zero_point, data, bias, residual, batch_size, channel_in,
+                                      height_in, width_in);
+}
+
+size_t QuantizedConvOpGetRequantizedOutputSize(QuantizedConvOp *p, size_t batch_size, size_t height_in,
+                                               size_t width_in) {
+  return QuantizedConvOpGetRequantizedOutputSizeRT(p, batch_size, height_in, width_in);
+}
+
+void QuantizedConvOpWarmUp(QuantizedConvOp *p, size_t batch_size, size_t channel_in, size_t height_in,
+                           size_t width_in) {
+  QuantizedConvOpWarmUpRT(p, batch_size, channel_in, height_in, width_in);
+}
+
+void QuantizedConvOpStartCalibration(QuantizedConvOp *p, CALIBRATION_MODE mode, float percentile) {
+  QuantizedConvOpStartCalibrationRT(p, mode, percentile);
+}
+
+void QuantizedConvOpFinishCalibration(QuantizedConvOp *p) {
+  QuantizedConvOpFinishCalibrationRT(p);
+}
+
+void QuantizedConvOpSetInputRange(QuantizedConvOp *p, float min, float max) {
+  QuantizedConvOpSetInputRangeRT(p, min, max);
+}
+
+int QuantizedConvOpGetInputRange(QuantizedConvOp *p, float *min, float *max) {
+  return QuantizedConvOpGetInputRangeRT(p, min, max);
+}
+
+int QuantizedConvOpSavePacked(QuantizedConvOp *p, const char *path) {
+  return QuantizedConvOpSavePackedRT(p, path);
+}
+
+QuantizedConvOp *QuantizedConvOpLoadPacked(const char *path) {
+  return QuantizedConvOpLoadPackedRT(path);
+}
+
+void QuantizedConvOpShrinkWorkspace(QuantizedConvOp *p) {
+  QuantizedConvOpShrinkWorkspaceRT(p);
+}
+
+size_t QuantizedConvOpGetWorkspaceSavedBytes(QuantizedConvOp *p) {
+  return QuantizedConvOpGetWorkspaceSavedBytesRT(p);
+}
+
+size_t QuantizedConvOpGetWorkspaceSize(QuantizedConvOp *p, size_t batch_size, size_t channel_in, size_t height_in,
+                                       size_t width_in) {
+  return QuantizedConvOpGetWorkspaceSizeRT(p, batch_size, channel_in, height_in, width_in);
+}
+
+int QuantizedConvOpExecuteWithWorkspace(QuantizedConvOp *p, void *workspace, size_t workspace_size, float *dst,
+                                        float *data, float *bias, float *residual, size_t batch_size, size_t channel_in,
+                                        size_t height_in, size_t width_in) {
+  return QuantizedConvOpExecuteWithWorkspaceRT(p, workspace, workspace_size, dst, data, bias, residual, batch_size,
+                                               channel_in, height_in, width_in);
+}
+
 void QuantizedConvOpFree(QuantizedConvOp *p) {
   QuantizedConvOpFreeRT(p);
 }
@@ -330,15 +765,180 @@ void QuantizedFCOpExecute(QuantizedFCOp *p, float *dst, float *data, float *bias
   QuantizedFCOpExecuteRT(p, dst, data, bias, batch_size, channel_in);
 }
 
+void QuantizedFCOpWarmUp(QuantizedFCOp *p, size_t batch_size, size_t channel_in) {
+  QuantizedFCOpWarmUpRT(p, batch_size, channel_in);
+}
+
+void QuantizedFCOpStartCalibration(QuantizedFCOp *p, CALIBRATION_MODE mode, float percentile) {
+  QuantizedFCOpStartCalibrationRT(p, mode, percentile);
+}
+
+void QuantizedFCOpFinishCalibration(QuantizedFCOp *p) {
+  QuantizedFCOpFinishCalibrationRT(p);
+}
+
+void QuantizedFCOpSetInputRange(QuantizedFCOp *p, float min, float max) {
+  QuantizedFCOpSetInputRangeRT(p, min, max);
+}
+
+int QuantizedFCOpGetInputRange(QuantizedFCOp *p, float *min, float *max) {
+  return QuantizedFCOpGetInputRangeRT(p, min, max);
+}
+
+int QuantizedFCOpSavePacked(QuantizedFCOp *p, const char *path) {
+  return QuantizedFCOpSavePackedRT(p, path);
+}
+
+QuantizedFCOp *QuantizedFCOpLoadPacked(const char *path) {
+  return QuantizedFCOpLoadPackedRT(path);
+}
+
+void QuantizedFCOpShrinkWorkspace(QuantizedFCOp *p) {
+  QuantizedFCOpShrinkWorkspaceRT(p);
+}
+
+size_t QuantizedFCOpGetWorkspaceSavedBytes(QuantizedFCOp *p) {
+  return QuantizedFCOpGetWorkspaceSavedBytesRT(p);
+}
+
+size_t QuantizedFCOpGetWorkspaceSize(QuantizedFCOp *p, size_t batch_size, size_t channel_in) {
+  return QuantizedFCOpGetWorkspaceSizeRT(p, batch_size, channel_in);
+}
+
+int QuantizedFCOpExecuteWithWorkspace(QuantizedFCOp *p, void *workspace, size_t workspace_size, float *dst, float *data,
+                                      float *bias, size_t batch_size, size_t channel_in) {
+  return QuantizedFCOpExecuteWithWorkspaceRT(p, workspace, workspace_size, dst, data, bias, batch_size, channel_in);
+}
+
 void QuantizedFCOpFree(QuantizedFCOp *p) {
   QuantizedFCOpFreeRT(p);
 }
 
+QuantizedGraph *QuantizedGraphCreate(LAYOUT layout, size_t channel, size_t height, size_t width) {
+  return QuantizedGraphCreateRT(layout, channel, height, width);
+}
+
+size_t QuantizedGraphAddConv(QuantizedGraph *p, size_t input, int residual, size_t channel_out, size_t group,
+                             size_t kernel_h, size_t kernel_w, size_t stride_h, size_t stride_w, size_t pad_h,
+                             size_t pad_w, size_t dilation_h, size_t dilation_w, size_t fusion_mask, float *weight,
+                             float *bias, CONV_ALGORITHM algo) {
+  return QuantizedGraphAddConvRT(p, input, residual, channel_out, group, kernel_h, kernel_w, stride_h, stride_w, pad_h,
+                                 pad_w, dilation_h, dilation_w, fusion_mask, weight, bias, algo);
+}
+
+void QuantizedGraphSetupConvBNParameter(QuantizedGraph *p, size_t tensor, float *mean, float *variance, float *scale,
+                                        float *shift, float eps) {
+  QuantizedGraphSetupConvBNParameterRT(p, tensor, mean, variance, scale, shift, eps);
+}
+
+size_t QuantizedGraphAddFC(QuantizedGraph *p, size_t input, size_t channel_out, float *weight, float *bias,
+                           FC_ALGORITHM algo) {
+  return QuantizedGraphAddFCRT(p, input, channel_out, weight, bias, algo);
+}
+
+size_t QuantizedGraphAddPool(QuantizedGraph *p, size_t input, POOL_MODE mode, size_t kernel_h, size_t kernel_w,
+                             size_t stride_h, size_t stride_w, size_t pad_h, size_t pad_w) {
+  return QuantizedGraphAddPoolRT(p, input, mode, kernel_h, kernel_w, stride_h, stride_w, pad_h, pad_w);
+}
+
+size_t QuantizedGraphAddSum(QuantizedGraph *p, size_t a, size_t b, int relu) {
+  return QuantizedGraphAddSumRT(p, a, b, relu);
+}
+
+size_t QuantizedGraphAddReLU(QuantizedGraph *p, size_t input) {
+  return QuantizedGraphAddReLURT(p, input);
+}
+
+size_t QuantizedGraphGetOutputSize(QuantizedGraph *p) {
+  return QuantizedGraphGetOutputSizeRT(p);
+}
+
+size_t QuantizedGraphGetActivationBytes(QuantizedGraph *p, size_t batch_size) {
+  return QuantizedGraphGetActivationBytesRT(p, batch_size);
+}
+
+void QuantizedGraphExecute(QuantizedGraph *p, float *dst, float *data, size_t batch_size) {
+  QuantizedGraphExecuteRT(p, dst, data, batch_size);
+}
+
+void QuantizedGraphStartCalibration(QuantizedGraph *p, CALIBRATION_MODE mode, float percentile) {
+  QuantizedGraphStartCalibrationRT(p, mode, percentile);
+}
+
+void QuantizedGraphFinishCalibration(QuantizedGraph *p) {
+  QuantizedGraphFinishCalibrationRT(p);
+}
+
+int QuantizedGraphSaveCalibration(QuantizedGraph *p, const char *path) {
+  return QuantizedGraphSaveCalibrationRT(p, path);
+}
+
+int QuantizedGraphLoadCalibration(QuantizedGraph *p, const char *path) {
+  return QuantizedGraphLoadCalibrationRT(p, path);
+}
+
+int QuantizedGraphSavePacked(QuantizedGraph *p, const char *path) {
+  return QuantizedGraphSavePackedRT(p, path);
+}
+
+QuantizedGraph *QuantizedGraphLoadPacked(const char *path) {
+  return QuantizedGraphLoadPackedRT(path);
+}
+
+void QuantizedGraphFree(QuantizedGraph *p) {
+  QuantizedGraphFreeRT(p);
+}
+
+int BigQuantLoadTuningFile(const char *path) {
+  return BigQuantLoadTuningFileRT(path);
+}
+
+int BigQuantSaveTuningFile(const char *path) {
+  return BigQuantSaveTuningFileRT(path);
+}
+
+void BigQuantEnablePerfCounters(int enable) {
+  BigQuantEnablePerfCountersRT(enable);
+}
+
+int BigQuantPerfCountersEnabled() {
+  return BigQuantPerfCountersEnabledRT();
+}
+
+void BigQuantResetPerfCounters() {
+  BigQuantResetPerfCountersRT();
+}
+
+int BigQuantGetPerfCounter(PERF_COUNTER counter, struct PerfCounterValue *value) {
+  return BigQuantGetPerfCounterRT(counter, value);
+}
+
+const char *BigQuantGetPerfCounterName(PERF_COUNTER counter) {
+  return BigQuantGetPerfCounterNameRT(counter);
+}
+
+void BigQuantStartTrace() {
+  BigQuantStartTraceRT();
+}
+
+int BigQuantStopTrace(const char *path) {
+  return BigQuantStopTraceRT(path);
+}
+
+const char *BigQuantGetISA() {
+  return BigQuantGetISART();
+}
+
 void QuantizedConvKernelDescInit(QuantizedTensorDesc *quantized_tensor, size_t c_out, size_t c_in, size_t kernel_h,
                                  size_t kernel_w) {
   QuantizedConvKernelDescInitRT(quantized_tensor, c_out, c_in, kernel_h, kernel_w);
 }
 
+void QuantizedConvKernelDescInitWithWorkspace(QuantizedTensorDesc *quantized_tensor, void *workspace, size_t c_out,
+                                              size_t c_in, size_t kernel_h, size_t kernel_w) {
+  QuantizedConvKernelDescInitWithWorkspaceRT(quantized_tensor, workspace, c_out, c_in, kernel_h, kernel_w);
+}
+
 void QuantizedConvKernelInit(QuantizedTensorDesc *quantized_tensor, float *src, size_t c_out, size_t c_in,
                              size_t kernel_h, size_t kernel_w, float threshold, LAYOUT layout) {
   QuantizedConvKernelInitRT(quantized_tensor, src, c_out, c_in, kernel_h, kernel_w, threshold, layout);
@@ -358,6 +958,14 @@ void QuantizedConvDataDescInit(QuantizedTensorDesc *quantized_tensor, size_t c_i
                               dilation_w, batch_size, h_in, w_in);
 }
 
+void QuantizedConvDataDescInitWithWorkspace(QuantizedTensorDesc *quantized_tensor, void *workspace, size_t c_in,
+                                            size_t kernel_h, size_t kernel_w, size_t stride_h, size_t stride_w,
+                                            size_t pad_h, size_t pad_w, size_t dilation_h, size_t dilation_w,
+                                            size_t batch_size, size_t h_in, size_t w_in) {
+  QuantizedConvDataDescInitWithWorkspaceRT(quantized_tensor, workspace, c_in, kernel_h, kernel_w, stride_h, stride_w,
+                                           pad_h, pad_w, dilation_h, dilation_w, batch_size, h_in, w_in);
+}
+
 void QuantizedConvDataInit(QuantizedTensorDesc *quantized_tensor, float *src, size_t c_in, size_t kernel_h,
                            size_t kernel_w, size_t stride_h, size_t stride_w, size_t pad_h, size_t pad_w,
                            size_t dilation_h, size_t dilation_w, size_t batch_size, size_t h_in, size_t w_in,
@@ -366,14 +974,39 @@ void QuantizedConvDataInit(QuantizedTensorDesc *quantized_tensor, float *src, si
                           dilation_w, batch_size, h_in, w_in, threshold, layout);
 }
 
+size_t QuantizedConvDataInitGetWorkspaceSize(size_t c_in, size_t kernel_h, size_t kernel_w, size_t stride_h,
+                                             size_t stride_w, size_t pad_h, size_t pad_w, size_t dilation_h,
+                                             size_t dilation_w, size_t batch_size, size_t h_in, size_t w_in,
+                                             LAYOUT layout) {
+  return QuantizedConvDataInitGetWorkspaceSizeRT(c_in, kernel_h, kernel_w, stride_h, stride_w, pad_h, pad_w, dilation_h,
+                                                 dilation_w, batch_size, h_in, w_in, layout);
+}
+
+void QuantizedConvDataInitWithWorkspace(QuantizedTensorDesc *quantized_tensor, void *workspace, float *src, size_t c_in,
+                                        size_t kernel_h, size_t kernel_w, size_t stride_h, size_t stride_w,
+                                        size_t pad_h, size_t pad_w, size_t dilation_h, size_t dilation_w,
+                                        size_t batch_size, size_t h_in, size_t w_in, float threshold, LAYOUT layout) {
+  QuantizedConvDataInitWithWorkspaceRT(quantized_tensor, workspace, src, c_in, kernel_h, kernel_w, stride_h, stride_w,
+                                       pad_h, pad_w, dilation_h, dilation_w, batch_size, h_in, w_in, threshold, layout);
+}
+
 void QuantizedConvKernelSumDescInit(FPTensorDesc *fp_tensor, size_t c_out) {
   QuantizedConvKernelSumDescInitRT(fp_tensor, c_out);
 }
 
+void QuantizedConvKernelSumDescInitWithWorkspace(FPTensorDesc *fp_tensor, void *workspace, size_t c_out) {
+  QuantizedConvKernelSumDescInitWithWorkspaceRT(fp_tensor, workspace, c_out);
+}
+
 void QuantizedConvKernelSumInit(FPTensorDesc *fp_tensor, float *src, size_t n, size_t c, size_t h, size_t w) {
   QuantizedConvKernelSumInitRT(fp_tensor, src, n, c, h, w);
 }
 
+void QuantizedConvKernelSumLoadFromModel(FPTensorDesc *fp_tensor, int8_t *src, float *min, float *max, size_t c_out,
+                                         size_t c_in, size_t kernel_h, size_t kernel_w) {
+  QuantizedConvKernelSumLoadFromModelRT(fp_tensor, src, min, max, c_out, c_in, kernel_h, kernel_w);
+}
+
 void MixPrecisionGEMM(LAYOUT layout, int8_t *pa, uint8_t *pb, float *pc, size_t m, size_t n, size_t k, float *ratio_a,
                       float *ratio_b, float *kernel_sum, float *min_b, float *bias, size_t batch_size,
                       size_t channel_per_group, size_t height_out, size_t width_out, float fault_tolerance,
@@ -386,6 +1019,11 @@ void QuantizedFCKernelDescInit(QuantizedTensorDesc *quantized_tensor, size_t c_o
   QuantizedFCKernelDescInitRT(quantized_tensor, c_out, c_in);
 }
 
+void QuantizedFCKernelDescInitWithWorkspace(QuantizedTensorDesc *quantized_tensor, void *workspace, size_t c_out,
+                                            size_t c_in) {
+  QuantizedFCKernelDescInitWithWorkspaceRT(quantized_tensor, workspace, c_out, c_in);
+}
+
 void QuantizedFCKernelInit(QuantizedTensorDesc *quantized_tensor, float *src, size_t c_out, size_t c_in,
                            float threshold, LAYOUT layout) {
   QuantizedFCKernelInitRT(quantized_tensor, src, c_out, c_in, threshold, layout);
@@ -400,6 +1038,11 @@ void QuantizedFCDataDescInit(QuantizedTensorDesc *quantized_tensor, size_t batch
   QuantizedFCDataDescInitRT(quantized_tensor, batch_size, channel);
 }
 
+void QuantizedFCDataDescInitWithWorkspace(QuantizedTensorDesc *quantized_tensor, void *workspace, size_t batch_size,
+                                          size_t channel) {
+  QuantizedFCDataDescInitWithWorkspaceRT(quantized_tensor, workspace, batch_size, channel);
+}
+
 void QuantizedFCDataInit(QuantizedTensorDesc *quantized_tensor, float *src, size_t batch_size, size_t channel,
                          float threshold, LAYOUT layout) {
   QuantizedFCDataInitRT(quantized_tensor, src, batch_size, channel, threshold, layout);
@@ -409,10 +1052,27 @@ void QuantizedFCKernelSumDescInit(FPTensorDesc *fp_tensor, size_t c_out) {
   QuantizedFCKernelSumDescInitRT(fp_tensor, c_out);
 }
 
+void QuantizedFCKernelSumDescInitWithWorkspace(FPTensorDesc *fp_tensor, void *workspace, size_t c_out) {
+  QuantizedFCKernelSumDescInitWithWorkspaceRT(fp_tensor, workspace, c_out);
+}
+
 void QuantizedFCKernelSumInit(FPTensorDesc *fp_tensor, float *src, size_t c_out, size_t c_in) {
   QuantizedFCKernelSumInitRT(fp_tensor, src, c_out, c_in);
 }
 
+void QuantizedFCKernelSumLoadFromModel(FPTensorDesc *fp_tensor, int8_t *src, float *min, float *max, size_t c_out,
+                                       size_t c_in) {
+  QuantizedFCKernelSumLoadFromModelRT(fp_tensor, src, min, max, c_out, c_in);
+}
+
+size_t QuantizedTensorDescGetWorkspaceSize(const QuantizedTensorDesc *quantized_tensor) {
+  return QuantizedTensorDescGetWorkspaceSizeRT(quantized_tensor);
+}
+
+size_t FPTensorDescGetWorkspaceSize(const FPTensorDesc *fp_tensor) {
+  return FPTensorDescGetWorkspaceSizeRT(fp_tensor);
+}
+
 void FreeFPTensor(struct FPTensorDesc *p) {
   FreeFPTensorRT(p);
 }
@@ -19,9 +19,7 @@
 #include "base.h"
 #include "arch/config.h"
 #include "arch/cpuid.h"
-#ifdef NUMA
-#include <numa.h>
-#endif
+#include "arch/topology.h"
 #include "alloc.h"
 /*
 INLINE_SPECIFIER void aligned_malloc(void** p, size_t alignment, size_t size) {
@@ -75,13 +73,6 @@ void ComputeMatrixSumPerRow(DType *dst, DType *src, size_t m, size_t n) {
   }
 }
 
-INLINE_SPECIFIER size_t GetSocketNum() {
-#ifdef NUMA
-  return numa_num_configured_nodes();
-  else return 1;
-#endif
-}
-
 size_t GetBlockSize(size_t x, size_t y) {
   return x * y;
 }
@@ -92,13 +83,7 @@ size_t GetBlockNum(size_t buffer_size, size_t tile_size, float ratio = 0.5) {
 
 size_t GetThreadsNum() {
 #ifdef _OPENMP
-  size_t n;
-#pragma omp parallel
-  {
-#pragma omp master
-    { n = omp_get_num_threads(); }
-  }
-  return n;
+  return omp_get_max_threads();
 #else
   return 1;
 #endif
@@ -108,56 +93,131 @@ size_t GetThreadsNumWrapper() {
   return GetThreadsNum();
 }
 
-// TODO(yan): still need some improvement, cannot detect cache relation, unified or private
+INLINE_SPECIFIER const char *GetISAName() {
+#if defined(AVX512)
+  return "avx512";
+#elif defined(__AVX2__)
+  return "avx2";
+#else
+  return "sse42";
+#endif
+}
+
 template <size_t tile_m>
 INLINE_SPECIFIER void GetBlocksInfo(size_t m, size_t k, size_t &m_in_l1, size_t &m_in_l2, size_t &m_in_l3) {
+  const CacheTopology &topology = GetCacheTopology();
   size_t threads_num = GetThreadsNumWrapper();
-  struct cache_info l1_info;
-  struct cache_info l2_info;
-  struct cache_info l3_info;
+  // only threads landing on the same L3 compete for it
+  size_t l3_threads_num = std::min(threads_num, topology.l3_shared_cpus_);
 
   size_t block_size = GetBlockSize(tile_m, k);
 
-  cpuid_caches(0, l1_info);
-  size_t l1_cache_size = l1_info.cache_size;
+  size_t l1_cache_size = topology.l1_size_;
   size_t block_num_per_L1 = GetBlockNum(l1_cache_size, block_size);
 
-  cpuid_caches(2, l2_info);
-  size_t l2_cache_size = l2_info.cache_size;
+  size_t l2_cache_size = topology.l2_size_;
   size_t block_num_per_L2 = GetBlockNum(l2_cache_size, block_size) / block_num_per_L1 * block_num_per_L1;
 
-  int ret = cpuid_caches(3, l3_info);
-  size_t l3_cache_size = l3_info.cache_size;
-
-#if defined(LLC_EXCLUSIVE)
-  l3_cache_size /= threads_num;
-  l3_cache_size += l2_cache_size;
-#else
-  l3_cache_size += l2_cache_size * threads_num;
-#endif
+  size_t l3_cache_size = topology.l3_size_;
+  if (topology.llc_exclusive_) {
+    l3_cache_size /= l3_threads_num;
+    l3_cache_size += l2_cache_size;
+  } else {
+    l3_cache_size += l2_cache_size * l3_threads_num;
+  }
   size_t block_num_per_L3 = GetBlockNum(l3_cache_size, block_size) / block_num_per_L2 * block_num_per_L2;
 
-#if defined(LLC_EXCLUSIVE)
-  if (ret < 0) {
-    m_in_l2 = std::max(std::min(block_num_per_L2 * tile_m, m / threads_num / tile_m * tile_m), tile_m);
-    m_in_l1 = std::max(std::min(block_num_per_L1 * tile_m, m_in_l2 / 2 / tile_m * tile_m), tile_m);
-    m_in_l3 = m_in_l2;
+  if (topology.llc_exclusive_) {
+    if (topology.l3_size_ == 0) {
+      m_in_l2 = std::max(std::min(block_num_per_L2 * tile_m, m / threads_num / tile_m * tile_m), tile_m);
+      m_in_l1 = std::max(std::min(block_num_per_L1 * tile_m, m_in_l2 / 2 / tile_m * tile_m), tile_m);
+      m_in_l3 = m_in_l2;
+    } else {
+      m_in_l3 = std::max(std::min(block_num_per_L3 * tile_m, m), tile_m);
+      m_in_l2 = std::max(std::min(block_num_per_L2 * tile_m, m_in_l3 / tile_m * tile_m), tile_m);
+      m_in_l1 = std::max(std::min(block_num_per_L1 * tile_m, m_in_l2 / 2 / tile_m * tile_m), tile_m);
+    }
   } else {
     m_in_l3 = std::max(std::min(block_num_per_L3 * tile_m, m), tile_m);
-    m_in_l2 = std::max(std::min(block_num_per_L2 * tile_m, m_in_l3 / tile_m * tile_m), tile_m);
+    m_in_l2 = std::max(std::min(block_num_per_L2 * tile_m, m_in_l3 / threads_num / tile_m * tile_m), tile_m);
     m_in_l1 = std::max(std::min(block_num_per_L1 * tile_m, m_in_l2 / 2 / tile_m * tile_m), tile_m);
   }
-#endif
-
-#if defined(LLC_SHARED)
-  m_in_l3 = std::max((ret < 0) ? m : std::min(block_num_per_L3 * tile_m, m), tile_m);
-  m_in_l2 = std::max(std::min(block_num_per_L2 * tile_m, m_in_l3 / threads_num / tile_m * tile_m), tile_m);
-  m_in_l1 = std::max(std::min(block_num_per_L1 * tile_m, m_in_l2 / 2 / tile_m * tile_m), tile_m);
-#endif
 
 #if defined(DEBUG)
   std::cerr << "l3:" << l3_cache_size << " l2: " << l2_cache_size << " l1:" << l1_cache_size << std::endl;
   std::cerr << "m:" << m << " m_in_l3:" << m_in_l3 << " m_in_l2: " << m_in_l2 << " m_in_l1:" << m_in_l1 << std::endl;
 #endif
 }
+
+// Values mirror omp_sched_t
+typedef enum GEMM_SCHEDULE {
+  GEMM_SCHEDULE_DEFAULT = 0,
+  GEMM_SCHEDULE_STATIC = 1,
+  GEMM_SCHEDULE_DYNAMIC = 2,
+  GEMM_SCHEDULE_GUIDED = 3
+} GEMM_SCHEDULE;
+
+// Overrides for the blocked loop nest of shuffle::ConvShuffleGEMM, picked by the autotuner (see autotuner.h).
+// A zero-initialized GemmTuning keeps the built-in heuristics.
+struct GemmTuning {
+  int loop_order_;       // 0: N tiles outer when m < n, 1: M tiles outer, 2: N tiles outer
+  int block_shift_[3];   // scale the GetBlocksInfo L1/L2/L3 blocks by 2^shift
+  int schedule_;         // GEMM_SCHEDULE, GEMM_SCHEDULE_DEFAULT keeps the built-in schedule
+  int chunk_;            // chunk size of the tuned schedule
+};
+
+INLINE_SPECIFIER size_t ShiftBlock(size_t block, int shift, size_t tile, size_t bound) {
+  size_t shifted = (shift >= 0) ? (block << shift) : (block >> -shift);
+  return std::max(std::min(shifted / tile * tile, std::max(bound, tile)), tile);
+}
+
+// Apply the tuned block scaling while keeping L1 <= L2 <= L3
+template <size_t tile>
+INLINE_SPECIFIER void ApplyGemmTuning(const GemmTuning *tuning, size_t m, size_t &m_in_l1, size_t &m_in_l2,
+                                      size_t &m_in_l3) {
+  if ((tuning == NULL) || ((tuning->block_shift_[0] == 0) && (tuning->block_shift_[1] == 0) &&
+                           (tuning->block_shift_[2] == 0))) {
+    return;
+  }
+  m_in_l3 = ShiftBlock(m_in_l3, tuning->block_shift_[2], tile, m);
+  m_in_l2 = ShiftBlock(m_in_l2, tuning->block_shift_[1], tile, m_in_l3);
+  m_in_l1 = ShiftBlock(m_in_l1, tuning->block_shift_[0], tile, m_in_l2);
+}
+
+INLINE_SPECIFIER bool GemmLoopNOuter(const GemmTuning *tuning, size_t m, size_t n) {
+  if ((tuning == NULL) || (tuning->loop_order_ == 0)) {
+    return m < n;
+  }
+  return tuning->loop_order_ == 2;
+}
+
+// Installs the schedule used by the next schedule(runtime) loop of the calling thread and restores the previous one
+struct ScopedGemmSchedule {
+  ScopedGemmSchedule(const GemmTuning *tuning, GEMM_SCHEDULE default_schedule, int default_chunk) {
+#ifdef _OPENMP
+    omp_get_schedule(&saved_schedule_, &saved_chunk_);
+    if ((tuning != NULL) && (tuning->schedule_ != GEMM_SCHEDULE_DEFAULT)) {
+      omp_set_schedule(static_cast<omp_sched_t>(tuning->schedule_), tuning->chunk_);
+    } else {
+      omp_set_schedule(static_cast<omp_sched_t>(default_schedule), default_chunk);
+    }
+#endif
+  }
+
+  ~ScopedGemmSchedule() {
+#ifdef _OPENMP
+    omp_set_schedule(saved_schedule_, saved_chunk_);
+#endif
+  }
+
+  ScopedGemmSchedule(const ScopedGemmSchedule&) = delete;
+
+  ScopedGemmSchedule& operator=(const ScopedGemmSchedule&) = delete;
+
+#ifdef _OPENMP
+ private:
+  omp_sched_t saved_schedule_;
+  int saved_chunk_;
+#endif
+};
 #endif
@@ -26,7 +26,10 @@
 #define API_PREFIX
 #endif
 
+// a per-ISA build of c_api.cc (see c_api_isa.cc) keeps these in its namespace, so they are C++ functions there
+#if !defined(ISA_NAMESPACE)
 extern "C" {
+#endif
 
 QuantizedConvOp *InternalQuantizedConvOpCreate();
 
@@ -37,9 +40,49 @@ void InternalQuantizedConvOpSetupConvParameter(QuantizedConvOp *p, LAYOUT layout
 
 void InternalQuantizedConvOpInitWeight(QuantizedConvOp *p, float *weight);
 
+void InternalQuantizedConvOpSetupBNParameter(QuantizedConvOp *p, float *mean, float *variance, float *scale,
+                                             float *shift, float eps);
+
 void InternalQuantizedConvOpExecute(QuantizedConvOp *p, float *dst, float *data, float *bias, size_t batch_size,
                                     size_t channel_in, size_t height_in, size_t width_in);
 
+void InternalQuantizedConvOpExecuteWithResidual(QuantizedConvOp *p, float *dst, float *data, float *bias,
+                                                float *residual, size_t batch_size, size_t channel_in,
+                                                size_t height_in, size_t width_in);
+
+void InternalQuantizedConvOpExecuteRequantized(QuantizedConvOp *p, uint8_t *dst, float scale, float zero_point,
+                                               float *data, float *bias, float *residual, size_t batch_size,
+                                               size_t channel_in, size_t height_in, size_t width_in);
+
+size_t InternalQuantizedConvOpGetRequantizedOutputSize(QuantizedConvOp *p, size_t batch_size, size_t height_in,
+                                                       size_t width_in);
+
+void InternalQuantizedConvOpWarmUp(QuantizedConvOp *p, size_t batch_size, size_t channel_in, size_t height_in,
+                                   size_t width_in);
+
+void InternalQuantizedConvOpStartCalibration(QuantizedConvOp *p, CALIBRATION_MODE mode, float percentile);
+
+void InternalQuantizedConvOpFinishCalibration(QuantizedConvOp *p);
+
+void InternalQuantizedConvOpSetInputRange(QuantizedConvOp *p, float min, float max);
+
+int InternalQuantizedConvOpGetInputRange(QuantizedConvOp *p, float *min, float *max);
+
+int InternalQuantizedConvOpSavePacked(QuantizedConvOp *p, const char *path);
+
+QuantizedConvOp *InternalQuantizedConvOpLoadPacked(const char *path);
+
+void InternalQuantizedConvOpShrinkWorkspace(QuantizedConvOp *p);
+
+size_t InternalQuantizedConvOpGetWorkspaceSavedBytes(QuantizedConvOp *p);
+
+size_t InternalQuantizedConvOpGetWorkspaceSize(QuantizedConvOp *p, size_t batch_size, size_t channel_in,
+                                               size_t height_in, size_t width_in);
+
+int InternalQuantizedConvOpExecuteWithWorkspace(QuantizedConvOp *p, void *workspace, size_t workspace_size, float *dst,
+                                                float *data, float *bias, float *residual, size_t batch_size,
+                                                size_t channel_in, size_t height_in, size_t width_in);
+
 void InternalQuantizedConvOpFree(QuantizedConvOp *p);
 
 QuantizedFCOp *InternalQuantizedFCOpCreate();
@@ -52,11 +95,97 @@ void InternalQuantizedFCOpInitWeight(QuantizedFCOp *p, float *weight);
 void InternalQuantizedFCOpExecute(QuantizedFCOp *p, float *dst, float *data, float *bias, size_t batch_size,
                                   size_t channel_in);
 
+void InternalQuantizedFCOpWarmUp(QuantizedFCOp *p, size_t batch_size, size_t channel_in);
+
+void InternalQuantizedFCOpStartCalibration(QuantizedFCOp *p, CALIBRATION_MODE mode, float percentile);
+
+void InternalQuantizedFCOpFinishCalibration(QuantizedFCOp *p);
+
+void InternalQuantizedFCOpSetInputRange(QuantizedFCOp *p, float min, float max);
+
+int InternalQuantizedFCOpGetInputRange(QuantizedFCOp *p, float *min, float *max);
+
+int InternalQuantizedFCOpSavePacked(QuantizedFCOp *p, const char *path);
+
+QuantizedFCOp *InternalQuantizedFCOpLoadPacked(const char *path);
+
+void InternalQuantizedFCOpShrinkWorkspace(QuantizedFCOp *p);
+
+size_t InternalQuantizedFCOpGetWorkspaceSavedBytes(QuantizedFCOp *p);
+
+size_t InternalQuantizedFCOpGetWorkspaceSize(QuantizedFCOp *p, size_t batch_size, size_t channel_in);
+
+int InternalQuantizedFCOpExecuteWithWorkspace(QuantizedFCOp *p, void *workspace, size_t workspace_size, float *dst,
+                                              float *data, float *bias, size_t batch_size, size_t channel_in);
+
 void InternalQuantizedFCOpFree(QuantizedFCOp *p);
 
+QuantizedGraph *InternalQuantizedGraphCreate(LAYOUT layout, size_t channel, size_t height, size_t width);
+
+size_t InternalQuantizedGraphAddConv(QuantizedGraph *p, size_t input, int residual, size_t channel_out, size_t group,
+                                     size_t kernel_h, size_t kernel_w, size_t stride_h, size_t stride_w, size_t pad_h,
+                                     size_t pad_w, size_t dilation_h, size_t dilation_w, size_t fusion_mask,
+                                     float *weight, float *bias, CONV_ALGORITHM algo);
+
+void InternalQuantizedGraphSetupConvBNParameter(QuantizedGraph *p, size_t tensor, float *mean, float *variance,
+                                                float *scale, float *shift, float eps);
+
+size_t InternalQuantizedGraphAddFC(QuantizedGraph *p, size_t input, size_t channel_out, float *weight, float *bias,
+                                   FC_ALGORITHM algo);
+
+size_t InternalQuantizedGraphAddPool(QuantizedGraph *p, size_t input, POOL_MODE mode, size_t kernel_h, size_t kernel_w,
+                                     size_t stride_h, size_t stride_w, size_t pad_h, size_t pad_w);
+
+size_t InternalQuantizedGraphAddSum(QuantizedGraph *p, size_t a, size_t b, int relu);
+
+size_t InternalQuantizedGraphAddReLU(QuantizedGraph *p, size_t input);
+
+size_t InternalQuantizedGraphGetOutputSize(QuantizedGraph *p);
+
+size_t InternalQuantizedGraphGetActivationBytes(QuantizedGraph *p, size_t batch_size);
+
+void InternalQuantizedGraphExecute(QuantizedGraph *p, float *dst, float *data, size_t batch_size);
+
+void InternalQuantizedGraphStartCalibration(QuantizedGraph *p, CALIBRATION_MODE mode, float percentile);
+
+void InternalQuantizedGraphFinishCalibration(QuantizedGraph *p);
+
+int InternalQuantizedGraphSaveCalibration(QuantizedGraph *p, const char *path);
+
+int InternalQuantizedGraphLoadCalibration(QuantizedGraph *p, const char *path);
+
+int InternalQuantizedGraphSavePacked(QuantizedGraph *p, const char *path);
+
+QuantizedGraph *InternalQuantizedGraphLoadPacked(const char *path);
+
+void InternalQuantizedGraphFree(QuantizedGraph *p);
+
+int InternalBigQuantLoadTuningFile(const char *path);
+
+int InternalBigQuantSaveTuningFile(const char *path);
+
+void InternalBigQuantEnablePerfCounters(int enable);
+
+int InternalBigQuantPerfCountersEnabled();
+
+void InternalBigQuantResetPerfCounters();
+
+int InternalBigQuantGetPerfCounter(PERF_COUNTER counter, struct PerfCounterValue *value);
+
+const char *InternalBigQuantGetPerfCounterName(PERF_COUNTER counter);
+
+void InternalBigQuantStartTrace();
+
+int InternalBigQuantStopTrace(const char *path);
+
+const char *InternalBigQuantGetISA();
+
 void InternalQuantizedConvKernelDescInit(QuantizedTensorDesc *quantized_tensor, size_t c_out, size_t c_in,
                                          size_t kernel_h, size_t kernel_w);
 
+void InternalQuantizedConvKernelDescInitWithWorkspace(QuantizedTensorDesc *quantized_tensor, void *workspace,
+                                                      size_t c_out, size_t c_in, size_t kernel_h, size_t kernel_w);
+
 void InternalQuantizedConvKernelInit(QuantizedTensorDesc *quantized_tensor, float *src, size_t c_out, size_t c_in,
                                      size_t kernel_h, size_t kernel_w, float threshold, LAYOUT layout);
 
@@ -69,15 +198,36 @@ void InternalQuantizedConvDataDescInit(QuantizedTensorDesc *quantized_tensor, si
                                        size_t dilation_h, size_t dilation_w, size_t batch_size, size_t h_in,
                                        size_t w_in);
 
+void InternalQuantizedConvDataDescInitWithWorkspace(QuantizedTensorDesc *quantized_tensor, void *workspace, size_t c_in,
+                                                    size_t kernel_h, size_t kernel_w, size_t stride_h, size_t stride_w,
+                                                    size_t pad_h, size_t pad_w, size_t dilation_h, size_t dilation_w,
+                                                    size_t batch_size, size_t h_in, size_t w_in);
+
 void InternalQuantizedConvDataInit(QuantizedTensorDesc *quantized_tensor, float *src, size_t c_in, size_t kernel_h,
                                    size_t kernel_w, size_t stride_h, size_t stride_w, size_t pad_h, size_t pad_w,
                                    size_t dilation_h, size_t dilation_w, size_t batch_size, size_t h_in, size_t w_in,
                                    float threshold, LAYOUT layout);
 
+size_t InternalQuantizedConvDataInitGetWorkspaceSize(size_t c_in, size_t kernel_h, size_t kernel_w, size_t stride_h,
+                                                     size_t stride_w, size_t pad_h, size_t pad_w, size_t dilation_h,
+                                                     size_t dilation_w, size_t batch_size, size_t h_in, size_t w_in,
+                                                     LAYOUT layout);
+
+void InternalQuantizedConvDataInitWithWorkspace(QuantizedTensorDesc *quantized_tensor, void *workspace, float *src,
+                                                size_t c_in, size_t kernel_h, size_t kernel_w, size_t stride_h,
+                                                size_t stride_w, size_t pad_h, size_t pad_w, size_t dilation_h,
+                                                size_t dilation_w, size_t batch_size, size_t h_in, size_t w_in,
+                                                float threshold, LAYOUT layout);
+
 void InternalQuantizedConvKernelSumDescInit(FPTensorDesc *fp_tensor, size_t c_out);
 
+void InternalQuantizedConvKernelSumDescInitWithWorkspace(FPTensorDesc *fp_tensor, void *workspace, size_t c_out);
+
 void InternalQuantizedConvKernelSumInit(FPTensorDesc *fp_tensor, float *src, size_t n, size_t c, size_t h, size_t w);
 
+void InternalQuantizedConvKernelSumLoadFromModel(FPTensorDesc *fp_tensor, int8_t *src, float *min, float *max,
+                                                 size_t c_out, size_t c_in, size_t kernel_h, size_t kernel_w);
+
 void InternalMixPrecisionGEMM(LAYOUT layout, int8_t *pa, uint8_t *pb, float *pc, size_t m, size_t n, size_t k,
                               float *ratio_a, float *ratio_b, float *kernel_sum, float *min_b, float *bias,
                               size_t batch_size, size_t channel_per_group, size_t height_out, size_t width_out,
@@ -85,6 +235,9 @@ void InternalMixPrecisionGEMM(LAYOUT layout, int8_t *pa, uint8_t *pb, float *pc,
 
 void InternalQuantizedFCKernelDescInit(QuantizedTensorDesc *quantized_tensor, size_t c_out, size_t c_in);
 
+void InternalQuantizedFCKernelDescInitWithWorkspace(QuantizedTensorDesc *quantized_tensor, void *workspace,
+                                                    size_t c_out, size_t c_in);
+
 void InternalQuantizedFCKernelInit(QuantizedTensorDesc *quantized_tensor, float *src, size_t c_out, size_t c_in,
                                    float threshold, LAYOUT layout);
 
@@ -93,15 +246,29 @@ void InternalQuantizedFCKernelLoadFromModel(QuantizedTensorDesc *quantized_tenso
 
 void InternalQuantizedFCDataDescInit(QuantizedTensorDesc *quantized_tensor, size_t batch_size, size_t channel);
 
+void InternalQuantizedFCDataDescInitWithWorkspace(QuantizedTensorDesc *quantized_tensor, void *workspace,
+                                                  size_t batch_size, size_t channel);
+
 void InternalQuantizedFCDataInit(QuantizedTensorDesc *quantized_tensor, float *src, size_t batch_size, size_t channel,
                                  float threshold, LAYOUT layout);
 
 void InternalQuantizedFCKernelSumDescInit(FPTensorDesc *fp_tensor, size_t c_out);
 
+void InternalQuantizedFCKernelSumDescInitWithWorkspace(FPTensorDesc *fp_tensor, void *workspace, size_t c_out);
+
 void InternalQuantizedFCKernelSumInit(FPTensorDesc *fp_tensor, float *src, size_t c_out, size_t c_in);
 
+void InternalQuantizedFCKernelSumLoadFromModel(FPTensorDesc *fp_tensor, int8_t *src, float *min, float *max,
+                                               size_t c_out, size_t c_in);
+
+size_t InternalQuantizedTensorDescGetWorkspaceSize(const QuantizedTensorDesc *quantized_tensor);
+
+size_t InternalFPTensorDescGetWorkspaceSize(const FPTensorDesc *fp_tensor);
+
 void InternalFreeFPTensor(struct FPTensorDesc *p);
 
 void InternalFreeQuantizedTensor(struct QuantizedTensorDesc *p);
+#if !defined(ISA_NAMESPACE)
 }
 #endif
+#endif
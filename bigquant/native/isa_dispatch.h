@@ -0,0 +1,40 @@
+/*
+ * Copyright 2016 The BigDL Authors.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ISA_DISPATCH_H
+#define ISA_DISPATCH_H
+#include <stddef.h>
+
+// An Internal* function of one ISA's build of c_api.cc, by name. Each build linked into the single runtime library
+// lists its functions in a table ending with a NULL name, which the runtime binds in place of dlsym, see c_api_isa.cc.
+struct IsaSymbol {
+  const char *name;
+  void *address;
+};
+
+namespace avx512 {
+const IsaSymbol *IsaSymbols();
+}
+
+namespace avx2 {
+const IsaSymbol *IsaSymbols();
+}
+
+namespace sse42 {
+const IsaSymbol *IsaSymbols();
+}
+
+#endif
@@ -17,15 +17,16 @@
 #ifndef MODEL_H
 #define MODEL_H
 
-void DequantizeModel(float *dst, int8_t *src, float *src_min, float *src_max, size_t c_out, size_t c_in,
-                     size_t kernel_h, size_t kernel_w) {
-  for (size_t c_o = 0; c_o < c_out; ++c_o) {
-    size_t meta_index = c_o;
-    for (size_t k = 0; k < c_in * kernel_h * kernel_w; ++k) {
-      size_t index = c_o * c_in * kernel_h * kernel_w + k;
-      dst[index] =
-          1.0 * static_cast<float>(src[index]) / 127.0 * fmaxf(fabs(src_max[meta_index]), fabs(src_min[meta_index]));
+// Per output channel sums of the dequantized model weights, accumulated on the int8 values
+void ComputeModelSumPerRow(float *dst, const int8_t *src, const float *src_min, const float *src_max, size_t m,
+                           size_t n) {
+#pragma omp parallel for
+  for (size_t i = 0; i < m; ++i) {
+    int64_t sum = 0;
+    for (size_t j = 0; j < n; ++j) {
+      sum += src[i * n + j];
     }
+    dst[i] = static_cast<float>(sum) / 127.0 * fmaxf(fabs(src_max[i]), fabs(src_min[i]));
   }
 }
 #endif
@@ -20,7 +20,11 @@
 #include "../base.h"
 #include "../common.h"
 #include "../tensor.h"
+#include "../workspace.h"
+#include "../packed_model.h"
+#include "../perf_counters.h"
 #include "../ops/ops.h"
+#include "calibration.h"
 #ifdef TIME_PROFILE
 #include <chrono>
 #endif
@@ -52,24 +56,143 @@ struct ConvolutionDataDesc {
   size_t width_in_;
 };
 
+// Mutable per-call state of an algorithm. The algorithm itself only holds the packed weights and is shared by all
+// threads executing an op, each of which brings its own context.
+struct ConvolutionContext {
+  ConvolutionContext() : gemm_tuning_(GemmTuning()) {
+  }
+
+  ConvolutionContext(const ConvolutionContext&) = delete;
+
+  ConvolutionContext& operator=(const ConvolutionContext&) = delete;
+
+  virtual ~ConvolutionContext() {
+  }
+
+  Workspace workspace_;
+  // Only algorithms built on shuffle::ConvShuffleGEMM honour the tuning
+  GemmTuning gemm_tuning_;
+};
+
 struct BaseConvolutionAlgo {
 
-  BaseConvolutionAlgo() = default;
+  BaseConvolutionAlgo() : bn_mean_(NULL), bn_variance_coeff_(NULL), bn_scale_(NULL), bn_shift_(NULL) {
+  }
 
   BaseConvolutionAlgo(const BaseConvolutionAlgo&) = delete;
 
   BaseConvolutionAlgo& operator=(const BaseConvolutionAlgo&) = delete;
 
-  virtual ~BaseConvolutionAlgo(){
-
+  virtual ~BaseConvolutionAlgo() {
+    delete bn_mean_;
+    delete bn_variance_coeff_;
+    delete bn_scale_;
+    delete bn_shift_;
   };
   virtual void InitWeight(float *weight, ConvolutionKernelDesc &conv_kernel_desc) = 0;
-  virtual void Execute(float *out, float *data, float *bias, ConvolutionDataDesc &conv_data_desc,
-                       ConvolutionKernelDesc &conv_kernel_desc) = 0;
+  // Execute only reads the algorithm, so it may run concurrently as long as every caller passes its own context
+  virtual void Execute(ConvolutionContext *context, float *out, float *data, float *bias, float *residual,
+                       const ConvolutionDataDesc &conv_data_desc, const ConvolutionKernelDesc &conv_kernel_desc) = 0;
+
+  virtual ConvolutionContext *CreateContext() {
+    return new ConvolutionContext();
+  }
+
+  // Bytes Execute reserves in the workspace of its context for an input of this shape with the current thread count
+  virtual size_t WorkspaceSize(const ConvolutionDataDesc &conv_data_desc,
+                               const ConvolutionKernelDesc &conv_kernel_desc) = 0;
+
+  // Execute with the output requantized to uint8 by the GEMM epilogue, see shuffle::Requantization
+  virtual bool SupportsRequantization() const {
+    return false;
+  }
+
+  virtual void ExecuteRequantized(ConvolutionContext *context, const shuffle::Requantization &requant, float *data,
+                                  float *bias, float *residual, const ConvolutionDataDesc &conv_data_desc,
+                                  const ConvolutionKernelDesc &conv_kernel_desc) {
+    assert(false);
+  }
+
+  // Execute on an input already quantized with the static input range, writing the float output or, with requant,
+  // its requantization. InputRequantization is how the convolution before it requantizes the bytes.
+  virtual bool SupportsQuantizedInput() const {
+    return false;
+  }
+
+  virtual shuffle::Requantization InputRequantization(uint8_t *dst) const {
+    assert(false);
+    return shuffle::Requantization();
+  }
+
+  virtual void ExecuteQuantizedInput(ConvolutionContext *context, float *out, const shuffle::Requantization *requant,
+                                     const uint8_t *data, float *bias, float *residual,
+                                     const ConvolutionDataDesc &conv_data_desc,
+                                     const ConvolutionKernelDesc &conv_kernel_desc) {
+    assert(false);
+  }
+
+  // Packed state for a packed model file: BN, then the weights of the algorithm. The loaded tensors point into the
+  // mapped file instead of being allocated.
+  void SavePacked(PackedWriter &writer) {
+    writer.WriteTensor(bn_mean_);
+    writer.WriteTensor(bn_variance_coeff_);
+    writer.WriteTensor(bn_scale_);
+    writer.WriteTensor(bn_shift_);
+    SavePackedWeight(writer);
+  }
+
+  bool LoadPacked(PackedReader &reader, const ConvolutionKernelDesc &conv_kernel_desc) {
+    size_t channel_out = conv_kernel_desc.channel_out_;
+    bn_mean_ = reader.ReadOptionalTensor<float>(channel_out);
+    bn_variance_coeff_ = reader.ReadOptionalTensor<float>(channel_out);
+    bn_scale_ = reader.ReadOptionalTensor<float>(channel_out);
+    bn_shift_ = reader.ReadOptionalTensor<float>(channel_out);
+    return LoadPackedWeight(reader, conv_kernel_desc) && reader.Ok();
+  }
+
+  virtual void SavePackedWeight(PackedWriter &writer) = 0;
+
+  // Frees the weights of a candidate AUTO_SELECT_CONV stopped considering. Only the algorithms that can lose
+  // release anything; the algorithm must not execute afterwards.
+  virtual void ReleaseWeight() {
+  }
+
+  virtual bool LoadPackedWeight(PackedReader &reader, const ConvolutionKernelDesc &conv_kernel_desc) = 0;
+
+  // Algorithms without static quantization ignore the range and keep quantizing every input dynamically
+  void SetInputRange(const StaticRange &range) {
+    input_range_ = range;
+  }
+
+  // Inference BN folded into the epilogue: (x - mean) / sqrt(variance + eps) * scale + shift.
+  // scale and shift may be NULL.
+  void InitBN(float *mean, float *variance, float *scale, float *shift, float eps, size_t channel_out) {
+    delete bn_mean_;
+    delete bn_variance_coeff_;
+    delete bn_scale_;
+    delete bn_shift_;
+    bn_mean_ = new Tensor<float>(make_shape(channel_out), 64);
+    bn_variance_coeff_ = new Tensor<float>(make_shape(channel_out), 64);
+    bn_scale_ = (scale == NULL) ? NULL : new Tensor<float>(make_shape(channel_out), 64);
+    bn_shift_ = (shift == NULL) ? NULL : new Tensor<float>(make_shape(channel_out), 64);
+    for (size_t c = 0; c < channel_out; ++c) {
+      bn_mean_->data_[c] = mean[c];
+      bn_variance_coeff_->data_[c] = 1.0f / sqrtf(variance[c] + eps);
+      if (scale != NULL) {
+        bn_scale_->data_[c] = scale[c];
+      }
+      if (shift != NULL) {
+        bn_shift_->data_[c] = shift[c];
+      }
+    }
+  }
 
  protected:
-  size_t height_out_;
-  size_t width_out_;
+  Tensor<float> *bn_mean_;
+  Tensor<float> *bn_variance_coeff_;
+  Tensor<float> *bn_scale_;
+  Tensor<float> *bn_shift_;
+  StaticRange input_range_;
 };
 
 #endif
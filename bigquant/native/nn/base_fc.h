@@ -20,7 +20,11 @@
 #include "../base.h"
 #include "../common.h"
 #include "../tensor.h"
+#include "../workspace.h"
+#include "../packed_model.h"
+#include "../perf_counters.h"
 #include "../ops/ops.h"
+#include "calibration.h"
 
 struct FCKernelDesc {
   LAYOUT layout_;
@@ -32,9 +36,26 @@ struct FCDataDesc {
   size_t channel_in_;
 };
 
+// Mutable per-call state of an algorithm, see ConvolutionContext
+struct FCContext {
+  FCContext() : gemm_tuning_(GemmTuning()) {
+  }
+
+  FCContext(const FCContext&) = delete;
+
+  FCContext& operator=(const FCContext&) = delete;
+
+  virtual ~FCContext() {
+  }
+
+  Workspace workspace_;
+  GemmTuning gemm_tuning_;
+};
+
 struct BaseFCAlgo {
 
-  BaseFCAlgo() = default;
+  BaseFCAlgo() {
+  }
 
   BaseFCAlgo(const BaseFCAlgo&) = delete;
 
@@ -43,8 +64,28 @@ struct BaseFCAlgo {
   virtual ~BaseFCAlgo() {
   }
   virtual void InitWeight(float *weight, FCKernelDesc &fc_kernel_desc) = 0;
-  virtual void Execute(float *out, float *data, float *bias, FCDataDesc &fc_data_desc,
-                       FCKernelDesc &fc_kernel_desc) = 0;
+  virtual void Execute(FCContext *context, float *out, float *data, float *bias, const FCDataDesc &fc_data_desc,
+                       const FCKernelDesc &fc_kernel_desc) = 0;
+
+  virtual FCContext *CreateContext() {
+    return new FCContext();
+  }
+
+  // See BaseConvolutionAlgo::WorkspaceSize
+  virtual size_t WorkspaceSize(const FCDataDesc &fc_data_desc, const FCKernelDesc &fc_kernel_desc) = 0;
+
+  // See BaseConvolutionAlgo::SavePacked
+  virtual void SavePacked(PackedWriter &writer) = 0;
+
+  virtual bool LoadPacked(PackedReader &reader, const FCKernelDesc &fc_kernel_desc) = 0;
+
+  // See BaseConvolutionAlgo::SetInputRange
+  void SetInputRange(const StaticRange &range) {
+    input_range_ = range;
+  }
+
+ protected:
+  StaticRange input_range_;
 };
 
 #endif
@@ -0,0 +1,165 @@
+/*
+ * Copyright 2016 The BigDL Authors.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef NN_CALIBRATION_H
+#define NN_CALIBRATION_H
+
+#include "../base.h"
+#include "../common.h"
+#include "../ops/ops.h"
+#include <mutex>
+
+#define CALIBRATION_HISTOGRAM_BINS 2048
+
+// Input range of a layer fixed ahead of time, usually by calibration. Static quantization maps every element of the
+// input with the same constants, q = saturate(round(x * scale + zero_point)), instead of finding the range of every
+// pixel. The range always contains 0 and the zero point is an integer, so the padding dequantizes to exactly 0.
+struct StaticRange {
+  StaticRange() : min_(0.0f), max_(0.0f) {
+  }
+
+  StaticRange(float min, float max) : min_(std::min(min, 0.0f)), max_(std::max(max, 0.0f)) {
+  }
+
+  bool Enabled() const {
+    return max_ > min_;
+  }
+
+  float Scale(float threshold) const {
+    return threshold / (max_ - min_);
+  }
+
+  float ZeroPoint(float threshold) const {
+    return std::round(-min_ * Scale(threshold));
+  }
+
+  // The GEMM epilogue reads a min and a ratio per pixel of B; with a static range they are all the same
+  void FillPixelRanges(float *min, float *max, float *ratio, size_t pixels, float threshold) const {
+    float scale = Scale(threshold);
+    float zero_point = ZeroPoint(threshold);
+    std::fill(min, min + pixels, -zero_point / scale);
+    std::fill(max, max + pixels, (threshold - zero_point) / scale);
+    std::fill(ratio, ratio + pixels, 1.0f / scale);
+  }
+
+  float min_;
+  float max_;
+};
+
+// Collects the inputs a layer executes on between Start and Finish. CALIBRATION_MINMAX keeps their extremes,
+// CALIBRATION_PERCENTILE also a histogram over the extremes seen so far, rebinned whenever a batch falls outside them.
+// Observe may run from concurrent Executes; Start and Finish must not.
+struct ActivationCalibrator {
+  ActivationCalibrator() : active_(false), mode_(CALIBRATION_MINMAX), percentile_(100.0f) {
+  }
+
+  ActivationCalibrator(const ActivationCalibrator&) = delete;
+
+  ActivationCalibrator& operator=(const ActivationCalibrator&) = delete;
+
+  void Start(CALIBRATION_MODE mode, float percentile) {
+    assert((percentile > 50.0f) && (percentile <= 100.0f));
+    active_ = true;
+    mode_ = mode;
+    percentile_ = percentile;
+    min_ = FLT_MAX;
+    max_ = -FLT_MAX;
+    histogram_.assign((mode == CALIBRATION_PERCENTILE) ? CALIBRATION_HISTOGRAM_BINS : 0, 0);
+  }
+
+  bool Active() const {
+    return active_;
+  }
+
+  void Observe(const float *data, size_t length) {
+    if (length == 0) {
+      return;
+    }
+    float min, max;
+    FindMinMaxValue(data, length, min, max);
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (mode_ == CALIBRATION_PERCENTILE) {
+      Rebin(std::min(min, min_), std::max(max, max_));
+      float bins_per_unit = (max_ > min_) ? CALIBRATION_HISTOGRAM_BINS / (max_ - min_) : 0.0f;
+      for (size_t i = 0; i < length; ++i) {
+        ++histogram_[Bin(data[i], bins_per_unit)];
+      }
+    }
+    min_ = std::min(min_, min);
+    max_ = std::max(max_, max);
+  }
+
+  // The range of everything observed, or with CALIBRATION_PERCENTILE the one leaving (100 - percentile)% of the values
+  // outside at either end. Empty, i.e. dynamic quantization, if nothing was observed.
+  StaticRange Finish() {
+    active_ = false;
+    if (min_ > max_) {
+      return StaticRange();
+    }
+    if ((mode_ == CALIBRATION_MINMAX) || (max_ == min_)) {
+      return StaticRange(min_, max_);
+    }
+    double total = 0;
+    for (size_t b = 0; b < CALIBRATION_HISTOGRAM_BINS; ++b) {
+      total += histogram_[b];
+    }
+    double tail = total * (100.0 - percentile_) / 100.0;
+    size_t low = 0;
+    for (double count = histogram_[0]; (low + 1 < CALIBRATION_HISTOGRAM_BINS) && (count <= tail);
+         count += histogram_[++low]) {
+    }
+    size_t high = CALIBRATION_HISTOGRAM_BINS - 1;
+    for (double count = histogram_[high]; (high > low) && (count <= tail); count += histogram_[--high]) {
+    }
+    float bin_width = (max_ - min_) / CALIBRATION_HISTOGRAM_BINS;
+    return StaticRange(min_ + low * bin_width, min_ + (high + 1) * bin_width);
+  }
+
+ private:
+  size_t Bin(float value, float bins_per_unit) const {
+    size_t bin = static_cast<size_t>((value - min_) * bins_per_unit);
+    return std::min(bin, static_cast<size_t>(CALIBRATION_HISTOGRAM_BINS - 1));
+  }
+
+  // Moves the counts of the histogram over [min_, max_] to one over [min, max], each at the centre of its old bin
+  void Rebin(float min, float max) {
+    if ((min_ > max_) || ((min == min_) && (max == max_))) {
+      min_ = min;
+      max_ = max;
+      return;
+    }
+    std::vector<size_t> old_histogram(CALIBRATION_HISTOGRAM_BINS, 0);
+    old_histogram.swap(histogram_);
+    float old_min = min_;
+    float old_bin_width = (max_ - min_) / CALIBRATION_HISTOGRAM_BINS;
+    min_ = min;
+    max_ = max;
+    float bins_per_unit = CALIBRATION_HISTOGRAM_BINS / (max_ - min_);
+    for (size_t b = 0; b < CALIBRATION_HISTOGRAM_BINS; ++b) {
+      histogram_[Bin(old_min + (b + 0.5f) * old_bin_width, bins_per_unit)] += old_histogram[b];
+    }
+  }
+
+  bool active_;
+  CALIBRATION_MODE mode_;
+  float percentile_;
+  float min_;
+  float max_;
+  std::vector<size_t> histogram_;
+  std::mutex mutex_;
+};
+
+#endif
@@ -19,19 +19,50 @@
 
 #include "base_convolution.h"
 #include "shuffle_convolution.h"
-
-#ifdef TIME_PROFILE
-#include <chrono>
-#endif
+#include "depthwise_convolution.h"
+#include "winograd_convolution.h"
+#include "../autotuner.h"
+#include "../thread_contexts.h"
+#include "../trace.h"
+#include <algorithm>
+#include <atomic>
+#include <mutex>
 
 // typedef enum CONV_ALGORITHM {SHULLFE_CONV=0} CONV_ALGORITHM;
 
+// What one caller mutates while executing a ConvOp: the input shape, the algorithm tuned for it and one context per
+// candidate algorithm
+struct ConvOpContext {
+  ConvOpContext() : algo_index_(0), tuned_(false) {
+  }
+
+  ~ConvOpContext() {
+    for (size_t i = 0; i < algo_contexts_.size(); ++i) {
+      delete algo_contexts_[i];
+    }
+  }
+
+  ConvOpContext(const ConvOpContext&) = delete;
+
+  ConvOpContext& operator=(const ConvOpContext&) = delete;
+
+  size_t algo_index_;
+  bool tuned_;
+  ConvolutionDataDesc data_desc_;
+  ConvolutionDataDesc tuned_data_desc_;
+  std::vector<ConvolutionContext *> algo_contexts_;
+  // Float output of ExecuteRequantized for the algorithms without a requantizing epilogue
+  std::vector<float> requant_scratch_;
+};
+
+// The algorithms only hold the packed weights, so once set up an op can be executed by several threads at a time.
+// Each calling thread gets its own ConvOpContext, see ThreadContexts; the setup functions must not race with Execute.
 struct ConvOp {
-  ConvOp() : algo_id_(AUTO_SELECT_CONV), algo_(NULL) {
+  ConvOp() : algo_id_(AUTO_SELECT_CONV), algo_index_(0), autotune_(false) {
   }
 
   ~ConvOp() {
-    delete algo_;
+    ReleaseAlgos();
   }
 
   ConvOp(const ConvOp&) = delete;
@@ -47,37 +78,529 @@ struct ConvOp {
     ChooseAlgo(algo);
   }
 
-  void SetupConvolutionDataParameter(size_t batch_size, size_t channel_in, size_t height_in, size_t width_in) {
-    conv_data_desc_ = {batch_size, channel_in, height_in, width_in};
+  bool IsDepthwise() {
+    return (conv_kernel_desc_.group_ > 1) && (conv_kernel_desc_.group_ == conv_kernel_desc_.channel_in_) &&
+           (conv_kernel_desc_.group_ == conv_kernel_desc_.channel_out_);
+  }
+
+  bool IsWinogradApplicable() {
+    return (conv_kernel_desc_.group_ == 1) && (conv_kernel_desc_.kernel_h_ == 3) && (conv_kernel_desc_.kernel_w_ == 3) &&
+           (conv_kernel_desc_.stride_h_ == 1) && (conv_kernel_desc_.stride_w_ == 1) &&
+           (conv_kernel_desc_.dilation_h_ == 1) && (conv_kernel_desc_.dilation_w_ == 1);
   }
 
+  // AUTO_SELECT_CONV initializes every applicable algorithm and times them on the first Execute of each input shape,
+  // see Autotune; the ones that win no shape are then released. IMPLICIT_GEMM_CONV is never a candidate: it would hold
+  // a second copy of the SHUFFLE_CONV weights.
   void ChooseAlgo(CONV_ALGORITHM algo_id) {
-    algo_id_ = algo_id;
-    switch (algo_id_) {
+    ReleaseAlgos();
+    autotune_ = (algo_id == AUTO_SELECT_CONV);
+    if (autotune_) {
+      candidate_ids_.push_back(SHUFFLE_CONV);
+      if (IsDepthwise()) {
+        candidate_ids_.push_back(DEPTHWISE_CONV);
+      }
+      if (IsWinogradApplicable()) {
+        candidate_ids_.push_back(WINOGRAD_CONV);
+      }
+      algo_id = IsDepthwise() ? DEPTHWISE_CONV : SHUFFLE_CONV;
+    } else {
+      candidate_ids_.push_back(algo_id);
+    }
+    for (size_t i = 0; i < candidate_ids_.size(); ++i) {
+      candidates_.push_back(CreateAlgo(candidate_ids_[i]));
+      candidates_.back()->SetInputRange(input_range_);
+    }
+    won_.assign(candidates_.size(), false);
+    std::vector<std::atomic<bool>>(candidates_.size()).swap(released_);
+    for (size_t i = 0; i < candidates_.size(); ++i) {
+      released_[i].store(false, std::memory_order_relaxed);
+    }
+    algo_index_ = FindAlgo(algo_id);
+    algo_id_ = candidate_ids_[algo_index_];
+  }
+
+  BaseConvolutionAlgo *CreateAlgo(CONV_ALGORITHM algo_id) {
+    switch (algo_id) {
       case SHUFFLE_CONV: {
-        algo_ = new ShuffleConvolutionAlgo(conv_kernel_desc_);
-        break;
+        return new ShuffleConvolutionAlgo(conv_kernel_desc_);
+      }
+      case DEPTHWISE_CONV: {
+        assert(IsDepthwise());
+        return new DepthwiseConvolutionAlgo(conv_kernel_desc_);
+      }
+      case WINOGRAD_CONV: {
+        assert(IsWinogradApplicable());
+        return new WinogradConvolutionAlgo<2>(conv_kernel_desc_);
+      }
+      case IMPLICIT_GEMM_CONV: {
+        return new ShuffleConvolutionAlgo(conv_kernel_desc_, true);
       }
       default: {
-        algo_ = new ShuffleConvolutionAlgo(conv_kernel_desc_);
-        break;
+        return new ShuffleConvolutionAlgo(conv_kernel_desc_);
+      }
+    }
+  }
+
+  // Falls back to the first candidate when algo_id was not set up or was released, e.g. a stale tuning file
+  size_t FindAlgo(CONV_ALGORITHM algo_id) {
+    for (size_t i = 0; i < candidate_ids_.size(); ++i) {
+      if ((candidate_ids_[i] == algo_id) && !Released(i)) {
+        return i;
       }
     }
+    return 0;
+  }
+
+  // Read without tune_mutex_ by the Execute of other threads and by Graph, while ReleaseLosers may set it
+  bool Released(size_t i) const {
+    return released_[i].load(std::memory_order_acquire);
+  }
+
+  void ReleaseAlgos() {
+    ReleaseContexts();
+    for (size_t i = 0; i < candidates_.size(); ++i) {
+      delete candidates_[i];
+    }
+    candidates_.clear();
+    candidate_ids_.clear();
+  }
+
+  ConvOpContext *CreateContext() {
+    ConvOpContext *context = new ConvOpContext();
+    context->algo_index_ = algo_index_;
+    for (size_t i = 0; i < candidates_.size(); ++i) {
+      context->algo_contexts_.push_back(candidates_[i]->CreateContext());
+    }
+    return context;
+  }
+
+  // The context of the calling thread, created on its first Execute
+  ConvOpContext *ThreadContext() {
+    return contexts_.Local([this] { return CreateContext(); });
+  }
+
+  void ReleaseContexts() {
+    contexts_.Clear();
   }
 
   void InitWeight(float *weight) {
-    algo_->InitWeight(weight, conv_kernel_desc_);
+    for (size_t i = 0; i < candidates_.size(); ++i) {
+      if (!Released(i)) {
+        candidates_[i]->InitWeight(weight, conv_kernel_desc_);
+      }
+    }
+  }
+
+  void SetupBNParameter(float *mean, float *variance, float *scale, float *shift, float eps) {
+    for (size_t i = 0; i < candidates_.size(); ++i) {
+      if (!Released(i)) {
+        candidates_[i]->InitBN(mean, variance, scale, shift, eps, conv_kernel_desc_.channel_out_);
+      }
+    }
+  }
+
+  // The inputs of the public entry points are the ones calibration records; WarmUp's synthetic input is not
+  void Execute(float *out, float *data, float *bias, float *residual, size_t batch_size, size_t channel_in,
+               size_t height_in, size_t width_in) {
+    if (calibrator_.Active()) {
+      calibrator_.Observe(data, batch_size * channel_in * height_in * width_in);
+    }
+    Execute(ThreadContext(), out, data, bias, residual, batch_size, channel_in, height_in, width_in);
+  }
+
+  void Execute(ConvOpContext *context, float *out, float *data, float *bias, float *residual, size_t batch_size,
+               size_t channel_in, size_t height_in, size_t width_in) {
+    PerfScope perf(PERF_CONV_OP, Operations(batch_size, height_in, width_in));
+    TraceShape(perf, batch_size, channel_in, height_in, width_in);
+    context->data_desc_ = {batch_size, channel_in, height_in, width_in};
+    if (autotune_) {
+      Autotune(context, data, bias, residual);
+    }
+    size_t i = context->algo_index_;
+    perf.Arg("algo", candidate_ids_[i]);
+    candidates_[i]->Execute(context->algo_contexts_[i], out, data, bias, residual, context->data_desc_,
+                            conv_kernel_desc_);
+  }
+
+  // Bytes of caller workspace ExecuteWithWorkspace needs for this input shape at the current thread count: the most
+  // any candidate reserves, since AUTO_SELECT_CONV may still run them all to tune
+  size_t WorkspaceSize(size_t batch_size, size_t channel_in, size_t height_in, size_t width_in) {
+    ConvolutionDataDesc conv_data_desc = {batch_size, channel_in, height_in, width_in};
+    size_t size = 0;
+    for (size_t i = 0; i < candidates_.size(); ++i) {
+      size = std::max(size, candidates_[i]->WorkspaceSize(conv_data_desc, conv_kernel_desc_));
+    }
+    return Workspace::AttachedSize(size);
+  }
+
+  // Execute carving the temporaries out of the caller's buffer. The calling thread's own workspaces are released
+  // first, so memory isn't held twice. Returns false without executing when the buffer is too small. The context is
+  // still created on the heap by the first call of a thread, unless WarmUp ran on it.
+  bool ExecuteWithWorkspace(void *workspace, size_t workspace_size, float *out, float *data, float *bias,
+                            float *residual, size_t batch_size, size_t channel_in, size_t height_in, size_t width_in) {
+    if ((workspace == NULL) || (workspace_size < WorkspaceSize(batch_size, channel_in, height_in, width_in))) {
+      return false;
+    }
+    if (calibrator_.Active()) {
+      calibrator_.Observe(data, batch_size * channel_in * height_in * width_in);
+    }
+    ConvOpContext *context = ThreadContext();
+    for (size_t i = 0; i < context->algo_contexts_.size(); ++i) {
+      context->algo_contexts_[i]->workspace_.Attach(workspace, workspace_size);
+    }
+    Execute(context, out, data, bias, residual, batch_size, channel_in, height_in, width_in);
+    for (size_t i = 0; i < context->algo_contexts_.size(); ++i) {
+      context->algo_contexts_[i]->workspace_.Detach();
+    }
+    return true;
+  }
+
+  // uint8 output in the layout of the float one. The candidate QuantizedAlgo picks requantizes in its GEMM epilogue;
+  // without one, e.g. DEPTHWISE_CONV or WINOGRAD_CONV alone, the chosen algorithm writes float output to a per-thread
+  // buffer that is requantized in a separate pass.
+  void ExecuteRequantized(uint8_t *dst, float scale, float zero_point, float *data, float *bias, float *residual,
+                          size_t batch_size, size_t channel_in, size_t height_in, size_t width_in) {
+    if (calibrator_.Active()) {
+      calibrator_.Observe(data, batch_size * channel_in * height_in * width_in);
+    }
+    PerfScope perf(PERF_CONV_OP, Operations(batch_size, height_in, width_in));
+    TraceShape(perf, batch_size, channel_in, height_in, width_in);
+    ConvOpContext *context = ThreadContext();
+    context->data_desc_ = {batch_size, channel_in, height_in, width_in};
+    if (autotune_) {
+      Autotune(context, data, bias, residual);
+    }
+    int i = QuantizedAlgo(context->algo_index_, false);
+    if (i >= 0) {
+      perf.Arg("algo", candidate_ids_[i]);
+      shuffle::Requantization requant = {dst, 1.0f / scale, zero_point, 255.0f};
+      candidates_[i]->ExecuteRequantized(context->algo_contexts_[i], requant, data, bias, residual,
+                                         context->data_desc_, conv_kernel_desc_);
+      return;
+    }
+    size_t n = context->algo_index_;
+    perf.Arg("algo", candidate_ids_[n]);
+    size_t count = RequantizedOutputSize(batch_size, height_in, width_in);
+    context->requant_scratch_.resize(count);
+    float *out = context->requant_scratch_.data();
+    candidates_[n]->Execute(context->algo_contexts_[n], out, data, bias, residual, context->data_desc_,
+                            conv_kernel_desc_);
+    const size_t chunk = 4096;
+#pragma omp parallel for
+    for (size_t k = 0; k < count; k += chunk) {
+      SaturateQuantize(dst + k, out + k, std::min(chunk, count - k), 1.0f / scale, zero_point, 255.0f);
+    }
+  }
+
+  // Candidate running the quantized edges of a Graph: the preferred one if it has the GEMM epilogue and, for a
+  // quantized input, takes one, else the first live candidate that does. -1 if none does.
+  int QuantizedAlgo(size_t preferred, bool quantized_input) {
+    for (size_t n = 0; n <= candidates_.size(); ++n) {
+      size_t i = (n == 0) ? preferred : n - 1;
+      if ((i < candidates_.size()) && !Released(i) && candidates_[i]->SupportsRequantization() &&
+          (!quantized_input || candidates_[i]->SupportsQuantizedInput())) {
+        return static_cast<int>(i);
+      }
+    }
+    return -1;
+  }
+
+  // How the convolution producing the input of this one requantizes it into dst, see QuantizedAlgo
+  shuffle::Requantization InputRequantization(uint8_t *dst) {
+    int i = QuantizedAlgo(algo_index_, true);
+    assert(i >= 0);
+    return candidates_[i]->InputRequantization(dst);
+  }
+
+  // One convolution of a Graph with uint8 edges: the input is read from quantized, as InputRequantization wrote it, or
+  // from data, and the output is requantized by requant or written to out as float; at least one end is quantized. A
+  // quantized input is not tuned, the candidates are timed on float input.
+  void ExecuteQuantized(float *out, const shuffle::Requantization *requant, float *data, const uint8_t *quantized,
+                        float *bias, float *residual, size_t batch_size, size_t channel_in, size_t height_in,
+                        size_t width_in) {
+    if ((quantized == NULL) && calibrator_.Active()) {
+      calibrator_.Observe(data, batch_size * channel_in * height_in * width_in);
+    }
+    PerfScope perf(PERF_CONV_OP, Operations(batch_size, height_in, width_in));
+    TraceShape(perf, batch_size, channel_in, height_in, width_in);
+    ConvOpContext *context = ThreadContext();
+    context->data_desc_ = {batch_size, channel_in, height_in, width_in};
+    if (autotune_ && (quantized == NULL)) {
+      Autotune(context, data, bias, residual);
+    }
+    int i = QuantizedAlgo(context->algo_index_, quantized != NULL);
+    assert(i >= 0);
+    perf.Arg("algo", candidate_ids_[i]);
+    if (quantized != NULL) {
+      candidates_[i]->ExecuteQuantizedInput(context->algo_contexts_[i], out, requant, quantized, bias, residual,
+                                            context->data_desc_, conv_kernel_desc_);
+    } else {
+      candidates_[i]->ExecuteRequantized(context->algo_contexts_[i], *requant, data, bias, residual,
+                                         context->data_desc_, conv_kernel_desc_);
+    }
+  }
+
+  // Multiply-adds of one Execute counted as two operations, see PerfCounterValue
+  uint64_t Operations(size_t batch_size, size_t height_in, size_t width_in) const {
+    size_t height_out = GetConvOutSize(height_in, conv_kernel_desc_.kernel_h_, conv_kernel_desc_.stride_h_,
+                                       conv_kernel_desc_.pad_h_, conv_kernel_desc_.dilation_h_);
+    size_t width_out = GetConvOutSize(width_in, conv_kernel_desc_.kernel_w_, conv_kernel_desc_.stride_w_,
+                                      conv_kernel_desc_.pad_w_, conv_kernel_desc_.dilation_w_);
+    return 2ull * batch_size * height_out * width_out * conv_kernel_desc_.channel_out_ *
+           conv_kernel_desc_.channel_in_per_group_ * conv_kernel_desc_.kernel_h_ * conv_kernel_desc_.kernel_w_;
+  }
+
+  // The input and kernel dimensions on the trace span of an Execute
+  void TraceShape(PerfScope &perf, size_t batch_size, size_t channel_in, size_t height_in, size_t width_in) const {
+    perf.Arg("batch", batch_size).Arg("channel_in", channel_in).Arg("height_in", height_in).Arg("width_in", width_in);
+    perf.Arg("channel_out", conv_kernel_desc_.channel_out_).Arg("group", conv_kernel_desc_.group_);
+    perf.Arg("kernel_h", conv_kernel_desc_.kernel_h_).Arg("kernel_w", conv_kernel_desc_.kernel_w_);
+    perf.Arg("stride_h", conv_kernel_desc_.stride_h_).Arg("stride_w", conv_kernel_desc_.stride_w_);
+  }
+
+  // Bytes of the uint8 output of ExecuteRequantized
+  size_t RequantizedOutputSize(size_t batch_size, size_t height_in, size_t width_in) {
+    size_t height_out = GetConvOutSize(height_in, conv_kernel_desc_.kernel_h_, conv_kernel_desc_.stride_h_,
+                                       conv_kernel_desc_.pad_h_, conv_kernel_desc_.dilation_h_);
+    size_t width_out = GetConvOutSize(width_in, conv_kernel_desc_.kernel_w_, conv_kernel_desc_.stride_w_,
+                                      conv_kernel_desc_.pad_w_, conv_kernel_desc_.dilation_w_);
+    return batch_size * height_out * width_out * conv_kernel_desc_.channel_out_;
+  }
+
+  // Runs the layer once on synthetic input of the given shape, so the first request doesn't pay for the workspace,
+  // the GEMM plans or, with AUTO_SELECT_CONV, the tuning of that shape. Workspace and plans belong to the calling
+  // thread's context; other threads only reuse the tuning.
+  void WarmUp(size_t batch_size, size_t channel_in, size_t height_in, size_t width_in) {
+    size_t height_out = GetConvOutSize(height_in, conv_kernel_desc_.kernel_h_, conv_kernel_desc_.stride_h_,
+                                       conv_kernel_desc_.pad_h_, conv_kernel_desc_.dilation_h_);
+    size_t width_out = GetConvOutSize(width_in, conv_kernel_desc_.kernel_w_, conv_kernel_desc_.stride_w_,
+                                      conv_kernel_desc_.pad_w_, conv_kernel_desc_.dilation_w_);
+    std::vector<float> data(batch_size * channel_in * height_in * width_in);
+    for (size_t i = 0; i < data.size(); ++i) {
+      data[i] = static_cast<float>(i % 251) / 251.0f - 0.5f;
+    }
+    std::vector<float> out(batch_size * conv_kernel_desc_.channel_out_ * height_out * width_out, 0.0f);
+    Execute(ThreadContext(), out.data(), data.data(), NULL, out.data(), batch_size, channel_in, height_in, width_in);
+  }
+
+  // Static input quantization, see ActivationCalibrator and StaticRange
+  void StartCalibration(CALIBRATION_MODE mode, float percentile) {
+    calibrator_.Start(mode, percentile);
+  }
+
+  void FinishCalibration() {
+    SetInputRange(calibrator_.Finish());
+  }
+
+  void SetInputRange(const StaticRange &range) {
+    input_range_ = range;
+    for (size_t i = 0; i < candidates_.size(); ++i) {
+      candidates_[i]->SetInputRange(range);
+    }
+  }
+
+  // The layer descriptor, the input range and the packed state of every candidate, see packed_model.h
+  void SavePacked(PackedWriter &writer) {
+    const ConvolutionKernelDesc &desc = conv_kernel_desc_;
+    size_t fields[] = {desc.layout_, desc.channel_out_, desc.channel_in_, desc.group_, desc.kernel_h_, desc.kernel_w_,
+                       desc.stride_h_, desc.stride_w_, desc.pad_h_, desc.pad_w_, desc.dilation_h_, desc.dilation_w_,
+                       desc.fusion_mask_};
+    for (size_t i = 0; i < sizeof(fields) / sizeof(fields[0]); ++i) {
+      writer.WriteSize(fields[i]);
+    }
+    writer.WriteSize(autotune_ ? AUTO_SELECT_CONV : algo_id_);
+    writer.WriteFloat(input_range_.min_);
+    writer.WriteFloat(input_range_.max_);
+    size_t live = 0;
+    for (size_t i = 0; i < candidates_.size(); ++i) {
+      live += Released(i) ? 0 : 1;
+    }
+    writer.WriteSize(live);
+    for (size_t i = 0; i < candidates_.size(); ++i) {
+      if (!Released(i)) {
+        writer.WriteSize(candidate_ids_[i]);
+        candidates_[i]->SavePacked(writer);
+      }
+    }
+  }
+
+  // Sets the op up as saved, its packed weights pointing into the mapping of the reader, which the op then keeps
+  bool LoadPacked(PackedReader &reader) {
+    size_t fields[13];
+    for (size_t i = 0; i < 13; ++i) {
+      fields[i] = reader.ReadSize();
+    }
+    size_t algo_id = reader.ReadSize();
+    float min = reader.ReadFloat();
+    float max = reader.ReadFloat();
+    size_t candidates = reader.ReadSize();
+    if (!reader.Ok() || (fields[0] > NHWC) || (fields[3] == 0) || (fields[1] % fields[3] != 0) ||
+        (fields[2] % fields[3] != 0) || (algo_id == 4) || (algo_id > IMPLICIT_GEMM_CONV)) {
+      return false;
+    }
+    conv_kernel_desc_ = {static_cast<LAYOUT>(fields[0]), fields[1], fields[2], fields[3], fields[1] / fields[3],
+                         fields[2] / fields[3], fields[4], fields[5], fields[6], fields[7], fields[8], fields[9],
+                         fields[10], fields[11], fields[12]};
+    CONV_ALGORITHM algo = static_cast<CONV_ALGORITHM>(algo_id);
+    if (((algo == DEPTHWISE_CONV) && !IsDepthwise()) ||
+        ((algo == WINOGRAD_CONV) && !IsWinogradApplicable())) {
+      return false;
+    }
+    ChooseAlgo(algo);
+    if ((candidates == 0) || (candidates > candidates_.size())) {
+      return false;
+    }
+    // An auto-selected model may have been saved after tuning released some candidates: the ids are an ordered
+    // subsequence of candidate_ids_ that still starts with the SHUFFLE_CONV fallback
+    std::vector<bool> loaded(candidates_.size(), false);
+    size_t index = 0;
+    for (size_t i = 0; i < candidates; ++i) {
+      size_t id = reader.ReadSize();
+      while ((index < candidate_ids_.size()) && (static_cast<size_t>(candidate_ids_[index]) != id)) {
+        ++index;
+      }
+      if ((index == candidate_ids_.size()) || ((i == 0) && (index != 0)) ||
+          !candidates_[index]->LoadPacked(reader, conv_kernel_desc_)) {
+        return false;
+      }
+      loaded[index++] = true;
+    }
+    for (size_t i = 0; i < candidates_.size(); ++i) {
+      released_[i].store(!loaded[i], std::memory_order_relaxed);
+    }
+    algo_index_ = FindAlgo(candidate_ids_[algo_index_]);
+    algo_id_ = candidate_ids_[algo_index_];
+    SetInputRange(StaticRange(min, max));
+    packed_mapping_ = reader.mapping_;
+    return true;
+  }
+
+  std::string TuningKey(const ConvolutionDataDesc &conv_data_desc) {
+    std::ostringstream key;
+    key << TuningKeyPrefix("conv") << ":" << ((conv_kernel_desc_.layout_ == NCHW) ? "nchw" : "nhwc") << ":o"
+        << conv_kernel_desc_.channel_out_ << ":i" << conv_kernel_desc_.channel_in_ << ":g" << conv_kernel_desc_.group_
+        << ":k" << conv_kernel_desc_.kernel_h_ << "x" << conv_kernel_desc_.kernel_w_ << ":s"
+        << conv_kernel_desc_.stride_h_ << "x" << conv_kernel_desc_.stride_w_ << ":p" << conv_kernel_desc_.pad_h_ << "x"
+        << conv_kernel_desc_.pad_w_ << ":d" << conv_kernel_desc_.dilation_h_ << "x" << conv_kernel_desc_.dilation_w_
+        << ":f" << conv_kernel_desc_.fusion_mask_ << ":n" << conv_data_desc.batch_size_ << ":"
+        << conv_data_desc.height_in_ << "x" << conv_data_desc.width_in_;
+    return key.str();
   }
 
-  void Execute(float *out, float *data, float *bias, size_t batch_size, size_t channel_in, size_t height_in,
-               size_t width_in) {
-    SetupConvolutionDataParameter(batch_size, channel_in, height_in, width_in);
-    algo_->Execute(out, data, bias, conv_data_desc_, conv_kernel_desc_);
+  // Looks the current input shape up in the Autotuner and searches the live candidates on a miss. The candidates
+  // write to a scratch output, so an in-place residual is left untouched for the real run. Each search is a trace span
+  // "autotune" per candidate with its algo and time_us.
+  void Autotune(ConvOpContext *context, float *data, float *bias, float *residual) {
+    const ConvolutionDataDesc &conv_data_desc = context->data_desc_;
+    // ReleaseLosers only frees the workspaces of the thread it runs on; the others let theirs go here
+    for (size_t i = 1; i < candidates_.size(); ++i) {
+      if (Released(i)) {
+        context->algo_contexts_[i]->workspace_.Shrink();
+      }
+    }
+    if (context->tuned_ && (context->tuned_data_desc_.batch_size_ == conv_data_desc.batch_size_) &&
+        (context->tuned_data_desc_.height_in_ == conv_data_desc.height_in_) &&
+        (context->tuned_data_desc_.width_in_ == conv_data_desc.width_in_)) {
+      return;
+    }
+    std::string key = TuningKey(conv_data_desc);
+    TuningRecord record;
+    // Serializes the searches with the releases: no thread may be running a candidate another one releases
+    std::lock_guard<std::mutex> lock(tune_mutex_);
+    if (!Autotuner::Instance().Lookup(key, record)) {
+      size_t height_out = GetConvOutSize(conv_data_desc.height_in_, conv_kernel_desc_.kernel_h_,
+                                         conv_kernel_desc_.stride_h_, conv_kernel_desc_.pad_h_,
+                                         conv_kernel_desc_.dilation_h_);
+      size_t width_out = GetConvOutSize(conv_data_desc.width_in_, conv_kernel_desc_.kernel_w_,
+                                        conv_kernel_desc_.stride_w_, conv_kernel_desc_.pad_w_,
+                                        conv_kernel_desc_.dilation_w_);
+      std::vector<float> scratch(conv_data_desc.batch_size_ * conv_kernel_desc_.channel_out_ * height_out * width_out);
+      double best_time = DBL_MAX;
+      for (size_t i = 0; i < candidates_.size(); ++i) {
+        if (Released(i)) {
+          continue;
+        }
+        TraceScope trace("autotune", "op");
+        BaseConvolutionAlgo *algo = candidates_[i];
+        ConvolutionContext *algo_context = context->algo_contexts_[i];
+        auto run = [&](const GemmTuning &tuning) {
+          algo_context->gemm_tuning_ = tuning;
+          algo->Execute(algo_context, scratch.data(), data, bias, residual, conv_data_desc, conv_kernel_desc_);
+        };
+        GemmTuning tuning = GemmTuning();
+        double time;
+        // grouped SHUFFLE_CONV runs on ConvShuffleGroupGEMM, which has no loop nest to tune
+        if ((candidate_ids_[i] == SHUFFLE_CONV) && (conv_kernel_desc_.group_ == 1)) {
+          tuning = SearchGemmTuning(run, time);
+        } else {
+          time = TimeRun([&] { run(tuning); });
+        }
+        trace.Arg("algo", candidate_ids_[i]).Arg("time_us", static_cast<uint64_t>(time));
+        if (time < best_time) {
+          best_time = time;
+          record.algo_ = candidate_ids_[i];
+          record.gemm_ = tuning;
+        }
+      }
+      Autotuner::Instance().Record(key, record);
+    }
+    context->algo_index_ = FindAlgo(static_cast<CONV_ALGORITHM>(record.algo_));
+    context->algo_contexts_[context->algo_index_]->gemm_tuning_ = record.gemm_;
+    context->tuned_ = true;
+    context->tuned_data_desc_ = conv_data_desc;
+    won_[context->algo_index_] = true;
+    ReleaseLosers(context);
+  }
+
+  // Frees the weights of every candidate that has won no shape so far, so an auto-selected op settles at the memory
+  // of the algorithms it runs; later shapes are tuned among the survivors. SHUFFLE_CONV stays: it is the fallback of
+  // FindAlgo and the one that requantizes. Called under tune_mutex_.
+  void ReleaseLosers(ConvOpContext *context) {
+    for (size_t i = 1; i < candidates_.size(); ++i) {
+      if (!won_[i] && !Released(i)) {
+        candidates_[i]->ReleaseWeight();
+        released_[i].store(true, std::memory_order_release);
+        context->algo_contexts_[i]->workspace_.Shrink();
+      }
+    }
+  }
+
+  // Only the workspaces of the calling thread: those of the others may be in use by an Execute
+  void ShrinkWorkspace() {
+    ConvOpContext *context = contexts_.Find();
+    for (size_t i = 0; (context != NULL) && (i < context->algo_contexts_.size()); ++i) {
+      context->algo_contexts_[i]->workspace_.Shrink();
+    }
+    if (context != NULL) {
+      std::vector<float>().swap(context->requant_scratch_);
+    }
+  }
+
+  size_t WorkspaceSavedBytes() {
+    ConvOpContext *context = contexts_.Find();
+    size_t saved_bytes = 0;
+    for (size_t i = 0; (context != NULL) && (i < context->algo_contexts_.size()); ++i) {
+      saved_bytes += context->algo_contexts_[i]->workspace_.SavedBytes();
+    }
+    return saved_bytes;
   }
 
   CONV_ALGORITHM algo_id_;
-  BaseConvolutionAlgo *algo_;
+  size_t algo_index_;
+  std::vector<CONV_ALGORITHM> candidate_ids_;
+  std::vector<BaseConvolutionAlgo *> candidates_;
+  // Per candidate: whether it won the search of some shape, only accessed under tune_mutex_, and whether ReleaseLosers
+  // freed its weights, see Released
+  std::vector<bool> won_;
+  std::vector<std::atomic<bool>> released_;
+  std::mutex tune_mutex_;
+  bool autotune_;
   ConvolutionKernelDesc conv_kernel_desc_;
-  ConvolutionDataDesc conv_data_desc_;
+  ActivationCalibrator calibrator_;
+  StaticRange input_range_;
+  ThreadContexts<ConvOpContext> contexts_;
+  // File the candidates of a loaded op execute from
+  std::shared_ptr<PackedMapping> packed_mapping_;
 };
 #endif
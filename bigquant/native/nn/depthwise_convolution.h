@@ -0,0 +1,197 @@
+/*
+ * Copyright 2016 The BigDL Authors.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef NN_DEPTHWISE_CONVOLUTION_H
+#define NN_DEPTHWISE_CONVOLUTION_H
+#include "base_convolution.h"
+
+// Direct convolution for group == channel_in == channel_out. The GEMM path would run one im2col GEMM per channel with
+// a single row padded up to CONV_SHUFFLE_KERNEL_M; here channels stay in the SIMD lanes and the input is quantized
+// once into a padded NHWC buffer.
+struct DepthwiseConvolutionAlgo : public BaseConvolutionAlgo {
+  DepthwiseConvolutionAlgo(const ConvolutionKernelDesc &conv_kernel_desc)
+      : quantized_weight_(NULL), weight_ratio_(NULL), kernel_sum_(NULL) {
+    assert((conv_kernel_desc.group_ == conv_kernel_desc.channel_in_) &&
+           (conv_kernel_desc.group_ == conv_kernel_desc.channel_out_));
+    // Products are accumulated in int32 lanes, so both operands can use their full range
+    weight_threshold_ = 127.0f;
+    data_threshold_ = 255.0f;
+    channel_aligned_ = GetAlignmentLength(conv_kernel_desc.channel_out_, PS_OPERAND_WIDTH);
+  }
+
+  ~DepthwiseConvolutionAlgo() {
+    delete quantized_weight_;
+    delete weight_ratio_;
+    delete kernel_sum_;
+  }
+
+  void ReleaseWeight() {
+    delete quantized_weight_;
+    delete weight_ratio_;
+    delete kernel_sum_;
+    quantized_weight_ = NULL;
+    weight_ratio_ = NULL;
+    kernel_sum_ = NULL;
+  }
+
+  void InitWeight(float *weight, ConvolutionKernelDesc &conv_kernel_desc) {
+    // One input channel per group, so the NCHW and NHWC kernels are both [channel][kernel_h][kernel_w]
+    size_t taps = conv_kernel_desc.kernel_h_ * conv_kernel_desc.kernel_w_;
+    delete quantized_weight_;
+    delete weight_ratio_;
+    delete kernel_sum_;
+    quantized_weight_ = new Tensor<int8_t>(make_shape(taps, channel_aligned_), 64);
+    weight_ratio_ = new Tensor<float>(make_shape(channel_aligned_), 64);
+    kernel_sum_ = new Tensor<float>(make_shape(channel_aligned_), 64);
+    memset(quantized_weight_->data_, 0, quantized_weight_->Size());
+    for (size_t c = 0; c < channel_aligned_; ++c) {
+      float max_abs = 0.0f;
+      float sum = 0.0f;
+      for (size_t t = 0; (c < conv_kernel_desc.channel_out_) && (t < taps); ++t) {
+        max_abs = std::max(max_abs, std::fabs(weight[c * taps + t]));
+        sum += weight[c * taps + t];
+      }
+      float ratio = (max_abs > 0.0f) ? weight_threshold_ / max_abs : 1.0f;
+      for (size_t t = 0; (c < conv_kernel_desc.channel_out_) && (t < taps); ++t) {
+        quantized_weight_->data_[t * channel_aligned_ + c] = static_cast<int8_t>(roundf(weight[c * taps + t] * ratio));
+      }
+      weight_ratio_->data_[c] = ratio;
+      kernel_sum_->data_[c] = sum;
+    }
+  }
+
+  void SavePackedWeight(PackedWriter &writer) {
+    writer.WriteTensor(quantized_weight_);
+    writer.WriteTensor(weight_ratio_);
+    writer.WriteTensor(kernel_sum_);
+  }
+
+  bool LoadPackedWeight(PackedReader &reader, const ConvolutionKernelDesc &conv_kernel_desc) {
+    quantized_weight_ = new Tensor<int8_t>(Shape());
+    weight_ratio_ = new Tensor<float>(Shape());
+    kernel_sum_ = new Tensor<float>(Shape());
+    reader.ReadTensor(*quantized_weight_, conv_kernel_desc.kernel_h_ * conv_kernel_desc.kernel_w_ * channel_aligned_);
+    reader.ReadTensor(*weight_ratio_, channel_aligned_);
+    reader.ReadTensor(*kernel_sum_, channel_aligned_);
+    return reader.Ok();
+  }
+
+  // The padded quantized input, four per-channel parameter arrays and a float output row per thread
+  size_t WorkspaceSize(const ConvolutionDataDesc &conv_data_desc, const ConvolutionKernelDesc &conv_kernel_desc) {
+    size_t width_out = GetConvOutSize(conv_data_desc.width_in_, conv_kernel_desc.kernel_w_, conv_kernel_desc.stride_w_,
+                                      conv_kernel_desc.pad_w_, conv_kernel_desc.dilation_w_);
+    size_t height_padded = conv_data_desc.height_in_ + 2 * conv_kernel_desc.pad_h_;
+    size_t width_padded = conv_data_desc.width_in_ + 2 * conv_kernel_desc.pad_w_;
+    size_t params_count = conv_data_desc.batch_size_ * channel_aligned_;
+    size_t quantized_count = conv_data_desc.batch_size_ * height_padded * width_padded * channel_aligned_;
+    size_t row_count = width_out * channel_aligned_;
+    return Workspace::AlignedSize(sizeof(uint8_t) * quantized_count) +
+           4 * Workspace::AlignedSize(sizeof(float) * params_count) +
+           GetThreadsNumWrapper() * Workspace::AlignedSize(sizeof(float) * row_count);
+  }
+
+  void Execute(ConvolutionContext *context, float *out, float *data, float *bias, float *residual,
+               const ConvolutionDataDesc &conv_data_desc, const ConvolutionKernelDesc &conv_kernel_desc) {
+    bool relu = (conv_kernel_desc.fusion_mask_ & FUSION_RELU) != 0;
+    bool bn = (conv_kernel_desc.fusion_mask_ & FUSION_BN) != 0;
+    assert(!bn || (bn_mean_ != NULL));
+    assert(((conv_kernel_desc.fusion_mask_ & FUSION_SUM) == 0) || (residual != NULL));
+    if ((conv_kernel_desc.fusion_mask_ & FUSION_SUM) == 0) {
+      residual = NULL;
+    }
+    size_t batch_size = conv_data_desc.batch_size_;
+    size_t channels = conv_kernel_desc.channel_out_;
+    size_t height_out = GetConvOutSize(conv_data_desc.height_in_, conv_kernel_desc.kernel_h_,
+                                       conv_kernel_desc.stride_h_, conv_kernel_desc.pad_h_,
+                                       conv_kernel_desc.dilation_h_);
+    size_t width_out = GetConvOutSize(conv_data_desc.width_in_, conv_kernel_desc.kernel_w_, conv_kernel_desc.stride_w_,
+                                      conv_kernel_desc.pad_w_, conv_kernel_desc.dilation_w_);
+    size_t height_padded = conv_data_desc.height_in_ + 2 * conv_kernel_desc.pad_h_;
+    size_t width_padded = conv_data_desc.width_in_ + 2 * conv_kernel_desc.pad_w_;
+    size_t threads = GetThreadsNumWrapper();
+    Workspace &workspace = context->workspace_;
+    size_t params_count = batch_size * channel_aligned_;
+    size_t quantized_count = batch_size * height_padded * width_padded * channel_aligned_;
+    size_t row_count = width_out * channel_aligned_;
+    workspace.Reserve(WorkspaceSize(conv_data_desc, conv_kernel_desc));
+    uint8_t *quantized_data = workspace.Allocate<uint8_t>(quantized_count);
+    float *min = workspace.Allocate<float>(params_count);
+    float *ratio = workspace.Allocate<float>(params_count);
+    float *coeff = workspace.Allocate<float>(params_count);
+    float *offset = workspace.Allocate<float>(params_count);
+    std::vector<float *> rows(threads);
+    for (size_t t = 0; t < threads; ++t) {
+      rows[t] = workspace.Allocate<float>(row_count);
+    }
+    if (conv_kernel_desc.layout_ == NCHW) {
+      depthwise::PadQuantize<NCHW>(quantized_data, data, batch_size, channels, channel_aligned_,
+                                   conv_data_desc.height_in_, conv_data_desc.width_in_, conv_kernel_desc.pad_h_,
+                                   conv_kernel_desc.pad_w_, min, ratio, data_threshold_);
+    } else {
+      depthwise::PadQuantize<NHWC>(quantized_data, data, batch_size, channels, channel_aligned_,
+                                   conv_data_desc.height_in_, conv_data_desc.width_in_, conv_kernel_desc.pad_h_,
+                                   conv_kernel_desc.pad_w_, min, ratio, data_threshold_);
+    }
+    // Dequantization, bias and BN fold into one affine transform per (image, channel)
+    for (size_t n = 0; n < batch_size; ++n) {
+      for (size_t c = 0; c < channel_aligned_; ++c) {
+        size_t i = n * channel_aligned_ + c;
+        float bn_a = 1.0f;
+        float bn_b = 0.0f;
+        if (bn && (c < channels)) {
+          bn_a = bn_variance_coeff_->data_[c] * ((bn_scale_ == NULL) ? 1.0f : bn_scale_->data_[c]);
+          bn_b = ((bn_shift_ == NULL) ? 0.0f : bn_shift_->data_[c]) - bn_mean_->data_[c] * bn_a;
+        }
+        float bias_c = ((bias == NULL) || (c >= channels)) ? 0.0f : bias[c];
+        coeff[i] = bn_a / (weight_ratio_->data_[c] * ratio[i]);
+        offset[i] = (min[i] * kernel_sum_->data_[c] + bias_c) * bn_a + bn_b;
+      }
+    }
+    size_t input_image_size = height_padded * width_padded * channel_aligned_;
+#pragma omp parallel for collapse(2)
+    for (size_t n = 0; n < batch_size; ++n) {
+      for (size_t y = 0; y < height_out; ++y) {
+#ifdef _OPENMP
+        float *row = rows[omp_get_thread_num()];
+#else
+        float *row = rows[0];
+#endif
+        uint8_t *src = quantized_data + n * input_image_size +
+                       y * conv_kernel_desc.stride_h_ * width_padded * channel_aligned_;
+        depthwise::ConvRow(row, src, quantized_weight_->data_, channel_aligned_, width_padded, width_out,
+                           conv_kernel_desc.kernel_h_, conv_kernel_desc.kernel_w_, conv_kernel_desc.stride_w_,
+                           conv_kernel_desc.dilation_h_, conv_kernel_desc.dilation_w_, coeff + n * channel_aligned_,
+                           offset + n * channel_aligned_);
+        if (conv_kernel_desc.layout_ == NCHW) {
+          depthwise::CommitRow<NCHW>(out, row, residual, channels, channel_aligned_, height_out, width_out, n, y,
+                                     relu);
+        } else {
+          depthwise::CommitRow<NHWC>(out, row, residual, channels, channel_aligned_, height_out, width_out, n, y,
+                                     relu);
+        }
+      }
+    }
+  }
+
+ private:
+  size_t channel_aligned_;
+  float weight_threshold_;
+  float data_threshold_;
+  Tensor<int8_t> *quantized_weight_;
+  Tensor<float> *weight_ratio_;
+  Tensor<float> *kernel_sum_;
+};
+#endif
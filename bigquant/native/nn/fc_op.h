@@ -19,12 +19,35 @@
 
 #include "base_fc.h"
 #include "shuffle_fc.h"
+#include "../autotuner.h"
+#include "../thread_contexts.h"
+#include "../trace.h"
 
+// What one caller mutates while executing an FCOp, see ConvOpContext
+struct FCOpContext {
+  FCOpContext() : algo_context_(NULL), tuned_batch_size_(0) {
+  }
+
+  ~FCOpContext() {
+    delete algo_context_;
+  }
+
+  FCOpContext(const FCOpContext&) = delete;
+
+  FCOpContext& operator=(const FCOpContext&) = delete;
+
+  FCContext *algo_context_;
+  size_t tuned_batch_size_;
+  FCDataDesc data_desc_;
+};
+
+// Shares the packed weights between concurrent callers like ConvOp
 struct FCOp {
-  FCOp() : algo_id_(AUTO_SELECT_FC), algo_(NULL) {
+  FCOp() : algo_id_(AUTO_SELECT_FC), algo_(NULL), autotune_(false) {
   }
 
   ~FCOp() {
+    ReleaseContexts();
     delete algo_;
   }
 
@@ -37,12 +60,12 @@ struct FCOp {
     ChooseAlgo(algo);
   }
 
-  void SetupFCDataParameter(size_t batch_size, size_t channel_in) {
-    fc_data_desc_ = {batch_size, channel_in};
-  }
-
+  // SHUFFLE_FC is the only algorithm, so AUTO_SELECT_FC tunes its GEMM loop nest per batch size, see Autotune
   void ChooseAlgo(FC_ALGORITHM algo_id) {
-    algo_id_ = algo_id;
+    ReleaseContexts();
+    delete algo_;
+    autotune_ = (algo_id == AUTO_SELECT_FC);
+    algo_id_ = autotune_ ? SHUFFLE_FC : algo_id;
     switch (algo_id_) {
       case SHUFFLE_FC: {
         algo_ = new ShuffleFCAlgo();
@@ -53,21 +76,174 @@ struct FCOp {
         break;
       }
     }
+    algo_->SetInputRange(input_range_);
   }
 
   void InitWeight(float *weight) {
     algo_->InitWeight(weight, fc_kernel_desc_);
   }
 
+  // Static input quantization, see ConvOp::StartCalibration
+  void StartCalibration(CALIBRATION_MODE mode, float percentile) {
+    calibrator_.Start(mode, percentile);
+  }
+
+  void FinishCalibration() {
+    SetInputRange(calibrator_.Finish());
+  }
+
+  void SetInputRange(const StaticRange &range) {
+    input_range_ = range;
+    algo_->SetInputRange(range);
+  }
+
+  // See ConvOp::SavePacked
+  void SavePacked(PackedWriter &writer) {
+    writer.WriteSize(fc_kernel_desc_.layout_);
+    writer.WriteSize(fc_kernel_desc_.channel_out_);
+    writer.WriteSize(fc_kernel_desc_.channel_in_);
+    writer.WriteSize(autotune_ ? AUTO_SELECT_FC : algo_id_);
+    writer.WriteFloat(input_range_.min_);
+    writer.WriteFloat(input_range_.max_);
+    algo_->SavePacked(writer);
+  }
+
+  bool LoadPacked(PackedReader &reader) {
+    size_t layout = reader.ReadSize();
+    size_t channel_out = reader.ReadSize();
+    size_t channel_in = reader.ReadSize();
+    size_t algo_id = reader.ReadSize();
+    float min = reader.ReadFloat();
+    float max = reader.ReadFloat();
+    if (!reader.Ok() || (layout > NHWC) || (algo_id > SHUFFLE_FC)) {
+      return false;
+    }
+    SetupFCKernelParameter(static_cast<LAYOUT>(layout), channel_out, channel_in, static_cast<FC_ALGORITHM>(algo_id));
+    if (!algo_->LoadPacked(reader, fc_kernel_desc_)) {
+      return false;
+    }
+    SetInputRange(StaticRange(min, max));
+    packed_mapping_ = reader.mapping_;
+    return true;
+  }
+
+  FCOpContext *CreateContext() {
+    FCOpContext *context = new FCOpContext();
+    context->algo_context_ = algo_->CreateContext();
+    return context;
+  }
+
+  // The context of the calling thread, created on its first Execute
+  FCOpContext *ThreadContext() {
+    return contexts_.Local([this] { return CreateContext(); });
+  }
+
+  void ReleaseContexts() {
+    contexts_.Clear();
+  }
+
   void Execute(float *out, float *data, float *bias, size_t batch_size, size_t channel_in) {
-    SetupFCDataParameter(batch_size, channel_in);
-    algo_->Execute(out, data, bias, fc_data_desc_, fc_kernel_desc_);
+    if (calibrator_.Active()) {
+      calibrator_.Observe(data, batch_size * channel_in);
+    }
+    Execute(ThreadContext(), out, data, bias, batch_size, channel_in);
+  }
+
+  void Execute(FCOpContext *context, float *out, float *data, float *bias, size_t batch_size, size_t channel_in) {
+    PerfScope perf(PERF_FC_OP, 2ull * batch_size * fc_kernel_desc_.channel_out_ * fc_kernel_desc_.channel_in_);
+    perf.Arg("batch", batch_size).Arg("channel_in", channel_in).Arg("channel_out", fc_kernel_desc_.channel_out_);
+    context->data_desc_ = {batch_size, channel_in};
+    if (autotune_) {
+      Autotune(context, data, bias);
+    }
+    algo_->Execute(context->algo_context_, out, data, bias, context->data_desc_, fc_kernel_desc_);
+  }
+
+  // See ConvOp::WorkspaceSize
+  size_t WorkspaceSize(size_t batch_size, size_t channel_in) {
+    FCDataDesc fc_data_desc = {batch_size, channel_in};
+    return Workspace::AttachedSize(algo_->WorkspaceSize(fc_data_desc, fc_kernel_desc_));
+  }
+
+  // See ConvOp::ExecuteWithWorkspace
+  bool ExecuteWithWorkspace(void *workspace, size_t workspace_size, float *out, float *data, float *bias,
+                            size_t batch_size, size_t channel_in) {
+    if ((workspace == NULL) || (workspace_size < WorkspaceSize(batch_size, channel_in))) {
+      return false;
+    }
+    if (calibrator_.Active()) {
+      calibrator_.Observe(data, batch_size * channel_in);
+    }
+    FCOpContext *context = ThreadContext();
+    context->algo_context_->workspace_.Attach(workspace, workspace_size);
+    Execute(context, out, data, bias, batch_size, channel_in);
+    context->algo_context_->workspace_.Detach();
+    return true;
+  }
+
+  // Runs the layer once on synthetic input of the given batch size, see ConvOp::WarmUp
+  void WarmUp(size_t batch_size, size_t channel_in) {
+    std::vector<float> data(batch_size * channel_in);
+    for (size_t i = 0; i < data.size(); ++i) {
+      data[i] = static_cast<float>(i % 251) / 251.0f - 0.5f;
+    }
+    std::vector<float> out(batch_size * fc_kernel_desc_.channel_out_);
+    Execute(ThreadContext(), out.data(), data.data(), NULL, batch_size, channel_in);
+  }
+
+  std::string TuningKey(const FCDataDesc &fc_data_desc) {
+    std::ostringstream key;
+    key << TuningKeyPrefix("fc") << ":" << ((fc_kernel_desc_.layout_ == NCHW) ? "nchw" : "nhwc") << ":o"
+        << fc_kernel_desc_.channel_out_ << ":i" << fc_kernel_desc_.channel_in_ << ":n" << fc_data_desc.batch_size_;
+    return key.str();
+  }
+
+  // Batches up to FC_GEMV_MAX_BATCH run as a GEMV and have nothing to tune
+  void Autotune(FCOpContext *context, float *data, float *bias) {
+    const FCDataDesc &fc_data_desc = context->data_desc_;
+    if ((fc_data_desc.batch_size_ <= FC_GEMV_MAX_BATCH) || (context->tuned_batch_size_ == fc_data_desc.batch_size_)) {
+      return;
+    }
+    std::string key = TuningKey(fc_data_desc);
+    TuningRecord record;
+    if (!Autotuner::Instance().Lookup(key, record)) {
+      std::vector<float> scratch(fc_data_desc.batch_size_ * fc_kernel_desc_.channel_out_);
+      auto run = [&](const GemmTuning &tuning) {
+        context->algo_context_->gemm_tuning_ = tuning;
+        algo_->Execute(context->algo_context_, scratch.data(), data, bias, fc_data_desc, fc_kernel_desc_);
+      };
+      TraceScope trace("autotune", "op");
+      double time;
+      record.algo_ = SHUFFLE_FC;
+      record.gemm_ = SearchGemmTuning(run, time);
+      trace.Arg("algo", record.algo_).Arg("time_us", static_cast<uint64_t>(time));
+      Autotuner::Instance().Record(key, record);
+    }
+    context->algo_context_->gemm_tuning_ = record.gemm_;
+    context->tuned_batch_size_ = fc_data_desc.batch_size_;
+  }
+
+  // Only the workspace of the calling thread, see ConvOp::ShrinkWorkspace
+  void ShrinkWorkspace() {
+    FCOpContext *context = contexts_.Find();
+    if (context != NULL) {
+      context->algo_context_->workspace_.Shrink();
+    }
+  }
+
+  size_t WorkspaceSavedBytes() {
+    FCOpContext *context = contexts_.Find();
+    return (context == NULL) ? 0 : context->algo_context_->workspace_.SavedBytes();
   }
 
   FC_ALGORITHM algo_id_;
   BaseFCAlgo *algo_;
+  bool autotune_;
   FCKernelDesc fc_kernel_desc_;
-  FCDataDesc fc_data_desc_;
+  ActivationCalibrator calibrator_;
+  StaticRange input_range_;
+  ThreadContexts<FCOpContext> contexts_;
+  std::shared_ptr<PackedMapping> packed_mapping_;
 };
 
 #endif
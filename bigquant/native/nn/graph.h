@@ -0,0 +1,701 @@
+/*
+ * Copyright 2016 The BigDL Authors.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef NN_GRAPH_H
+#define NN_GRAPH_H
+
+#include "convolution_op.h"
+#include "fc_op.h"
+#include <fstream>
+#include <iomanip>
+
+typedef enum GRAPH_NODE { GRAPH_CONV = 0, GRAPH_FC, GRAPH_POOL, GRAPH_SUM, GRAPH_RELU } GRAPH_NODE;
+
+// Shape of one image of an activation, in the layout of the graph
+struct GraphTensor {
+  size_t channel_;
+  size_t height_;
+  size_t width_;
+
+  size_t Count() const {
+    return channel_ * height_ * width_;
+  }
+};
+
+struct GraphNode {
+  GraphNode() : conv_(NULL), fc_(NULL), relu_(false), max_pool_(false) {
+  }
+
+  ~GraphNode() {
+    delete conv_;
+    delete fc_;
+  }
+
+  GraphNode(const GraphNode&) = delete;
+
+  GraphNode& operator=(const GraphNode&) = delete;
+
+  GRAPH_NODE type_;
+  // conv: data and, with FUSION_SUM, the residual; sum: both operands
+  std::vector<size_t> inputs_;
+  size_t output_;
+
+  ConvOp *conv_;
+  FCOp *fc_;
+  std::vector<float> bias_;
+
+  bool relu_;
+  bool max_pool_;
+  size_t kernel_h_;
+  size_t kernel_w_;
+  size_t stride_h_;
+  size_t stride_w_;
+  size_t pad_h_;
+  size_t pad_w_;
+};
+
+// Where every activation of one batch size lives and in which type. Intermediates share a few slots of one buffer: a
+// slot is reused as soon as the last reader of the tensor in it has run. The graph input and output stay in the
+// caller's buffers.
+struct GraphPlan {
+  GraphPlan() : batch_size_(0), bytes_(0) {
+  }
+
+  size_t batch_size_;
+  size_t bytes_;
+  std::vector<size_t> slot_offset_;
+  // Slot of every tensor, -1 for the graph input and output
+  std::vector<int> tensor_slot_;
+  // Node reading the tensor as uint8, see Graph::PlanQuantizedEdges, -1 for a float tensor
+  std::vector<int> quantized_reader_;
+};
+
+struct GraphContext {
+  GraphPlan plan_;
+  Workspace activations_;
+};
+
+// An ordered list of layers run in one call. Tensor 0 is the graph input, every Add* returns the id of the tensor its
+// node produces and the last one added is the graph output. Execute may run concurrently from several threads like
+// ConvOp::Execute; the Add*, Setup* and calibration functions must not.
+struct Graph {
+  Graph(LAYOUT layout, size_t channel, size_t height, size_t width) : layout_(layout), calibrating_(false) {
+    tensors_.push_back({channel, height, width});
+  }
+
+  ~Graph() {
+    ReleaseContexts();
+    for (size_t i = 0; i < nodes_.size(); ++i) {
+      delete nodes_[i];
+    }
+  }
+
+  Graph(const Graph&) = delete;
+
+  Graph& operator=(const Graph&) = delete;
+
+  size_t AddNode(GraphNode *node, const GraphTensor &output) {
+    ReleaseContexts();
+    node->output_ = tensors_.size();
+    tensors_.push_back(output);
+    nodes_.push_back(node);
+    return node->output_;
+  }
+
+  size_t AddConv(size_t input, int residual, size_t channel_out, size_t group, size_t kernel_h, size_t kernel_w,
+                 size_t stride_h, size_t stride_w, size_t pad_h, size_t pad_w, size_t dilation_h, size_t dilation_w,
+                 size_t fusion_mask, float *weight, float *bias, CONV_ALGORITHM algo) {
+    assert(input < tensors_.size());
+    assert(((fusion_mask & FUSION_SUM) == 0) == (residual < 0));
+    const GraphTensor &in = tensors_[input];
+    GraphTensor out = {channel_out, GetConvOutSize(in.height_, kernel_h, stride_h, pad_h, dilation_h),
+                       GetConvOutSize(in.width_, kernel_w, stride_w, pad_w, dilation_w)};
+    GraphNode *node = new GraphNode();
+    node->type_ = GRAPH_CONV;
+    node->inputs_.push_back(input);
+    if (residual >= 0) {
+      assert((static_cast<size_t>(residual) < tensors_.size()) && (tensors_[residual].Count() == out.Count()));
+      node->inputs_.push_back(residual);
+    }
+    node->conv_ = new ConvOp();
+    node->conv_->SetupConvolutionParameter(layout_, channel_out, in.channel_, group, kernel_h, kernel_w, stride_h,
+                                           stride_w, pad_h, pad_w, dilation_h, dilation_w, fusion_mask, algo);
+    node->conv_->InitWeight(weight);
+    if (bias != NULL) {
+      node->bias_.assign(bias, bias + channel_out);
+    }
+    return AddNode(node, out);
+  }
+
+  void SetupConvBNParameter(size_t tensor, float *mean, float *variance, float *scale, float *shift, float eps) {
+    GraphNode *node = Producer(tensor);
+    assert(node->type_ == GRAPH_CONV);
+    node->conv_->SetupBNParameter(mean, variance, scale, shift, eps);
+  }
+
+  // The input is flattened in the layout of the graph, so the weight of an NHWC graph is in HWC order
+  size_t AddFC(size_t input, size_t channel_out, float *weight, float *bias, FC_ALGORITHM algo) {
+    assert(input < tensors_.size());
+    GraphNode *node = new GraphNode();
+    node->type_ = GRAPH_FC;
+    node->inputs_.push_back(input);
+    node->fc_ = new FCOp();
+    node->fc_->SetupFCKernelParameter(layout_, channel_out, tensors_[input].Count(), algo);
+    node->fc_->InitWeight(weight);
+    if (bias != NULL) {
+      node->bias_.assign(bias, bias + channel_out);
+    }
+    return AddNode(node, {channel_out, 1, 1});
+  }
+
+  size_t AddPool(size_t input, bool max_pool, size_t kernel_h, size_t kernel_w, size_t stride_h, size_t stride_w,
+                 size_t pad_h, size_t pad_w) {
+    assert(input < tensors_.size());
+    assert((pad_h < kernel_h) && (pad_w < kernel_w));
+    const GraphTensor &in = tensors_[input];
+    GraphNode *node = new GraphNode();
+    node->type_ = GRAPH_POOL;
+    node->inputs_.push_back(input);
+    node->max_pool_ = max_pool;
+    node->kernel_h_ = kernel_h;
+    node->kernel_w_ = kernel_w;
+    node->stride_h_ = stride_h;
+    node->stride_w_ = stride_w;
+    node->pad_h_ = pad_h;
+    node->pad_w_ = pad_w;
+    return AddNode(node, {in.channel_, GetConvOutSize(in.height_, kernel_h, stride_h, pad_h, 1),
+                          GetConvOutSize(in.width_, kernel_w, stride_w, pad_w, 1)});
+  }
+
+  size_t AddSum(size_t a, size_t b, bool relu) {
+    assert((a < tensors_.size()) && (b < tensors_.size()) && (tensors_[a].Count() == tensors_[b].Count()));
+    GraphNode *node = new GraphNode();
+    node->type_ = GRAPH_SUM;
+    node->inputs_.push_back(a);
+    node->inputs_.push_back(b);
+    node->relu_ = relu;
+    return AddNode(node, tensors_[a]);
+  }
+
+  size_t AddReLU(size_t input) {
+    assert(input < tensors_.size());
+    GraphNode *node = new GraphNode();
+    node->type_ = GRAPH_RELU;
+    node->inputs_.push_back(input);
+    return AddNode(node, tensors_[input]);
+  }
+
+  GraphNode *Producer(size_t tensor) {
+    assert((tensor > 0) && (tensor < tensors_.size()));
+    return nodes_[tensor - 1];
+  }
+
+  size_t OutputCount() {
+    return tensors_.back().Count();
+  }
+
+  // Input a node may overwrite with its output when it is the last reader of it, -1 if none. A uint8 output would
+  // overwrite the float residual faster than the epilogue reads it.
+  int InPlaceInput(GraphNode *node, const GraphPlan &plan) {
+    if (plan.quantized_reader_[node->output_] >= 0) {
+      return -1;
+    }
+    switch (node->type_) {
+      case GRAPH_CONV: {
+        // the residual is read after the GEMM, but not if it is also the data being convolved
+        return ((node->inputs_.size() == 2) && (node->inputs_[0] != node->inputs_[1])) ? 1 : -1;
+      }
+      case GRAPH_SUM:
+      case GRAPH_RELU: {
+        return 0;
+      }
+      default: {
+        return -1;
+      }
+    }
+  }
+
+  // A convolution hands its output to the next one as uint8, requantized by its GEMM epilogue, when that one is its
+  // only reader, takes it as data rather than as residual and has a static input range to requantize with. Everything
+  // else stays float, as does all of it while calibrating, which observes the float inputs.
+  void PlanQuantizedEdges(GraphPlan &plan) {
+    std::vector<size_t> readers(tensors_.size(), 0);
+    for (size_t i = 0; i < nodes_.size(); ++i) {
+      for (size_t j = 0; j < nodes_[i]->inputs_.size(); ++j) {
+        ++readers[nodes_[i]->inputs_[j]];
+      }
+    }
+    plan.quantized_reader_.assign(tensors_.size(), -1);
+    for (size_t i = 0; !calibrating_ && (i < nodes_.size()); ++i) {
+      GraphNode *node = nodes_[i];
+      size_t input = node->inputs_[0];
+      if ((node->type_ != GRAPH_CONV) || (input == 0) || (readers[input] != 1) ||
+          (node->conv_->QuantizedAlgo(node->conv_->algo_index_, true) < 0)) {
+        continue;
+      }
+      GraphNode *producer = Producer(input);
+      if ((producer->type_ == GRAPH_CONV) &&
+          (producer->conv_->QuantizedAlgo(producer->conv_->algo_index_, false) >= 0)) {
+        plan.quantized_reader_[input] = static_cast<int>(i);
+      }
+    }
+  }
+
+  // Greedy liveness planning in execution order. The output of a node writes in place of a dying input when the node
+  // allows it, else takes the smallest free slot that fits or grows the largest free one. The slots of the inputs read
+  // for the last time are released once the node has run. Slots are sized in bytes of the type of the tensor.
+  void BuildPlan(GraphPlan &plan, size_t batch_size) {
+    assert(!nodes_.empty());
+    PlanQuantizedEdges(plan);
+    size_t output = tensors_.size() - 1;
+    // a tensor nobody reads dies right after its producer
+    std::vector<size_t> last_use(tensors_.size(), 0);
+    for (size_t t = 1; t < tensors_.size(); ++t) {
+      last_use[t] = t - 1;
+    }
+    for (size_t i = 0; i < nodes_.size(); ++i) {
+      for (size_t j = 0; j < nodes_[i]->inputs_.size(); ++j) {
+        last_use[nodes_[i]->inputs_[j]] = i;
+      }
+    }
+    std::vector<size_t> slot_bytes;
+    std::vector<bool> slot_free;
+    plan.tensor_slot_.assign(tensors_.size(), -1);
+    for (size_t i = 0; i < nodes_.size(); ++i) {
+      GraphNode *node = nodes_[i];
+      size_t element = (plan.quantized_reader_[node->output_] >= 0) ? sizeof(uint8_t) : sizeof(float);
+      size_t bytes = Workspace::AlignedSize(element * batch_size * tensors_[node->output_].Count());
+      int slot = -1;
+      if (node->output_ != output) {
+        int in_place = InPlaceInput(node, plan);
+        bool reuse = (in_place >= 0) && (last_use[node->inputs_[in_place]] == i) &&
+                     (plan.tensor_slot_[node->inputs_[in_place]] >= 0);
+        int largest = -1;
+        if (reuse) {
+          slot = plan.tensor_slot_[node->inputs_[in_place]];
+        }
+        for (size_t s = 0; !reuse && (s < slot_bytes.size()); ++s) {
+          if (!slot_free[s]) {
+            continue;
+          }
+          if ((slot_bytes[s] >= bytes) && ((slot < 0) || (slot_bytes[s] < slot_bytes[slot]))) {
+            slot = static_cast<int>(s);
+          }
+          if ((largest < 0) || (slot_bytes[s] > slot_bytes[largest])) {
+            largest = static_cast<int>(s);
+          }
+        }
+        if (slot < 0) {
+          slot = largest;
+        }
+        if (slot < 0) {
+          slot = static_cast<int>(slot_bytes.size());
+          slot_bytes.push_back(0);
+          slot_free.push_back(true);
+        }
+        slot_bytes[slot] = std::max(slot_bytes[slot], bytes);
+        slot_free[slot] = false;
+        plan.tensor_slot_[node->output_] = slot;
+      }
+      for (size_t j = 0; j < node->inputs_.size(); ++j) {
+        int input_slot = plan.tensor_slot_[node->inputs_[j]];
+        if ((last_use[node->inputs_[j]] == i) && (input_slot >= 0) && (input_slot != slot)) {
+          slot_free[input_slot] = true;
+        }
+      }
+      if ((last_use[node->output_] == i) && (slot >= 0)) {
+        slot_free[slot] = true;
+      }
+    }
+    plan.slot_offset_.resize(slot_bytes.size());
+    plan.bytes_ = 0;
+    for (size_t s = 0; s < slot_bytes.size(); ++s) {
+      plan.slot_offset_[s] = plan.bytes_;
+      plan.bytes_ += slot_bytes[s];
+    }
+    plan.batch_size_ = batch_size;
+  }
+
+  void Execute(float *out, float *data, size_t batch_size) {
+    Execute(ThreadContext(), out, data, batch_size);
+  }
+
+  // Counts time and calls only; the operations are counted by the convolutions and FCs it runs
+  void Execute(GraphContext *context, float *out, float *data, size_t batch_size) {
+    PerfScope perf(PERF_GRAPH);
+    perf.Arg("batch", batch_size);
+    GraphPlan &plan = context->plan_;
+    if (plan.batch_size_ != batch_size) {
+      BuildPlan(plan, batch_size);
+    }
+    context->activations_.Reserve(plan.bytes_);
+    int8_t *base = context->activations_.Allocate<int8_t>(plan.bytes_);
+    auto tensor = [&](size_t t) {
+      if (t == 0) {
+        return data;
+      }
+      if (t == tensors_.size() - 1) {
+        return out;
+      }
+      return reinterpret_cast<float *>(base + plan.slot_offset_[plan.tensor_slot_[t]]);
+    };
+    for (size_t i = 0; i < nodes_.size(); ++i) {
+      GraphNode *node = nodes_[i];
+#ifdef TIME_PROFILE
+      auto start = std::chrono::system_clock::now();
+#endif
+      const GraphTensor &in = tensors_[node->inputs_[0]];
+      const GraphTensor &result = tensors_[node->output_];
+      float *src = tensor(node->inputs_[0]);
+      float *dst = tensor(node->output_);
+      float *bias = node->bias_.empty() ? NULL : node->bias_.data();
+      switch (node->type_) {
+        case GRAPH_CONV: {
+          float *residual = (node->inputs_.size() == 2) ? tensor(node->inputs_[1]) : NULL;
+          int reader = plan.quantized_reader_[node->output_];
+          bool quantized = (plan.quantized_reader_[node->inputs_[0]] >= 0);
+          if ((reader < 0) && !quantized) {
+            node->conv_->Execute(dst, src, bias, residual, batch_size, in.channel_, in.height_, in.width_);
+            break;
+          }
+          shuffle::Requantization requant;
+          if (reader >= 0) {
+            requant = nodes_[reader]->conv_->InputRequantization(reinterpret_cast<uint8_t *>(dst));
+          }
+          node->conv_->ExecuteQuantized(dst, (reader >= 0) ? &requant : NULL, src,
+                                        quantized ? reinterpret_cast<uint8_t *>(src) : NULL, bias, residual,
+                                        batch_size, in.channel_, in.height_, in.width_);
+          break;
+        }
+        case GRAPH_FC: {
+          node->fc_->Execute(dst, src, bias, batch_size, in.Count());
+          break;
+        }
+        case GRAPH_POOL: {
+          if (layout_ == NCHW) {
+            pool::Pool<NCHW>(dst, src, batch_size, in.channel_, in.height_, in.width_, result.height_, result.width_,
+                             node->kernel_h_, node->kernel_w_, node->stride_h_, node->stride_w_, node->pad_h_,
+                             node->pad_w_, node->max_pool_);
+          } else {
+            pool::Pool<NHWC>(dst, src, batch_size, in.channel_, in.height_, in.width_, result.height_, result.width_,
+                             node->kernel_h_, node->kernel_w_, node->stride_h_, node->stride_w_, node->pad_h_,
+                             node->pad_w_, node->max_pool_);
+          }
+          break;
+        }
+        case GRAPH_SUM: {
+          eltwise::Sum(dst, src, tensor(node->inputs_[1]), batch_size * result.Count(), node->relu_);
+          break;
+        }
+        case GRAPH_RELU: {
+          eltwise::ReLU(dst, src, batch_size * result.Count());
+          break;
+        }
+      }
+#ifdef TIME_PROFILE
+      auto end = std::chrono::system_clock::now();
+      std::cerr << "graph node " << i << " type " << node->type_ << " "
+                << std::chrono::duration_cast<std::chrono::microseconds>(end - start).count() << "us" << std::endl;
+#endif
+    }
+  }
+
+  // The plans are dropped whenever the input ranges may change, since they decide which edges are uint8
+  void StartCalibration(CALIBRATION_MODE mode, float percentile) {
+    ReleaseContexts();
+    calibrating_ = true;
+    for (size_t i = 0; i < nodes_.size(); ++i) {
+      if (nodes_[i]->conv_ != NULL) {
+        nodes_[i]->conv_->StartCalibration(mode, percentile);
+      } else if (nodes_[i]->fc_ != NULL) {
+        nodes_[i]->fc_->StartCalibration(mode, percentile);
+      }
+    }
+  }
+
+  void FinishCalibration() {
+    ReleaseContexts();
+    calibrating_ = false;
+    for (size_t i = 0; i < nodes_.size(); ++i) {
+      if (nodes_[i]->conv_ != NULL) {
+        nodes_[i]->conv_->FinishCalibration();
+      } else if (nodes_[i]->fc_ != NULL) {
+        nodes_[i]->fc_->FinishCalibration();
+      }
+    }
+  }
+
+  // One "tensor min max" line per layer with a static input range, keyed by the tensor the layer produces. Returns the
+  // number of layers written, or -1 if the file cannot be opened.
+  int SaveCalibration(const char *path) {
+    std::ofstream out(path, std::ios::trunc);
+    if (!out) {
+      return -1;
+    }
+    int count = 0;
+    out << std::setprecision(9);
+    for (size_t i = 0; i < nodes_.size(); ++i) {
+      GraphNode *node = nodes_[i];
+      if ((node->conv_ == NULL) && (node->fc_ == NULL)) {
+        continue;
+      }
+      const StaticRange &range = (node->conv_ != NULL) ? node->conv_->input_range_ : node->fc_->input_range_;
+      if (range.Enabled()) {
+        out << node->output_ << " " << range.min_ << " " << range.max_ << std::endl;
+        ++count;
+      }
+    }
+    return count;
+  }
+
+  // Lines naming no convolution or FC of this graph are skipped, like the comments and blank lines
+  int LoadCalibration(const char *path) {
+    std::ifstream in(path);
+    if (!in) {
+      return -1;
+    }
+    ReleaseContexts();
+    int count = 0;
+    std::string line;
+    while (std::getline(in, line)) {
+      if (line.empty() || (line[0] == '#')) {
+        continue;
+      }
+      std::istringstream fields(line);
+      size_t tensor;
+      float min, max;
+      fields >> tensor >> min >> max;
+      if (fields.fail() || (tensor == 0) || (tensor >= tensors_.size())) {
+        continue;
+      }
+      GraphNode *node = Producer(tensor);
+      if (node->conv_ != NULL) {
+        node->conv_->SetInputRange(StaticRange(min, max));
+      } else if (node->fc_ != NULL) {
+        node->fc_->SetInputRange(StaticRange(min, max));
+      } else {
+        continue;
+      }
+      ++count;
+    }
+    return count;
+  }
+
+  // The input shape, then every node with its inputs, output shape, bias and layer, see packed_model.h
+  void SavePacked(PackedWriter &writer) {
+    writer.WriteSize(layout_);
+    writer.WriteSize(tensors_[0].channel_);
+    writer.WriteSize(tensors_[0].height_);
+    writer.WriteSize(tensors_[0].width_);
+    writer.WriteSize(nodes_.size());
+    for (size_t i = 0; i < nodes_.size(); ++i) {
+      GraphNode *node = nodes_[i];
+      const GraphTensor &out = tensors_[node->output_];
+      writer.WriteSize(node->type_);
+      writer.WriteSize(node->inputs_.size());
+      for (size_t j = 0; j < node->inputs_.size(); ++j) {
+        writer.WriteSize(node->inputs_[j]);
+      }
+      writer.WriteSize(out.channel_);
+      writer.WriteSize(out.height_);
+      writer.WriteSize(out.width_);
+      Tensor<float> bias(make_shape(node->bias_.size()), node->bias_.data());
+      writer.WriteTensor(node->bias_.empty() ? NULL : &bias);
+      switch (node->type_) {
+        case GRAPH_CONV: {
+          node->conv_->SavePacked(writer);
+          break;
+        }
+        case GRAPH_FC: {
+          node->fc_->SavePacked(writer);
+          break;
+        }
+        case GRAPH_POOL: {
+          size_t fields[] = {node->max_pool_, node->kernel_h_, node->kernel_w_, node->stride_h_, node->stride_w_,
+                             node->pad_h_, node->pad_w_};
+          for (size_t j = 0; j < sizeof(fields) / sizeof(fields[0]); ++j) {
+            writer.WriteSize(fields[j]);
+          }
+          break;
+        }
+        case GRAPH_SUM: {
+          writer.WriteSize(node->relu_);
+          break;
+        }
+        case GRAPH_RELU: {
+          break;
+        }
+      }
+    }
+  }
+
+  // NULL if the record is damaged or was written by another build
+  static Graph *LoadPacked(PackedReader &reader) {
+    size_t layout = reader.ReadSize();
+    size_t channel = reader.ReadSize();
+    size_t height = reader.ReadSize();
+    size_t width = reader.ReadSize();
+    size_t nodes = reader.ReadSize();
+    if (!reader.Ok() || (layout > NHWC) || (channel == 0) || (height == 0) || (width == 0)) {
+      return NULL;
+    }
+    Graph *graph = new Graph(static_cast<LAYOUT>(layout), channel, height, width);
+    for (size_t i = 0; i < nodes; ++i) {
+      if (!graph->LoadPackedNode(reader)) {
+        delete graph;
+        return NULL;
+      }
+    }
+    return graph;
+  }
+
+  bool LoadPackedNode(PackedReader &reader) {
+    size_t type = reader.ReadSize();
+    size_t inputs = reader.ReadSize();
+    if (!reader.Ok() || (type > GRAPH_RELU) || (inputs == 0) || (inputs > 2)) {
+      return false;
+    }
+    GraphNode *node = new GraphNode();
+    node->type_ = static_cast<GRAPH_NODE>(type);
+    for (size_t j = 0; j < inputs; ++j) {
+      node->inputs_.push_back(reader.ReadSize());
+    }
+    GraphTensor out;
+    out.channel_ = reader.ReadSize();
+    out.height_ = reader.ReadSize();
+    out.width_ = reader.ReadSize();
+    Tensor<float> *bias = reader.ReadOptionalTensor<float>(out.channel_);
+    if (bias != NULL) {
+      node->bias_.assign(bias->data_, bias->data_ + out.channel_);
+      delete bias;
+    }
+    bool ok = reader.Ok();
+    for (size_t j = 0; j < inputs; ++j) {
+      ok = ok && (node->inputs_[j] < tensors_.size());
+    }
+    switch (node->type_) {
+      case GRAPH_CONV: {
+        node->conv_ = new ConvOp();
+        ok = ok && node->conv_->LoadPacked(reader) && (node->conv_->conv_kernel_desc_.layout_ == layout_);
+        break;
+      }
+      case GRAPH_FC: {
+        node->fc_ = new FCOp();
+        ok = ok && node->fc_->LoadPacked(reader) && (node->fc_->fc_kernel_desc_.layout_ == layout_);
+        break;
+      }
+      case GRAPH_POOL: {
+        node->max_pool_ = (reader.ReadSize() != 0);
+        node->kernel_h_ = reader.ReadSize();
+        node->kernel_w_ = reader.ReadSize();
+        node->stride_h_ = reader.ReadSize();
+        node->stride_w_ = reader.ReadSize();
+        node->pad_h_ = reader.ReadSize();
+        node->pad_w_ = reader.ReadSize();
+        break;
+      }
+      case GRAPH_SUM: {
+        node->relu_ = (reader.ReadSize() != 0);
+        break;
+      }
+      case GRAPH_RELU: {
+        break;
+      }
+    }
+    // the recorded output has to be the one the Add* function of the node computes from its inputs
+    GraphTensor expected;
+    ok = ok && reader.Ok() && PackedNodeOutput(node, expected) && (expected.channel_ == out.channel_) &&
+         (expected.height_ == out.height_) && (expected.width_ == out.width_);
+    if (!ok) {
+      delete node;
+      return false;
+    }
+    AddNode(node, out);
+    return true;
+  }
+
+  // Whether a window of kernel taps dilation apart, moved by stride, fits the padded input at least once
+  static bool WindowFits(size_t in, size_t kernel, size_t stride, size_t pad, size_t dilation) {
+    return (kernel > 0) && (stride > 0) && (dilation > 0) && (dilation * (kernel - 1) + 1 <= in + 2 * pad);
+  }
+
+  // Output shape of a loaded node, computed from its inputs and layer as AddConv, AddFC, AddPool, AddSum and AddReLU
+  // do. false if no Add* function accepts the node, e.g. a pool with a stride of 0 or a residual of another size.
+  bool PackedNodeOutput(const GraphNode *node, GraphTensor &out) {
+    const GraphTensor &in = tensors_[node->inputs_[0]];
+    size_t inputs = node->inputs_.size();
+    switch (node->type_) {
+      case GRAPH_CONV: {
+        const ConvolutionKernelDesc &desc = node->conv_->conv_kernel_desc_;
+        if ((desc.channel_in_ != in.channel_) || ((inputs == 2) != ((desc.fusion_mask_ & FUSION_SUM) != 0)) ||
+            !WindowFits(in.height_, desc.kernel_h_, desc.stride_h_, desc.pad_h_, desc.dilation_h_) ||
+            !WindowFits(in.width_, desc.kernel_w_, desc.stride_w_, desc.pad_w_, desc.dilation_w_)) {
+          return false;
+        }
+        out = {desc.channel_out_, GetConvOutSize(in.height_, desc.kernel_h_, desc.stride_h_, desc.pad_h_,
+                                                 desc.dilation_h_),
+               GetConvOutSize(in.width_, desc.kernel_w_, desc.stride_w_, desc.pad_w_, desc.dilation_w_)};
+        return (inputs == 1) || (tensors_[node->inputs_[1]].Count() == out.Count());
+      }
+      case GRAPH_FC: {
+        out = {node->fc_->fc_kernel_desc_.channel_out_, 1, 1};
+        return (inputs == 1) && (node->fc_->fc_kernel_desc_.channel_in_ == in.Count());
+      }
+      case GRAPH_POOL: {
+        if ((inputs != 1) || (node->pad_h_ >= node->kernel_h_) || (node->pad_w_ >= node->kernel_w_) ||
+            !WindowFits(in.height_, node->kernel_h_, node->stride_h_, node->pad_h_, 1) ||
+            !WindowFits(in.width_, node->kernel_w_, node->stride_w_, node->pad_w_, 1)) {
+          return false;
+        }
+        out = {in.channel_, GetConvOutSize(in.height_, node->kernel_h_, node->stride_h_, node->pad_h_, 1),
+               GetConvOutSize(in.width_, node->kernel_w_, node->stride_w_, node->pad_w_, 1)};
+        return true;
+      }
+      case GRAPH_SUM: {
+        out = in;
+        return (inputs == 2) && (tensors_[node->inputs_[1]].Count() == in.Count());
+      }
+      case GRAPH_RELU: {
+        out = in;
+        return inputs == 1;
+      }
+    }
+    return false;
+  }
+
+  // Bytes of intermediate activations the plan for batch_size needs
+  size_t ActivationBytes(size_t batch_size) {
+    GraphPlan plan;
+    BuildPlan(plan, batch_size);
+    return plan.bytes_;
+  }
+
+  GraphContext *ThreadContext() {
+    return contexts_.Local([] { return new GraphContext(); });
+  }
+
+  void ReleaseContexts() {
+    contexts_.Clear();
+  }
+
+  LAYOUT layout_;
+  std::vector<GraphTensor> tensors_;
+  std::vector<GraphNode *> nodes_;
+  bool calibrating_;
+  ThreadContexts<GraphContext> contexts_;
+};
+
+#endif
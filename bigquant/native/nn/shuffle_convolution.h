@@ -18,19 +18,42 @@
 #define NN_SHUFFLE_CONVOLUTION_H
 #include "base_convolution.h"
 
+// Quantized im2col data and the GEMM plan of the last input shape run with this context
+struct ShuffleConvolutionContext : public ConvolutionContext {
+  ShuffleConvolutionContext() {
+  }
+
+  ~ShuffleConvolutionContext() {
+    for (size_t g = 0; g < quantized_data_.size(); ++g) {
+      delete quantized_data_[g];
+    }
+  }
+
+  std::vector<QuantizedTensor<float, uint8_t> *> quantized_data_;
+  shuffle::GemmPlan gemm_plan_;
+
+  size_t height_out_;
+  size_t width_out_;
+  size_t gemm_n_;
+  size_t aligned_gemm_n_;
+};
+
 struct ShuffleConvolutionAlgo : public BaseConvolutionAlgo {
-  ShuffleConvolutionAlgo(const ConvolutionKernelDesc &conv_kernel_desc) : internal_layout_(NHWC) {
+  // implicit_gemm streams the im2col matrix through per-thread panels instead of materializing it, see RunImplicit
+  ShuffleConvolutionAlgo(const ConvolutionKernelDesc &conv_kernel_desc, bool implicit_gemm = false)
+      : internal_layout_(NHWC), implicit_gemm_(implicit_gemm) {
     weight_threshold_ = 64.0f;
     data_threshold_ = 127.0f;
     transformed_kernel_ = NULL;
     sum_per_channel_out_ = NULL;
-    data_workspace_ = NULL;
   }
 
   ~ShuffleConvolutionAlgo() {
-    size_t group = group_weight_.size();
-    for (size_t g = 0; g < group; ++g) {
+    // a loaded algorithm has no float group weights
+    for (size_t g = 0; g < group_weight_.size(); ++g) {
       delete group_weight_[g];
+    }
+    for (size_t g = 0; g < quantized_weight_.size(); ++g) {
       delete quantized_weight_[g];
     }
     if (transformed_kernel_) {
@@ -67,16 +90,20 @@ struct ShuffleConvolutionAlgo : public BaseConvolutionAlgo {
         conv_kernel_desc.channel_in_per_group_ * conv_kernel_desc.kernel_h_ * conv_kernel_desc.kernel_w_);
   }
 
+  void SetGemmShape(const ConvolutionKernelDesc &conv_kernel_desc) {
+    gemm_m_ = conv_kernel_desc.channel_out_per_group_;
+    gemm_k_ = conv_kernel_desc.channel_in_per_group_ * conv_kernel_desc.kernel_h_ * conv_kernel_desc.kernel_w_;
+    aligned_gemm_m_ = GetAlignmentLength(gemm_m_, CONV_SHUFFLE_KERNEL_M);
+    aligned_gemm_k_ = GetAlignmentLength(gemm_k_, CONV_SHUFFLE_KERNEL_K);
+  }
+
   void InitWeight(float *weight, ConvolutionKernelDesc &conv_kernel_desc) {
     ComputeKernelSum(weight, conv_kernel_desc);
     if (conv_kernel_desc.layout_ != internal_layout_) {
       KernelLayoutTransform(weight, conv_kernel_desc);
       weight = transformed_kernel_->data_;
     }
-    gemm_m_ = conv_kernel_desc.channel_out_per_group_;
-    gemm_k_ = conv_kernel_desc.channel_in_per_group_ * conv_kernel_desc.kernel_h_ * conv_kernel_desc.kernel_w_;
-    aligned_gemm_m_ = GetAlignmentLength(gemm_m_, CONV_SHUFFLE_KERNEL_M);
-    aligned_gemm_k_ = GetAlignmentLength(gemm_k_, CONV_SHUFFLE_KERNEL_K);
+    SetGemmShape(conv_kernel_desc);
     group_weight_.resize(conv_kernel_desc.group_);
     quantized_weight_.resize(conv_kernel_desc.group_);
     for (size_t g = 0; g < conv_kernel_desc.group_; ++g) {
@@ -109,26 +136,79 @@ struct ShuffleConvolutionAlgo : public BaseConvolutionAlgo {
       }
     }
     QuantizeKernel(weight_threshold_);
+    // grouped convolutions run on ConvShuffleGroupGEMM, which reads the original
+    if (NumaEnabled() && (conv_kernel_desc.group_ == 1)) {
+      weight_replicas_.ReplicateTensor(quantized_weight_[0], aligned_gemm_m_ * aligned_gemm_k_);
+    }
   }
 
-  void InitData(float *srcdata, ConvolutionDataDesc &conv_data_desc, ConvolutionKernelDesc &conv_kernel_desc,
-                float sw_threshold, bool layout_transform) {
-    // Allocate Memory
-    height_out_ = GetConvOutSize(conv_data_desc.height_in_, conv_kernel_desc.kernel_h_, conv_kernel_desc.stride_h_,
-                                 conv_kernel_desc.pad_h_, conv_kernel_desc.dilation_h_);
-    width_out_ = GetConvOutSize(conv_data_desc.width_in_, conv_kernel_desc.kernel_w_, conv_kernel_desc.stride_w_,
-                                conv_kernel_desc.pad_w_, conv_kernel_desc.dilation_w_);
-    gemm_n_ = conv_data_desc.batch_size_ * height_out_ * width_out_;
-    aligned_gemm_n_ = GetAlignmentLength(gemm_n_, CONV_SHUFFLE_KERNEL_N);
-    quantized_data_.resize(conv_kernel_desc.group_);
+  void SavePackedWeight(PackedWriter &writer) {
+    writer.WriteTensor(sum_per_channel_out_);
+    for (size_t g = 0; g < quantized_weight_.size(); ++g) {
+      writer.WriteTensor(quantized_weight_[g]);
+      writer.WriteTensor(&quantized_weight_[g]->min_);
+      writer.WriteTensor(&quantized_weight_[g]->max_);
+      writer.WriteTensor(&quantized_weight_[g]->ratio_);
+    }
+  }
+
+  bool LoadPackedWeight(PackedReader &reader, const ConvolutionKernelDesc &conv_kernel_desc) {
+    SetGemmShape(conv_kernel_desc);
+    sum_per_channel_out_ = new Tensor<float>(Shape());
+    reader.ReadTensor(*sum_per_channel_out_, conv_kernel_desc.channel_out_);
+    quantized_weight_.resize(conv_kernel_desc.group_);
     for (size_t g = 0; g < conv_kernel_desc.group_; ++g) {
-      quantized_data_[g] = new QuantizedTensor<float, uint8_t>(make_shape(aligned_gemm_n_, aligned_gemm_k_),
-                                                               make_shape(gemm_n_), make_shape(gemm_n_, gemm_k_), 64);
+      quantized_weight_[g] = new QuantizedTensor<float, int8_t>(Shape(), Shape(), make_shape(gemm_m_, gemm_k_));
+      reader.ReadTensor<int8_t>(*quantized_weight_[g], aligned_gemm_m_ * aligned_gemm_k_);
+      reader.ReadTensor(quantized_weight_[g]->min_, gemm_m_);
+      reader.ReadTensor(quantized_weight_[g]->max_, gemm_m_);
+      reader.ReadTensor(quantized_weight_[g]->ratio_, gemm_m_);
+    }
+    if (reader.Ok() && NumaEnabled() && (conv_kernel_desc.group_ == 1)) {
+      weight_replicas_.ReplicateTensor(quantized_weight_[0], aligned_gemm_m_ * aligned_gemm_k_);
+    }
+    return reader.Ok();
+  }
+
+  ConvolutionContext *CreateContext() {
+    return new ShuffleConvolutionContext();
+  }
+
+  // quantized is the input already quantized with the static range, else NULL and srcdata is quantized here
+  void InitData(ShuffleConvolutionContext *context, float *srcdata, const uint8_t *quantized,
+                const ConvolutionDataDesc &conv_data_desc, const ConvolutionKernelDesc &conv_kernel_desc,
+                float sw_threshold, bool layout_transform) {
+    // Carve buffers out of the workspace
+    context->height_out_ = GetConvOutSize(conv_data_desc.height_in_, conv_kernel_desc.kernel_h_,
+                                          conv_kernel_desc.stride_h_, conv_kernel_desc.pad_h_,
+                                          conv_kernel_desc.dilation_h_);
+    context->width_out_ = GetConvOutSize(conv_data_desc.width_in_, conv_kernel_desc.kernel_w_,
+                                         conv_kernel_desc.stride_w_, conv_kernel_desc.pad_w_,
+                                         conv_kernel_desc.dilation_w_);
+    size_t gemm_n = conv_data_desc.batch_size_ * context->height_out_ * context->width_out_;
+    size_t aligned_gemm_n = GetAlignmentLength(gemm_n, CONV_SHUFFLE_KERNEL_N);
+    context->gemm_n_ = gemm_n;
+    context->aligned_gemm_n_ = aligned_gemm_n;
+    size_t data_count = conv_data_desc.batch_size_ * conv_data_desc.height_in_ * conv_data_desc.width_in_ *
+                        conv_data_desc.channel_in_;
+    Workspace &workspace = context->workspace_;
+    workspace.Reserve(GetWorkspaceSize(conv_data_desc, conv_kernel_desc, gemm_n, layout_transform));
+    std::vector<QuantizedTensor<float, uint8_t> *> &quantized_data_tensor = context->quantized_data_;
+    if (quantized_data_tensor.size() != conv_kernel_desc.group_) {
+      quantized_data_tensor.resize(conv_kernel_desc.group_);
+      for (size_t g = 0; g < conv_kernel_desc.group_; ++g) {
+        quantized_data_tensor[g] = new QuantizedTensor<float, uint8_t>(Shape(), Shape(), Shape());
+      }
     }
-    if (layout_transform) {
-      data_workspace_ = new Tensor<float>(make_shape(conv_data_desc.batch_size_, conv_data_desc.height_in_,
-                                                     conv_data_desc.width_in_, conv_data_desc.channel_in_),
-                                          64);
+    for (size_t g = 0; g < conv_kernel_desc.group_; ++g) {
+      QuantizedTensor<float, uint8_t> *p = quantized_data_tensor[g];
+      p->shape_ = make_shape(aligned_gemm_n, aligned_gemm_k_);
+      p->ori_shape_ = make_shape(gemm_n, gemm_k_);
+      p->min_.shape_ = p->max_.shape_ = p->ratio_.shape_ = make_shape(gemm_n);
+      p->SetData(workspace.Allocate<uint8_t>(aligned_gemm_n * aligned_gemm_k_));
+      p->min_.SetData(workspace.Allocate<float>(gemm_n));
+      p->max_.SetData(workspace.Allocate<float>(gemm_n));
+      p->ratio_.SetData(workspace.Allocate<float>(gemm_n));
     }
     // Init data
     std::vector<uint8_t *> quantized_data(conv_kernel_desc.group_);
@@ -136,86 +216,351 @@ struct ShuffleConvolutionAlgo : public BaseConvolutionAlgo {
     std::vector<float *> max(conv_kernel_desc.group_);
     std::vector<float *> ratio(conv_kernel_desc.group_);
     for (size_t g = 0; g < conv_kernel_desc.group_; ++g) {
-      quantized_data[g] = quantized_data_[g]->data_;
-      min[g] = quantized_data_[g]->min_.data_;
-      max[g] = quantized_data_[g]->max_.data_;
-      ratio[g] = quantized_data_[g]->ratio_.data_;
+      quantized_data[g] = quantized_data_tensor[g]->data_;
+      min[g] = quantized_data_tensor[g]->min_.data_;
+      max[g] = quantized_data_tensor[g]->max_.data_;
+      ratio[g] = quantized_data_tensor[g]->ratio_.data_;
     }
-#ifdef TIME_PROFILE
-    auto start = std::chrono::system_clock::now();
-#endif
-    if (conv_kernel_desc.layout_ == NCHW && layout_transform == false) {
-      shuffle::PadQuantizeShuffleIm2colWrapper<float, NCHW>(
-          srcdata, conv_data_desc.batch_size_, conv_kernel_desc.channel_in_per_group_, conv_kernel_desc.group_,
-          conv_data_desc.height_in_, conv_data_desc.width_in_, conv_kernel_desc.kernel_h_, conv_kernel_desc.kernel_w_,
-          conv_kernel_desc.pad_h_, conv_kernel_desc.pad_w_, conv_kernel_desc.stride_h_, conv_kernel_desc.stride_w_,
-          conv_kernel_desc.dilation_h_, conv_kernel_desc.dilation_w_, quantized_data.data(), min.data(), max.data(),
-          ratio.data(), data_workspace_->data_, sw_threshold, layout_transform);
+    if (input_range_.Enabled()) {
+      for (size_t g = 0; g < conv_kernel_desc.group_; ++g) {
+        input_range_.FillPixelRanges(min[g], max[g], ratio[g], gemm_n, sw_threshold);
+      }
+      uint8_t *quantized_input = workspace.Allocate<uint8_t>(data_count);
+      float scale = input_range_.Scale(sw_threshold);
+      float zero_point = input_range_.ZeroPoint(sw_threshold);
+      if ((quantized != NULL) && (conv_kernel_desc.layout_ == NCHW)) {
+        shuffle::StaticShuffleIm2colWrapper<NCHW>(
+            quantized, conv_data_desc.batch_size_, conv_kernel_desc.channel_in_per_group_, conv_kernel_desc.group_,
+            conv_data_desc.height_in_, conv_data_desc.width_in_, conv_kernel_desc.kernel_h_, conv_kernel_desc.kernel_w_,
+            conv_kernel_desc.pad_h_, conv_kernel_desc.pad_w_, conv_kernel_desc.stride_h_, conv_kernel_desc.stride_w_,
+            conv_kernel_desc.dilation_h_, conv_kernel_desc.dilation_w_, quantized_data.data(),
+            static_cast<uint8_t>(zero_point));
+      } else if (quantized != NULL) {
+        shuffle::StaticShuffleIm2colWrapper<NHWC>(
+            quantized, conv_data_desc.batch_size_, conv_kernel_desc.channel_in_per_group_, conv_kernel_desc.group_,
+            conv_data_desc.height_in_, conv_data_desc.width_in_, conv_kernel_desc.kernel_h_, conv_kernel_desc.kernel_w_,
+            conv_kernel_desc.pad_h_, conv_kernel_desc.pad_w_, conv_kernel_desc.stride_h_, conv_kernel_desc.stride_w_,
+            conv_kernel_desc.dilation_h_, conv_kernel_desc.dilation_w_, quantized_data.data(),
+            static_cast<uint8_t>(zero_point));
+      } else if (conv_kernel_desc.layout_ == NCHW) {
+        shuffle::StaticQuantizeShuffleIm2colWrapper<NCHW>(
+            srcdata, conv_data_desc.batch_size_, conv_kernel_desc.channel_in_per_group_, conv_kernel_desc.group_,
+            conv_data_desc.height_in_, conv_data_desc.width_in_, conv_kernel_desc.kernel_h_, conv_kernel_desc.kernel_w_,
+            conv_kernel_desc.pad_h_, conv_kernel_desc.pad_w_, conv_kernel_desc.stride_h_, conv_kernel_desc.stride_w_,
+            conv_kernel_desc.dilation_h_, conv_kernel_desc.dilation_w_, quantized_data.data(), scale, zero_point,
+            quantized_input, sw_threshold);
+      } else {
+        shuffle::StaticQuantizeShuffleIm2colWrapper<NHWC>(
+            srcdata, conv_data_desc.batch_size_, conv_kernel_desc.channel_in_per_group_, conv_kernel_desc.group_,
+            conv_data_desc.height_in_, conv_data_desc.width_in_, conv_kernel_desc.kernel_h_, conv_kernel_desc.kernel_w_,
+            conv_kernel_desc.pad_h_, conv_kernel_desc.pad_w_, conv_kernel_desc.stride_h_, conv_kernel_desc.stride_w_,
+            conv_kernel_desc.dilation_h_, conv_kernel_desc.dilation_w_, quantized_data.data(), scale, zero_point,
+            quantized_input, sw_threshold);
+      }
     } else {
-      shuffle::PadQuantizeShuffleIm2colWrapper<float, NHWC>(
-          srcdata, conv_data_desc.batch_size_, conv_kernel_desc.channel_in_per_group_, conv_kernel_desc.group_,
-          conv_data_desc.height_in_, conv_data_desc.width_in_, conv_kernel_desc.kernel_h_, conv_kernel_desc.kernel_w_,
-          conv_kernel_desc.pad_h_, conv_kernel_desc.pad_w_, conv_kernel_desc.stride_h_, conv_kernel_desc.stride_w_,
-          conv_kernel_desc.dilation_h_, conv_kernel_desc.dilation_w_, quantized_data.data(), min.data(), max.data(),
-          ratio.data(), NULL, sw_threshold, layout_transform);
-    }
-
-#ifdef TIME_PROFILE
-    auto end = std::chrono::system_clock::now();
-    auto diff = std::chrono::duration_cast<std::chrono::microseconds>(end - start);
-    std::cerr << "im2col " << diff.count() << "us" << std::endl;
-#endif
+      size_t threads = GetThreadsNumWrapper();
+      size_t scratch_size = GetIm2colScratchSize(conv_data_desc, conv_kernel_desc, layout_transform);
+      std::vector<float *> scratch(threads);
+      for (size_t t = 0; t < threads; ++t) {
+        scratch[t] = workspace.Allocate<float>(scratch_size);
+      }
+      if (conv_kernel_desc.layout_ == NCHW && layout_transform == false) {
+        shuffle::PadQuantizeShuffleIm2colWrapper<float, NCHW>(
+            srcdata, conv_data_desc.batch_size_, conv_kernel_desc.channel_in_per_group_, conv_kernel_desc.group_,
+            conv_data_desc.height_in_, conv_data_desc.width_in_, conv_kernel_desc.kernel_h_, conv_kernel_desc.kernel_w_,
+            conv_kernel_desc.pad_h_, conv_kernel_desc.pad_w_, conv_kernel_desc.stride_h_, conv_kernel_desc.stride_w_,
+            conv_kernel_desc.dilation_h_, conv_kernel_desc.dilation_w_, quantized_data.data(), min.data(), max.data(),
+            ratio.data(), scratch.data(), sw_threshold, layout_transform);
+      } else {
+        shuffle::PadQuantizeShuffleIm2colWrapper<float, NHWC>(
+            srcdata, conv_data_desc.batch_size_, conv_kernel_desc.channel_in_per_group_, conv_kernel_desc.group_,
+            conv_data_desc.height_in_, conv_data_desc.width_in_, conv_kernel_desc.kernel_h_, conv_kernel_desc.kernel_w_,
+            conv_kernel_desc.pad_h_, conv_kernel_desc.pad_w_, conv_kernel_desc.stride_h_, conv_kernel_desc.stride_w_,
+            conv_kernel_desc.dilation_h_, conv_kernel_desc.dilation_w_, quantized_data.data(), min.data(), max.data(),
+            ratio.data(), scratch.data(), sw_threshold, layout_transform);
+      }
+    }
+  }
+
+  // Follows the path Run takes
+  size_t WorkspaceSize(const ConvolutionDataDesc &conv_data_desc, const ConvolutionKernelDesc &conv_kernel_desc) {
+    if (implicit_gemm_ && !input_range_.Enabled()) {
+      return GetThreadsNumWrapper() * GetImplicitWorkspaceSize(GetImplicitPanelSize());
+    }
+    size_t height_out = GetConvOutSize(conv_data_desc.height_in_, conv_kernel_desc.kernel_h_,
+                                       conv_kernel_desc.stride_h_, conv_kernel_desc.pad_h_,
+                                       conv_kernel_desc.dilation_h_);
+    size_t width_out = GetConvOutSize(conv_data_desc.width_in_, conv_kernel_desc.kernel_w_, conv_kernel_desc.stride_w_,
+                                      conv_kernel_desc.pad_w_, conv_kernel_desc.dilation_w_);
+    return GetWorkspaceSize(conv_data_desc, conv_kernel_desc, conv_data_desc.batch_size_ * height_out * width_out,
+                            conv_kernel_desc.layout_ != internal_layout_);
+  }
+
+  void Execute(ConvolutionContext *context, float *out, float *data, float *bias, float *residual,
+               const ConvolutionDataDesc &conv_data_desc, const ConvolutionKernelDesc &conv_kernel_desc) {
+    Run(static_cast<ShuffleConvolutionContext *>(context), out, NULL, data, NULL, bias, residual, conv_data_desc,
+        conv_kernel_desc);
+  }
+
+  bool SupportsRequantization() const {
+    return true;
+  }
+
+  void ExecuteRequantized(ConvolutionContext *context, const shuffle::Requantization &requant, float *data,
+                          float *bias, float *residual, const ConvolutionDataDesc &conv_data_desc,
+                          const ConvolutionKernelDesc &conv_kernel_desc) {
+    Run(static_cast<ShuffleConvolutionContext *>(context), NULL, &requant, data, NULL, bias, residual, conv_data_desc,
+        conv_kernel_desc);
+  }
+
+  // Only a static input range fixes the quantization a producer has to match
+  bool SupportsQuantizedInput() const {
+    return input_range_.Enabled();
+  }
+
+  shuffle::Requantization InputRequantization(uint8_t *dst) const {
+    float scale = input_range_.Scale(data_threshold_);
+    shuffle::Requantization requant = {dst, scale, input_range_.ZeroPoint(data_threshold_), data_threshold_};
+    return requant;
   }
 
-  void Execute(float *out, float *data, float *bias, ConvolutionDataDesc &conv_data_desc,
-               ConvolutionKernelDesc &conv_kernel_desc) {
-    // Allocate memory
+  void ExecuteQuantizedInput(ConvolutionContext *context, float *out, const shuffle::Requantization *requant,
+                             const uint8_t *data, float *bias, float *residual,
+                             const ConvolutionDataDesc &conv_data_desc, const ConvolutionKernelDesc &conv_kernel_desc) {
+    assert(input_range_.Enabled());
+    Run(static_cast<ShuffleConvolutionContext *>(context), out, requant, NULL, data, bias, residual, conv_data_desc,
+        conv_kernel_desc);
+  }
+
+  // Writes either the float output or, with requant, its uint8 requantization. The input is data, or with a static
+  // input range quantized when it is already quantized.
+  void Run(ShuffleConvolutionContext *ctx, float *out, const shuffle::Requantization *requant, float *data,
+           const uint8_t *quantized, float *bias, float *residual, const ConvolutionDataDesc &conv_data_desc,
+           const ConvolutionKernelDesc &conv_kernel_desc) {
+    bool relu = (conv_kernel_desc.fusion_mask_ & FUSION_RELU) != 0;
+    bool bn = (conv_kernel_desc.fusion_mask_ & FUSION_BN) != 0;
+    assert(!bn || (bn_mean_ != NULL));
+    assert(((conv_kernel_desc.fusion_mask_ & FUSION_SUM) == 0) || (residual != NULL));
+    if ((conv_kernel_desc.fusion_mask_ & FUSION_SUM) == 0) {
+      residual = NULL;
+    }
+    // a static input range quantizes the whole input up front, so it keeps the materialized im2col
+    if (implicit_gemm_ && !input_range_.Enabled()) {
+      RunImplicit(ctx, out, requant, data, bias, residual, relu, bn, conv_data_desc, conv_kernel_desc);
+      return;
+    }
     bool transpose_data = (conv_kernel_desc.layout_ != internal_layout_) ? true : false;
-    InitData(data, conv_data_desc, conv_kernel_desc, data_threshold_, transpose_data);
+    InitData(ctx, data, quantized, conv_data_desc, conv_kernel_desc, data_threshold_, transpose_data);
+    if (conv_kernel_desc.group_ > 1) {
+      ExecuteGroups(ctx, out, requant, bias, residual, relu, bn, conv_data_desc, conv_kernel_desc);
+      return;
+    }
+    size_t gemm_n = ctx->gemm_n_;
+    size_t aligned_gemm_n = ctx->aligned_gemm_n_;
     // Run
     for (size_t g = 0; g < conv_kernel_desc.group_; ++g) {
-#ifdef TIME_PROFILE
-      auto start = std::chrono::system_clock::now();
-#endif
-      float *tempbias = (bias == NULL) ? bias : bias + g * conv_kernel_desc.channel_out_per_group_;
+      QuantizedTensor<float, uint8_t> *quantized_data = ctx->quantized_data_[g];
+      size_t channel_offset = g * conv_kernel_desc.channel_out_per_group_;
+      float *tempbias = (bias == NULL) ? bias : bias + channel_offset;
+      float *mean = bn ? bn_mean_->data_ + channel_offset : NULL;
+      float *variance_coeff = bn ? bn_variance_coeff_->data_ + channel_offset : NULL;
+      float *scale = (bn && bn_scale_ != NULL) ? bn_scale_->data_ + channel_offset : NULL;
+      float *shift = (bn && bn_shift_ != NULL) ? bn_shift_->data_ + channel_offset : NULL;
       if (conv_kernel_desc.layout_ == NCHW) {
         shuffle::ConvShuffleGEMM<CONV_SHUFFLE_KERNEL_M, CONV_SHUFFLE_KERNEL_N, CONV_SHUFFLE_KERNEL_K, NCHW>(
-            quantized_weight_[g]->data_, quantized_data_[g]->data_, out, aligned_gemm_m_, aligned_gemm_n_,
-            aligned_gemm_k_, quantized_weight_[g]->ratio_.data_, quantized_data_[g]->ratio_.data_,
-            sum_per_channel_out_->data_ + g * conv_kernel_desc.channel_out_per_group_, quantized_data_[g]->min_.data_,
+            quantized_weight_[g]->data_, quantized_data->data_, out, aligned_gemm_m_, aligned_gemm_n,
+            aligned_gemm_k_, quantized_weight_[g]->ratio_.data_, quantized_data->ratio_.data_,
+            sum_per_channel_out_->data_ + g * conv_kernel_desc.channel_out_per_group_, quantized_data->min_.data_,
             tempbias, conv_data_desc.batch_size_, conv_kernel_desc.group_,
-            conv_kernel_desc.channel_out_ / conv_kernel_desc.group_, g, height_out_, width_out_, 0.5,
-            aligned_gemm_m_ - gemm_m_, aligned_gemm_n_ - gemm_n_);
+            conv_kernel_desc.channel_out_ / conv_kernel_desc.group_, g, ctx->height_out_, ctx->width_out_, 0.5,
+            aligned_gemm_m_ - gemm_m_, aligned_gemm_n - gemm_n, relu && !bn, bn && !relu, bn && relu, false, mean,
+            variance_coeff, scale, shift, residual, &ctx->gemm_tuning_, &ctx->gemm_plan_, &weight_replicas_,
+            requant);
       } else {
         shuffle::ConvShuffleGEMM<CONV_SHUFFLE_KERNEL_M, CONV_SHUFFLE_KERNEL_N, CONV_SHUFFLE_KERNEL_K, NHWC>(
-            quantized_weight_[g]->data_, quantized_data_[g]->data_, out, aligned_gemm_m_, aligned_gemm_n_,
-            aligned_gemm_k_, quantized_weight_[g]->ratio_.data_, quantized_data_[g]->ratio_.data_,
-            sum_per_channel_out_->data_ + g * conv_kernel_desc.channel_out_per_group_, quantized_data_[g]->min_.data_,
+            quantized_weight_[g]->data_, quantized_data->data_, out, aligned_gemm_m_, aligned_gemm_n,
+            aligned_gemm_k_, quantized_weight_[g]->ratio_.data_, quantized_data->ratio_.data_,
+            sum_per_channel_out_->data_ + g * conv_kernel_desc.channel_out_per_group_, quantized_data->min_.data_,
             tempbias, conv_data_desc.batch_size_, conv_kernel_desc.group_,
-            conv_kernel_desc.channel_out_ / conv_kernel_desc.group_, g, height_out_, width_out_, 0.5,
-            aligned_gemm_m_ - gemm_m_, aligned_gemm_n_ - gemm_n_);
+            conv_kernel_desc.channel_out_ / conv_kernel_desc.group_, g, ctx->height_out_, ctx->width_out_, 0.5,
+            aligned_gemm_m_ - gemm_m_, aligned_gemm_n - gemm_n, relu && !bn, bn && !relu, bn && relu, false, mean,
+            variance_coeff, scale, shift, residual, &ctx->gemm_tuning_, &ctx->gemm_plan_, &weight_replicas_,
+            requant);
       }
-#ifdef TIME_PROFILE
-      auto end = std::chrono::system_clock::now();
-      auto diff = std::chrono::duration_cast<std::chrono::microseconds>(end - start);
-      std::cerr << aligned_gemm_m_ << "," << aligned_gemm_n_ << "," << aligned_gemm_k_ << ",";
-      std::cerr << diff.count() << "us, "
-                << (2.0 * aligned_gemm_m_ * aligned_gemm_n_ * aligned_gemm_k_) / diff.count() / 1.0e3 << " glops"
-                << std::endl;
+    }
+  }
 
+  // Implicit GEMM: the team shares the list of (panel, group) tasks. A thread quantizes the im2col rows of its panel
+  // into its own L2-sized buffer and multiplies them right away, so the workspace is a few panels per thread, however
+  // large the input is.
+  void RunImplicit(ShuffleConvolutionContext *ctx, float *out, const shuffle::Requantization *requant, float *data,
+                   float *bias, float *residual, bool relu, bool bn, const ConvolutionDataDesc &conv_data_desc,
+                   const ConvolutionKernelDesc &conv_kernel_desc) {
+    size_t group = conv_kernel_desc.group_;
+    size_t channel_per_group = conv_kernel_desc.channel_out_per_group_;
+    size_t height_out = GetConvOutSize(conv_data_desc.height_in_, conv_kernel_desc.kernel_h_,
+                                       conv_kernel_desc.stride_h_, conv_kernel_desc.pad_h_,
+                                       conv_kernel_desc.dilation_h_);
+    size_t width_out = GetConvOutSize(conv_data_desc.width_in_, conv_kernel_desc.kernel_w_, conv_kernel_desc.stride_w_,
+                                      conv_kernel_desc.pad_w_, conv_kernel_desc.dilation_w_);
+    size_t gemm_n = conv_data_desc.batch_size_ * height_out * width_out;
+    size_t aligned_gemm_n = GetAlignmentLength(gemm_n, CONV_SHUFFLE_KERNEL_N);
+    size_t panel_n = GetImplicitPanelSize();
+    size_t panels = (aligned_gemm_n + panel_n - 1) / panel_n;
+    size_t threads = GetThreadsNumWrapper();
+    Workspace &workspace = ctx->workspace_;
+    workspace.Reserve(threads * GetImplicitWorkspaceSize(panel_n));
+    std::vector<uint8_t *> panel(threads);
+    std::vector<float *> min(threads);
+    std::vector<float *> max(threads);
+    std::vector<float *> ratio(threads);
+    std::vector<float *> patch(threads);
+    for (size_t t = 0; t < threads; ++t) {
+      panel[t] = workspace.Allocate<uint8_t>(panel_n * aligned_gemm_k_);
+      min[t] = workspace.Allocate<float>(panel_n);
+      max[t] = workspace.Allocate<float>(panel_n);
+      ratio[t] = workspace.Allocate<float>(panel_n);
+      patch[t] = workspace.Allocate<float>(gemm_k_);
+    }
+    // the panels are quantized inside the GEMM tasks, so PERF_GEMM includes their im2col
+    PerfScope perf(PERF_GEMM, 2ull * group * gemm_m_ * gemm_n * gemm_k_);
+#pragma omp parallel for schedule(dynamic) proc_bind(close)
+    for (size_t task = 0; task < panels * group; ++task) {
+#ifdef _OPENMP
+      size_t t = omp_get_thread_num();
+#else
+      size_t t = 0;
 #endif
+      // the groups of a panel are consecutive tasks, so they find its input pixels still cached
+      size_t g = task % group;
+      size_t begin = task / group * panel_n;
+      size_t pad_end = std::min(begin + panel_n, aligned_gemm_n);
+      size_t end = std::min(pad_end, gemm_n);
+      if (conv_kernel_desc.layout_ == NCHW) {
+        shuffle::PadQuantizeShufflePanelWrapper<float, NCHW>(
+            data, conv_kernel_desc.channel_in_per_group_, group, g, conv_data_desc.height_in_,
+            conv_data_desc.width_in_, conv_kernel_desc.kernel_h_, conv_kernel_desc.kernel_w_, conv_kernel_desc.pad_h_,
+            conv_kernel_desc.pad_w_, conv_kernel_desc.stride_h_, conv_kernel_desc.stride_w_,
+            conv_kernel_desc.dilation_h_, conv_kernel_desc.dilation_w_, height_out, width_out, begin, end, pad_end,
+            panel[t], min[t], max[t], ratio[t], patch[t], data_threshold_);
+      } else {
+        shuffle::PadQuantizeShufflePanelWrapper<float, NHWC>(
+            data, conv_kernel_desc.channel_in_per_group_, group, g, conv_data_desc.height_in_,
+            conv_data_desc.width_in_, conv_kernel_desc.kernel_h_, conv_kernel_desc.kernel_w_, conv_kernel_desc.pad_h_,
+            conv_kernel_desc.pad_w_, conv_kernel_desc.stride_h_, conv_kernel_desc.stride_w_,
+            conv_kernel_desc.dilation_h_, conv_kernel_desc.dilation_w_, height_out, width_out, begin, end, pad_end,
+            panel[t], min[t], max[t], ratio[t], patch[t], data_threshold_);
+      }
+      size_t channel_offset = g * channel_per_group;
+      // only the weight of a single group is replicated, see InitWeight
+      int8_t *weight =
+          (group == 1) ? weight_replicas_.Local(quantized_weight_[0]->data_) : quantized_weight_[g]->data_;
+      float *tempbias = (bias == NULL) ? bias : bias + channel_offset;
+      float *mean = bn ? bn_mean_->data_ + channel_offset : NULL;
+      float *variance_coeff = bn ? bn_variance_coeff_->data_ + channel_offset : NULL;
+      float *scale = (bn && bn_scale_ != NULL) ? bn_scale_->data_ + channel_offset : NULL;
+      float *shift = (bn && bn_shift_ != NULL) ? bn_shift_->data_ + channel_offset : NULL;
+      if (conv_kernel_desc.layout_ == NCHW) {
+        shuffle::ConvShufflePanelGEMM<CONV_SHUFFLE_KERNEL_M, CONV_SHUFFLE_KERNEL_N, CONV_SHUFFLE_KERNEL_K, NCHW>(
+            weight, panel[t], out, aligned_gemm_m_, aligned_gemm_n, aligned_gemm_k_, begin, pad_end,
+            quantized_weight_[g]->ratio_.data_, ratio[t], sum_per_channel_out_->data_ + channel_offset, min[t],
+            tempbias, group, channel_per_group, g, height_out, width_out, 0.5, aligned_gemm_m_ - gemm_m_,
+            aligned_gemm_n - gemm_n, relu && !bn, bn && !relu, bn && relu, false, mean, variance_coeff, scale, shift,
+            residual, requant);
+      } else {
+        shuffle::ConvShufflePanelGEMM<CONV_SHUFFLE_KERNEL_M, CONV_SHUFFLE_KERNEL_N, CONV_SHUFFLE_KERNEL_K, NHWC>(
+            weight, panel[t], out, aligned_gemm_m_, aligned_gemm_n, aligned_gemm_k_, begin, pad_end,
+            quantized_weight_[g]->ratio_.data_, ratio[t], sum_per_channel_out_->data_ + channel_offset, min[t],
+            tempbias, group, channel_per_group, g, height_out, width_out, 0.5, aligned_gemm_m_ - gemm_m_,
+            aligned_gemm_n - gemm_n, relu && !bn, bn && !relu, bn && relu, false, mean, variance_coeff, scale, shift,
+            residual, requant);
+      }
     }
-    FreeMemory(conv_kernel_desc);
   }
 
-  void FreeMemory(ConvolutionKernelDesc &conv_kernel_desc) {
-    for (size_t g = 0; g < conv_kernel_desc.group_; ++g) {
-      delete quantized_data_[g];
+  // Output pixels per panel of RunImplicit: as many kernel_n rows of the im2col matrix as fit in half of L2
+  size_t GetImplicitPanelSize() {
+    size_t rows = GetBlockNum(GetCacheTopology().l2_size_, aligned_gemm_k_);
+    return std::max(rows / CONV_SHUFFLE_KERNEL_N, static_cast<size_t>(1)) * CONV_SHUFFLE_KERNEL_N;
+  }
+
+  // Per-thread bytes of RunImplicit: a panel, its pixel ranges and one float patch
+  size_t GetImplicitWorkspaceSize(size_t panel_n) {
+    return Workspace::AlignedSize(sizeof(uint8_t) * panel_n * aligned_gemm_k_) +
+           3 * Workspace::AlignedSize(sizeof(float) * panel_n) + Workspace::AlignedSize(sizeof(float) * gemm_k_);
+  }
+
+  // All groups share one parallel region, see shuffle::ConvShuffleGroupGEMM
+  void ExecuteGroups(ShuffleConvolutionContext *context, float *out, const shuffle::Requantization *requant,
+                     float *bias, float *residual, bool relu, bool bn, const ConvolutionDataDesc &conv_data_desc,
+                     const ConvolutionKernelDesc &conv_kernel_desc) {
+    size_t group = conv_kernel_desc.group_;
+    size_t gemm_n = context->gemm_n_;
+    size_t aligned_gemm_n = context->aligned_gemm_n_;
+    std::vector<int8_t *> weight(group);
+    std::vector<uint8_t *> quantized_data(group);
+    std::vector<float *> ratio_a(group);
+    std::vector<float *> ratio_b(group);
+    std::vector<float *> min_b(group);
+    for (size_t g = 0; g < group; ++g) {
+      weight[g] = quantized_weight_[g]->data_;
+      quantized_data[g] = context->quantized_data_[g]->data_;
+      ratio_a[g] = quantized_weight_[g]->ratio_.data_;
+      ratio_b[g] = context->quantized_data_[g]->ratio_.data_;
+      min_b[g] = context->quantized_data_[g]->min_.data_;
+    }
+    float *mean = bn ? bn_mean_->data_ : NULL;
+    float *variance_coeff = bn ? bn_variance_coeff_->data_ : NULL;
+    float *scale = (bn && bn_scale_ != NULL) ? bn_scale_->data_ : NULL;
+    float *shift = (bn && bn_shift_ != NULL) ? bn_shift_->data_ : NULL;
+    if (conv_kernel_desc.layout_ == NCHW) {
+      shuffle::ConvShuffleGroupGEMM<CONV_SHUFFLE_KERNEL_M, CONV_SHUFFLE_KERNEL_N, CONV_SHUFFLE_KERNEL_K, NCHW>(
+          weight.data(), quantized_data.data(), out, aligned_gemm_m_, aligned_gemm_n, aligned_gemm_k_, ratio_a.data(),
+          ratio_b.data(), sum_per_channel_out_->data_, min_b.data(), bias, conv_data_desc.batch_size_, group,
+          conv_kernel_desc.channel_out_per_group_, context->height_out_, context->width_out_, 0.5,
+          aligned_gemm_m_ - gemm_m_, aligned_gemm_n - gemm_n, relu && !bn, bn && !relu, bn && relu, false, mean,
+          variance_coeff, scale, shift, residual, requant);
+    } else {
+      shuffle::ConvShuffleGroupGEMM<CONV_SHUFFLE_KERNEL_M, CONV_SHUFFLE_KERNEL_N, CONV_SHUFFLE_KERNEL_K, NHWC>(
+          weight.data(), quantized_data.data(), out, aligned_gemm_m_, aligned_gemm_n, aligned_gemm_k_, ratio_a.data(),
+          ratio_b.data(), sum_per_channel_out_->data_, min_b.data(), bias, conv_data_desc.batch_size_, group,
+          conv_kernel_desc.channel_out_per_group_, context->height_out_, context->width_out_, 0.5,
+          aligned_gemm_m_ - gemm_m_, aligned_gemm_n - gemm_n, relu && !bn, bn && !relu, bn && relu, false, mean,
+          variance_coeff, scale, shift, residual, requant);
+    }
+  }
+
+  size_t GetWorkspaceSize(const ConvolutionDataDesc &conv_data_desc, const ConvolutionKernelDesc &conv_kernel_desc,
+                          size_t gemm_n, bool layout_transform) {
+    size_t group = conv_kernel_desc.group_;
+    size_t aligned_gemm_n = GetAlignmentLength(gemm_n, CONV_SHUFFLE_KERNEL_N);
+    size_t size = group * (Workspace::AlignedSize(sizeof(uint8_t) * aligned_gemm_n * aligned_gemm_k_) +
+                           3 * Workspace::AlignedSize(sizeof(float) * gemm_n));
+    if (input_range_.Enabled()) {
+      size_t data_count = conv_data_desc.batch_size_ * conv_data_desc.height_in_ * conv_data_desc.width_in_ *
+                          conv_data_desc.channel_in_;
+      size += Workspace::AlignedSize(sizeof(uint8_t) * data_count);
+    } else {
+      size += GetThreadsNumWrapper() *
+              Workspace::AlignedSize(sizeof(float) * GetIm2colScratchSize(conv_data_desc, conv_kernel_desc,
+                                                                          layout_transform));
     }
-    if (data_workspace_) {
-      delete data_workspace_;
-      data_workspace_ = NULL;
+    return size;
+  }
+
+  // Per-thread floats of the dynamic im2col, none for the pointwise NHWC one
+  size_t GetIm2colScratchSize(const ConvolutionDataDesc &conv_data_desc, const ConvolutionKernelDesc &conv_kernel_desc,
+                              bool layout_transform) {
+    bool pointwise = (conv_kernel_desc.kernel_h_ == 1) && (conv_kernel_desc.kernel_w_ == 1) &&
+                     (conv_kernel_desc.stride_h_ == 1) && (conv_kernel_desc.stride_w_ == 1) &&
+                     (conv_kernel_desc.pad_h_ == 0) && (conv_kernel_desc.pad_w_ == 0);
+    if (pointwise && !layout_transform) {
+      return 0;
     }
+    return shuffle::PadQuantizeShuffleNHWCIm2colScratchSize<float>(
+        conv_data_desc.batch_size_, conv_kernel_desc.channel_in_per_group_, conv_kernel_desc.group_,
+        conv_data_desc.height_in_, conv_data_desc.width_in_, conv_kernel_desc.kernel_h_, conv_kernel_desc.pad_h_,
+        conv_kernel_desc.stride_h_, conv_kernel_desc.dilation_h_, layout_transform);
   }
 
  private:
@@ -223,16 +568,14 @@ struct ShuffleConvolutionAlgo : public BaseConvolutionAlgo {
   Tensor<float> *sum_per_channel_out_;
   std::vector<Tensor<float> *> group_weight_;
   std::vector<QuantizedTensor<float, int8_t> *> quantized_weight_;
-  Tensor<float> *data_workspace_;
-  std::vector<QuantizedTensor<float, uint8_t> *> quantized_data_;
+  NumaReplicas<int8_t> weight_replicas_;
 
   const LAYOUT internal_layout_;
+  const bool implicit_gemm_;
 
   size_t gemm_m_;
-  size_t gemm_n_;
   size_t gemm_k_;
   size_t aligned_gemm_m_;
-  size_t aligned_gemm_n_;
   size_t aligned_gemm_k_;
 
   float weight_threshold_;
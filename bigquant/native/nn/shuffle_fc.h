@@ -19,10 +19,26 @@
 
 #include "base_fc.h"
 
+// Quantized input and the GEMM plan of the last batch size run with this context
+struct ShuffleFCContext : public FCContext {
+  ShuffleFCContext() {
+    quantized_data_ = new QuantizedTensor<float, uint8_t>(Shape(), Shape(), Shape());
+  }
+
+  ~ShuffleFCContext() {
+    delete quantized_data_;
+  }
+
+  QuantizedTensor<float, uint8_t> *quantized_data_;
+  shuffle::GemmPlan gemm_plan_;
+};
+
 struct ShuffleFCAlgo : public BaseFCAlgo {
   ShuffleFCAlgo() {
     weight_threshold_ = 64.0f;
     data_threshold_ = 127.0f;
+    sum_per_channel_out_ = NULL;
+    quantized_kernel_ = NULL;
   }
 
   ~ShuffleFCAlgo() {
@@ -36,11 +52,15 @@ struct ShuffleFCAlgo : public BaseFCAlgo {
     }
   }
 
-  void InitWeight(float *weight, FCKernelDesc &fc_kernel_desc) {
+  void SetGemmShape(const FCKernelDesc &fc_kernel_desc) {
     fc_m_ = fc_kernel_desc.channel_out_;
     fc_k_ = fc_kernel_desc.channel_in_;
     aligned_fc_m_ = GetAlignmentLength(fc_m_, FC_SHUFFLE_KERNEL_M);
     aligned_fc_k_ = GetAlignmentLength(fc_k_, FC_SHUFFLE_KERNEL_K);
+  }
+
+  void InitWeight(float *weight, FCKernelDesc &fc_kernel_desc) {
+    SetGemmShape(fc_kernel_desc);
 
     sum_per_channel_out_ = new Tensor<float>(make_shape(fc_kernel_desc.channel_out_), 64);
     ComputeMatrixSumPerRow<float>(sum_per_channel_out_->data_, weight, fc_kernel_desc.channel_out_,
@@ -50,45 +70,129 @@ struct ShuffleFCAlgo : public BaseFCAlgo {
     shuffle::PadQuantizeShuffle2D<float, FC_SHUFFLE_KERNEL_M, FC_SHUFFLE_KERNEL_K>(
         quantized_kernel_->data_, fc_m_, fc_k_, aligned_fc_m_, aligned_fc_k_, weight, quantized_kernel_->min_.data_,
         quantized_kernel_->max_.data_, quantized_kernel_->ratio_.data_, weight_threshold_);
+    if (NumaEnabled()) {
+      weight_replicas_.ReplicateTensor(quantized_kernel_, aligned_fc_m_ * aligned_fc_k_);
+    }
   }
 
-  void Execute(float *out, float *data, float *bias, FCDataDesc &fc_data_desc, FCKernelDesc &fc_kernel_desc) {
-    fc_n_ = fc_data_desc.batch_size_;
-    aligned_fc_n_ = GetAlignmentLength(fc_n_, FC_SHUFFLE_KERNEL_N);
-    quantized_data_ = new QuantizedTensor<float, uint8_t>(make_shape(aligned_fc_n_, aligned_fc_k_), make_shape(fc_n_),
-                                                          make_shape(fc_n_, fc_k_), 64);
+  void SavePacked(PackedWriter &writer) {
+    writer.WriteTensor(sum_per_channel_out_);
+    writer.WriteTensor(quantized_kernel_);
+    writer.WriteTensor(&quantized_kernel_->min_);
+    writer.WriteTensor(&quantized_kernel_->max_);
+    writer.WriteTensor(&quantized_kernel_->ratio_);
+  }
+
+  bool LoadPacked(PackedReader &reader, const FCKernelDesc &fc_kernel_desc) {
+    SetGemmShape(fc_kernel_desc);
+    sum_per_channel_out_ = new Tensor<float>(Shape());
+    quantized_kernel_ = new QuantizedTensor<float, int8_t>(Shape(), Shape(), make_shape(fc_m_, fc_k_));
+    reader.ReadTensor(*sum_per_channel_out_, fc_m_);
+    reader.ReadTensor<int8_t>(*quantized_kernel_, aligned_fc_m_ * aligned_fc_k_);
+    reader.ReadTensor(quantized_kernel_->min_, fc_m_);
+    reader.ReadTensor(quantized_kernel_->max_, fc_m_);
+    reader.ReadTensor(quantized_kernel_->ratio_, fc_m_);
+    if (reader.Ok() && NumaEnabled()) {
+      weight_replicas_.ReplicateTensor(quantized_kernel_, aligned_fc_m_ * aligned_fc_k_);
+    }
+    return reader.Ok();
+  }
 
-    shuffle::PadQuantizeShuffle2D<float, FC_SHUFFLE_KERNEL_N, FC_SHUFFLE_KERNEL_K>(
-        quantized_data_->data_, fc_n_, fc_k_, aligned_fc_n_, aligned_fc_k_, data, quantized_data_->min_.data_,
-        quantized_data_->max_.data_, quantized_data_->ratio_.data_, data_threshold_);
+  FCContext *CreateContext() {
+    return new ShuffleFCContext();
+  }
+
+  void Execute(FCContext *context, float *out, float *data, float *bias, const FCDataDesc &fc_data_desc,
+               const FCKernelDesc &fc_kernel_desc) {
+    ShuffleFCContext *ctx = static_cast<ShuffleFCContext *>(context);
+    size_t fc_n = fc_data_desc.batch_size_;
+    if (fc_n <= FC_GEMV_MAX_BATCH) {
+      ExecuteGEMV(ctx, out, data, bias, fc_n);
+      return;
+    }
+    size_t aligned_fc_n = GetAlignmentLength(fc_n, FC_SHUFFLE_KERNEL_N);
+    QuantizedTensor<float, uint8_t> *quantized_data = InitData(ctx, fc_n, aligned_fc_n);
+    QuantizeData<FC_SHUFFLE_KERNEL_N>(quantized_data, data, fc_n, aligned_fc_n);
     if (fc_kernel_desc.layout_ == NCHW) {
       shuffle::ConvShuffleGEMM<FC_SHUFFLE_KERNEL_M, FC_SHUFFLE_KERNEL_N, FC_SHUFFLE_KERNEL_K, NCHW>(
-          quantized_kernel_->data_, quantized_data_->data_, out, aligned_fc_m_, aligned_fc_n_, aligned_fc_k_,
-          quantized_kernel_->ratio_.data_, quantized_data_->ratio_.data_, sum_per_channel_out_->data_,
-          quantized_data_->min_.data_, bias, fc_data_desc.batch_size_, 1, fc_kernel_desc.channel_out_, 0, 1, 1, 0.5,
-          aligned_fc_m_ - fc_m_, aligned_fc_n_ - fc_n_, false);
+          quantized_kernel_->data_, quantized_data->data_, out, aligned_fc_m_, aligned_fc_n, aligned_fc_k_,
+          quantized_kernel_->ratio_.data_, quantized_data->ratio_.data_, sum_per_channel_out_->data_,
+          quantized_data->min_.data_, bias, fc_data_desc.batch_size_, 1, fc_kernel_desc.channel_out_, 0, 1, 1, 0.5,
+          aligned_fc_m_ - fc_m_, aligned_fc_n - fc_n, false, false, false, false, NULL, NULL, NULL, NULL, NULL,
+          &ctx->gemm_tuning_, &ctx->gemm_plan_, &weight_replicas_);
     } else {
       shuffle::ConvShuffleGEMM<FC_SHUFFLE_KERNEL_M, FC_SHUFFLE_KERNEL_N, FC_SHUFFLE_KERNEL_K, NHWC>(
-          quantized_kernel_->data_, quantized_data_->data_, out, aligned_fc_m_, aligned_fc_n_, aligned_fc_k_,
-          quantized_kernel_->ratio_.data_, quantized_data_->ratio_.data_, sum_per_channel_out_->data_,
-          quantized_data_->min_.data_, bias, fc_data_desc.batch_size_, 1, fc_kernel_desc.channel_out_, 0, 1, 1, 0.5,
-          aligned_fc_m_ - fc_m_, aligned_fc_n_ - fc_n_, false);
+          quantized_kernel_->data_, quantized_data->data_, out, aligned_fc_m_, aligned_fc_n, aligned_fc_k_,
+          quantized_kernel_->ratio_.data_, quantized_data->ratio_.data_, sum_per_channel_out_->data_,
+          quantized_data->min_.data_, bias, fc_data_desc.batch_size_, 1, fc_kernel_desc.channel_out_, 0, 1, 1, 0.5,
+          aligned_fc_m_ - fc_m_, aligned_fc_n - fc_n, false, false, false, false, NULL, NULL, NULL, NULL, NULL,
+          &ctx->gemm_tuning_, &ctx->gemm_plan_, &weight_replicas_);
     }
-    delete quantized_data_;
-    quantized_data_ = NULL;
+  }
+
+  // Small batches: the data rows are quantized without shuffling or padding the batch, and the packed weights are
+  // streamed once against all of them. The output layout is the same for NCHW and NHWC.
+  void ExecuteGEMV(ShuffleFCContext *context, float *out, float *data, float *bias, size_t fc_n) {
+    QuantizedTensor<float, uint8_t> *quantized_data = InitData(context, fc_n, fc_n);
+    QuantizeData<1>(quantized_data, data, fc_n, fc_n);
+    PerfScope perf(PERF_GEMM, 2ull * fc_m_ * fc_n * aligned_fc_k_);
+    shuffle::ShuffleGEMV<FC_SHUFFLE_KERNEL_M, FC_SHUFFLE_KERNEL_K>(
+        quantized_kernel_->data_, quantized_data->data_, out, aligned_fc_m_, fc_n, aligned_fc_k_,
+        quantized_kernel_->ratio_.data_, quantized_data->ratio_.data_, sum_per_channel_out_->data_,
+        quantized_data->min_.data_, bias, aligned_fc_m_ - fc_m_, &weight_replicas_);
+  }
+
+  // Dynamic quantization finds the range of every row, static quantization uses the input range for all of them
+  template <size_t shuffle_rows>
+  void QuantizeData(QuantizedTensor<float, uint8_t> *quantized_data, float *data, size_t fc_n, size_t aligned_n) {
+    PerfScope perf(PERF_QUANTIZE, 0, aligned_n * aligned_fc_k_);
+    if (!input_range_.Enabled()) {
+      shuffle::PadQuantizeShuffle2D<float, shuffle_rows, FC_SHUFFLE_KERNEL_K>(
+          quantized_data->data_, fc_n, fc_k_, aligned_n, aligned_fc_k_, data, quantized_data->min_.data_,
+          quantized_data->max_.data_, quantized_data->ratio_.data_, data_threshold_);
+      return;
+    }
+    input_range_.FillPixelRanges(quantized_data->min_.data_, quantized_data->max_.data_, quantized_data->ratio_.data_,
+                                 fc_n, data_threshold_);
+    shuffle::StaticQuantizeShuffle2D<shuffle_rows, FC_SHUFFLE_KERNEL_K>(
+        quantized_data->data_, fc_n, fc_k_, aligned_n, aligned_fc_k_, data, input_range_.Scale(data_threshold_),
+        input_range_.ZeroPoint(data_threshold_), data_threshold_);
+  }
+
+  // Small batches are not padded, see ExecuteGEMV
+  size_t WorkspaceSize(const FCDataDesc &fc_data_desc, const FCKernelDesc &fc_kernel_desc) {
+    size_t fc_n = fc_data_desc.batch_size_;
+    return GetWorkspaceSize(fc_n, (fc_n <= FC_GEMV_MAX_BATCH) ? fc_n : GetAlignmentLength(fc_n, FC_SHUFFLE_KERNEL_N));
+  }
+
+  size_t GetWorkspaceSize(size_t fc_n, size_t aligned_n) {
+    return Workspace::AlignedSize(sizeof(uint8_t) * aligned_n * aligned_fc_k_) +
+           3 * Workspace::AlignedSize(sizeof(float) * fc_n);
+  }
+
+  QuantizedTensor<float, uint8_t> *InitData(ShuffleFCContext *context, size_t fc_n, size_t aligned_n) {
+    Workspace &workspace = context->workspace_;
+    QuantizedTensor<float, uint8_t> *quantized_data = context->quantized_data_;
+    workspace.Reserve(GetWorkspaceSize(fc_n, aligned_n));
+    quantized_data->shape_ = make_shape(aligned_n, aligned_fc_k_);
+    quantized_data->ori_shape_ = make_shape(fc_n, fc_k_);
+    quantized_data->min_.shape_ = quantized_data->max_.shape_ = quantized_data->ratio_.shape_ = make_shape(fc_n);
+    quantized_data->SetData(workspace.Allocate<uint8_t>(aligned_n * aligned_fc_k_));
+    quantized_data->min_.SetData(workspace.Allocate<float>(fc_n));
+    quantized_data->max_.SetData(workspace.Allocate<float>(fc_n));
+    quantized_data->ratio_.SetData(workspace.Allocate<float>(fc_n));
+    return quantized_data;
   }
 
  private:
   size_t fc_m_;
-  size_t fc_n_;
   size_t fc_k_;
   size_t aligned_fc_m_;
-  size_t aligned_fc_n_;
   size_t aligned_fc_k_;
 
   Tensor<float> *sum_per_channel_out_;
   QuantizedTensor<float, int8_t> *quantized_kernel_;
-  QuantizedTensor<float, uint8_t> *quantized_data_;
+  NumaReplicas<int8_t> weight_replicas_;
 
   float weight_threshold_;
   float data_threshold_;
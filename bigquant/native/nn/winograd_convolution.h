@@ -0,0 +1,239 @@
+/*
+ * Copyright 2016 The BigDL Authors.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef NN_WINOGRAD_CONVOLUTION_H
+#define NN_WINOGRAD_CONVOLUTION_H
+#include "base_convolution.h"
+
+// F(tile x tile, 3x3) Winograd convolution for 3x3, stride 1, dilation 1 and a single group. Weights and input patches
+// are transformed in float, then each of the alpha * alpha transformed points is one int8 shuffle GEMM of
+// channel_out x patches x channel_in, all of them scheduled together by ConvShuffleGroupGEMM.
+template <size_t tile>
+struct WinogradConvolutionAlgo : public BaseConvolutionAlgo {
+  WinogradConvolutionAlgo(const ConvolutionKernelDesc &conv_kernel_desc)
+      : quantized_weight_(NULL), weight_min_(NULL), weight_max_(NULL), weight_ratio_(NULL), kernel_sum_(NULL) {
+    assert((conv_kernel_desc.kernel_h_ == 3) && (conv_kernel_desc.kernel_w_ == 3));
+    assert((conv_kernel_desc.stride_h_ == 1) && (conv_kernel_desc.stride_w_ == 1));
+    assert((conv_kernel_desc.dilation_h_ == 1) && (conv_kernel_desc.dilation_w_ == 1));
+    assert(conv_kernel_desc.group_ == 1);
+    // The shuffle kernels sum eight u8 x s8 products in saturating int16 lanes. Transformed patches sit around the
+    // middle of their quantized range instead of near zero like post-ReLU im2col data, so the data range is halved to
+    // keep 8 * 63 * 64 below INT16_MAX.
+    weight_threshold_ = 64.0f;
+    data_threshold_ = 63.0f;
+    points_ = winograd::Winograd3x3Matrix<tile>::alpha * winograd::Winograd3x3Matrix<tile>::alpha;
+    aligned_m_ = GetAlignmentLength(conv_kernel_desc.channel_out_, CONV_SHUFFLE_KERNEL_M);
+    aligned_k_ = GetAlignmentLength(conv_kernel_desc.channel_in_, CONV_SHUFFLE_KERNEL_K);
+  }
+
+  ~WinogradConvolutionAlgo() {
+    delete quantized_weight_;
+    delete weight_min_;
+    delete weight_max_;
+    delete weight_ratio_;
+    delete kernel_sum_;
+  }
+
+  void ReleaseWeight() {
+    delete quantized_weight_;
+    delete weight_min_;
+    delete weight_max_;
+    delete weight_ratio_;
+    delete kernel_sum_;
+    quantized_weight_ = NULL;
+    weight_min_ = NULL;
+    weight_max_ = NULL;
+    weight_ratio_ = NULL;
+    kernel_sum_ = NULL;
+  }
+
+  void InitWeight(float *weight, ConvolutionKernelDesc &conv_kernel_desc) {
+    size_t channel_out = conv_kernel_desc.channel_out_;
+    size_t channel_in = conv_kernel_desc.channel_in_;
+    Tensor<float> transformed_weight(make_shape(points_, channel_out, channel_in), 64);
+    if (conv_kernel_desc.layout_ == NCHW) {
+      Tensor<float> nhwc_weight(make_shape(channel_out, 3, 3, channel_in), 64);
+      TransformLayout(NHWC, NCHW, nhwc_weight.data_, weight, channel_out, channel_in, 9);
+      winograd::NHWCWinograd3x3KernelProcess<tile>(transformed_weight.data_, nhwc_weight.data_, channel_out,
+                                                   channel_in);
+    } else {
+      winograd::NHWCWinograd3x3KernelProcess<tile>(transformed_weight.data_, weight, channel_out, channel_in);
+    }
+    delete quantized_weight_;
+    delete weight_min_;
+    delete weight_max_;
+    delete weight_ratio_;
+    delete kernel_sum_;
+    quantized_weight_ = new Tensor<int8_t>(make_shape(points_, aligned_m_, aligned_k_), 64);
+    weight_min_ = new Tensor<float>(make_shape(points_, channel_out), 64);
+    weight_max_ = new Tensor<float>(make_shape(points_, channel_out), 64);
+    weight_ratio_ = new Tensor<float>(make_shape(points_, channel_out), 64);
+    kernel_sum_ = new Tensor<float>(make_shape(points_, channel_out), 64);
+    ComputeMatrixSumPerRow<float>(kernel_sum_->data_, transformed_weight.data_, points_ * channel_out, channel_in);
+    std::vector<int8_t *> quantized(points_);
+    std::vector<float *> min(points_);
+    std::vector<float *> max(points_);
+    std::vector<float *> ratio(points_);
+    for (size_t xi = 0; xi < points_; ++xi) {
+      quantized[xi] = quantized_weight_->data_ + xi * aligned_m_ * aligned_k_;
+      min[xi] = weight_min_->data_ + xi * channel_out;
+      max[xi] = weight_max_->data_ + xi * channel_out;
+      ratio[xi] = weight_ratio_->data_ + xi * channel_out;
+    }
+    winograd::NHWCWinogradQuantizeKernelByChannel<tile>(quantized.data(), transformed_weight.data_, channel_out,
+                                                        channel_in, aligned_m_, aligned_k_, min.data(), max.data(),
+                                                        ratio.data(), weight_threshold_);
+  }
+
+  void SavePackedWeight(PackedWriter &writer) {
+    writer.WriteTensor(quantized_weight_);
+    writer.WriteTensor(weight_min_);
+    writer.WriteTensor(weight_max_);
+    writer.WriteTensor(weight_ratio_);
+    writer.WriteTensor(kernel_sum_);
+  }
+
+  bool LoadPackedWeight(PackedReader &reader, const ConvolutionKernelDesc &conv_kernel_desc) {
+    size_t count = points_ * conv_kernel_desc.channel_out_;
+    quantized_weight_ = new Tensor<int8_t>(Shape());
+    weight_min_ = new Tensor<float>(Shape());
+    weight_max_ = new Tensor<float>(Shape());
+    weight_ratio_ = new Tensor<float>(Shape());
+    kernel_sum_ = new Tensor<float>(Shape());
+    reader.ReadTensor(*quantized_weight_, points_ * aligned_m_ * aligned_k_);
+    reader.ReadTensor(*weight_min_, count);
+    reader.ReadTensor(*weight_max_, count);
+    reader.ReadTensor(*weight_ratio_, count);
+    reader.ReadTensor(*kernel_sum_, count);
+    return reader.Ok();
+  }
+
+  // The NHWC copy of an NCHW input, a transform scratch per thread, the quantized patches with their ranges and the
+  // transformed output
+  size_t WorkspaceSize(const ConvolutionDataDesc &conv_data_desc, const ConvolutionKernelDesc &conv_kernel_desc) {
+    size_t channel_out = conv_kernel_desc.channel_out_;
+    size_t channel_in = conv_kernel_desc.channel_in_;
+    size_t height_out = GetConvOutSize(conv_data_desc.height_in_, 3, 1, conv_kernel_desc.pad_h_, 1);
+    size_t width_out = GetConvOutSize(conv_data_desc.width_in_, 3, 1, conv_kernel_desc.pad_w_, 1);
+    size_t patches = conv_data_desc.batch_size_ * ((height_out + tile - 1) / tile) * ((width_out + tile - 1) / tile);
+    size_t aligned_n = GetAlignmentLength(patches, CONV_SHUFFLE_KERNEL_N);
+    size_t data_count = conv_data_desc.batch_size_ * conv_data_desc.height_in_ * conv_data_desc.width_in_ * channel_in;
+    bool transpose_data = (conv_kernel_desc.layout_ == NCHW);
+    return (transpose_data ? Workspace::AlignedSize(sizeof(float) * data_count) : 0) +
+           GetThreadsNumWrapper() * Workspace::AlignedSize(sizeof(float) * points_ * channel_in) +
+           Workspace::AlignedSize(sizeof(uint8_t) * points_ * aligned_n * aligned_k_) +
+           3 * Workspace::AlignedSize(sizeof(float) * points_ * patches) +
+           Workspace::AlignedSize(sizeof(float) * points_ * channel_out * patches);
+  }
+
+  void Execute(ConvolutionContext *context, float *out, float *data, float *bias, float *residual,
+               const ConvolutionDataDesc &conv_data_desc, const ConvolutionKernelDesc &conv_kernel_desc) {
+    bool relu = (conv_kernel_desc.fusion_mask_ & FUSION_RELU) != 0;
+    bool bn = (conv_kernel_desc.fusion_mask_ & FUSION_BN) != 0;
+    assert(!bn || (bn_mean_ != NULL));
+    assert(((conv_kernel_desc.fusion_mask_ & FUSION_SUM) == 0) || (residual != NULL));
+    if ((conv_kernel_desc.fusion_mask_ & FUSION_SUM) == 0) {
+      residual = NULL;
+    }
+    size_t batch_size = conv_data_desc.batch_size_;
+    size_t channel_out = conv_kernel_desc.channel_out_;
+    size_t channel_in = conv_kernel_desc.channel_in_;
+    size_t height_out = GetConvOutSize(conv_data_desc.height_in_, 3, 1, conv_kernel_desc.pad_h_, 1);
+    size_t width_out = GetConvOutSize(conv_data_desc.width_in_, 3, 1, conv_kernel_desc.pad_w_, 1);
+    size_t patch_y_num = (height_out + tile - 1) / tile;
+    size_t patch_x_num = (width_out + tile - 1) / tile;
+    size_t patches = batch_size * patch_y_num * patch_x_num;
+    size_t aligned_n = GetAlignmentLength(patches, CONV_SHUFFLE_KERNEL_N);
+    size_t data_count = batch_size * conv_data_desc.height_in_ * conv_data_desc.width_in_ * channel_in;
+    bool transpose_data = (conv_kernel_desc.layout_ == NCHW);
+
+    size_t threads = GetThreadsNumWrapper();
+    Workspace &workspace = context->workspace_;
+    workspace.Reserve(WorkspaceSize(conv_data_desc, conv_kernel_desc));
+    float *nhwc_data = data;
+    if (transpose_data) {
+      nhwc_data = workspace.Allocate<float>(data_count);
+      TransformLayout(NHWC, NCHW, nhwc_data, data, batch_size, channel_in,
+                      conv_data_desc.height_in_ * conv_data_desc.width_in_);
+    }
+    std::vector<float *> scratch(threads);
+    for (size_t t = 0; t < threads; ++t) {
+      scratch[t] = workspace.Allocate<float>(points_ * channel_in);
+    }
+    uint8_t *quantized_data = workspace.Allocate<uint8_t>(points_ * aligned_n * aligned_k_);
+    float *data_min = workspace.Allocate<float>(points_ * patches);
+    float *data_max = workspace.Allocate<float>(points_ * patches);
+    float *data_ratio = workspace.Allocate<float>(points_ * patches);
+    float *intermedia_out = workspace.Allocate<float>(points_ * channel_out * patches);
+
+    std::vector<int8_t *> weight(points_);
+    std::vector<uint8_t *> quantized(points_);
+    std::vector<float *> ratio_a(points_);
+    std::vector<float *> min_b(points_);
+    std::vector<float *> max_b(points_);
+    std::vector<float *> ratio_b(points_);
+    for (size_t xi = 0; xi < points_; ++xi) {
+      weight[xi] = quantized_weight_->data_ + xi * aligned_m_ * aligned_k_;
+      quantized[xi] = quantized_data + xi * aligned_n * aligned_k_;
+      ratio_a[xi] = weight_ratio_->data_ + xi * channel_out;
+      min_b[xi] = data_min + xi * patches;
+      max_b[xi] = data_max + xi * patches;
+      ratio_b[xi] = data_ratio + xi * patches;
+    }
+    {
+      // the input transform is the im2col of Winograd, quantizing points_ matrices of transformed patches
+      PerfScope perf(PERF_IM2COL, 0, points_ * aligned_n * aligned_k_);
+      winograd::NHWCWinograd3x3DataProcess<tile>(quantized.data(), nhwc_data, batch_size, conv_data_desc.height_in_,
+                                                 conv_data_desc.width_in_, channel_in, conv_kernel_desc.pad_h_,
+                                                 conv_kernel_desc.pad_w_, patch_y_num, patch_x_num, aligned_n,
+                                                 aligned_k_, min_b.data(), max_b.data(), ratio_b.data(),
+                                                 data_threshold_, scratch.data());
+    }
+    winograd::NHWCWinograd3x3ElementWiseBatchMul<tile>(intermedia_out, weight.data(), quantized.data(), batch_size,
+                                                       patch_y_num, patch_x_num, channel_in, channel_out,
+                                                       ratio_a.data(), kernel_sum_->data_, ratio_b.data(),
+                                                       min_b.data());
+
+    float *mean = bn ? bn_mean_->data_ : NULL;
+    float *variance_coeff = bn ? bn_variance_coeff_->data_ : NULL;
+    float *scale = (bn && bn_scale_ != NULL) ? bn_scale_->data_ : NULL;
+    float *shift = (bn && bn_shift_ != NULL) ? bn_shift_->data_ : NULL;
+    if (conv_kernel_desc.layout_ == NCHW) {
+      winograd::NHWCWinograd3x3PostProcess<tile, NCHW>(out, intermedia_out, bias, batch_size, patch_y_num,
+                                                       patch_x_num, channel_out, height_out, width_out, relu && !bn,
+                                                       bn && !relu, bn && relu, mean, variance_coeff, scale, shift,
+                                                       residual);
+    } else {
+      winograd::NHWCWinograd3x3PostProcess<tile, NHWC>(out, intermedia_out, bias, batch_size, patch_y_num,
+                                                       patch_x_num, channel_out, height_out, width_out, relu && !bn,
+                                                       bn && !relu, bn && relu, mean, variance_coeff, scale, shift,
+                                                       residual);
+    }
+  }
+
+ private:
+  size_t points_;
+  size_t aligned_m_;
+  size_t aligned_k_;
+  float weight_threshold_;
+  float data_threshold_;
+  Tensor<int8_t> *quantized_weight_;
+  Tensor<float> *weight_min_;
+  Tensor<float> *weight_max_;
+  Tensor<float> *weight_ratio_;
+  Tensor<float> *kernel_sum_;
+};
+#endif
@@ -0,0 +1,178 @@
+/*
+ * Copyright 2016 The BigDL Authors.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef OPS_DEPTHWISE_CONV_H
+#define OPS_DEPTHWISE_CONV_H
+
+#include "../base.h"
+#include "../common.h"
+
+namespace depthwise {
+
+// Quantize a batch into a zero-bordered NHWC uint8 buffer with channel_aligned lanes per pixel. Every (image, channel)
+// plane has its own asymmetric range, widened to include 0 so that the border holds the exact zero point.
+template <LAYOUT layout>
+void PadQuantize(uint8_t *dst, float *src, size_t batch_size, size_t channels, size_t channel_aligned, size_t height,
+                 size_t width, size_t pad_h, size_t pad_w, float *min, float *ratio, float threshold) {
+  size_t height_padded = height + 2 * pad_h;
+  size_t width_padded = width + 2 * pad_w;
+  size_t hxw = height * width;
+  if (layout == NCHW) {
+#pragma omp parallel for
+    for (size_t i = 0; i < batch_size * channels; ++i) {
+      size_t n = i / channels;
+      size_t c = i % channels;
+      FindMinMaxValue(src + i * hxw, hxw, min[n * channel_aligned + c], ratio[n * channel_aligned + c]);
+    }
+  } else {
+#pragma omp parallel for
+    for (size_t n = 0; n < batch_size; ++n) {
+      float *local_min = min + n * channel_aligned;
+      float *local_max = ratio + n * channel_aligned;
+      std::fill(local_min, local_min + channels, FLT_MAX);
+      std::fill(local_max, local_max + channels, -FLT_MAX);
+      for (size_t p = 0; p < hxw; ++p) {
+        float *pixel = src + (n * hxw + p) * channels;
+        for (size_t c = 0; c < channels; ++c) {
+          local_min[c] = std::min(local_min[c], pixel[c]);
+          local_max[c] = std::max(local_max[c], pixel[c]);
+        }
+      }
+    }
+  }
+  // ratio holds the max until here
+  for (size_t n = 0; n < batch_size; ++n) {
+    for (size_t c = 0; c < channel_aligned; ++c) {
+      size_t i = n * channel_aligned + c;
+      if (c < channels) {
+        min[i] = std::min(min[i], 0.0f);
+        float range = std::max(ratio[i], 0.0f) - min[i];
+        ratio[i] = (range > 0.0f) ? threshold / range : 1.0f;
+      } else {
+        min[i] = 0.0f;
+        ratio[i] = 1.0f;
+      }
+    }
+  }
+#pragma omp parallel for collapse(2)
+  for (size_t n = 0; n < batch_size; ++n) {
+    for (size_t y = 0; y < height_padded; ++y) {
+      float *local_min = min + n * channel_aligned;
+      float *local_ratio = ratio + n * channel_aligned;
+      uint8_t *dst_row = dst + (n * height_padded + y) * width_padded * channel_aligned;
+      bool border_row = (y < pad_h) || (y >= height + pad_h);
+      for (size_t x = 0; x < width_padded; ++x) {
+        if (border_row || (x < pad_w) || (x >= width + pad_w)) {
+          for (size_t c = 0; c < channel_aligned; ++c) {
+            dst_row[x * channel_aligned + c] = static_cast<uint8_t>(-local_min[c] * local_ratio[c] + 0.5f);
+          }
+        }
+      }
+      if (border_row) {
+        continue;
+      }
+      size_t iy = y - pad_h;
+      uint8_t *dst_pixel = dst_row + pad_w * channel_aligned;
+      if (layout == NCHW) {
+        for (size_t c = 0; c < channels; ++c) {
+          float *src_row = src + ((n * channels + c) * height + iy) * width;
+          for (size_t x = 0; x < width; ++x) {
+            dst_pixel[x * channel_aligned + c] =
+                static_cast<uint8_t>((src_row[x] - local_min[c]) * local_ratio[c] + 0.5f);
+          }
+        }
+      } else {
+        float *src_row = src + (n * height + iy) * width * channels;
+        for (size_t x = 0; x < width; ++x) {
+          for (size_t c = 0; c < channels; ++c) {
+            dst_pixel[x * channel_aligned + c] =
+                static_cast<uint8_t>((src_row[x * channels + c] - local_min[c]) * local_ratio[c] + 0.5f);
+          }
+        }
+      }
+      for (size_t x = 0; x < width; ++x) {
+        std::fill(dst_pixel + x * channel_aligned + channels, dst_pixel + (x + 1) * channel_aligned, 0);
+      }
+    }
+  }
+}
+
+// One output row with PS_OPERAND_WIDTH channels per register: dst[x][c] = coeff[c] * sum(w * q) + offset[c].
+// Activations are zero-extended to int32, so MADD_EPI16 computes each product exactly against a zero high half.
+// src points at the first padded input row of the window, weight is [kernel_h * kernel_w][channel_aligned].
+void ConvRow(float *dst, uint8_t *src, int8_t *weight, size_t channel_aligned, size_t width_padded, size_t width_out,
+             size_t kernel_h, size_t kernel_w, size_t stride_w, size_t dilation_h, size_t dilation_w, float *coeff,
+             float *offset) {
+  size_t row_stride = dilation_h * width_padded * channel_aligned;
+  for (size_t c = 0; c < channel_aligned; c += PS_OPERAND_WIDTH) {
+    SIMDPSTYPE simd_coeff = LOADU_PS(coeff + c);
+    SIMDPSTYPE simd_offset = LOADU_PS(offset + c);
+    for (size_t x = 0; x < width_out; ++x) {
+      INIT(acc);
+      uint8_t *window = src + x * stride_w * channel_aligned + c;
+      int8_t *local_weight = weight + c;
+      for (size_t ky = 0; ky < kernel_h; ++ky) {
+        uint8_t *tap = window + ky * row_stride;
+        for (size_t kx = 0; kx < kernel_w; ++kx) {
+          acc = ADD_EPI32(acc, MADD_EPI16(LOADU_EPU8_EPI32(tap), LOADU_EPI8_EPI32(local_weight)));
+          tap += dilation_w * channel_aligned;
+          local_weight += channel_aligned;
+        }
+      }
+      STOREU_PS(dst + x * channel_aligned + c, FMA_PS(EPI32TOPS(acc), simd_coeff, simd_offset));
+    }
+  }
+}
+
+// Write one computed row to the output, adding the residual and applying ReLU on the way.
+template <LAYOUT layout>
+void CommitRow(float *out, float *row, float *residual, size_t channels, size_t channel_aligned, size_t height_out,
+               size_t width_out, size_t n, size_t y, bool relu) {
+  if (layout == NHWC) {
+    size_t base = (n * height_out + y) * width_out * channels;
+    size_t full = channels / PS_OPERAND_WIDTH * PS_OPERAND_WIDTH;
+    for (size_t x = 0; x < width_out; ++x) {
+      float *src = row + x * channel_aligned;
+      float *dst = out + base + x * channels;
+      float *res = (residual == NULL) ? NULL : residual + base + x * channels;
+      for (size_t c = 0; c < full; c += PS_OPERAND_WIDTH) {
+        SIMDPSTYPE value = LOADU_PS(src + c);
+        if (res != NULL) {
+          value = ADD_PS(value, LOADU_PS(res + c));
+        }
+        if (relu) {
+          value = MAX_PS(value, ZERO_PS());
+        }
+        STOREU_PS(dst + c, value);
+      }
+      for (size_t c = full; c < channels; ++c) {
+        float value = src[c] + ((res == NULL) ? 0.0f : res[c]);
+        dst[c] = relu ? std::max(value, 0.0f) : value;
+      }
+    }
+  } else {
+    for (size_t c = 0; c < channels; ++c) {
+      size_t base = ((n * channels + c) * height_out + y) * width_out;
+      for (size_t x = 0; x < width_out; ++x) {
+        float value = row[x * channel_aligned + c] + ((residual == NULL) ? 0.0f : residual[base + x]);
+        out[base + x] = relu ? std::max(value, 0.0f) : value;
+      }
+    }
+  }
+}
+}
+
+#endif
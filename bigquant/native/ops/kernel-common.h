@@ -99,4 +99,80 @@ static INLINE_SPECIFIER void INLINE_ATTRIBUTE ScalarBN(float &result, const floa
   result += shift;
 }
 
+// Fused convolution epilogue. It runs as BN -> residual sum -> ReLU, or ReLU -> BN -> residual sum when
+// conv_relu_bn_fusion is set. The channel part only depends on the output channel and the output part only on the
+// output address, so the NHWC block kernels can apply them on either side of their transpose.
+static INLINE_SPECIFIER void INLINE_ATTRIBUTE ScalarChannelFusion(float &result, size_t c, bool conv_bn_fusion,
+                                                                  bool conv_bn_relu_fusion, bool conv_relu_bn_fusion,
+                                                                  float *global_mean, float *mul_variance_coeff,
+                                                                  float *scale, float *shift) {
+  if (conv_relu_bn_fusion) {
+    result = fmaxf(result, 0.0f);
+  }
+  if (conv_bn_fusion || conv_bn_relu_fusion || conv_relu_bn_fusion) {
+    ScalarBN(result, global_mean[c], mul_variance_coeff[c], (scale == NULL) ? 1.0f : scale[c],
+             (shift == NULL) ? 0.0f : shift[c]);
+  }
+}
+
+static INLINE_SPECIFIER void INLINE_ATTRIBUTE ScalarOutputFusion(float &result, float *residual, bool conv_relu_fusion,
+                                                                 bool conv_bn_relu_fusion) {
+  if (residual != NULL) {
+    result += *residual;
+  }
+  if (conv_relu_fusion || conv_bn_relu_fusion) {
+    result = fmaxf(result, 0.0f);
+  }
+}
+
+static INLINE_SPECIFIER void INLINE_ATTRIBUTE ChannelFusion(SIMDPSTYPE &result, size_t c, bool conv_bn_fusion,
+                                                            bool conv_bn_relu_fusion, bool conv_relu_bn_fusion,
+                                                            float *global_mean, float *mul_variance_coeff, float *scale,
+                                                            float *shift) {
+  if (conv_relu_bn_fusion) {
+    PRELU(result, ZERO_PS());
+  }
+  if (conv_bn_fusion || conv_bn_relu_fusion || conv_relu_bn_fusion) {
+    BN(result, SET1_PS(global_mean[c]), SET1_PS(mul_variance_coeff[c]), SET1_PS((scale == NULL) ? 1.0f : scale[c]),
+       SET1_PS((shift == NULL) ? 0.0f : shift[c]));
+  }
+}
+
+static INLINE_SPECIFIER void INLINE_ATTRIBUTE OutputFusion(SIMDPSTYPE &result, float *residual, bool conv_relu_fusion,
+                                                           bool conv_bn_relu_fusion) {
+  if (residual != NULL) {
+    result = ADD_PS(result, LOADU_PS(residual));
+  }
+  if (conv_relu_fusion || conv_bn_relu_fusion) {
+    PRELU(result, ZERO_PS());
+  }
+}
+
+#if defined(__AVX2__)
+// Some AVX512 and AVX2 tiles are finished in half-width registers
+static INLINE_SPECIFIER void INLINE_ATTRIBUTE ChannelFusionHalf(SIMDPSTYPEHALF &result, size_t c, bool conv_bn_fusion,
+                                                                bool conv_bn_relu_fusion, bool conv_relu_bn_fusion,
+                                                                float *global_mean, float *mul_variance_coeff,
+                                                                float *scale, float *shift) {
+  if (conv_relu_bn_fusion) {
+    result = MAX_PS_HALF(result, SET1_PS_HALF(0.0f));
+  }
+  if (conv_bn_fusion || conv_bn_relu_fusion || conv_relu_bn_fusion) {
+    result = MUL_PS_HALF(SUB_PS_HALF(result, SET1_PS_HALF(global_mean[c])), SET1_PS_HALF(mul_variance_coeff[c]));
+    result = FMA_PS_HALF(result, SET1_PS_HALF((scale == NULL) ? 1.0f : scale[c]),
+                         SET1_PS_HALF((shift == NULL) ? 0.0f : shift[c]));
+  }
+}
+
+static INLINE_SPECIFIER void INLINE_ATTRIBUTE OutputFusionHalf(SIMDPSTYPEHALF &result, float *residual,
+                                                               bool conv_relu_fusion, bool conv_bn_relu_fusion) {
+  if (residual != NULL) {
+    result = ADD_PS_HALF(result, LOADU_PS_HALF(residual));
+  }
+  if (conv_relu_fusion || conv_bn_relu_fusion) {
+    result = MAX_PS_HALF(result, SET1_PS_HALF(0.0f));
+  }
+}
+#endif
+
 #endif
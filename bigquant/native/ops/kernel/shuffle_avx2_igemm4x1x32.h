@@ -108,7 +108,7 @@ ApplyStreamKernel(int8_t *&pa, uint8_t *&pb, size_t k, float fault_tolerance, fl
                   size_t valid_lanes, size_t i_index, size_t j_index, float *ratio_a, float *ratio_b, float *min_b,
                   float *kernel_sum, float *bias, bool conv_relu_fusion, bool conv_bn_fusion, bool conv_bn_relu_fusion,
                   bool conv_relu_bn_fusion, float *global_mean, float *mul_variance_coeff, float *scale, float *shift,
-                  kernel_function kernel, sum_function sum, postprocess_function postprocess) {
+                  float *residual[], kernel_function kernel, sum_function sum, postprocess_function postprocess) {
   SIMDSITYPEHALF accumulator;
   INIT(c1);
   INIT(c2);
@@ -130,7 +130,7 @@ ApplyStreamKernel(int8_t *&pa, uint8_t *&pb, size_t k, float fault_tolerance, fl
   PostReduce(sum1, sum2, sum3, sum4, accumulator);
   postprocess(accumulator, result, length, valid_lanes, i_index, j_index, ratio_a, ratio_b, min_b, kernel_sum, bias,
               conv_relu_fusion, conv_bn_fusion, conv_bn_relu_fusion, conv_relu_bn_fusion, global_mean,
-              mul_variance_coeff, scale, shift);
+              mul_variance_coeff, scale, shift, residual);
 }
 
 static INLINE_SPECIFIER void INLINE_ATTRIBUTE CommitResult(SIMDSITYPEHALF &accumulator, void *result[], size_t length,
@@ -157,11 +157,15 @@ static INLINE_SPECIFIER void INLINE_ATTRIBUTE
 StreamFMAResult(SIMDSITYPEHALF &accumulator, float *result[], size_t length, size_t valid_lanes, size_t i_index,
                 size_t j_index, float *ratio_a, float *ratio_b, float *min_b, float *kernel_sum, float *bias,
                 bool conv_relu_fusion, bool conv_bn_fusion, bool conv_bn_relu_fusion, bool conv_relu_bn_fusion,
-                float *global_mean, float *mul_variance_coeff, float *scale, float *shift) {
+                float *global_mean, float *mul_variance_coeff, float *scale, float *shift, float *residual[]) {
   int *tmp = reinterpret_cast<int *>(&accumulator);
   for (size_t m = 0; m < length; ++m) {
-    *(reinterpret_cast<float *>(result[m])) =
-        ratio_a[i_index + m] * ratio_b[j_index] * tmp[m] + kernel_sum[i_index + m] * min_b[j_index] + bias[i_index + m];
+    float value = ratio_a[i_index + m] * ratio_b[j_index] * tmp[m] + kernel_sum[i_index + m] * min_b[j_index] +
+                  ((bias == NULL) ? 0.0f : bias[i_index + m]);
+    ScalarChannelFusion(value, i_index + m, conv_bn_fusion, conv_bn_relu_fusion, conv_relu_bn_fusion, global_mean,
+                        mul_variance_coeff, scale, shift);
+    ScalarOutputFusion(value, (residual == NULL) ? NULL : residual[m], conv_relu_fusion, conv_bn_relu_fusion);
+    *(reinterpret_cast<float *>(result[m])) = value;
   }
 }
 
@@ -184,12 +188,12 @@ static INLINE_SPECIFIER void INLINE_ATTRIBUTE ApplyKernelWrapper(
     int8_t *&pa, uint8_t *&pb, size_t k, float fault_tolerance, float *result[], size_t length, size_t valid_lanes,
     size_t i_index, size_t j_index, float *ratio_a, float *ratio_b, float *min_b, float *kernel_sum, float *bias,
     bool conv_relu_fusion, bool conv_bn_fusion, bool conv_bn_relu_fusion, bool conv_relu_bn_fusion, float *global_mean,
-    float *mul_variance_coeff, float *scale, float *shift, bool is_block) {
+    float *mul_variance_coeff, float *scale, float *shift, float *residual[], bool is_block) {
   assert((kernel_m == 4) && (kernel_n == 1) && (kernel_k == 32));
   ApplyStreamKernel<kernel_k>(pa, pb, k, fault_tolerance, result, std::min(length, kernel_m),
                               std::min(valid_lanes, kernel_n), i_index, j_index, ratio_a, ratio_b, min_b, kernel_sum,
                               bias, conv_relu_fusion, conv_bn_fusion, conv_bn_relu_fusion, conv_relu_bn_fusion,
-                              global_mean, mul_variance_coeff, scale, shift, Kernel4x1x32, Reduce,
+                              global_mean, mul_variance_coeff, scale, shift, residual, Kernel4x1x32, Reduce,
                               StreamFMAResult<kernel_m, kernel_n>);
 }
 
@@ -313,7 +313,7 @@ static INLINE_SPECIFIER void INLINE_ATTRIBUTE ApplyKernel(
     int8_t *&pa, uint8_t *&pb, size_t k, float fault_tolerance, float *result[], size_t length, size_t valid_lanes,
     size_t i_index, size_t j_index, float *ratio_a, float *ratio_b, float *min_b, float *kernel_sum, float *bias,
     bool conv_relu_fusion, bool conv_bn_fusion, bool conv_bn_relu_fusion, bool conv_relu_bn_fusion, float *global_mean,
-    float *mul_variance_coeff, float *scale, float *shift, postprocess_function postprocess) {
+    float *mul_variance_coeff, float *scale, float *shift, float *residual[], postprocess_function postprocess) {
   SIMDSITYPE sum[8];
   for (size_t i = 0; i < 8; ++i) {
     sum[i] = ZEROS();
@@ -321,7 +321,7 @@ static INLINE_SPECIFIER void INLINE_ATTRIBUTE ApplyKernel(
   KernelReduce<kernel_k>(pa, pb, sum, k);
   postprocess(sum, result, length, valid_lanes, i_index, j_index, ratio_a, ratio_b, min_b, kernel_sum, bias,
               conv_relu_fusion, conv_bn_fusion, conv_bn_relu_fusion, conv_relu_bn_fusion, global_mean,
-              mul_variance_coeff, scale, shift);
+              mul_variance_coeff, scale, shift, residual);
 }
 
 /*
@@ -370,7 +370,8 @@ static INLINE_SPECIFIER void INLINE_ATTRIBUTE NCHWBlockFMA(SIMDSITYPE sum[], flo
                                                            float *kernel_sum, float *bias, bool conv_relu_fusion,
                                                            bool conv_bn_fusion, bool conv_bn_relu_fusion,
                                                            bool conv_relu_bn_fusion, float *global_mean,
-                                                           float *mul_variance_coeff, float *scale, float *shift) {
+                                                           float *mul_variance_coeff, float *scale, float *shift,
+                                                           float *residual[]) {
   const SIMDSITYPE permute_mask = SET_EPI32(0, 0, 0, 0, 0, 0, 0, 0, 14, 12, 10, 8, 6, 4, 2, 0);
 
   sum[0] = ADD_EPI32(BSRLI_EPI128(sum[0], 4), sum[0]);
@@ -439,6 +440,12 @@ static INLINE_SPECIFIER void INLINE_ATTRIBUTE NCHWBlockFMA(SIMDSITYPE sum[], flo
                                FMA_PS_HALF(simd_min_b, SET1_PS_HALF(kernel_sum[i_index + 6]), simd_bias[6]));
   simd_result[7] = FMA_PS_HALF(EPI32TOPS_HALF(CASTSI512TOSI256(sum[7])), simd_coeffi[7],
                                FMA_PS_HALF(simd_min_b, SET1_PS_HALF(kernel_sum[i_index + 7]), simd_bias[7]));
+  for (size_t m = 0; m < 8; ++m) {
+    ChannelFusionHalf(simd_result[m], i_index + m, conv_bn_fusion, conv_bn_relu_fusion, conv_relu_bn_fusion,
+                      global_mean, mul_variance_coeff, scale, shift);
+    OutputFusionHalf(simd_result[m], (residual == NULL) ? NULL : residual[m * kernel_n], conv_relu_fusion,
+                     conv_bn_relu_fusion);
+  }
 
   STOREU_PS_HALF(result[0 * kernel_n], simd_result[0]);
   STOREU_PS_HALF(result[1 * kernel_n], simd_result[1]);
@@ -457,7 +464,8 @@ static INLINE_SPECIFIER void INLINE_ATTRIBUTE NHWCBlockFMA(SIMDSITYPE sum[], flo
                                                            float *kernel_sum, float *bias, bool conv_relu_fusion,
                                                            bool conv_bn_fusion, bool conv_bn_relu_fusion,
                                                            bool conv_relu_bn_fusion, float *global_mean,
-                                                           float *mul_variance_coeff, float *scale, float *shift) {
+                                                           float *mul_variance_coeff, float *scale, float *shift,
+                                                           float *residual[]) {
   const SIMDSITYPE permute_mask = SET_EPI32(0, 0, 0, 0, 0, 0, 0, 0, 14, 12, 10, 8, 6, 4, 2, 0);
 
   sum[0] = ADD_EPI32(BSRLI_EPI128(sum[0], 4), sum[0]);
@@ -526,6 +534,10 @@ static INLINE_SPECIFIER void INLINE_ATTRIBUTE NHWCBlockFMA(SIMDSITYPE sum[], flo
                                FMA_PS_HALF(simd_min_b, SET1_PS_HALF(kernel_sum[i_index + 6]), simd_bias[6]));
   simd_result[7] = FMA_PS_HALF(EPI32TOPS_HALF(CASTSI512TOSI256(sum[7])), simd_coeffi[7],
                                FMA_PS_HALF(simd_min_b, SET1_PS_HALF(kernel_sum[i_index + 7]), simd_bias[7]));
+  for (size_t m = 0; m < 8; ++m) {
+    ChannelFusionHalf(simd_result[m], i_index + m, conv_bn_fusion, conv_bn_relu_fusion, conv_relu_bn_fusion,
+                      global_mean, mul_variance_coeff, scale, shift);
+  }
   // a1,a2,a3,a4,a5,a6,a7,a8
   // b1,b2,b3,b4,b5,b6,b7,b8
   // c1,c2,c3,c4,c5,c6,c7,c8
@@ -597,6 +609,10 @@ static INLINE_SPECIFIER void INLINE_ATTRIBUTE NHWCBlockFMA(SIMDSITYPE sum[], flo
   tmp1[5] = PERMUTE2F128_PS_HALF(simd_result[1], simd_result[5], 1 + (3 << 4));
   tmp1[6] = PERMUTE2F128_PS_HALF(simd_result[2], simd_result[6], 1 + (3 << 4));
   tmp1[7] = PERMUTE2F128_PS_HALF(simd_result[3], simd_result[7], 1 + (3 << 4));
+  for (size_t n = 0; n < 8; ++n) {
+    OutputFusionHalf(tmp1[n], (residual == NULL) ? NULL : residual[n * kernel_n], conv_relu_fusion,
+                     conv_bn_relu_fusion);
+  }
 
   STOREU_PS_HALF(result[0 * kernel_n], tmp1[0]);
   STOREU_PS_HALF(result[1 * kernel_n], tmp1[1]);
@@ -615,7 +631,7 @@ static INLINE_SPECIFIER void INLINE_ATTRIBUTE FMAResult(SIMDSITYPE sum[], float
                                                         float *bias, bool conv_relu_fusion, bool conv_bn_fusion,
                                                         bool conv_bn_relu_fusion, bool conv_relu_bn_fusion,
                                                         float *global_mean, float *mul_variance_coeff, float *scale,
-                                                        float *shift) {
+                                                        float *shift, float *residual[]) {
   const SIMDSITYPE permute_mask = SET_EPI32(0, 0, 0, 0, 0, 0, 0, 0, 14, 12, 10, 8, 6, 4, 2, 0);
 
   sum[0] = ADD_EPI32(BSRLI_EPI128(sum[0], 4), sum[0]);
@@ -639,9 +655,13 @@ static INLINE_SPECIFIER void INLINE_ATTRIBUTE FMAResult(SIMDSITYPE sum[], float
   for (size_t m = 0; m < length; ++m) {
     for (size_t n = 0; n < valid_lanes; ++n) {
       int *tmp = reinterpret_cast<int *>(&sum[m]);
-      *(reinterpret_cast<float *>(result[m * kernel_n + n])) = ratio_a[i_index + m] * ratio_b[j_index + n] * tmp[n] +
-                                                               kernel_sum[i_index + m] * min_b[j_index + n] +
-                                                               ((bias == NULL) ? 0.0f : bias[i_index + m]);
+      float value = ratio_a[i_index + m] * ratio_b[j_index + n] * tmp[n] +
+                    kernel_sum[i_index + m] * min_b[j_index + n] + ((bias == NULL) ? 0.0f : bias[i_index + m]);
+      ScalarChannelFusion(value, i_index + m, conv_bn_fusion, conv_bn_relu_fusion, conv_relu_bn_fusion, global_mean,
+                          mul_variance_coeff, scale, shift);
+      ScalarOutputFusion(value, (residual == NULL) ? NULL : residual[m * kernel_n + n], conv_relu_fusion,
+                         conv_bn_relu_fusion);
+      *(reinterpret_cast<float *>(result[m * kernel_n + n])) = value;
     }
   }
 }
@@ -659,30 +679,30 @@ static INLINE_SPECIFIER void INLINE_ATTRIBUTE ApplyKernelWrapper(
     int8_t *&pa, uint8_t *&pb, size_t k, float fault_tolerance, float *result[], size_t length, size_t valid_lanes,
     size_t i_index, size_t j_index, float *ratio_a, float *ratio_b, float *min_b, float *kernel_sum, float *bias,
     bool conv_relu_fusion, bool conv_bn_fusion, bool conv_bn_relu_fusion, bool conv_relu_bn_fusion, float *global_mean,
-    float *mul_variance_coeff, float *scale, float *shift, bool is_block) {
+    float *mul_variance_coeff, float *scale, float *shift, float *residual[], bool is_block) {
   assert((kernel_m == 8) && (kernel_n == 8) && (kernel_k == 8));
   if (layout == NCHW) {
     if (is_block == false) {
       ApplyKernel<kernel_k>(pa, pb, k, fault_tolerance, result, length, valid_lanes, i_index, j_index, ratio_a, ratio_b,
                             min_b, kernel_sum, bias, conv_relu_fusion, conv_bn_fusion, conv_bn_relu_fusion,
-                            conv_relu_bn_fusion, global_mean, mul_variance_coeff, scale, shift,
+                            conv_relu_bn_fusion, global_mean, mul_variance_coeff, scale, shift, residual,
                             FMAResult<kernel_m, kernel_n>);
     } else {
       ApplyKernel<kernel_k>(pa, pb, k, fault_tolerance, result, length, valid_lanes, i_index, j_index, ratio_a, ratio_b,
                             min_b, kernel_sum, bias, conv_relu_fusion, conv_bn_fusion, conv_bn_relu_fusion,
-                            conv_relu_bn_fusion, global_mean, mul_variance_coeff, scale, shift,
+                            conv_relu_bn_fusion, global_mean, mul_variance_coeff, scale, shift, residual,
                             NCHWBlockFMA<kernel_m, kernel_n>);
     }
   } else {
     if (is_block == false) {
       ApplyKernel<kernel_k>(pa, pb, k, fault_tolerance, result, length, valid_lanes, i_index, j_index, ratio_a, ratio_b,
                             min_b, kernel_sum, bias, conv_relu_fusion, conv_bn_fusion, conv_bn_relu_fusion,
-                            conv_relu_bn_fusion, global_mean, mul_variance_coeff, scale, shift,
+                            conv_relu_bn_fusion, global_mean, mul_variance_coeff, scale, shift, residual,
                             FMAResult<kernel_m, kernel_n>);
     } else {
       ApplyKernel<kernel_k>(pa, pb, k, fault_tolerance, result, length, valid_lanes, i_index, j_index, ratio_a, ratio_b,
                             min_b, kernel_sum, bias, conv_relu_fusion, conv_bn_fusion, conv_bn_relu_fusion,
-                            conv_relu_bn_fusion, global_mean, mul_variance_coeff, scale, shift,
+                            conv_relu_bn_fusion, global_mean, mul_variance_coeff, scale, shift, residual,
                             NHWCBlockFMA<kernel_m, kernel_n>);
     }
   }
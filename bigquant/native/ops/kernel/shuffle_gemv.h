@@ -0,0 +1,97 @@
+/*
+ * Copyright 2016 The BigDL Authors.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef OPS_SHUFFLE_KERNEL_GEMV_H
+#define OPS_SHUFFLE_KERNEL_GEMV_H
+#include "../../base.h"
+
+#define GEMV_PREFETCH_DISTANCE 1024
+
+// Matrix-vector kernel for a handful of columns. A is the int8 weight packed by PadQuantizeShuffle2D<kernel_m,
+// kernel_k> (one kernel_m x kernel_k patch after another), B holds n unshuffled uint8 rows of length k. Every
+// kernel_m x k stripe of A is streamed exactly once and multiplied against all n columns. MADD_EPI8 adds two u8 x s8
+// products into a saturating int16, so B must be quantized to at most 127, as ShuffleFC does: 2 * 127 * 128 still fits.
+// The pairs are widened to int32 right after.
+namespace kernel {
+namespace gemv {
+
+template <size_t kernel_k>
+static INLINE_SPECIFIER SIMDSITYPE INLINE_ATTRIBUTE BroadcastColumn(uint8_t *pb) {
+#if defined(__AVX2__)
+  // one 8-byte slice of the column for every row of the patch
+  return SET1_EPI64(*reinterpret_cast<int64_t *>(pb));
+#else
+  // the register holds a single row of the patch
+  return LOAD_SI(reinterpret_cast<SIMDSITYPE *>(pb));
+#endif
+}
+
+template <size_t kernel_m, size_t kernel_k, size_t n>
+static INLINE_SPECIFIER void INLINE_ATTRIBUTE ApplyKernel(int8_t *pa, uint8_t *pb[], size_t k, int result[][kernel_m]) {
+  const size_t vectors = kernel_m * kernel_k / OPERAND_WIDTH;
+  const size_t lanes_per_row = kernel_k / sizeof(int);
+  const SIMDSITYPE ones = SET1_EPI16(1);
+  SIMDSITYPE sum[n][vectors];
+  for (size_t j = 0; j < n; ++j) {
+    for (size_t v = 0; v < vectors; ++v) {
+      sum[j][v] = ZEROS();
+    }
+  }
+  for (size_t kk = 0; kk < k; kk += kernel_k) {
+    _mm_prefetch(reinterpret_cast<const char *>(pa + GEMV_PREFETCH_DISTANCE), _MM_HINT_T0);
+    SIMDSITYPE b[n];
+    for (size_t j = 0; j < n; ++j) {
+      b[j] = BroadcastColumn<kernel_k>(pb[j] + kk);
+    }
+    for (size_t v = 0; v < vectors; ++v) {
+      SIMDSITYPE a = LOAD_SI(reinterpret_cast<SIMDSITYPE *>(pa + v * OPERAND_WIDTH));
+      for (size_t j = 0; j < n; ++j) {
+        sum[j][v] = ADD_EPI32(sum[j][v], MADD_EPI16(MADD_EPI8(b[j], a), ones));
+      }
+    }
+    pa += kernel_m * kernel_k;
+  }
+  int lanes[vectors * OPERAND_WIDTH / sizeof(int)];
+  for (size_t j = 0; j < n; ++j) {
+    for (size_t v = 0; v < vectors; ++v) {
+      STOREU_SI(reinterpret_cast<SIMDSITYPE *>(lanes + v * OPERAND_WIDTH / sizeof(int)), sum[j][v]);
+    }
+    for (size_t r = 0; r < kernel_m; ++r) {
+      int acc = 0;
+      for (size_t l = 0; l < lanes_per_row; ++l) {
+        acc += lanes[r * lanes_per_row + l];
+      }
+      result[j][r] = acc;
+    }
+  }
+}
+
+template <size_t kernel_m, size_t n>
+static INLINE_SPECIFIER void INLINE_ATTRIBUTE FMAResult(int result[][kernel_m], float *pc, size_t ldc, size_t i_index,
+                                                        size_t valid_rows, float *ratio_a, float *ratio_b,
+                                                        float *kernel_sum, float *min_b, float *bias) {
+  for (size_t j = 0; j < n; ++j) {
+    for (size_t r = 0; r < valid_rows; ++r) {
+      size_t i = i_index + r;
+      float value = ratio_a[i] * ratio_b[j] * result[j][r] + kernel_sum[i] * min_b[j];
+      pc[j * ldc + i] = (bias == NULL) ? value : value + bias[i];
+    }
+  }
+}
+}
+}
+
+#endif  // OPS_SHUFFLE_KERNEL_GEMV_H
@@ -156,7 +156,8 @@ ApplyKernel(int8_t *&pa, uint8_t *&pb, size_t k, float fault_tolerance, float *r
             size_t valid_lanes, size_t i_index, size_t j_index, float *ratio_a, float *ratio_b, float *min_b,
             float *kernel_sum, float *bias, bool conv_relu_fusion, bool conv_bn_fusion, bool conv_bn_relu_fusion,
             bool conv_relu_bn_fusion, float *global_mean, float *mul_variance_coeff, float *scale, float *shift,
-            kernel_function kernel, sum_function sum, reduce_function reduce, postprocess_function postprocess) {
+            float *residual[], kernel_function kernel, sum_function sum, reduce_function reduce,
+            postprocess_function postprocess) {
   SIMDSITYPE ones = SET1_EPI16(-1);
   SIMDPSTYPE zero = ZERO_PS();
   SIMDSITYPE max_threshold = SET1_EPI16((INT16_MAX * fault_tolerance));
@@ -177,7 +178,7 @@ ApplyKernel(int8_t *&pa, uint8_t *&pb, size_t k, float fault_tolerance, float *r
   reduce(c11, c12, c21, c22, accumulator);
   postprocess(accumulator, result, length, valid_lanes, i_index, j_index, ratio_a, ratio_b, min_b, kernel_sum, bias,
               conv_relu_fusion, conv_bn_fusion, conv_bn_relu_fusion, conv_relu_bn_fusion, global_mean,
-              mul_variance_coeff, scale, shift);
+              mul_variance_coeff, scale, shift, residual);
 }
 
 static INLINE_SPECIFIER void INLINE_ATTRIBUTE CommitBlockResult(SIMDSITYPE &sum, void *result[], size_t length,
@@ -208,9 +209,14 @@ static INLINE_SPECIFIER void INLINE_ATTRIBUTE FMAResult(SIMDSITYPE &sum, float *
                                                         float *bias, bool conv_relu_fusion, bool conv_bn_fusion,
                                                         bool conv_bn_relu_fusion, bool conv_relu_bn_fusion,
                                                         float *global_mean, float *mul_variance_coeff, float *scale,
-                                                        float *shift) {
+                                                        float *shift, float *residual[]) {
   SIMDSITYPE sum_hi = SRLI_SI128(sum, 8);
   for (size_t ky = 0; ky < valid_lanes; ++ky) {
+    // the residual may alias the output, so read it before the stores below
+    float residual_value[kernel_m];
+    for (size_t l = 0; (residual != NULL) && (l < length); ++l) {
+      residual_value[l] = *(residual[l * kernel_n + ky]);
+    }
     if (length == 2) {
       *(result[0 * kernel_n + ky]) = ratio_a[i_index] * ratio_b[j_index + ky] * EXTRACT_EPI32(sum, 0) +
                                      kernel_sum[i_index] * min_b[j_index + ky] +
@@ -223,6 +229,12 @@ static INLINE_SPECIFIER void INLINE_ATTRIBUTE FMAResult(SIMDSITYPE &sum, float *
                                      kernel_sum[i_index] * min_b[j_index + ky] +
                                      ((bias == NULL) ? 0.0f : bias[i_index]);
     }
+    for (size_t l = 0; l < length; ++l) {
+      ScalarChannelFusion(*(result[l * kernel_n + ky]), i_index + l, conv_bn_fusion, conv_bn_relu_fusion,
+                          conv_relu_bn_fusion, global_mean, mul_variance_coeff, scale, shift);
+      ScalarOutputFusion(*(result[l * kernel_n + ky]), (residual == NULL) ? NULL : &residual_value[l],
+                         conv_relu_fusion, conv_bn_relu_fusion);
+    }
     sum = SRLI_SI128(sum, 4);
     sum_hi = SRLI_SI128(sum_hi, 4);
   }
@@ -247,12 +259,12 @@ static INLINE_SPECIFIER void INLINE_ATTRIBUTE ApplyKernelWrapper(
     int8_t *&pa, uint8_t *&pb, size_t k, float fault_tolerance, float *result[], size_t length, size_t valid_lanes,
     size_t i_index, size_t j_index, float *ratio_a, float *ratio_b, float *min_b, float *kernel_sum, float *bias,
     bool conv_relu_fusion, bool conv_bn_fusion, bool conv_bn_relu_fusion, bool conv_relu_bn_fusion, float *global_mean,
-    float *mul_variance_coeff, float *scale, float *shift, bool is_block) {
+    float *mul_variance_coeff, float *scale, float *shift, float *residual[], bool is_block) {
   assert((kernel_m == 2) && (kernel_n == 2) && (kernel_k == 16));
   ApplyKernel<kernel_k>(pa, pb, k, fault_tolerance, result, std::min(length, kernel_m), std::min(valid_lanes, kernel_n),
                         i_index, j_index, ratio_a, ratio_b, min_b, kernel_sum, bias, conv_relu_fusion, conv_bn_fusion,
                         conv_bn_relu_fusion, conv_relu_bn_fusion, global_mean, mul_variance_coeff, scale, shift,
-                        SSE42Kernel2x2x16, ReduceWrapper, Reduce, FMAResult<kernel_m, kernel_n>);
+                        residual, SSE42Kernel2x2x16, ReduceWrapper, Reduce, FMAResult<kernel_m, kernel_n>);
 }
 
 template <typename DType, size_t kernel_m, size_t kernel_n, size_t kernel_k>
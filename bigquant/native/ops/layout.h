@@ -18,10 +18,7 @@
 #define OPS_LAYOUT_H
 
 #include "../base.h"
-
-#ifdef TIME_PROFILE
-#include <chrono>
-#endif
+#include "../perf_counters.h"
 
 /*
 #if defined(MKL_TRANSPOSE)
@@ -62,63 +59,182 @@ hxw) {
 #endif
 */
 
-template <typename DType>
-void Transpose(DType *dst, DType *src, size_t m, size_t n) {
-#ifdef TIME_PROFILE
-  auto start = std::chrono::system_clock::now();
+// Side of the square SIMD transpose tile, one register of floats per row
+#if defined(AVX512)
+#define TRANSPOSE_TILE 16
+#elif defined(__AVX2__)
+#define TRANSPOSE_TILE 8
+#else
+#define TRANSPOSE_TILE 4
 #endif
-  for (size_t y = 0; y < n; ++y) {
-    for (size_t x = 0; x < m; ++x) {
-      *(dst + y * m + x) = *(src + x * n + y);
+
+// Side of the square block a thread transposes at once, small enough for its source and destination to share L1
+#define TRANSPOSE_BLOCK 64
+
+// dst[c * ld_dst + r] = src[r * ld_src + c] for one TRANSPOSE_TILE square
+static INLINE_SPECIFIER void INLINE_ATTRIBUTE TransposeTile(float *dst, size_t ld_dst, const float *src,
+                                                            size_t ld_src) {
+  SIMDPSTYPE r[TRANSPOSE_TILE];
+  for (size_t i = 0; i < TRANSPOSE_TILE; ++i) {
+    r[i] = LOADU_PS(src + i * ld_src);
+  }
+#if defined(AVX512)
+  __m512 t[TRANSPOSE_TILE];
+  for (size_t i = 0; i < 16; i += 2) {
+    t[i] = _mm512_unpacklo_ps(r[i], r[i + 1]);
+    t[i + 1] = _mm512_unpackhi_ps(r[i], r[i + 1]);
+  }
+  for (size_t i = 0; i < 16; i += 4) {
+    r[i] = _mm512_castpd_ps(_mm512_unpacklo_pd(_mm512_castps_pd(t[i]), _mm512_castps_pd(t[i + 2])));
+    r[i + 1] = _mm512_castpd_ps(_mm512_unpackhi_pd(_mm512_castps_pd(t[i]), _mm512_castps_pd(t[i + 2])));
+    r[i + 2] = _mm512_castpd_ps(_mm512_unpacklo_pd(_mm512_castps_pd(t[i + 1]), _mm512_castps_pd(t[i + 3])));
+    r[i + 3] = _mm512_castpd_ps(_mm512_unpackhi_pd(_mm512_castps_pd(t[i + 1]), _mm512_castps_pd(t[i + 3])));
+  }
+  // 128-bit lanes: first gather lanes 0 and 2 / 1 and 3 of row pairs four apart, then of pairs eight apart
+  for (size_t i = 0; i < 16; i += 8) {
+    for (size_t j = 0; j < 4; ++j) {
+      t[i + j] = _mm512_shuffle_f32x4(r[i + j], r[i + j + 4], 0x88);
+      t[i + j + 4] = _mm512_shuffle_f32x4(r[i + j], r[i + j + 4], 0xdd);
     }
   }
-#ifdef TIME_PROFILE
-  auto end = std::chrono::system_clock::now();
-  auto diff = std::chrono::duration_cast<std::chrono::microseconds>(end - start);
-  std::cerr << "layout transform " << diff.count() << "us"
-            << " " << m << " " << n << std::endl;
+  for (size_t j = 0; j < 8; ++j) {
+    r[j] = _mm512_shuffle_f32x4(t[j], t[j + 8], 0x88);
+    r[j + 8] = _mm512_shuffle_f32x4(t[j], t[j + 8], 0xdd);
+  }
+#elif defined(__AVX2__)
+  __m256 t[TRANSPOSE_TILE];
+  for (size_t i = 0; i < 8; i += 2) {
+    t[i] = _mm256_unpacklo_ps(r[i], r[i + 1]);
+    t[i + 1] = _mm256_unpackhi_ps(r[i], r[i + 1]);
+  }
+  for (size_t i = 0; i < 8; i += 4) {
+    r[i] = _mm256_shuffle_ps(t[i], t[i + 2], 0x44);
+    r[i + 1] = _mm256_shuffle_ps(t[i], t[i + 2], 0xee);
+    r[i + 2] = _mm256_shuffle_ps(t[i + 1], t[i + 3], 0x44);
+    r[i + 3] = _mm256_shuffle_ps(t[i + 1], t[i + 3], 0xee);
+  }
+  for (size_t j = 0; j < 4; ++j) {
+    t[j] = _mm256_permute2f128_ps(r[j], r[j + 4], 0x20);
+    t[j + 4] = _mm256_permute2f128_ps(r[j], r[j + 4], 0x31);
+  }
+  for (size_t i = 0; i < 8; ++i) {
+    r[i] = t[i];
+  }
+#else
+  _MM_TRANSPOSE4_PS(r[0], r[1], r[2], r[3]);
 #endif
+  for (size_t i = 0; i < TRANSPOSE_TILE; ++i) {
+    STOREU_PS(dst + i * ld_dst, r[i]);
+  }
 }
 
+// dst[c * ld_dst + r] = src[r * ld_src + c] for a rows x cols block of src, one thread
 template <typename DType>
-void TransformLayout(LAYOUT dst_layout, LAYOUT src_layout, DType *dst, DType *src, size_t batch_size, size_t channels,
-                     size_t hxw) {
-#ifdef TIME_PROFILE
-  auto start = std::chrono::system_clock::now();
-#endif
-  if ((dst_layout == NHWC) && (src_layout == NCHW)) {
-#pragma omp parallel for collapse(2) schedule(static, 1)
-    for (size_t n = 0; n < batch_size; ++n) {
-      for (size_t s = 0; s < hxw; ++s) {
-        size_t batch_offset = n * channels * hxw;
-        size_t offset = batch_offset + s * channels;
-        DType *src_per_pixel = src + batch_offset + s;
-        DType *dst_per_pixel = dst + offset;
-        for (size_t c = 0; c < channels; ++c) {
-          *(dst_per_pixel + c) = *(src_per_pixel + c * hxw);
+INLINE_SPECIFIER void TransposeBlock(DType *dst, size_t ld_dst, const DType *src, size_t ld_src, size_t rows,
+                                     size_t cols, bool stream = false) {
+  for (size_t r = 0; r < rows; ++r) {
+    for (size_t c = 0; c < cols; ++c) {
+      dst[c * ld_dst + r] = src[r * ld_src + c];
+    }
+  }
+}
+
+// With stream the block is at most TRANSPOSE_BLOCK square. It is transposed into L1 first and then written out one
+// whole dst row after the other, with streaming stores when the rows are aligned to the register width, instead of
+// TRANSPOSE_TILE partial lines at a time, which would thrash the write-combining buffers.
+template <>
+INLINE_SPECIFIER void TransposeBlock<float>(float *dst, size_t ld_dst, const float *src, size_t ld_src, size_t rows,
+                                            size_t cols, bool stream) {
+  if (stream) {
+    assert((rows <= TRANSPOSE_BLOCK) && (cols <= TRANSPOSE_BLOCK));
+    alignas(64) float staged[TRANSPOSE_BLOCK * TRANSPOSE_BLOCK];
+    TransposeBlock<float>(staged, TRANSPOSE_BLOCK, src, ld_src, rows, cols);
+    const size_t alignment = TRANSPOSE_TILE * sizeof(float);
+    bool aligned = (reinterpret_cast<uintptr_t>(dst) % alignment == 0) && (ld_dst % TRANSPOSE_TILE == 0);
+    size_t tiled_rows = rows / TRANSPOSE_TILE * TRANSPOSE_TILE;
+    for (size_t c = 0; c < cols; ++c) {
+      float *dst_row = dst + c * ld_dst;
+      float *staged_row = staged + c * TRANSPOSE_BLOCK;
+      for (size_t r = 0; r < tiled_rows; r += TRANSPOSE_TILE) {
+        if (aligned) {
+          STREAMSTORE_PS(dst_row + r, LOADU_PS(staged_row + r));
+        } else {
+          STOREU_PS(dst_row + r, LOADU_PS(staged_row + r));
         }
       }
+      for (size_t r = tiled_rows; r < rows; ++r) {
+        dst_row[r] = staged_row[r];
+      }
     }
-  } else if ((dst_layout == NCHW) && (src_layout == NHWC)) {
-#pragma omp parallel for collapse(2) schedule(static, 1)
+    return;
+  }
+  size_t tiled_rows = rows / TRANSPOSE_TILE * TRANSPOSE_TILE;
+  size_t tiled_cols = cols / TRANSPOSE_TILE * TRANSPOSE_TILE;
+  for (size_t r = 0; r < tiled_rows; r += TRANSPOSE_TILE) {
+    for (size_t c = 0; c < tiled_cols; c += TRANSPOSE_TILE) {
+      TransposeTile(dst + c * ld_dst + r, ld_dst, src + r * ld_src + c, ld_src);
+    }
+    for (size_t c = tiled_cols; c < cols; ++c) {
+      for (size_t i = r; i < r + TRANSPOSE_TILE; ++i) {
+        dst[c * ld_dst + i] = src[i * ld_src + c];
+      }
+    }
+  }
+  for (size_t r = tiled_rows; r < rows; ++r) {
+    for (size_t c = 0; c < cols; ++c) {
+      dst[c * ld_dst + r] = src[r * ld_src + c];
+    }
+  }
+}
+
+// batch_size transposes of a rows x cols matrix, parallel over TRANSPOSE_BLOCK squares. Results that outgrow the L2s
+// of the team are on their way to memory anyway, so they are written row by row, see TransposeBlock.
+template <typename DType>
+void BatchTranspose(DType *dst, const DType *src, size_t batch_size, size_t rows, size_t cols) {
+  bool stream = batch_size * rows * cols * sizeof(DType) > GetCacheTopology().l2_size_ * GetThreadsNumWrapper();
+  size_t row_blocks = (rows + TRANSPOSE_BLOCK - 1) / TRANSPOSE_BLOCK;
+  size_t col_blocks = (cols + TRANSPOSE_BLOCK - 1) / TRANSPOSE_BLOCK;
+#pragma omp parallel
+  {
+    TraceScope trace("transpose");
+#pragma omp for collapse(3) nowait
     for (size_t n = 0; n < batch_size; ++n) {
-      for (size_t c = 0; c < channels; ++c) {
-        size_t batch_offset = n * channels * hxw;
-        size_t offset = batch_offset + c * hxw;
-        DType *dst_per_channel = dst + offset;
-        DType *src_per_channel = src + batch_offset + c;
-        for (size_t s = 0; s < hxw; ++s) {
-          *(dst_per_channel + s) = *(src_per_channel + s * channels);
+      for (size_t rb = 0; rb < row_blocks; ++rb) {
+        for (size_t cb = 0; cb < col_blocks; ++cb) {
+          size_t r = rb * TRANSPOSE_BLOCK;
+          size_t c = cb * TRANSPOSE_BLOCK;
+          TransposeBlock<DType>(dst + n * rows * cols + c * rows + r, rows, src + n * rows * cols + r * cols + c, cols,
+                                std::min(rows - r, static_cast<size_t>(TRANSPOSE_BLOCK)),
+                                std::min(cols - c, static_cast<size_t>(TRANSPOSE_BLOCK)), stream);
         }
       }
     }
+    // order this thread's streaming stores before the barrier closing the region
+    if (stream) {
+      _mm_sfence();
+    }
+  }
+}
+
+template <typename DType>
+void Transpose(DType *dst, DType *src, size_t m, size_t n) {
+  PerfScope perf(PERF_LAYOUT_TRANSFORM, 0, 2 * sizeof(DType) * m * n);
+  BatchTranspose(dst, src, 1, m, n);
+}
+
+// Counts as PERF_LAYOUT_TRANSFORM only when the layouts differ
+template <typename DType>
+void TransformLayout(LAYOUT dst_layout, LAYOUT src_layout, DType *dst, DType *src, size_t batch_size, size_t channels,
+                     size_t hxw) {
+  if (dst_layout == src_layout) {
+    return;
+  }
+  PerfScope perf(PERF_LAYOUT_TRANSFORM, 0, 2 * sizeof(DType) * batch_size * channels * hxw);
+  if ((dst_layout == NHWC) && (src_layout == NCHW)) {
+    BatchTranspose(dst, src, batch_size, channels, hxw);
+  } else if ((dst_layout == NCHW) && (src_layout == NHWC)) {
+    BatchTranspose(dst, src, batch_size, hxw, channels);
   }
-#ifdef TIME_PROFILE
-  auto end = std::chrono::system_clock::now();
-  auto diff = std::chrono::duration_cast<std::chrono::microseconds>(end - start);
-  std::cerr << "layout transform " << diff.count() << "us"
-            << " " << batch_size << " " << channels << " " << hxw << std::endl;
-#endif
 }
 
 #endif
@@ -70,8 +70,17 @@ void PadQuantizeIm2colWrapper(DType *data, size_t batch_size, size_t channels_pe
 void MixPrecisionGemm(ORDER order, enum TRANSPOSE transA, enum TRANSPOSE transB, int m, int n, int k, int8_t *a,
                       int lda, uint8_t *b, int ldb, int *c, int ldc, float fault_tolerance);
 
+struct GemmTuning;
+
+template <typename DType>
+struct NumaReplicas;
+
 namespace shuffle {
 
+struct GemmPlan;
+
+struct Requantization;
+
 template <typename DType, size_t shuffle_rows, size_t shuffle_cols>
 void PadShuffle2D(DType *dst, size_t m, size_t n, DType *src);
 
@@ -87,12 +96,34 @@ template <typename DType, size_t shuffle_rows, size_t shuffle_cols>
 void PadQuantizeShuffle2D(uint8_t *dst, size_t m, size_t n, size_t pad_m, size_t pad_n, DType *src, DType *min,
                           DType *max, DType *ratio, float sw_threshold);
 
+template <size_t shuffle_rows, size_t shuffle_cols>
+void PadRescaleShuffle2D(int8_t *dst, size_t m, size_t n, size_t pad_m, size_t pad_n, const int8_t *src,
+                         const float *src_min, const float *src_max, float *min, float *max, float *ratio,
+                         float sw_threshold);
+
 template <typename DType, LAYOUT layout>
 void PadQuantizeShuffleIm2colWrapper(DType *data, size_t batch_size, size_t channels_per_group, size_t groups,
                                      size_t height, size_t width, size_t kernel_h, size_t kernel_w, size_t pad_h,
                                      size_t pad_w, size_t stride_h, size_t stride_w, size_t dilation_h,
                                      size_t dilation_w, uint8_t *data_col[], DType *min[], DType *max[], DType *ratio[],
-                                     DType *workspace, float sw_threshold = 255.0f, bool transpose = false);
+                                     DType *scratch[], float sw_threshold = 255.0f, bool transpose = false);
+
+template <size_t shuffle_rows, size_t shuffle_cols>
+void StaticQuantizeShuffle2D(uint8_t *dst, size_t m, size_t n, size_t pad_m, size_t pad_n, const float *src,
+                             float scale, float zero_point, float sw_threshold);
+
+template <LAYOUT layout>
+void StaticQuantizeShuffleIm2colWrapper(const float *data, size_t batch_size, size_t channels_per_group, size_t groups,
+                                        size_t height, size_t width, size_t kernel_h, size_t kernel_w, size_t pad_h,
+                                        size_t pad_w, size_t stride_h, size_t stride_w, size_t dilation_h,
+                                        size_t dilation_w, uint8_t *data_col[], float scale, float zero_point,
+                                        uint8_t *workspace, float sw_threshold);
+
+template <LAYOUT layout>
+void StaticShuffleIm2colWrapper(const uint8_t *quantized, size_t batch_size, size_t channels_per_group, size_t groups,
+                                size_t height, size_t width, size_t kernel_h, size_t kernel_w, size_t pad_h,
+                                size_t pad_w, size_t stride_h, size_t stride_w, size_t dilation_h, size_t dilation_w,
+                                uint8_t *data_col[], uint8_t zero_point);
 
 template <size_t kernel_m, size_t kernel_n, size_t kernel_k, LAYOUT layout>
 void ConvShuffleGEMM(int8_t *pa, uint8_t *pb, float *pc, size_t m, size_t n, size_t k, float *ratio_a, float *ratio_b,
@@ -101,7 +132,24 @@ void ConvShuffleGEMM(int8_t *pa, uint8_t *pb, float *pc, size_t m, size_t n, siz
                      float fault_tolerance = 0.5, size_t pad_m = 0, size_t pad_n = 0, bool conv_relu_fusion = false,
                      bool conv_bn_fusion = false, bool conv_bn_relu_fusion = false, bool conv_relu_bn_fusion = false,
                      float *global_mean = NULL, float *mul_variance_coeff = NULL, float *scale = NULL,
-                     float *shift = NULL);
+                     float *shift = NULL, float *residual = NULL, const GemmTuning *tuning = NULL,
+                     GemmPlan *plan = NULL, const NumaReplicas<int8_t> *pa_replicas = NULL,
+                     const Requantization *requant = NULL);
+
+template <size_t kernel_m, size_t kernel_n, size_t kernel_k, LAYOUT layout>
+void ConvShuffleGroupGEMM(int8_t *pa[], uint8_t *pb[], float *pc, size_t m, size_t n, size_t k, float *ratio_a[],
+                          float *ratio_b[], float *kernel_sum, float *min_b[], float *bias, size_t batch_size,
+                          size_t groups, size_t channel_per_group, size_t height_out, size_t width_out,
+                          float fault_tolerance = 0.5, size_t pad_m = 0, size_t pad_n = 0,
+                          bool conv_relu_fusion = false, bool conv_bn_fusion = false,
+                          bool conv_bn_relu_fusion = false, bool conv_relu_bn_fusion = false,
+                          float *global_mean = NULL, float *mul_variance_coeff = NULL, float *scale = NULL,
+                          float *shift = NULL, float *residual = NULL, const Requantization *requant = NULL);
+
+template <size_t kernel_m, size_t kernel_k>
+void ShuffleGEMV(int8_t *pa, uint8_t *pb, float *pc, size_t m, size_t n, size_t k, float *ratio_a, float *ratio_b,
+                 float *kernel_sum, float *min_b, float *bias, size_t pad_m,
+                 const NumaReplicas<int8_t> *pa_replicas = NULL);
 }
 
 namespace dot {
@@ -111,20 +159,58 @@ void Dot(int8_t *pa, uint8_t *pb, int &result, size_t length);
 void Dot(int8_t *pa, uint8_t *pb, float &result, size_t length, float ratio_a, float a_sum, float ratio_b, float min_b);
 }
 
-namespace winograd {
+namespace depthwise {
 
-void NHWCWinograd3x3KernelProcess(float *transformed_weight, float *weight, int channel_out, int channel_in, int height,
-                                  int width);
+template <LAYOUT layout>
+void PadQuantize(uint8_t *dst, float *src, size_t batch_size, size_t channels, size_t channel_aligned, size_t height,
+                 size_t width, size_t pad_h, size_t pad_w, float *min, float *ratio, float threshold);
 
-void NHWCWinogradQuantizeKernelByChannel(int8_t *quantized_kernel, float *transformed_kernel, size_t m, size_t n,
-                                         size_t pad_m, size_t pad_n, float *min, float *max, float *ratio);
+void ConvRow(float *dst, uint8_t *src, int8_t *weight, size_t channel_aligned, size_t width_padded, size_t width_out,
+             size_t kernel_h, size_t kernel_w, size_t stride_w, size_t dilation_h, size_t dilation_w, float *coeff,
+             float *offset);
+
+template <LAYOUT layout>
+void CommitRow(float *out, float *row, float *residual, size_t channels, size_t channel_aligned, size_t height_out,
+               size_t width_out, size_t n, size_t y, bool relu);
+}
+
+namespace winograd {
+
+template <size_t tile>
+void NHWCWinograd3x3KernelProcess(float *transformed_weight, float *weight, size_t channel_out, size_t channel_in);
+
+template <size_t tile>
+void NHWCWinogradQuantizeKernelByChannel(int8_t *quantized_kernel[], float *transformed_kernel, size_t m, size_t n,
+                                         size_t pad_m, size_t pad_n, float *min[], float *max[], float *ratio[],
+                                         float sw_threshold);
+
+template <size_t tile>
+void NHWCWinograd3x3DataProcess(uint8_t *quantized_data[], float *data, size_t batch_size, size_t height,
+                                size_t width, size_t channel_in, size_t pad_h, size_t pad_w, size_t patch_y_num,
+                                size_t patch_x_num, size_t pad_patches, size_t pad_channel_in, float *min[],
+                                float *max[], float *ratio[], float sw_threshold, float *scratch[]);
+
+template <size_t tile>
+void NHWCWinograd3x3ElementWiseBatchMul(float *intermedia_out, int8_t *transformed_kernel[],
+                                        uint8_t *transformed_data[], size_t batch_size, size_t patch_y_num,
+                                        size_t patch_x_num, size_t channel_in, size_t channel_out, float *ratio_a[],
+                                        float *sum_a, float *ratio_b[], float *min_b[]);
+
+template <size_t tile, LAYOUT layout>
+void NHWCWinograd3x3PostProcess(float *out, float *intermedia_out, float *bias, size_t batch_size, size_t patch_y_num,
+                                size_t patch_x_num, size_t channel_out, size_t height_out, size_t width_out,
+                                bool conv_relu_fusion = false, bool conv_bn_fusion = false,
+                                bool conv_bn_relu_fusion = false, float *global_mean = NULL,
+                                float *mul_variance_coeff = NULL, float *scale = NULL, float *shift = NULL,
+                                float *residual = NULL);
+}
 
-void NHWCWinograd3x3ElementWiseBatchMul(float *intermedia_out, int8_t *transformed_kernel, uint8_t *transformed_data,
-                                        size_t batch_size, size_t patch_y_num, size_t patch_x_num, size_t channel_in,
-                                        size_t channel_out, float *ratio_a, float *sum_a, float *ratio_b, float *min_b);
+namespace pool {
 
-void NHWCWinograd3x3PostProcess(float *out, float *intermedia_out, size_t batch_size, size_t patch_y_num,
-                                size_t patch_x_num, size_t channel_out, size_t height_out, size_t width_out);
+template <LAYOUT layout>
+void Pool(float *dst, float *src, size_t batch_size, size_t channels, size_t height, size_t width, size_t height_out,
+          size_t width_out, size_t kernel_h, size_t kernel_w, size_t stride_h, size_t stride_w, size_t pad_h,
+          size_t pad_w, bool max_pool);
 }
 
 #include "find_extreme.h"
@@ -134,6 +220,10 @@ void NHWCWinograd3x3PostProcess(float *out, float *intermedia_out, size_t batch_
 #include "./shuffle/pad_shuffle.h"
 #include "./shuffle/shuffle_im2col.h"
 #include "./shuffle/shuffle_igemm.h"
+#include "./shuffle/shuffle_gemv.h"
 #include "./mixprecison_gemm.h"
 #include "./dot.h"
+#include "./depthwise_conv.h"
+#include "./winograd.h"
+#include "./pool.h"
 #endif
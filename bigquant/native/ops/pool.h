@@ -0,0 +1,79 @@
+/*
+ * Copyright 2016 The BigDL Authors.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef OPS_POOL_H
+#define OPS_POOL_H
+
+#include "../base.h"
+
+namespace pool {
+
+// Padded positions are skipped: they never win a max and are not counted by the average
+template <LAYOUT layout>
+void Pool(float *dst, float *src, size_t batch_size, size_t channels, size_t height, size_t width, size_t height_out,
+          size_t width_out, size_t kernel_h, size_t kernel_w, size_t stride_h, size_t stride_w, size_t pad_h,
+          size_t pad_w, bool max_pool) {
+  size_t stride_c = (layout == NCHW) ? height * width : 1;
+  size_t stride_x = (layout == NCHW) ? 1 : channels;
+  size_t out_stride_c = (layout == NCHW) ? height_out * width_out : 1;
+  size_t out_stride_x = (layout == NCHW) ? 1 : channels;
+#pragma omp parallel for collapse(2)
+  for (size_t n = 0; n < batch_size; ++n) {
+    for (size_t y = 0; y < height_out; ++y) {
+      float *image = src + n * channels * height * width;
+      float *out_image = dst + n * channels * height_out * width_out;
+      size_t y_begin = (y * stride_h < pad_h) ? 0 : y * stride_h - pad_h;
+      size_t y_end = std::min(y * stride_h + kernel_h - pad_h, height);
+      for (size_t x = 0; x < width_out; ++x) {
+        size_t x_begin = (x * stride_w < pad_w) ? 0 : x * stride_w - pad_w;
+        size_t x_end = std::min(x * stride_w + kernel_w - pad_w, width);
+        float count = static_cast<float>((y_end - y_begin) * (x_end - x_begin));
+        for (size_t c = 0; c < channels; ++c) {
+          float acc = max_pool ? -FLT_MAX : 0.0f;
+          for (size_t yy = y_begin; yy < y_end; ++yy) {
+            for (size_t xx = x_begin; xx < x_end; ++xx) {
+              float v = image[c * stride_c + (yy * width + xx) * stride_x];
+              acc = max_pool ? std::max(acc, v) : acc + v;
+            }
+          }
+          out_image[c * out_stride_c + (y * width_out + x) * out_stride_x] = max_pool ? acc : acc / count;
+        }
+      }
+    }
+  }
+}
+
+}
+
+namespace eltwise {
+
+inline void Sum(float *dst, float *a, float *b, size_t length, bool relu) {
+#pragma omp parallel for
+  for (size_t i = 0; i < length; ++i) {
+    float v = a[i] + b[i];
+    dst[i] = (relu && v < 0.0f) ? 0.0f : v;
+  }
+}
+
+inline void ReLU(float *dst, float *src, size_t length) {
+#pragma omp parallel for
+  for (size_t i = 0; i < length; ++i) {
+    dst[i] = (src[i] < 0.0f) ? 0.0f : src[i];
+  }
+}
+}
+
+#endif
@@ -142,6 +142,36 @@ INLINE_SPECIFIER void INLINE_ATTRIBUTE SSE42Kernel16Quantize(uint8_t *dst, float
 }
 #endif
 
+// dst = round(src * scale + shift) saturated to [0, upper]. The range behind scale and shift is fixed ahead of the
+// data, static quantization and requantization, so unlike the kernels above the result is clamped.
+static INLINE_SPECIFIER void INLINE_ATTRIBUTE SaturateQuantize(uint8_t *dst, const float *src, size_t length,
+                                                               float scale, float shift, float upper) {
+  __m128 simd_scale = _mm_set1_ps(scale);
+  __m128 simd_shift = _mm_set1_ps(shift);
+  __m128 low = _mm_setzero_ps();
+  __m128 high = _mm_set1_ps(upper);
+  auto quantize = [&](const float *p) {
+    __m128 q = _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(p), simd_scale), simd_shift);
+    return _mm_cvtps_epi32(_mm_min_ps(_mm_max_ps(q, low), high));
+  };
+  size_t i = 0;
+  for (; i + 16 <= length; i += 16) {
+    __m128i v0 = _mm_packs_epi32(quantize(src + i), quantize(src + i + 4));
+    __m128i v1 = _mm_packs_epi32(quantize(src + i + 8), quantize(src + i + 12));
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i), _mm_packus_epi16(v0, v1));
+  }
+  for (; i + 4 <= length; i += 4) {
+    __m128i v = quantize(src + i);
+    v = _mm_packus_epi16(_mm_packs_epi32(v, v), v);
+    int32_t packed = _mm_cvtsi128_si32(v);
+    memcpy(dst + i, &packed, sizeof(packed));
+  }
+  for (; i < length; ++i) {
+    __m128 q = _mm_add_ss(_mm_mul_ss(_mm_load_ss(src + i), simd_scale), simd_shift);
+    dst[i] = static_cast<uint8_t>(_mm_cvtss_si32(_mm_min_ss(_mm_max_ss(q, low), high)));
+  }
+}
+
 template <typename SrcType>
 void PadQuantize(int8_t *dst, size_t length, size_t pad_length, SrcType *src, SrcType &min, SrcType &max,
                  SrcType &ratio, float threshold) {
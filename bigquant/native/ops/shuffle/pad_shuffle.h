@@ -18,6 +18,7 @@
 #define PAD_SHUFFLE_H
 
 #include "../../base.h"
+#include "../../trace.h"
 namespace shuffle {
 template <typename DType, size_t shuffle_rows, size_t shuffle_cols>
 void PadShuffle2D(DType *dst, size_t m, size_t n, DType *src) {
@@ -104,30 +105,68 @@ void PadQuantizeShuffle2D(uint8_t *dst, size_t m, size_t n, size_t pad_m, size_t
   assert(GetAlignmentLength(n, shuffle_cols) == pad_n);
   size_t shuffle_cols_num = n / shuffle_cols * shuffle_cols;
   size_t patch_size = shuffle_cols * shuffle_rows;
+#pragma omp parallel proc_bind(close)
+  {
+    TraceScope trace("quantize");
+#pragma omp for
+    for (size_t i = 0; i < pad_m; ++i) {
+      size_t x_block_id = i / shuffle_rows;
+      size_t offset_in_block = (i % shuffle_rows) * shuffle_cols;
+      size_t dst_index = x_block_id * shuffle_rows * pad_n + offset_in_block;
+      size_t src_index = i * n;
+      bool iltm = (i < m);
+      size_t j;
+      if (iltm) {  // i lt m; FindMinMaxValue; GetRatio and Quantize
+        FindMinMaxValue(src + src_index, n, min[i], max[i]);
+        DType scale = sw_threshold / (max[i] - min[i]);
+        ratio[i] = 1.0 / scale;
+        for (j = 0; j < shuffle_cols_num; j += shuffle_cols) {
+          for (size_t k = 0; k < shuffle_cols; ++k) {
+            dst[dst_index + k] = static_cast<uint8_t>(std::round((src[src_index + k] - min[i]) * scale));
+          }
+          dst_index += patch_size;
+          src_index += shuffle_cols;
+        }
+        for (j = shuffle_cols_num; j < n; ++j) {
+          dst[dst_index++] = static_cast<uint8_t>(std::round((src[src_index++] - min[i]) * scale));
+        }
+        memset(&dst[dst_index], 0, pad_n - n);
+      } else {  // i >= m; memset;
+        for (j = 0; j < shuffle_cols_num; j += shuffle_cols) {
+          memset(&dst[dst_index], 0, shuffle_cols);
+          dst_index += patch_size;
+        }
+        memset(&dst[dst_index], 0, pad_n - shuffle_cols_num);
+      }
+    }
+  }
+}
+
+// Static quantization: every row is quantized with the same scale and zero point, see SaturateQuantize
+template <size_t shuffle_rows, size_t shuffle_cols>
+void StaticQuantizeShuffle2D(uint8_t *dst, size_t m, size_t n, size_t pad_m, size_t pad_n, const float *src,
+                             float scale, float zero_point, float sw_threshold) {
+  assert(GetAlignmentLength(m, shuffle_rows) == pad_m);
+  assert(GetAlignmentLength(n, shuffle_cols) == pad_n);
+  size_t shuffle_cols_num = n / shuffle_cols * shuffle_cols;
+  size_t patch_size = shuffle_cols * shuffle_rows;
 #pragma omp parallel for proc_bind(close)
   for (size_t i = 0; i < pad_m; ++i) {
-    size_t x_block_id = i / shuffle_rows;
-    size_t offset_in_block = (i % shuffle_rows) * shuffle_cols;
-    size_t dst_index = x_block_id * shuffle_rows * pad_n + offset_in_block;
+    size_t dst_index = i / shuffle_rows * shuffle_rows * pad_n + (i % shuffle_rows) * shuffle_cols;
     size_t src_index = i * n;
-    bool iltm = (i < m);
     size_t j;
-    if (iltm) {  // i lt m; FindMinMaxValue; GetRatio and Quantize
-      FindMinMaxValue(src + src_index, n, min[i], max[i]);
-      DType scale = sw_threshold / (max[i] - min[i]);
-      ratio[i] = 1.0 / scale;
+    if ((i < m) && (shuffle_rows == 1)) {  // the row is contiguous
+      SaturateQuantize(dst + dst_index, src + src_index, n, scale, zero_point, sw_threshold);
+      memset(&dst[dst_index + n], 0, pad_n - n);
+    } else if (i < m) {
       for (j = 0; j < shuffle_cols_num; j += shuffle_cols) {
-        for (size_t k = 0; k < shuffle_cols; ++k) {
-          dst[dst_index + k] = static_cast<uint8_t>(std::round((src[src_index + k] - min[i]) * scale));
-        }
+        SaturateQuantize(dst + dst_index, src + src_index, shuffle_cols, scale, zero_point, sw_threshold);
         dst_index += patch_size;
         src_index += shuffle_cols;
       }
-      for (j = shuffle_cols_num; j < n; ++j) {
-        dst[dst_index++] = static_cast<uint8_t>(std::round((src[src_index++] - min[i]) * scale));
-      }
-      memset(&dst[dst_index], 0, pad_n - n);
-    } else {  // i >= m; memset;
+      SaturateQuantize(dst + dst_index, src + src_index, n - shuffle_cols_num, scale, zero_point, sw_threshold);
+      memset(&dst[dst_index + n - shuffle_cols_num], 0, pad_n - n);
+    } else {
       for (j = 0; j < shuffle_cols_num; j += shuffle_cols) {
         memset(&dst[dst_index], 0, shuffle_cols);
         dst_index += patch_size;
@@ -177,5 +216,61 @@ void PadQuantizeShuffle2D(int8_t *dst, size_t m, size_t n, size_t pad_m, size_t
     }
   }
 }
+
+// Repacks int8 rows a model quantized symmetrically, row i with the scale 127 / max(|src_min[i]|, |src_max[i]|), the
+// way PadQuantizeShuffle2D packs their dequantized values, without going through float rows. The largest magnitude of
+// a row maps to sw_threshold; rows already at that scale are copied, the others rescaled through a lookup table.
+template <size_t shuffle_rows, size_t shuffle_cols>
+void PadRescaleShuffle2D(int8_t *dst, size_t m, size_t n, size_t pad_m, size_t pad_n, const int8_t *src,
+                         const float *src_min, const float *src_max, float *min, float *max, float *ratio,
+                         float sw_threshold) {
+  assert(GetAlignmentLength(m, shuffle_rows) == pad_m);
+  assert(GetAlignmentLength(n, shuffle_cols) == pad_n);
+  size_t shuffle_cols_num = n / shuffle_cols * shuffle_cols;
+  size_t patch_size = shuffle_cols * shuffle_rows;
+#pragma omp parallel for proc_bind(close)
+  for (size_t i = 0; i < pad_m; ++i) {
+    size_t dst_index = i / shuffle_rows * shuffle_rows * pad_n + (i % shuffle_rows) * shuffle_cols;
+    size_t j;
+    if (i >= m) {
+      for (j = 0; j < shuffle_cols_num; j += shuffle_cols) {
+        memset(&dst[dst_index], 0, shuffle_cols);
+        dst_index += patch_size;
+      }
+      memset(&dst[dst_index], 0, pad_n - shuffle_cols_num);
+      continue;
+    }
+    const int8_t *row = src + i * n;
+    // FindMinMaxValue starts from +-FLT_MAX, which int8_t can't hold
+    std::pair<const int8_t *, const int8_t *> extremes = std::minmax_element(row, row + n);
+    int8_t row_min = *extremes.first;
+    int8_t row_max = *extremes.second;
+    float step = std::max(std::abs(src_min[i]), std::abs(src_max[i])) / 127.0f;
+    int peak = std::max(static_cast<int>(row_max), -static_cast<int>(row_min));
+    min[i] = row_min * step;
+    max[i] = row_max * step;
+    ratio[i] = peak * step / sw_threshold;
+    bool copy = (static_cast<float>(peak) == sw_threshold);
+    int8_t table[256];
+    if (!copy) {
+      float scale = (peak == 0) ? 0.0f : sw_threshold / peak;
+      for (int v = row_min; v <= row_max; ++v) {
+        table[v + 128] = static_cast<int8_t>(std::round(v * scale));
+      }
+    }
+    for (j = 0; j < n; j += shuffle_cols) {
+      size_t cols = std::min(shuffle_cols, n - j);
+      if (copy) {
+        memcpy(&dst[dst_index], row + j, cols);
+      } else {
+        for (size_t k = 0; k < cols; ++k) {
+          dst[dst_index + k] = table[row[j + k] + 128];
+        }
+      }
+      dst_index += (cols == shuffle_cols) ? patch_size : cols;
+    }
+    memset(&dst[dst_index], 0, pad_n - n);
+  }
+}
 }
 #endif
@@ -0,0 +1,81 @@
+/*
+ * Copyright 2016 The BigDL Authors.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef OPS_SHUFFLE_GEMV_H
+#define OPS_SHUFFLE_GEMV_H
+
+#include "../../base.h"
+#include "../../trace.h"
+#include "../../tensor.h"
+#include "../kernel/shuffle_gemv.h"
+
+namespace shuffle {
+
+template <size_t kernel_m, size_t kernel_k, size_t n>
+void ShuffleGEMVImpl(int8_t *pa, uint8_t *pb, float *pc, size_t m, size_t k, float *ratio_a, float *ratio_b,
+                     float *kernel_sum, float *min_b, float *bias, size_t pad_m,
+                     const NumaReplicas<int8_t> *pa_replicas) {
+  size_t valid_m = m - pad_m;
+  size_t blocks = m / kernel_m;
+#pragma omp parallel
+  {
+    TraceScope trace("gemv_blocks");
+    int8_t *local_a = (pa_replicas == NULL) ? pa : pa_replicas->Local(pa);
+#pragma omp for schedule(static) nowait
+    for (size_t block = 0; block < blocks; ++block) {
+      size_t i_index = block * kernel_m;
+      if (i_index >= valid_m) {
+        continue;
+      }
+      uint8_t *columns[n];
+      for (size_t j = 0; j < n; ++j) {
+        columns[j] = pb + j * k;
+      }
+      int result[n][kernel_m];
+      kernel::gemv::ApplyKernel<kernel_m, kernel_k, n>(local_a + i_index * k, columns, k, result);
+      kernel::gemv::FMAResult<kernel_m, n>(result, pc, valid_m, i_index, std::min(kernel_m, valid_m - i_index),
+                                           ratio_a, ratio_b, kernel_sum, min_b, bias);
+    }
+  }
+}
+
+template <size_t kernel_m, size_t kernel_k>
+void ShuffleGEMV(int8_t *pa, uint8_t *pb, float *pc, size_t m, size_t n, size_t k, float *ratio_a, float *ratio_b,
+                 float *kernel_sum, float *min_b, float *bias, size_t pad_m, const NumaReplicas<int8_t> *pa_replicas) {
+  assert((n >= 1) && (n <= 4));
+  assert((m % kernel_m == 0) && (k % kernel_k == 0));
+  switch (n) {
+    case 1:
+      ShuffleGEMVImpl<kernel_m, kernel_k, 1>(pa, pb, pc, m, k, ratio_a, ratio_b, kernel_sum, min_b, bias, pad_m,
+                                             pa_replicas);
+      break;
+    case 2:
+      ShuffleGEMVImpl<kernel_m, kernel_k, 2>(pa, pb, pc, m, k, ratio_a, ratio_b, kernel_sum, min_b, bias, pad_m,
+                                             pa_replicas);
+      break;
+    case 3:
+      ShuffleGEMVImpl<kernel_m, kernel_k, 3>(pa, pb, pc, m, k, ratio_a, ratio_b, kernel_sum, min_b, bias, pad_m,
+                                             pa_replicas);
+      break;
+    default:
+      ShuffleGEMVImpl<kernel_m, kernel_k, 4>(pa, pb, pc, m, k, ratio_a, ratio_b, kernel_sum, min_b, bias, pad_m,
+                                             pa_replicas);
+      break;
+  }
+}
+}
+
+#endif
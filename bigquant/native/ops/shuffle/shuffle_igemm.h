@@ -19,6 +19,8 @@
 
 #include "../../base.h"
 #include "../../common.h"
+#include "../../tensor.h"
+#include "../../perf_counters.h"
 #include "../kernel-common.h"
 #define UNROLL_NUM 4
 
@@ -53,6 +55,9 @@ void ShuffleGEMM(int8_t *pa, uint8_t *pb, int *pc, size_t m, size_t n, size_t k,
 #pragma omp for collapse(2) schedule(dynamic) nowait
         for (size_t y2 = 0; y2 < blocks[2]; y2 += blocks[4]) {
           for (size_t x2 = 0; x2 < blocks[3]; x2 += blocks[5]) {
+            // one L2 block of C, its first row i and column j
+            TraceScope trace("gemm_block");
+            trace.Arg("i", mltn ? x3 + x2 : y3 + y2).Arg("j", mltn ? y3 + y2 : x3 + x2);
             for (size_t y1 = 0; y1 < blocks[4]; y1 += blocks[6]) {
               for (size_t x1 = 0; x1 < blocks[5]; x1 += blocks[7]) {
                 for (size_t y0 = 0; y0 < blocks[6]; y0 += blocks[8]) {
@@ -91,6 +96,7 @@ void InternalMixPrecisionGemm(ORDER order, enum TRANSPOSE transA, enum TRANSPOSE
   assert(order == 101);   // We use RowMajor and only support RowMajor
   assert(transA == 111);  // A is not transposed.
   assert(transB == 112);  // B is transposed.
+  PerfScope perf(PERF_MIX_PRECISION_GEMM, 2ull * m * n * k);
   size_t m_out = GetAlignmentLength(m, kernel_m);
   size_t k_out = GetAlignmentLength(k, kernel_k);
   size_t n_out = GetAlignmentLength(n, kernel_n);
@@ -100,18 +106,12 @@ void InternalMixPrecisionGemm(ORDER order, enum TRANSPOSE transA, enum TRANSPOSE
   aligned_malloc(reinterpret_cast<void **>(&pad_b), 64, sizeof(uint8_t) * n_out * k_out);
   PadShuffle2D<int8_t, kernel_m, kernel_k>(pad_a, m, k, a);
   PadShuffle2D<uint8_t, kernel_n, kernel_k>(pad_b, n, k, b);
-#ifdef TIME_PROFILE
-  auto start = std::chrono::system_clock::now();
-#endif
-  // TODO(yandai) better wrapper
-  ShuffleGEMM<kernel_m, kernel_n, kernel_k>(pad_a, pad_b, c, m_out, n_out, k_out, fault_tolerance, m_out - m, n_out - n,
-                                            kernel);
-#ifdef TIME_PROFILE
-  auto end = std::chrono::system_clock::now();
-  auto diff = std::chrono::duration_cast<std::chrono::microseconds>(end - start);
-  std::cerr << std::endl << "time = " << diff.count() << "us" << std::endl;
-  std::cerr << "flops = " << (2.0 * m * n * k / (diff.count() / 1.0e6)) / 1.0e9 << std::endl;
-#endif
+  {
+    PerfScope gemm_perf(PERF_GEMM, 2ull * m * n * k);
+    // TODO(yandai) better wrapper
+    ShuffleGEMM<kernel_m, kernel_n, kernel_k>(pad_a, pad_b, c, m_out, n_out, k_out, fault_tolerance, m_out - m,
+                                              n_out - n, kernel);
+  }
   aligned_free(pad_a);
   aligned_free(pad_b);
 }
@@ -121,26 +121,26 @@ static INLINE_SPECIFIER void INLINE_ATTRIBUTE QuantizedGemmSelect(
     int8_t *&pa, uint8_t *&pb, size_t k, float fault_tolerance, float *result[], size_t length, size_t valid_lanes,
     size_t i_index, size_t j_index, float *ratio_a, float *ratio_b, float *min_b, float *kernel_sum, float *bias,
     bool conv_relu_fusion, bool conv_bn_fusion, bool conv_bn_relu_fusion, bool conv_relu_bn_fusion, float *global_mean,
-    float *mul_variance_coeff, float *scale, float *shift, bool is_block) {
+    float *mul_variance_coeff, float *scale, float *shift, float *residual[], bool is_block) {
 #if defined(AVX512)
   if ((kernel_m == 8) && (kernel_n == 8) && (kernel_k == 8)) {
     kernel::avx512_igemm8x8x8::ApplyKernelWrapper<kernel_m, kernel_n, kernel_k, layout>(
         pa, pb, k, fault_tolerance, result, length, valid_lanes, i_index, j_index, ratio_a, ratio_b, min_b, kernel_sum,
         bias, conv_relu_fusion, conv_bn_fusion, conv_bn_relu_fusion, conv_relu_bn_fusion, global_mean,
-        mul_variance_coeff, scale, shift, is_block);
+        mul_variance_coeff, scale, shift, residual, is_block);
   }
 #elif defined(__AVX2__)
   if ((kernel_m == 4) && (kernel_n == 8) && (kernel_k == 8)) {
     kernel::igemm4xn::ApplyKernelWrapper<kernel_m, kernel_n, kernel_k, layout>(
         pa, pb, k, fault_tolerance, result, length, valid_lanes, i_index, j_index, ratio_a, ratio_b, min_b, kernel_sum,
         bias, conv_relu_fusion, conv_bn_fusion, conv_bn_relu_fusion, conv_relu_bn_fusion, global_mean,
-        mul_variance_coeff, scale, shift, is_block);
+        mul_variance_coeff, scale, shift, residual, is_block);
   }
   if ((kernel_m == 4) && (kernel_n == 1) && (kernel_k == 32)) {
     kernel::igemm4x1::ApplyKernelWrapper<kernel_m, kernel_n, kernel_k, layout>(
         pa, pb, k, fault_tolerance, result, length, valid_lanes, i_index, j_index, ratio_a, ratio_b, min_b, kernel_sum,
         bias, conv_relu_fusion, conv_bn_fusion, conv_bn_relu_fusion, conv_relu_bn_fusion, global_mean,
-        mul_variance_coeff, scale, shift, is_block);
+        mul_variance_coeff, scale, shift, residual, is_block);
   }
 #else
   /*
@@ -158,7 +158,7 @@ static INLINE_SPECIFIER void INLINE_ATTRIBUTE QuantizedGemmSelect(
     kernel::sse42_igemm2x2x16::ApplyKernelWrapper<kernel_m, kernel_n, kernel_k, layout>(
         pa, pb, k, fault_tolerance, result, length, valid_lanes, i_index, j_index, ratio_a, ratio_b, min_b, kernel_sum,
         bias, conv_relu_fusion, conv_bn_fusion, conv_bn_relu_fusion, conv_relu_bn_fusion, global_mean,
-        mul_variance_coeff, scale, shift, is_block);
+        mul_variance_coeff, scale, shift, residual, is_block);
   }
 #endif
 }
@@ -235,67 +235,279 @@ static INLINE_SPECIFIER int INLINE_ATTRIBUTE NCHWRTGenrateTargetAddr(
 #endif
 }
 
-#if defined(LLC_SHARED)
+// uint8 output of ConvShuffleGEMM. The epilogue stores saturate(round(y / scale) + zero_point) for every element y of
+// the fused float result, in the layout of the float output. upper_ is the largest value stored, the threshold of the
+// static quantization when a following convolution reads the bytes as its input.
+struct Requantization {
+  uint8_t *dst_;
+  float inv_scale_;
+  float zero_point_;
+  float upper_;
+};
+
+// Register tiles of a requantized GEMM are stored to a dense scratch tile instead of the output, in the form the
+// kernel expects for is_block: rows of kernel_n for NCHW and columns of kernel_m for NHWC.
+template <size_t kernel_m, size_t kernel_n, LAYOUT layout>
+static INLINE_SPECIFIER void INLINE_ATTRIBUTE TileTargetAddr(float *result[], float *tile, bool is_block) {
+  if (is_block && (layout == NHWC)) {
+    for (size_t ky = 0; ky < kernel_n; ++ky) {
+      result[ky * kernel_m] = tile + ky * kernel_m;
+    }
+    return;
+  }
+  for (size_t kx = 0; kx < kernel_m; ++kx) {
+    for (size_t ky = 0; ky < kernel_n; ++ky) {
+      result[kx * kernel_n + ky] = tile + ((layout == NCHW) ? kx * kernel_n + ky : ky * kernel_m + kx);
+    }
+  }
+}
+
+// Whether the kernel can store a full tile at once. The scratch tile is dense, so unlike the output it never splits
+// at an image boundary.
+template <size_t kernel_m, size_t kernel_n, size_t kernel_k>
+static INLINE_SPECIFIER bool INLINE_ATTRIBUTE IsBlockTile(size_t rows, size_t cols) {
+  float tile[kernel_m * kernel_n];
+  float *result[kernel_m * kernel_n];
+  return NHWCRTGenrateTargetAddr<float, kernel_m, kernel_n, kernel_k>(result, tile, rows, cols, 0, 0, 0, kernel_m,
+                                                                      kernel_m);
+}
+
+// Offsets of the rows (output channels) and columns (output pixels) of a tile in the requantized output
 template <size_t kernel_m, size_t kernel_n, size_t kernel_k, LAYOUT layout>
-void ConvShuffleGEMM(int8_t *pa, uint8_t *pb, float *pc, size_t m, size_t n, size_t k, float *ratio_a, float *ratio_b,
-                     float *kernel_sum, float *min_b, float *bias, size_t batch_size, size_t groups,
-                     size_t channel_per_group, size_t cur_group, size_t height_out, size_t width_out,
-                     float fault_tolerance, size_t pad_m, size_t pad_n, bool conv_relu_fusion, bool conv_bn_fusion,
-                     bool conv_bn_relu_fusion, bool conv_relu_bn_fusion, float *global_mean, float *mul_variance_coeff,
-                     float *scale, float *shift) {
-#ifdef TIME_PROFILE
-  auto start = std::chrono::system_clock::now();
-#endif
-  assert((fault_tolerance <= 1.0f) && (fault_tolerance >= 0.0f));
-  assert((layout == NCHW) || (layout == NHWC));
-  size_t feature_map_size_per_channel = height_out * width_out;
-  size_t total_channels = channel_per_group * groups;
-  size_t feature_map_size_per_image = total_channels * height_out * width_out;
-  size_t feature_map_size_per_group = height_out * width_out * channel_per_group;
+static INLINE_SPECIFIER void INLINE_ATTRIBUTE RequantizeOffsets(size_t row[], size_t col[], size_t rows, size_t cols,
+                                                                size_t channel, size_t pixel, size_t total_channels,
+                                                                size_t feature_map_size_per_channel) {
+  for (size_t kx = 0; kx < rows; ++kx) {
+    size_t c = channel + kx;
+    row[kx] = (layout == NCHW) ? c * feature_map_size_per_channel : c;
+  }
+  for (size_t ky = 0; ky < cols; ++ky) {
+    size_t p = pixel + ky;
+    if (layout == NCHW) {
+      col[ky] = p / feature_map_size_per_channel * total_channels * feature_map_size_per_channel +
+                p % feature_map_size_per_channel;
+    } else {
+      col[ky] = p * total_channels;
+    }
+  }
+}
+
+// Requantizes length floats to consecutive bytes. Rounds to nearest even like the SIMD conversion.
+static INLINE_SPECIFIER void INLINE_ATTRIBUTE RequantizeRun(uint8_t *dst, const float *src, size_t length,
+                                                            const Requantization &requant) {
+  SaturateQuantize(dst, src, length, requant.inv_scale_, requant.zero_point_, requant.upper_);
+}
+
+// Runs of the tile that are consecutive in the output, the channels of a pixel in NHWC and the pixels of a channel in
+// NCHW, are requantized at once. The offsets grow with the index, so a run is consecutive iff its ends are.
+template <size_t kernel_m, size_t kernel_n, LAYOUT layout>
+static INLINE_SPECIFIER void INLINE_ATTRIBUTE RequantizeTile(const Requantization &requant, const float *tile,
+                                                             size_t rows, size_t cols, const size_t *row,
+                                                             const size_t *col) {
+  if ((layout == NHWC) && (row[rows - 1] - row[0] == rows - 1)) {
+    for (size_t ky = 0; ky < cols; ++ky) {
+      RequantizeRun(requant.dst_ + col[ky] + row[0], tile + ky * kernel_m, rows, requant);
+    }
+  } else if ((layout == NCHW) && (col[cols - 1] - col[0] == cols - 1)) {
+    for (size_t kx = 0; kx < rows; ++kx) {
+      RequantizeRun(requant.dst_ + row[kx] + col[0], tile + kx * kernel_n, cols, requant);
+    }
+  } else {
+    for (size_t kx = 0; kx < rows; ++kx) {
+      for (size_t ky = 0; ky < cols; ++ky) {
+        RequantizeRun(requant.dst_ + row[kx] + col[ky],
+                      tile + ((layout == NCHW) ? kx * kernel_n + ky : ky * kernel_m + kx), 1, requant);
+      }
+    }
+  }
+}
+
+// Block sizes and loop order of the ConvShuffleGEMM loop nest: {outer, inner, outer/inner L3, L2, L1, tile}
+template <size_t kernel_m, size_t kernel_n>
+INLINE_SPECIFIER void GetGemmBlocks(size_t m, size_t n, size_t k, const GemmTuning *tuning,
+                                    std::array<size_t, 10> &blocks, bool &mltn) {
   size_t m_in_l1, m_in_l2, m_in_l3, n_in_l1, n_in_l2, n_in_l3;
   GetBlocksInfo<kernel_m>(m, k, m_in_l1, m_in_l2, m_in_l3);
   GetBlocksInfo<kernel_n>(n, k, n_in_l1, n_in_l2, n_in_l3);
-  size_t valid_m = m - pad_m;
-  size_t valid_n = n - pad_n;
-  bool mltn = m < n;
-  std::array<size_t, 10> blocks1 = {n, m, n_in_l3, m_in_l3, n_in_l2, m_in_l2, n_in_l1, m_in_l1, kernel_n, kernel_m};
-  std::array<size_t, 10> blocks2 = {m, n, m_in_l3, n_in_l3, m_in_l2, n_in_l2, m_in_l1, n_in_l1, kernel_m, kernel_n};
-  std::array<size_t, 10> &blocks = (mltn) ? blocks1 : blocks2;
-#pragma omp parallel proc_bind(close)
-  {
-    for (size_t y3 = 0; y3 < blocks[0]; y3 += blocks[2]) {
-      for (size_t x3 = 0; x3 < blocks[1]; x3 += blocks[3]) {
-#pragma omp for collapse(2) schedule(dynamic, 4) nowait
-        for (size_t y2 = 0; y2 < blocks[2]; y2 += blocks[4]) {
-          for (size_t x2 = 0; x2 < blocks[3]; x2 += blocks[5]) {
-            for (size_t y1 = 0; y1 < blocks[4]; y1 += blocks[6]) {
-              for (size_t x1 = 0; x1 < blocks[5]; x1 += blocks[7]) {
-                for (size_t y0 = 0; y0 < blocks[6]; y0 += blocks[8]) {
-                  for (size_t x0 = 0; x0 < blocks[7]; x0 += blocks[9]) {
-                    auto y_sum = y3 + y2 + y1 + y0;
-                    auto x_sum = x3 + x2 + x1 + x0;
-                    auto j_index = mltn ? y_sum : x_sum;
-                    auto i_index = mltn ? x_sum : y_sum;
-                    if ((j_index < n) && (i_index < m)) {
-                      float *result[kernel_m * kernel_n];
-                      int8_t *local_pa = pa + i_index * k;
-                      uint8_t *local_pb = pb + j_index * k;
-                      bool is_block;
-                      if (layout == NCHW) {
-                        is_block = NCHWRTGenrateTargetAddr<float, kernel_m, kernel_n, kernel_k>(
-                            result, pc, valid_m, valid_n, i_index, j_index, cur_group, feature_map_size_per_image,
-                            feature_map_size_per_group, feature_map_size_per_channel);
-                      } else {
-                        is_block = NHWCRTGenrateTargetAddr<float, kernel_m, kernel_n, kernel_k>(
-                            result, pc, valid_m, valid_n, i_index, j_index, cur_group, channel_per_group,
-                            total_channels);
-                      }
-                      QuantizedGemmSelect<kernel_m, kernel_n, kernel_k, layout>(
-                          local_pa, local_pb, k, fault_tolerance, result, std::min(valid_m - i_index, kernel_m),
-                          std::min(valid_n - j_index, kernel_n), i_index, j_index, ratio_a, ratio_b, min_b, kernel_sum,
-                          bias, conv_relu_fusion, conv_bn_fusion, conv_bn_relu_fusion, conv_relu_bn_fusion, global_mean,
-                          mul_variance_coeff, scale, shift, is_block);
-                    }
+  ApplyGemmTuning<kernel_m>(tuning, m, m_in_l1, m_in_l2, m_in_l3);
+  ApplyGemmTuning<kernel_n>(tuning, n, n_in_l1, n_in_l2, n_in_l3);
+  mltn = GemmLoopNOuter(tuning, m, n);
+  if (mltn) {
+    blocks = {n, m, n_in_l3, m_in_l3, n_in_l2, m_in_l2, n_in_l1, m_in_l1, kernel_n, kernel_m};
+  } else {
+    blocks = {m, n, m_in_l3, n_in_l3, m_in_l2, n_in_l2, m_in_l1, n_in_l1, kernel_m, kernel_n};
+  }
+}
+
+// A GemmPlan fixes the schedule statically, so a tuned dynamic or guided schedule keeps the runtime loop nest
+INLINE_SPECIFIER bool UseGemmPlan(const GemmTuning *tuning) {
+  return (tuning == NULL) || (tuning->schedule_ == GEMM_SCHEDULE_DEFAULT) ||
+         (tuning->schedule_ == GEMM_SCHEDULE_STATIC);
+}
+
+struct GemmTile {
+  uint32_t i_;
+  uint32_t j_;
+  uint32_t is_block_;
+};
+
+// Precomputed execution of one ConvShuffleGEMM shape. Layer shapes don't change between calls, so the blocking, the
+// tile walk with its ownership checks and the per-thread split are done once and Execute only replays the tile list.
+// Output addresses are separable into a row and a column offset for both layouts, which removes the per-element
+// div/mod of the NCHW address generation.
+struct GemmPlan {
+  GemmPlan() : layout_(NCHW), m_(0), n_(0), k_(0), threads_(0) {
+  }
+
+  bool Matches(LAYOUT layout, size_t m, size_t n, size_t k, size_t pad_m, size_t pad_n, size_t groups,
+               size_t channel_per_group, size_t cur_group, size_t height_out, size_t width_out,
+               const GemmTuning *tuning) const {
+    GemmTuning t = (tuning == NULL) ? GemmTuning() : *tuning;
+    return (threads_ == GetThreadsNumWrapper()) && (layout_ == layout) && (m_ == m) && (n_ == n) && (k_ == k) &&
+           (valid_m_ == m - pad_m) && (valid_n_ == n - pad_n) && (groups_ == groups) &&
+           (channel_per_group_ == channel_per_group) && (cur_group_ == cur_group) && (height_out_ == height_out) &&
+           (width_out_ == width_out) && (tuning_.loop_order_ == t.loop_order_) &&
+           (tuning_.block_shift_[0] == t.block_shift_[0]) && (tuning_.block_shift_[1] == t.block_shift_[1]) &&
+           (tuning_.block_shift_[2] == t.block_shift_[2]);
+  }
+
+  void Clear() {
+    threads_ = 0;
+    std::vector<GemmTile>().swap(tiles_);
+    std::vector<size_t>().swap(thread_begin_);
+    std::vector<size_t>().swap(row_offset_);
+    std::vector<size_t>().swap(col_offset_);
+  }
+
+  LAYOUT layout_;
+  size_t m_;
+  size_t n_;
+  size_t k_;
+  size_t valid_m_;
+  size_t valid_n_;
+  size_t groups_;
+  size_t channel_per_group_;
+  size_t cur_group_;
+  size_t height_out_;
+  size_t width_out_;
+  GemmTuning tuning_;
+  size_t threads_;
+  std::vector<GemmTile> tiles_;       // tiles of thread t are [thread_begin_[t], thread_begin_[t + 1])
+  std::vector<size_t> thread_begin_;
+  std::vector<size_t> row_offset_;    // output offset of row i of C, i.e. of an output channel
+  std::vector<size_t> col_offset_;    // output offset of column j of C, i.e. of an output pixel
+};
+
+// Walks the same loop nest as ConvShuffleGEMM. With an exclusive LLC the L2 blocks of the whole GEMM are split into
+// contiguous per-thread runs, with a shared LLC those of every L3 block, so the team still sweeps one L3 block at a
+// time. Runs are balanced by tile count.
+// In NUMA mode an L2 block first goes to the node of the thread that packed its first column of B (the packing loops
+// split the columns statically over the team), then to one of that node's threads, so every node works on its own
+// share of the activations and the output.
+template <size_t kernel_m, size_t kernel_n, LAYOUT layout>
+void BuildGemmPlan(GemmPlan &plan, size_t m, size_t n, size_t k, size_t pad_m, size_t pad_n, size_t groups,
+                   size_t channel_per_group, size_t cur_group, size_t height_out, size_t width_out,
+                   const GemmTuning *tuning) {
+  plan.Clear();
+  plan.layout_ = layout;
+  plan.m_ = m;
+  plan.n_ = n;
+  plan.k_ = k;
+  plan.valid_m_ = m - pad_m;
+  plan.valid_n_ = n - pad_n;
+  plan.groups_ = groups;
+  plan.channel_per_group_ = channel_per_group;
+  plan.cur_group_ = cur_group;
+  plan.height_out_ = height_out;
+  plan.width_out_ = width_out;
+  plan.tuning_ = (tuning == NULL) ? GemmTuning() : *tuning;
+  plan.threads_ = GetThreadsNumWrapper();
+
+  size_t feature_map_size_per_channel = height_out * width_out;
+  size_t total_channels = channel_per_group * groups;
+  size_t feature_map_size_per_image = total_channels * feature_map_size_per_channel;
+  size_t feature_map_size_per_group = channel_per_group * feature_map_size_per_channel;
+  plan.row_offset_.resize(m);
+  plan.col_offset_.resize(n);
+  for (size_t i = 0; i < m; ++i) {
+    plan.row_offset_[i] = (layout == NCHW) ? cur_group * feature_map_size_per_group + i * feature_map_size_per_channel
+                                           : cur_group * channel_per_group + i;
+  }
+  for (size_t j = 0; j < n; ++j) {
+    plan.col_offset_[j] = (layout == NCHW) ? (j / feature_map_size_per_channel) * feature_map_size_per_image +
+                                                 j % feature_map_size_per_channel
+                                           : j * total_channels;
+  }
+
+  // kernels with a block store path, see the *RTGenrateTargetAddr of each ISA
+  const bool block_kernel = ((kernel_m == 8) && (kernel_n == 8)) || ((kernel_m == 4) && (kernel_n == 8));
+  std::array<size_t, 10> blocks;
+  bool mltn;
+  GetGemmBlocks<kernel_m, kernel_n>(m, n, k, tuning, blocks, mltn);
+  std::vector<size_t> thread_node(plan.threads_, 0);
+  if (NumaEnabled()) {
+#ifdef _OPENMP
+#pragma omp parallel
+    { thread_node[omp_get_thread_num()] = GetCurrentSocket(); }
+#else
+    thread_node[0] = GetCurrentSocket();
+#endif
+  }
+  size_t nodes = *std::max_element(thread_node.begin(), thread_node.end()) + 1;
+  std::vector<std::vector<size_t>> node_threads(nodes);
+  for (size_t t = 0; t < plan.threads_; ++t) {
+    node_threads[thread_node[t]].push_back(t);
+  }
+  std::vector<std::vector<GemmTile>> thread_tiles(plan.threads_);
+  std::vector<std::vector<GemmTile>> tasks;
+  // within a node, a task goes to the thread whose share of the node's tiles contains its middle
+  auto distribute = [&]() {
+    std::vector<std::vector<size_t>> node_tasks(nodes);
+    std::vector<size_t> node_total(nodes, 0);
+    for (size_t t = 0; t < tasks.size(); ++t) {
+      if (!tasks[t].empty()) {
+        size_t node = thread_node[std::min(tasks[t][0].j_ * plan.threads_ / n, plan.threads_ - 1)];
+        node_tasks[node].push_back(t);
+        node_total[node] += tasks[t].size();
+      }
+    }
+    for (size_t node = 0; node < nodes; ++node) {
+      size_t done = 0;
+      for (size_t i = 0; i < node_tasks[node].size(); ++i) {
+        std::vector<GemmTile> &task = tasks[node_tasks[node][i]];
+        size_t share = std::min((done + task.size() / 2) * node_threads[node].size() / node_total[node],
+                                node_threads[node].size() - 1);
+        std::vector<GemmTile> &dst = thread_tiles[node_threads[node][share]];
+        dst.insert(dst.end(), task.begin(), task.end());
+        done += task.size();
+      }
+    }
+    tasks.clear();
+  };
+  bool llc_exclusive = GetCacheTopology().llc_exclusive_;
+  for (size_t y3 = 0; y3 < blocks[0]; y3 += blocks[2]) {
+    for (size_t x3 = 0; x3 < blocks[1]; x3 += blocks[3]) {
+      for (size_t y2 = 0; y2 < blocks[2]; y2 += blocks[4]) {
+        for (size_t x2 = 0; x2 < blocks[3]; x2 += blocks[5]) {
+          tasks.push_back(std::vector<GemmTile>());
+          for (size_t y1 = 0; y1 < blocks[4]; y1 += blocks[6]) {
+            for (size_t x1 = 0; x1 < blocks[5]; x1 += blocks[7]) {
+              for (size_t y0 = 0; y0 < blocks[6]; y0 += blocks[8]) {
+                for (size_t x0 = 0; x0 < blocks[7]; x0 += blocks[9]) {
+                  auto y_sum = y3 + y2 + y1 + y0;
+                  auto x_sum = x3 + x2 + x1 + x0;
+                  auto j_index = mltn ? y_sum : x_sum;
+                  auto i_index = mltn ? x_sum : y_sum;
+                  bool owned = (y2 + y1 + y0 < blocks[2]) && (y1 + y0 < blocks[4]) && (x2 + x1 + x0 < blocks[3]) &&
+                               (x1 + x0 < blocks[5]);
+                  if ((j_index < n) && (i_index < m) && owned) {
+                    bool full = (plan.valid_m_ - i_index >= kernel_m) && (plan.valid_n_ - j_index >= kernel_n);
+                    // (j_index + kernel_n) rather than the last column, as in NCHWRTGenrateTargetAddr
+                    bool one_image = (layout == NHWC) || (j_index / feature_map_size_per_channel ==
+                                                          (j_index + kernel_n) / feature_map_size_per_channel);
+                    GemmTile tile = {static_cast<uint32_t>(i_index), static_cast<uint32_t>(j_index),
+                                     block_kernel && full && one_image};
+                    tasks.back().push_back(tile);
                   }
                 }
               }
@@ -303,98 +515,398 @@ void ConvShuffleGEMM(int8_t *pa, uint8_t *pb, float *pc, size_t m, size_t n, siz
           }
         }
       }
+      if (!llc_exclusive) {
+        distribute();
+      }
     }
   }
-#ifdef TIME_PROFILE
-  auto end = std::chrono::system_clock::now();
-  auto diff = std::chrono::duration_cast<std::chrono::microseconds>(end - start);
-  std::cerr << m << "," << n << "," << k << ",";
-  std::cerr << diff.count() << "us, "
-            << (2.0 * m * n * k) / diff.count() / 1.0e3 << " glops"
-            << std::endl;
-#endif
+  distribute();
+  plan.thread_begin_.push_back(0);
+  for (size_t t = 0; t < plan.threads_; ++t) {
+    plan.tiles_.insert(plan.tiles_.end(), thread_tiles[t].begin(), thread_tiles[t].end());
+    plan.thread_begin_.push_back(plan.tiles_.size());
+  }
 }
+
+template <size_t kernel_m, size_t kernel_n, size_t kernel_k, LAYOUT layout>
+void ReplayGemmPlan(const GemmPlan &plan, int8_t *pa, uint8_t *pb, float *pc, float *ratio_a, float *ratio_b,
+                    float *kernel_sum, float *min_b, float *bias, float fault_tolerance, bool conv_relu_fusion,
+                    bool conv_bn_fusion, bool conv_bn_relu_fusion, bool conv_relu_bn_fusion, float *global_mean,
+                    float *mul_variance_coeff, float *scale, float *shift, float *residual,
+                    const NumaReplicas<int8_t> *pa_replicas, const Requantization *requant) {
+  size_t k = plan.k_;
+  size_t valid_m = plan.valid_m_;
+  size_t valid_n = plan.valid_n_;
+  // a smaller team than planned for (e.g. nested parallelism) walks several threads' runs each
+#pragma omp parallel proc_bind(close)
+  {
+#ifdef _OPENMP
+    size_t team = omp_get_num_threads();
+    size_t first = omp_get_thread_num();
+#else
+    size_t team = 1;
+    size_t first = 0;
 #endif
-#if defined(LLC_EXCLUSIVE)
+    int8_t *local_a = (pa_replicas == NULL) ? pa : pa_replicas->Local(pa);
+    for (size_t t = first; t < plan.threads_; t += team) {
+      TraceScope trace("gemm_tiles");
+      trace.Arg("tile_begin", plan.thread_begin_[t]).Arg("tile_end", plan.thread_begin_[t + 1]);
+      for (size_t idx = plan.thread_begin_[t]; idx < plan.thread_begin_[t + 1]; ++idx) {
+        const GemmTile &tile = plan.tiles_[idx];
+        size_t i_index = tile.i_;
+        size_t j_index = tile.j_;
+        const size_t *row = plan.row_offset_.data() + i_index;
+        const size_t *col = plan.col_offset_.data() + j_index;
+        // the residual has the layout of the output, so its tile shares the output offsets
+        auto addresses = [&](float *dst[], float *base) {
+          if (tile.is_block_ && (layout == NCHW)) {
+            for (size_t kx = 0; kx < kernel_m; ++kx) {
+              dst[kx * kernel_n] = base + row[kx] + col[0];
+            }
+          } else if (tile.is_block_) {
+            for (size_t ky = 0; ky < kernel_n; ++ky) {
+              dst[ky * kernel_m] = base + row[0] + col[ky];
+            }
+          } else {
+            for (size_t kx = 0; kx < kernel_m; ++kx) {
+              for (size_t ky = 0; ky < kernel_n; ++ky) {
+                dst[kx * kernel_n + ky] = base + row[kx] + col[ky];
+              }
+            }
+          }
+        };
+        size_t rows = std::min(valid_m - i_index, kernel_m);
+        size_t cols = std::min(valid_n - j_index, kernel_n);
+        float *result[kernel_m * kernel_n];
+        float *residual_result[kernel_m * kernel_n];
+        float scratch[kernel_m * kernel_n];
+        if (requant == NULL) {
+          addresses(result, pc);
+        } else {
+          TileTargetAddr<kernel_m, kernel_n, layout>(result, scratch, tile.is_block_ != 0);
+        }
+        if (residual != NULL) {
+          addresses(residual_result, residual);
+        }
+        int8_t *local_pa = local_a + i_index * k;
+        uint8_t *local_pb = pb + j_index * k;
+        QuantizedGemmSelect<kernel_m, kernel_n, kernel_k, layout>(
+            local_pa, local_pb, k, fault_tolerance, result, rows, cols, i_index, j_index, ratio_a, ratio_b, min_b,
+            kernel_sum, bias, conv_relu_fusion, conv_bn_fusion, conv_bn_relu_fusion, conv_relu_bn_fusion, global_mean,
+            mul_variance_coeff, scale, shift, (residual == NULL) ? NULL : residual_result, tile.is_block_ != 0);
+        if (requant != NULL) {
+          // the requantized output shares the offsets of the float output
+          RequantizeTile<kernel_m, kernel_n, layout>(*requant, scratch, rows, cols, row, col);
+        }
+      }
+    }
+  }
+}
+
 template <size_t kernel_m, size_t kernel_n, size_t kernel_k, LAYOUT layout>
 void ConvShuffleGEMM(int8_t *pa, uint8_t *pb, float *pc, size_t m, size_t n, size_t k, float *ratio_a, float *ratio_b,
                      float *kernel_sum, float *min_b, float *bias, size_t batch_size, size_t groups,
                      size_t channel_per_group, size_t cur_group, size_t height_out, size_t width_out,
                      float fault_tolerance, size_t pad_m, size_t pad_n, bool conv_relu_fusion, bool conv_bn_fusion,
                      bool conv_bn_relu_fusion, bool conv_relu_bn_fusion, float *global_mean, float *mul_variance_coeff,
-                     float *scale, float *shift) {
-#ifdef TIME_PROFILE
-  auto start = std::chrono::system_clock::now();
-#endif
+                     float *scale, float *shift, float *residual, const GemmTuning *tuning, GemmPlan *plan,
+                     const NumaReplicas<int8_t> *pa_replicas, const Requantization *requant) {
+  // k is padded, so the operations include the padding of the reduction dimension
+  PerfScope perf(PERF_GEMM, 2ull * (m - pad_m) * (n - pad_n) * k);
   assert((fault_tolerance <= 1.0f) && (fault_tolerance >= 0.0f));
   assert((layout == NCHW) || (layout == NHWC));
   size_t feature_map_size_per_channel = height_out * width_out;
   size_t total_channels = channel_per_group * groups;
   size_t feature_map_size_per_image = total_channels * height_out * width_out;
   size_t feature_map_size_per_group = height_out * width_out * channel_per_group;
-  size_t m_in_l1, m_in_l2, m_in_l3, n_in_l1, n_in_l2, n_in_l3;
-  GetBlocksInfo<kernel_m>(m, k, m_in_l1, m_in_l2, m_in_l3);
-  GetBlocksInfo<kernel_n>(n, k, n_in_l1, n_in_l2, n_in_l3);
+  if ((plan != NULL) && UseGemmPlan(tuning)) {
+    if (!plan->Matches(layout, m, n, k, pad_m, pad_n, groups, channel_per_group, cur_group, height_out, width_out,
+                       tuning)) {
+      BuildGemmPlan<kernel_m, kernel_n, layout>(*plan, m, n, k, pad_m, pad_n, groups, channel_per_group, cur_group,
+                                                height_out, width_out, tuning);
+    }
+    ReplayGemmPlan<kernel_m, kernel_n, kernel_k, layout>(
+        *plan, pa, pb, pc, ratio_a, ratio_b, kernel_sum, min_b, bias, fault_tolerance, conv_relu_fusion,
+        conv_bn_fusion, conv_bn_relu_fusion, conv_relu_bn_fusion, global_mean, mul_variance_coeff, scale, shift,
+        residual, pa_replicas, requant);
+    return;
+  }
   size_t valid_m = m - pad_m;
   size_t valid_n = n - pad_n;
-  bool mltn = m < n;
-  std::array<size_t, 10> blocks1 = {n, m, n_in_l3, m_in_l3, n_in_l2, m_in_l2, n_in_l1, m_in_l1, kernel_n, kernel_m};
-  std::array<size_t, 10> blocks2 = {m, n, m_in_l3, n_in_l3, m_in_l2, n_in_l2, m_in_l1, n_in_l1, kernel_m, kernel_n};
-  std::array<size_t, 10> &blocks = (mltn) ? blocks1 : blocks2;
-  {
-#pragma omp parallel for collapse(2) schedule(static)
+  std::array<size_t, 10> blocks;
+  bool mltn;
+  GetGemmBlocks<kernel_m, kernel_n>(m, n, k, tuning, blocks, mltn);
+  // one L2 block of C, walked in L1 blocks and register tiles
+  auto block_l2 = [&](size_t y3, size_t x3, size_t y2, size_t x2) {
+    // its first row i and column j
+    TraceScope trace("gemm_block");
+    trace.Arg("i", mltn ? x3 + x2 : y3 + y2).Arg("j", mltn ? y3 + y2 : x3 + x2);
+    int8_t *local_a = (pa_replicas == NULL) ? pa : pa_replicas->Local(pa);
+    for (size_t y1 = 0; y1 < blocks[4]; y1 += blocks[6]) {
+      for (size_t x1 = 0; x1 < blocks[5]; x1 += blocks[7]) {
+        for (size_t y0 = 0; y0 < blocks[6]; y0 += blocks[8]) {
+          for (size_t x0 = 0; x0 < blocks[7]; x0 += blocks[9]) {
+            auto y_sum = y3 + y2 + y1 + y0;
+            auto x_sum = x3 + x2 + x1 + x0;
+            auto j_index = mltn ? y_sum : x_sum;
+            auto i_index = mltn ? x_sum : y_sum;
+            // the block sizes need not divide each other, so skip tiles owned by the next outer block;
+            // an in-place residual must not be accumulated twice
+            bool owned = (y2 + y1 + y0 < blocks[2]) && (y1 + y0 < blocks[4]) && (x2 + x1 + x0 < blocks[3]) &&
+                         (x1 + x0 < blocks[5]);
+            if ((j_index < n) && (i_index < m) && owned) {
+              float *result[kernel_m * kernel_n];
+              int8_t *local_pa = local_a + i_index * k;
+              uint8_t *local_pb = pb + j_index * k;
+              size_t rows = std::min(valid_m - i_index, kernel_m);
+              size_t cols = std::min(valid_n - j_index, kernel_n);
+              bool is_block = false;
+              // the residual has the layout of the output, so its tile shares the output addressing
+              float *residual_result[kernel_m * kernel_n];
+              float scratch[kernel_m * kernel_n];
+              if (layout == NCHW) {
+                if (requant == NULL) {
+                  is_block = NCHWRTGenrateTargetAddr<float, kernel_m, kernel_n, kernel_k>(
+                      result, pc, valid_m, valid_n, i_index, j_index, cur_group, feature_map_size_per_image,
+                      feature_map_size_per_group, feature_map_size_per_channel);
+                }
+                if (residual != NULL) {
+                  is_block = NCHWRTGenrateTargetAddr<float, kernel_m, kernel_n, kernel_k>(
+                      residual_result, residual, valid_m, valid_n, i_index, j_index, cur_group,
+                      feature_map_size_per_image, feature_map_size_per_group, feature_map_size_per_channel);
+                }
+              } else {
+                if (requant == NULL) {
+                  is_block = NHWCRTGenrateTargetAddr<float, kernel_m, kernel_n, kernel_k>(
+                      result, pc, valid_m, valid_n, i_index, j_index, cur_group, channel_per_group,
+                      total_channels);
+                }
+                if (residual != NULL) {
+                  is_block = NHWCRTGenrateTargetAddr<float, kernel_m, kernel_n, kernel_k>(
+                      residual_result, residual, valid_m, valid_n, i_index, j_index, cur_group,
+                      channel_per_group, total_channels);
+                }
+              }
+              if (requant != NULL) {
+                // with no residual to follow, the scratch tile takes the block form whenever the kernel has one
+                if (residual == NULL) {
+                  is_block = IsBlockTile<kernel_m, kernel_n, kernel_k>(rows, cols);
+                }
+                TileTargetAddr<kernel_m, kernel_n, layout>(result, scratch, is_block);
+              }
+              QuantizedGemmSelect<kernel_m, kernel_n, kernel_k, layout>(
+                  local_pa, local_pb, k, fault_tolerance, result, rows, cols, i_index, j_index, ratio_a, ratio_b,
+                  min_b, kernel_sum, bias, conv_relu_fusion, conv_bn_fusion, conv_bn_relu_fusion, conv_relu_bn_fusion,
+                  global_mean, mul_variance_coeff, scale, shift, (residual == NULL) ? NULL : residual_result,
+                  is_block);
+              if (requant != NULL) {
+                size_t row_offset[kernel_m];
+                size_t col_offset[kernel_n];
+                RequantizeOffsets<kernel_m, kernel_n, kernel_k, layout>(
+                    row_offset, col_offset, rows, cols, cur_group * channel_per_group + i_index, j_index,
+                    total_channels, feature_map_size_per_channel);
+                RequantizeTile<kernel_m, kernel_n, layout>(*requant, scratch, rows, cols, row_offset, col_offset);
+              }
+            }
+          }
+        }
+      }
+    }
+  };
+  if (GetCacheTopology().llc_exclusive_) {
+    // private LLC slices: each thread streams whole L2 blocks through its own slice
+    ScopedGemmSchedule gemm_schedule(tuning, GEMM_SCHEDULE_STATIC, 0);
+#pragma omp parallel for collapse(2) schedule(runtime)
     for (size_t y3 = 0; y3 < blocks[0]; y3 += blocks[2]) {
       for (size_t x3 = 0; x3 < blocks[1]; x3 += blocks[3]) {
         for (size_t y2 = 0; y2 < blocks[2]; y2 += blocks[4]) {
           for (size_t x2 = 0; x2 < blocks[3]; x2 += blocks[5]) {
-            for (size_t y1 = 0; y1 < blocks[4]; y1 += blocks[6]) {
-              for (size_t x1 = 0; x1 < blocks[5]; x1 += blocks[7]) {
-                for (size_t y0 = 0; y0 < blocks[6]; y0 += blocks[8]) {
-                  for (size_t x0 = 0; x0 < blocks[7]; x0 += blocks[9]) {
-                    auto y_sum = y3 + y2 + y1 + y0;
-                    auto x_sum = x3 + x2 + x1 + x0;
-                    auto j_index = mltn ? y_sum : x_sum;
-                    auto i_index = mltn ? x_sum : y_sum;
-                    if ((j_index < n) && (i_index < m)) {
-                      float *result[kernel_m * kernel_n];
-                      int8_t *local_pa = pa + i_index * k;
-                      uint8_t *local_pb = pb + j_index * k;
-                      bool is_block;
-                      if (layout == NCHW) {
-                        is_block = NCHWRTGenrateTargetAddr<float, kernel_m, kernel_n, kernel_k>(
-                            result, pc, valid_m, valid_n, i_index, j_index, cur_group, feature_map_size_per_image,
-                            feature_map_size_per_group, feature_map_size_per_channel);
-                      } else {
-                        is_block = NHWCRTGenrateTargetAddr<float, kernel_m, kernel_n, kernel_k>(
-                            result, pc, valid_m, valid_n, i_index, j_index, cur_group, channel_per_group,
-                            total_channels);
-                      }
-                      QuantizedGemmSelect<kernel_m, kernel_n, kernel_k, layout>(
-                          local_pa, local_pb, k, fault_tolerance, result, std::min(valid_m - i_index, kernel_m),
-                          std::min(valid_n - j_index, kernel_n), i_index, j_index, ratio_a, ratio_b, min_b, kernel_sum,
-                          bias, conv_relu_fusion, conv_bn_fusion, conv_bn_relu_fusion, conv_relu_bn_fusion, global_mean,
-                          mul_variance_coeff, scale, shift, is_block);
-                    }
-                  }
-                }
-              }
+            block_l2(y3, x3, y2, x2);
+          }
+        }
+      }
+    }
+  } else {
+    // shared LLC: the team works through one L3 block at a time, splitting it into L2 blocks
+    ScopedGemmSchedule gemm_schedule(tuning, GEMM_SCHEDULE_DYNAMIC, 4);
+#pragma omp parallel proc_bind(close)
+    {
+      for (size_t y3 = 0; y3 < blocks[0]; y3 += blocks[2]) {
+        for (size_t x3 = 0; x3 < blocks[1]; x3 += blocks[3]) {
+#pragma omp for collapse(2) schedule(runtime) nowait
+          for (size_t y2 = 0; y2 < blocks[2]; y2 += blocks[4]) {
+            for (size_t x2 = 0; x2 < blocks[3]; x2 += blocks[5]) {
+              block_l2(y3, x3, y2, x2);
             }
           }
         }
       }
     }
   }
-#ifdef TIME_PROFILE
-  auto end = std::chrono::system_clock::now();
-  auto diff = std::chrono::duration_cast<std::chrono::microseconds>(end - start);
-  std::cerr << m << "," << n << "," << k << ",";
-  std::cerr << diff.count() << "us, "
-            << (2.0 * m * n * k) / diff.count() / 1.0e3 << " glops"
-            << std::endl;
-#endif
+}
 
+// One panel of an implicit GEMM, run by the calling thread alone: columns [j_begin, j_end) of B, the pixels just
+// quantized into panel, with their ratio_b and min_b indexed from j_begin. Each M-tile of A stays in L1 while it
+// sweeps the L2-resident panel. kernel_sum, bias and the BN arrays start at the channels of cur_group.
+template <size_t kernel_m, size_t kernel_n, size_t kernel_k, LAYOUT layout>
+void ConvShufflePanelGEMM(int8_t *pa, uint8_t *panel, float *pc, size_t m, size_t n, size_t k, size_t j_begin,
+                          size_t j_end, float *ratio_a, float *ratio_b, float *kernel_sum, float *min_b, float *bias,
+                          size_t groups, size_t channel_per_group, size_t cur_group, size_t height_out,
+                          size_t width_out, float fault_tolerance, size_t pad_m, size_t pad_n, bool conv_relu_fusion,
+                          bool conv_bn_fusion, bool conv_bn_relu_fusion, bool conv_relu_bn_fusion, float *global_mean,
+                          float *mul_variance_coeff, float *scale, float *shift, float *residual,
+                          const Requantization *requant) {
+  size_t feature_map_size_per_channel = height_out * width_out;
+  size_t total_channels = channel_per_group * groups;
+  size_t feature_map_size_per_image = total_channels * height_out * width_out;
+  size_t feature_map_size_per_group = height_out * width_out * channel_per_group;
+  size_t valid_m = m - pad_m;
+  size_t valid_n = n - pad_n;
+  size_t panel_end = std::min(valid_n, j_end);
+  TraceScope trace("panel_gemm");
+  trace.Arg("group", cur_group).Arg("j_begin", j_begin).Arg("j_end", panel_end);
+  for (size_t i_index = 0; i_index < valid_m; i_index += kernel_m) {
+    for (size_t j_index = j_begin; j_index < panel_end; j_index += kernel_n) {
+      size_t rows = std::min(valid_m - i_index, kernel_m);
+      size_t cols = std::min(panel_end - j_index, kernel_n);
+      float *result[kernel_m * kernel_n];
+      float *residual_result[kernel_m * kernel_n];
+      float scratch[kernel_m * kernel_n];
+      bool is_block = false;
+      if (layout == NCHW) {
+        if (requant == NULL) {
+          is_block = NCHWRTGenrateTargetAddr<float, kernel_m, kernel_n, kernel_k>(
+              result, pc, valid_m, valid_n, i_index, j_index, cur_group, feature_map_size_per_image,
+              feature_map_size_per_group, feature_map_size_per_channel);
+        }
+        if (residual != NULL) {
+          is_block = NCHWRTGenrateTargetAddr<float, kernel_m, kernel_n, kernel_k>(
+              residual_result, residual, valid_m, valid_n, i_index, j_index, cur_group,
+              feature_map_size_per_image, feature_map_size_per_group, feature_map_size_per_channel);
+        }
+      } else {
+        if (requant == NULL) {
+          is_block = NHWCRTGenrateTargetAddr<float, kernel_m, kernel_n, kernel_k>(
+              result, pc, valid_m, valid_n, i_index, j_index, cur_group, channel_per_group, total_channels);
+        }
+        if (residual != NULL) {
+          is_block = NHWCRTGenrateTargetAddr<float, kernel_m, kernel_n, kernel_k>(
+              residual_result, residual, valid_m, valid_n, i_index, j_index, cur_group, channel_per_group,
+              total_channels);
+        }
+      }
+      if (requant != NULL) {
+        if (residual == NULL) {
+          is_block = IsBlockTile<kernel_m, kernel_n, kernel_k>(rows, cols);
+        }
+        TileTargetAddr<kernel_m, kernel_n, layout>(result, scratch, is_block);
+      }
+      int8_t *local_pa = pa + i_index * k;
+      uint8_t *local_pb = panel + (j_index - j_begin) * k;
+      QuantizedGemmSelect<kernel_m, kernel_n, kernel_k, layout>(
+          local_pa, local_pb, k, fault_tolerance, result, rows, cols, i_index, j_index - j_begin, ratio_a, ratio_b,
+          min_b, kernel_sum, bias, conv_relu_fusion, conv_bn_fusion, conv_bn_relu_fusion, conv_relu_bn_fusion,
+          global_mean, mul_variance_coeff, scale, shift, (residual == NULL) ? NULL : residual_result, is_block);
+      if (requant != NULL) {
+        size_t row_offset[kernel_m];
+        size_t col_offset[kernel_n];
+        RequantizeOffsets<kernel_m, kernel_n, kernel_k, layout>(row_offset, col_offset, rows, cols,
+                                                                cur_group * channel_per_group + i_index, j_index,
+                                                                total_channels, feature_map_size_per_channel);
+        RequantizeTile<kernel_m, kernel_n, layout>(*requant, scratch, rows, cols, row_offset, col_offset);
+      }
+    }
+  }
 }
 
-#endif
+// Grouped convolution. The (group, N-tile, M-tile) space is flattened into one task list that is shared by all
+// threads, so small per-group GEMMs no longer pay one fork/join each and idle cores can pick up other groups.
+template <size_t kernel_m, size_t kernel_n, size_t kernel_k, LAYOUT layout>
+void ConvShuffleGroupGEMM(int8_t *pa[], uint8_t *pb[], float *pc, size_t m, size_t n, size_t k, float *ratio_a[],
+                          float *ratio_b[], float *kernel_sum, float *min_b[], float *bias, size_t batch_size,
+                          size_t groups, size_t channel_per_group, size_t height_out, size_t width_out,
+                          float fault_tolerance, size_t pad_m, size_t pad_n, bool conv_relu_fusion, bool conv_bn_fusion,
+                          bool conv_bn_relu_fusion, bool conv_relu_bn_fusion, float *global_mean,
+                          float *mul_variance_coeff, float *scale, float *shift, float *residual,
+                          const Requantization *requant) {
+  PerfScope perf(PERF_GEMM, 2ull * groups * (m - pad_m) * (n - pad_n) * k);
+  assert((fault_tolerance <= 1.0f) && (fault_tolerance >= 0.0f));
+  assert((layout == NCHW) || (layout == NHWC));
+  size_t feature_map_size_per_channel = height_out * width_out;
+  size_t total_channels = channel_per_group * groups;
+  size_t feature_map_size_per_image = total_channels * height_out * width_out;
+  size_t feature_map_size_per_group = height_out * width_out * channel_per_group;
+  size_t valid_m = m - pad_m;
+  size_t valid_n = n - pad_n;
+  size_t m_tiles = m / kernel_m;
+  size_t n_tiles = n / kernel_n;
+  size_t tiles_per_group = m_tiles * n_tiles;
+#pragma omp parallel proc_bind(close)
+  {
+    TraceScope trace("group_gemm_tiles");
+#pragma omp for schedule(dynamic, 4)
+    for (size_t task = 0; task < groups * tiles_per_group; ++task) {
+      // M-tiles are innermost so consecutive tasks reuse the same im2col panel
+      size_t g = task / tiles_per_group;
+      size_t i_index = (task % m_tiles) * kernel_m;
+      size_t j_index = (task % tiles_per_group) / m_tiles * kernel_n;
+      if ((i_index >= valid_m) || (j_index >= valid_n)) {
+        continue;
+      }
+      size_t channel_offset = g * channel_per_group;
+      size_t rows = std::min(valid_m - i_index, kernel_m);
+      size_t cols = std::min(valid_n - j_index, kernel_n);
+      float *result[kernel_m * kernel_n];
+      float *residual_result[kernel_m * kernel_n];
+      float scratch[kernel_m * kernel_n];
+      bool is_block = false;
+      if (layout == NCHW) {
+        if (requant == NULL) {
+          is_block = NCHWRTGenrateTargetAddr<float, kernel_m, kernel_n, kernel_k>(
+              result, pc, valid_m, valid_n, i_index, j_index, g, feature_map_size_per_image, feature_map_size_per_group,
+              feature_map_size_per_channel);
+        }
+        if (residual != NULL) {
+          is_block = NCHWRTGenrateTargetAddr<float, kernel_m, kernel_n, kernel_k>(
+              residual_result, residual, valid_m, valid_n, i_index, j_index, g, feature_map_size_per_image,
+              feature_map_size_per_group, feature_map_size_per_channel);
+        }
+      } else {
+        if (requant == NULL) {
+          is_block = NHWCRTGenrateTargetAddr<float, kernel_m, kernel_n, kernel_k>(
+              result, pc, valid_m, valid_n, i_index, j_index, g, channel_per_group, total_channels);
+        }
+        if (residual != NULL) {
+          is_block = NHWCRTGenrateTargetAddr<float, kernel_m, kernel_n, kernel_k>(
+              residual_result, residual, valid_m, valid_n, i_index, j_index, g, channel_per_group, total_channels);
+        }
+      }
+      if (requant != NULL) {
+        if (residual == NULL) {
+          is_block = IsBlockTile<kernel_m, kernel_n, kernel_k>(rows, cols);
+        }
+        TileTargetAddr<kernel_m, kernel_n, layout>(result, scratch, is_block);
+      }
+      int8_t *local_pa = pa[g] + i_index * k;
+      uint8_t *local_pb = pb[g] + j_index * k;
+      QuantizedGemmSelect<kernel_m, kernel_n, kernel_k, layout>(
+          local_pa, local_pb, k, fault_tolerance, result, rows, cols, i_index, j_index, ratio_a[g], ratio_b[g],
+          min_b[g], kernel_sum + channel_offset, (bias == NULL) ? NULL : bias + channel_offset, conv_relu_fusion,
+          conv_bn_fusion, conv_bn_relu_fusion, conv_relu_bn_fusion,
+          (global_mean == NULL) ? NULL : global_mean + channel_offset,
+          (mul_variance_coeff == NULL) ? NULL : mul_variance_coeff + channel_offset,
+          (scale == NULL) ? NULL : scale + channel_offset, (shift == NULL) ? NULL : shift + channel_offset,
+          (residual == NULL) ? NULL : residual_result, is_block);
+      if (requant != NULL) {
+        size_t row_offset[kernel_m];
+        size_t col_offset[kernel_n];
+        RequantizeOffsets<kernel_m, kernel_n, kernel_k, layout>(row_offset, col_offset, rows, cols,
+                                                                channel_offset + i_index, j_index, total_channels,
+                                                                feature_map_size_per_channel);
+        RequantizeTile<kernel_m, kernel_n, layout>(*requant, scratch, rows, cols, row_offset, col_offset);
+      }
+    }
+  }
+}
 }
 #endif
@@ -17,6 +17,7 @@
 #ifndef OPS_SHUFFLE_SHUFFLE_IM2COL_H
 #define OPS_SHUFFLE_SHUFFLE_IM2COL_H
 #include "../../base.h"
+#include "../../perf_counters.h"
 #include "../ops.h"
 #include "../im2col_common.h"
 
@@ -69,71 +70,75 @@ void PadQuantizeShuffleNCHWIm2col(DType *data, size_t batch_size, size_t channel
   }
   FindMinMaxAlongChannel<DType, NCHW>(data, groups, min_per_channel.data(), max_per_channel.data(), batch_size,
                                       channels_per_group, height * width, NULL);
-#pragma omp parallel for collapse(2)
-  for (size_t batch = 0; batch < batch_size; ++batch) {                   // total batch size
-    for (size_t o_y = 0; o_y < output_h; ++o_y) {    // total output rows
-      for (size_t o_x = 0; o_x < output_w; ++o_x) {  // total output cols
-        // index of output cols
-        size_t out_spatial_id = batch * output_h * output_w + o_y * output_w + o_x;
-        // name is weird but go on
-        size_t col_block = out_spatial_id / shuffle_rows;
-        size_t offset_in_block = (out_spatial_id % shuffle_rows) * shuffle_cols;
-        int conv_window_y = -pad_h + o_y * stride_h;  // startline of input rows
-        int conv_window_x = -pad_w + o_x * stride_w;  // startline of input cols
-        for (size_t g = 0; g < groups; ++g) {            // IT Mat Hurt Performance
-          uint8_t *addr =
-              data_col[g] + col_block * pad_patch_size * shuffle_rows + offset_in_block;  // Get Destination Address
-          DType local_min = FLT_MAX;
-          DType local_max = -FLT_MAX;
-          for (size_t y = 0; y < kernel_h; ++y) {
-            int in_y = conv_window_y + y * dilation_h;
-            for (size_t x = 0; x < kernel_w; ++x) {
-              int in_x = conv_window_x + x * dilation_w;
-              if (x_ge_0_and_x_lt_bound(in_y, height) && x_ge_0_and_x_lt_bound(in_x, width)) {
-                local_max =
-                    fmaxf(max_per_channel[g][batch * height * width + in_y * width + in_x], local_max);
-                local_min =
-                    fminf(min_per_channel[g][batch * height * width + in_y * width + in_x], local_min);
-              } else {
-                DType value = 0;
-                local_max = fmaxf(value, local_max);
-                local_min = fminf(value, local_min);
-              }
-            }
-          }
-          DType scale = sw_threshold / (local_max - local_min);
-          min[g][out_spatial_id] = local_min;
-          max[g][out_spatial_id] = local_max;
-          ratio[g][out_spatial_id] = 1.0f / scale;
-          DType shift = -local_min * scale;
-          uint8_t zerofill = static_cast<uint8_t>(std::round((shift)));
-          // The following code is for NCHW
-          int src_base_index =
-              batch * channels_per_group * groups * height * width + g * channels_per_group * input_size_per_channel;
-          for (size_t c = 0; c < channels_per_group; ++c) {  // total channel && real start of one patch
-            size_t channel_offset = src_base_index + c * input_size_per_channel;
-            size_t offset = c * kernel_size / shuffle_cols * (shuffle_rows * shuffle_cols);
-            offset += (c * kernel_size) % shuffle_cols;
-            for (size_t h = 0; h < kernel_h; ++h) {  // total kernel height
-              int in_y = conv_window_y + h * dilation_h;
-              size_t y_offset = channel_offset + in_y * width;
-              for (size_t w = 0; w < kernel_w; ++w) {  // total kernel width
-                int in_x = conv_window_x + w * dilation_w;
+#pragma omp parallel
+  {
+    TraceScope trace("im2col");
+#pragma omp for collapse(2)
+    for (size_t batch = 0; batch < batch_size; ++batch) {                   // total batch size
+      for (size_t o_y = 0; o_y < output_h; ++o_y) {    // total output rows
+        for (size_t o_x = 0; o_x < output_w; ++o_x) {  // total output cols
+          // index of output cols
+          size_t out_spatial_id = batch * output_h * output_w + o_y * output_w + o_x;
+          // name is weird but go on
+          size_t col_block = out_spatial_id / shuffle_rows;
+          size_t offset_in_block = (out_spatial_id % shuffle_rows) * shuffle_cols;
+          int conv_window_y = -pad_h + o_y * stride_h;  // startline of input rows
+          int conv_window_x = -pad_w + o_x * stride_w;  // startline of input cols
+          for (size_t g = 0; g < groups; ++g) {            // IT Mat Hurt Performance
+            uint8_t *addr =
+                data_col[g] + col_block * pad_patch_size * shuffle_rows + offset_in_block;  // Get Destination Address
+            DType local_min = FLT_MAX;
+            DType local_max = -FLT_MAX;
+            for (size_t y = 0; y < kernel_h; ++y) {
+              int in_y = conv_window_y + y * dilation_h;
+              for (size_t x = 0; x < kernel_w; ++x) {
+                int in_x = conv_window_x + x * dilation_w;
                 if (x_ge_0_and_x_lt_bound(in_y, height) && x_ge_0_and_x_lt_bound(in_x, width)) {
-                  *(addr + offset++) =
-                      static_cast<uint8_t>(std::round((data[y_offset + in_x] - local_min) * scale));
+                  local_max =
+                      fmaxf(max_per_channel[g][batch * height * width + in_y * width + in_x], local_max);
+                  local_min =
+                      fminf(min_per_channel[g][batch * height * width + in_y * width + in_x], local_min);
                 } else {
-                  *(addr + offset++) = zerofill;
+                  DType value = 0;
+                  local_max = fmaxf(value, local_max);
+                  local_min = fminf(value, local_min);
                 }
-                if ((offset % shuffle_cols) == 0) {
-                  offset += (shuffle_rows - 1) * shuffle_cols;
+              }
+            }
+            DType scale = sw_threshold / (local_max - local_min);
+            min[g][out_spatial_id] = local_min;
+            max[g][out_spatial_id] = local_max;
+            ratio[g][out_spatial_id] = 1.0f / scale;
+            DType shift = -local_min * scale;
+            uint8_t zerofill = static_cast<uint8_t>(std::round((shift)));
+            // The following code is for NCHW
+            int src_base_index =
+                batch * channels_per_group * groups * height * width + g * channels_per_group * input_size_per_channel;
+            for (size_t c = 0; c < channels_per_group; ++c) {  // total channel && real start of one patch
+              size_t channel_offset = src_base_index + c * input_size_per_channel;
+              size_t offset = c * kernel_size / shuffle_cols * (shuffle_rows * shuffle_cols);
+              offset += (c * kernel_size) % shuffle_cols;
+              for (size_t h = 0; h < kernel_h; ++h) {  // total kernel height
+                int in_y = conv_window_y + h * dilation_h;
+                size_t y_offset = channel_offset + in_y * width;
+                for (size_t w = 0; w < kernel_w; ++w) {  // total kernel width
+                  int in_x = conv_window_x + w * dilation_w;
+                  if (x_ge_0_and_x_lt_bound(in_y, height) && x_ge_0_and_x_lt_bound(in_x, width)) {
+                    *(addr + offset++) =
+                        static_cast<uint8_t>(std::round((data[y_offset + in_x] - local_min) * scale));
+                  } else {
+                    *(addr + offset++) = zerofill;
+                  }
+                  if ((offset % shuffle_cols) == 0) {
+                    offset += (shuffle_rows - 1) * shuffle_cols;
+                  }
                 }
               }
             }
+            // the above code is for NCHW only
+            size_t offset = pad_patch_size * shuffle_rows - (shuffle_cols * shuffle_rows) + patch_size % shuffle_cols;
+            memset(addr + offset, 0, pad_patch_size - patch_size);
           }
-          // the above code is for NCHW only
-          size_t offset = pad_patch_size * shuffle_rows - (shuffle_cols * shuffle_rows) + patch_size % shuffle_cols;
-          memset(addr + offset, 0, pad_patch_size - patch_size);
         }
       }
     }
@@ -179,71 +184,75 @@ void PadQuantizeShuffleNCHWIm2col(DType *data, size_t batch_size, size_t channel
   }
   FindMinMaxAlongChannel<DType, NCHW>(data, groups, min_per_channel.data(), max_per_channel.data(), batch_size,
                                       channels_per_group, height * width, NULL);
-#pragma omp parallel for collapse(3)
-  for (size_t batch = 0; batch < batch_size; ++batch) {                   // total batch size
-    for (size_t o_y = 0; o_y < output_h; ++o_y) {    // total output rows
-      for (size_t o_x = 0; o_x < output_w; ++o_x) {  // total output cols
-        // index of output cols
-        size_t out_spatial_id = batch * output_h * output_w + o_y * output_w + o_x;
-        // name is weird but go on
-        size_t col_block = out_spatial_id / shuffle_rows;
-        size_t offset_in_block = (out_spatial_id % shuffle_rows) * shuffle_cols;
-        int conv_window_y = -pad_h + o_y * stride_h;  // startline of input rows
-        int conv_window_x = -pad_w + o_x * stride_w;  // startline of input cols
-        for (size_t g = 0; g < groups; ++g) {            // IT Mat Hurt Performance
-          uint8_t *addr =
-              data_col[g] + col_block * pad_patch_size * shuffle_rows + offset_in_block;  // Get Destination Address
-          DType local_min = FLT_MAX;
-          DType local_max = -FLT_MAX;
-          for (size_t y = 0; y < kernel_h; ++y) {
-            int in_y = conv_window_y + y * dilation_h;
-            for (size_t x = 0; x < kernel_w; ++x) {
-              int in_x = conv_window_x + x * dilation_w;
-              if (x_ge_0_and_x_lt_bound(in_y, height) && x_ge_0_and_x_lt_bound(in_x, width)) {
-                local_max =
-                    fmaxf(max_per_channel[g][batch * height * width + in_y * width + in_x], local_max);
-                local_min =
-                    fminf(min_per_channel[g][batch * height * width + in_y * width + in_x], local_min);
-              } else {
-                DType value = 0;
-                local_max = fmaxf(value, local_max);
-                local_min = fminf(value, local_min);
-              }
-            }
-          }
-          DType scale = sw_threshold / (local_max - local_min);
-          min[g][out_spatial_id] = local_min;
-          max[g][out_spatial_id] = local_max;
-          ratio[g][out_spatial_id] = 1.0f / scale;
-          DType shift = -local_min * scale;
-          uint8_t zerofill = static_cast<uint8_t>(std::round(shift));
-          // The following code is for NCHW
-          int src_base_index =
-              batch * channels_per_group * groups * height * width + g * channels_per_group * input_size_per_channel;
-          for (size_t c = 0; c < channels_per_group; ++c) {  // total channel && real start of one patch
-            size_t channel_offset = src_base_index + c * input_size_per_channel;
-            size_t offset = c * kernel_size / shuffle_cols * (shuffle_rows * shuffle_cols);
-            offset += (c * kernel_size) % shuffle_cols;
-            for (size_t h = 0; h < kernel_h; ++h) {  // total kernel height
-              int in_y = conv_window_y + h * dilation_h;
-              size_t y_offset = channel_offset + in_y * width;
-              for (size_t w = 0; w < kernel_w; ++w) {  // total kernel width
-                int in_x = conv_window_x + w * dilation_w;
+#pragma omp parallel
+  {
+    TraceScope trace("im2col");
+#pragma omp for collapse(3)
+    for (size_t batch = 0; batch < batch_size; ++batch) {                   // total batch size
+      for (size_t o_y = 0; o_y < output_h; ++o_y) {    // total output rows
+        for (size_t o_x = 0; o_x < output_w; ++o_x) {  // total output cols
+          // index of output cols
+          size_t out_spatial_id = batch * output_h * output_w + o_y * output_w + o_x;
+          // name is weird but go on
+          size_t col_block = out_spatial_id / shuffle_rows;
+          size_t offset_in_block = (out_spatial_id % shuffle_rows) * shuffle_cols;
+          int conv_window_y = -pad_h + o_y * stride_h;  // startline of input rows
+          int conv_window_x = -pad_w + o_x * stride_w;  // startline of input cols
+          for (size_t g = 0; g < groups; ++g) {            // IT Mat Hurt Performance
+            uint8_t *addr =
+                data_col[g] + col_block * pad_patch_size * shuffle_rows + offset_in_block;  // Get Destination Address
+            DType local_min = FLT_MAX;
+            DType local_max = -FLT_MAX;
+            for (size_t y = 0; y < kernel_h; ++y) {
+              int in_y = conv_window_y + y * dilation_h;
+              for (size_t x = 0; x < kernel_w; ++x) {
+                int in_x = conv_window_x + x * dilation_w;
                 if (x_ge_0_and_x_lt_bound(in_y, height) && x_ge_0_and_x_lt_bound(in_x, width)) {
-                  *(addr + offset++) =
-                      static_cast<uint8_t>(std::round((data[y_offset + in_x] - local_min) * scale));
+                  local_max =
+                      fmaxf(max_per_channel[g][batch * height * width + in_y * width + in_x], local_max);
+                  local_min =
+                      fminf(min_per_channel[g][batch * height * width + in_y * width + in_x], local_min);
                 } else {
-                  *(addr + offset++) = zerofill;
+                  DType value = 0;
+                  local_max = fmaxf(value, local_max);
+                  local_min = fminf(value, local_min);
                 }
-                if ((offset % shuffle_cols) == 0) {
-                  offset += (shuffle_rows - 1) * shuffle_cols;
+              }
+            }
+            DType scale = sw_threshold / (local_max - local_min);
+            min[g][out_spatial_id] = local_min;
+            max[g][out_spatial_id] = local_max;
+            ratio[g][out_spatial_id] = 1.0f / scale;
+            DType shift = -local_min * scale;
+            uint8_t zerofill = static_cast<uint8_t>(std::round(shift));
+            // The following code is for NCHW
+            int src_base_index =
+                batch * channels_per_group * groups * height * width + g * channels_per_group * input_size_per_channel;
+            for (size_t c = 0; c < channels_per_group; ++c) {  // total channel && real start of one patch
+              size_t channel_offset = src_base_index + c * input_size_per_channel;
+              size_t offset = c * kernel_size / shuffle_cols * (shuffle_rows * shuffle_cols);
+              offset += (c * kernel_size) % shuffle_cols;
+              for (size_t h = 0; h < kernel_h; ++h) {  // total kernel height
+                int in_y = conv_window_y + h * dilation_h;
+                size_t y_offset = channel_offset + in_y * width;
+                for (size_t w = 0; w < kernel_w; ++w) {  // total kernel width
+                  int in_x = conv_window_x + w * dilation_w;
+                  if (x_ge_0_and_x_lt_bound(in_y, height) && x_ge_0_and_x_lt_bound(in_x, width)) {
+                    *(addr + offset++) =
+                        static_cast<uint8_t>(std::round((data[y_offset + in_x] - local_min) * scale));
+                  } else {
+                    *(addr + offset++) = zerofill;
+                  }
+                  if ((offset % shuffle_cols) == 0) {
+                    offset += (shuffle_rows - 1) * shuffle_cols;
+                  }
                 }
               }
             }
+            // the above code is for NCHW only
+            size_t offset = pad_patch_size * shuffle_rows - (shuffle_cols * shuffle_rows) + patch_size % shuffle_cols;
+            memset(addr + offset, 0, pad_patch_size - patch_size);
           }
-          // the above code is for NCHW only
-          size_t offset = pad_patch_size * shuffle_rows - (shuffle_cols * shuffle_rows) + patch_size % shuffle_cols;
-          memset(addr + offset, 0, pad_patch_size - patch_size);
         }
       }
     }
@@ -268,227 +277,490 @@ void PadQuantizeShuffleNCHWIm2col(DType *data, size_t batch_size, size_t channel
   }
 }
 
-template <typename DType, size_t shuffle_rows, size_t shuffle_cols, typename findextreme_function,
-          typename quantizekernel_function>
+// Writes count bytes to a row of a shuffled matrix from column k on, see PadShuffle2D. The bytes are read from src
+// every src_stride, or are value if src is NULL.
+template <size_t shuffle_rows, size_t shuffle_cols>
+INLINE_SPECIFIER void INLINE_ATTRIBUTE ShuffledRowFill(uint8_t *row, size_t k, size_t count, const uint8_t *src,
+                                                       size_t src_stride, uint8_t value) {
+  while (count > 0) {
+    size_t run = std::min(count, shuffle_cols - k % shuffle_cols);
+    uint8_t *dst = row + k / shuffle_cols * shuffle_rows * shuffle_cols + k % shuffle_cols;
+    if (src == NULL) {
+      memset(dst, value, run);
+    } else if (src_stride == 1) {
+      memcpy(dst, src, run);
+      src += run;
+    } else {
+      for (size_t c = 0; c < run; ++c) {
+        dst[c] = src[c * src_stride];
+      }
+      src += run * src_stride;
+    }
+    k += run;
+    count -= run;
+  }
+}
+
+// Quantizes count values of src into a row of a shuffled matrix from column k on, see ShuffledRowFill. Whole
+// shuffle_cols blocks go through quantizekernel, the ragged ends are quantized one by one.
+template <typename DType, size_t shuffle_rows, size_t shuffle_cols, typename quantizekernel_function>
+INLINE_SPECIFIER void INLINE_ATTRIBUTE ShuffledRowQuantize(uint8_t *row, size_t k, size_t count, DType *src,
+                                                           DType scale, DType shift, SIMDPSTYPE &simdscale,
+                                                           SIMDPSTYPE &simdshift,
+                                                           quantizekernel_function quantizekernel) {
+  while (count > 0) {
+    uint8_t *dst = row + k / shuffle_cols * shuffle_rows * shuffle_cols + k % shuffle_cols;
+    size_t run;
+    if ((k % shuffle_cols == 0) && (count >= shuffle_cols)) {
+      run = count / shuffle_cols * shuffle_cols;
+      for (size_t c = 0; c < run; c += shuffle_cols) {
+        quantizekernel(dst, src + c, simdscale, simdshift);
+        dst += shuffle_rows * shuffle_cols;
+      }
+    } else {
+      run = std::min(count, shuffle_cols - k % shuffle_cols);
+      for (size_t c = 0; c < run; ++c) {
+        dst[c] = static_cast<uint8_t>(src[c] * scale + shift);
+      }
+    }
+    src += run;
+    k += run;
+    count -= run;
+  }
+}
+
+// Cache blocking of PadQuantizeShuffleNHWCIm2col. A task covers block_rows_ output rows of one image, which read a
+// band of at most band_rows_ input rows.
+struct Im2colBanding {
+  size_t block_rows_;
+  size_t band_rows_;
+  size_t blocks_per_image_;
+};
+
+// The band is sized to half of L2, so it is still cached when it is quantized right after its extremes are found.
+// Blocks shrink when there are too few of them to keep every thread busy.
+static Im2colBanding GetIm2colBanding(size_t batch_size, size_t channels, size_t height, size_t width,
+                                      size_t kernel_h, size_t stride_h, size_t dilation_h, size_t output_h,
+                                      size_t element_size) {
+  size_t window_h = (kernel_h - 1) * dilation_h + 1;
+  size_t band_rows = GetBlockNum(GetCacheTopology().l2_size_, width * channels * element_size);
+  size_t block_rows = (band_rows > window_h) ? (band_rows - window_h) / stride_h + 1 : 1;
+  size_t threads = GetThreadsNumWrapper();
+  size_t min_blocks = (threads + batch_size - 1) / batch_size;
+  block_rows = std::max(std::min(block_rows, (output_h + min_blocks - 1) / min_blocks), static_cast<size_t>(1));
+  Im2colBanding banding;
+  banding.block_rows_ = block_rows;
+  banding.band_rows_ = std::min((block_rows - 1) * stride_h + window_h, height);
+  banding.blocks_per_image_ = (output_h + block_rows - 1) / block_rows;
+  return banding;
+}
+
+// Per-thread scratch, in DType elements, of a band of PadQuantizeShuffleNHWCIm2col: the extremes of its pixels and,
+// for an NCHW source, its NHWC transpose.
+template <typename DType>
+size_t PadQuantizeShuffleNHWCIm2colScratchSize(size_t batch_size, size_t channels_per_group, size_t groups,
+                                               size_t height, size_t width, size_t kernel_h, size_t pad_h,
+                                               size_t stride_h, size_t dilation_h, bool transpose) {
+  size_t total_channels = groups * channels_per_group;
+  size_t output_h = GetConvOutSize(height, kernel_h, stride_h, pad_h, dilation_h);
+  Im2colBanding banding = GetIm2colBanding(batch_size, total_channels, height, width, kernel_h, stride_h, dilation_h,
+                                           output_h, sizeof(DType));
+  size_t band_size = banding.band_rows_ * width;
+  return 2 * groups * band_size + (transpose ? band_size * total_channels : 0);
+}
+
+/*
+ * NHWC im2col fused with the per pixel quantization. The output rows are processed in blocks whose input band fits in
+ * L2: the extremes of every input pixel of the band are found with SIMD, then the patches of the block take the
+ * extremes of their taps and are quantized and scattered into the shuffled layout while the band is still cached.
+ * An NCHW source (transpose) is transposed band by band into scratch, so the whole input is never copied.
+ * scratch holds PadQuantizeShuffleNHWCIm2colScratchSize elements per thread.
+ */
+template <typename DType, size_t shuffle_rows, size_t shuffle_cols, typename quantizekernel_function>
 void PadQuantizeShuffleNHWCIm2col(DType *data, size_t batch_size, size_t channels_per_group, size_t groups,
                                   size_t height, size_t width, size_t kernel_h, size_t kernel_w, size_t pad_h,
                                   size_t pad_w, size_t stride_h, size_t stride_w, size_t dilation_h, size_t dilation_w,
-                                  uint8_t *data_col[], DType *min[], DType *max[], DType *ratio[], DType *workspace,
-                                  float sw_threshold, findextreme_function findextreme,
-                                  quantizekernel_function quantizekernel) {
+                                  uint8_t *data_col[], DType *min[], DType *max[], DType *ratio[], DType *scratch[],
+                                  float sw_threshold, bool transpose, quantizekernel_function quantizekernel) {
   size_t output_h = GetConvOutSize(height, kernel_h, stride_h, pad_h, dilation_h);
   size_t output_w = GetConvOutSize(width, kernel_w, stride_w, pad_w, dilation_w);
-  size_t kernel_size = kernel_h * kernel_w;
   size_t total_channels = groups * channels_per_group;
-  size_t input_feature_size_per_batch = height * width * total_channels;
-  size_t input_feature_size_per_height = width * total_channels;
-  size_t input_feature_size_per_width = total_channels;
-
-  size_t patch_size = channels_per_group * kernel_size;
-  size_t pad_patch_size = GetAlignmentLength(patch_size, shuffle_cols);  // Get Pad Size
-  size_t pad_output_spatial_size = GetAlignmentLength(batch_size * output_h * output_w, shuffle_rows);
-  std::vector<DType *> min_per_channel(groups);
-  std::vector<DType *> max_per_channel(groups);
-  for (size_t g = 0; g < groups; ++g) {
-    aligned_malloc(reinterpret_cast<void **>(&min_per_channel[g]), 64, sizeof(DType) * batch_size * height * width);
-    aligned_malloc(reinterpret_cast<void **>(&max_per_channel[g]), 64, sizeof(DType) * batch_size * height * width);
-  }
-#ifdef TIME_PROFILE
-  auto start = std::chrono::system_clock::now();
-#endif
-  findextreme(data, groups, min_per_channel.data(), max_per_channel.data(), batch_size, channels_per_group,
-              height * width, workspace);
-#ifdef TIME_PROFILE
-  auto end = std::chrono::system_clock::now();
-  auto diff = std::chrono::duration_cast<std::chrono::microseconds>(end - start);
-  std::cerr << "im2col findextreme per channel " << diff.count() << "us" << std::endl;
+  size_t patch_size = channels_per_group * kernel_h * kernel_w;
+  size_t pad_patch_size = GetAlignmentLength(patch_size, shuffle_cols);
+  size_t output_spatial_size = batch_size * output_h * output_w;
+  size_t pad_output_spatial_size = GetAlignmentLength(output_spatial_size, shuffle_rows);
+  size_t tap_size = channels_per_group;
+  // with one group and no dilation the valid taps of a kernel row are contiguous in the source
+  bool contiguous_taps = (groups == 1) && (dilation_w == 1);
+  Im2colBanding banding = GetIm2colBanding(batch_size, total_channels, height, width, kernel_h, stride_h, dilation_h,
+                                           output_h, sizeof(DType));
+  size_t band_size = banding.band_rows_ * width;
+#pragma omp parallel for collapse(2) schedule(dynamic)
+  for (size_t batch = 0; batch < batch_size; ++batch) {
+    for (size_t block = 0; block < banding.blocks_per_image_; ++block) {
+      TraceScope trace("im2col_band");
+      trace.Arg("batch", batch).Arg("block", block);
+#ifdef _OPENMP
+      DType *local = scratch[omp_get_thread_num()];
+#else
+      DType *local = scratch[0];
 #endif
-#pragma omp parallel for collapse(3)
-  for (size_t batch = 0; batch < batch_size; ++batch) {                   // total batch size
-    for (size_t o_y = 0; o_y < output_h; ++o_y) {    // total output rows
-      for (size_t o_x = 0; o_x < output_w; ++o_x) {  // total output cols
-        // index of output cols
-        size_t out_spatial_id = batch * output_h * output_w + o_y * output_w + o_x;
-        // name is weird but go on
-        size_t col_block = out_spatial_id / shuffle_rows;
-        size_t offset_in_block = (out_spatial_id % shuffle_rows) * shuffle_cols;
-        size_t base_offset = col_block * pad_patch_size * shuffle_rows + offset_in_block;
-        int conv_window_y = -pad_h + o_y * stride_h;  // startline of input rows
-        int conv_window_x = -pad_w + o_x * stride_w;  // startline of input cols
-        size_t batch_offset = batch * height * width;
-        for (size_t g = 0; g < groups; ++g) {  // Get min && max && ratio
-          DType local_min = FLT_MAX;
-          DType local_max = -FLT_MAX;
-          for (size_t y = 0; y < kernel_h; ++y) {
-            int in_y = conv_window_y + y * dilation_h;
-            for (size_t x = 0; x < kernel_w; ++x) {
-              int in_x = conv_window_x + x * dilation_w;
-              if (x_ge_0_and_x_lt_bound(in_y, height) && x_ge_0_and_x_lt_bound(in_x, width)) {
-                local_max = fmaxf(max_per_channel[g][batch_offset + in_y * width + in_x], local_max);
-                local_min = fminf(min_per_channel[g][batch_offset + in_y * width + in_x], local_min);
-              } else {
-                DType value = 0;
-                local_max = fmaxf(value, local_max);
-                local_min = fminf(value, local_min);
-              }
-            }
+      size_t o_y_begin = block * banding.block_rows_;
+      size_t o_y_end = std::min(o_y_begin + banding.block_rows_, output_h);
+      // input rows [row_begin, row_end) under the block, clipped to the image
+      long first_row = static_cast<long>(o_y_begin * stride_h) - static_cast<long>(pad_h);
+      long end_row = static_cast<long>((o_y_end - 1) * stride_h + (kernel_h - 1) * dilation_h + 1) -
+                     static_cast<long>(pad_h);
+      size_t row_begin = std::min(static_cast<size_t>(std::max(first_row, 0L)), height);
+      size_t row_end = std::max(std::min(static_cast<size_t>(std::max(end_row, 0L)), height), row_begin);
+      size_t band_pixels = (row_end - row_begin) * width;
+      DType *pixel_min = local;
+      DType *pixel_max = local + groups * band_size;
+      DType *rows = data + (batch * height + row_begin) * width * total_channels;
+      if (transpose) {
+        rows = local + 2 * groups * band_size;
+        DType *image = data + batch * total_channels * height * width;
+        for (size_t y = row_begin; y < row_end; ++y) {
+          TransposeBlock<DType>(rows + (y - row_begin) * width * total_channels, total_channels, image + y * width,
+                                height * width, total_channels, width);
+        }
+      }
+      for (size_t p = 0; p < band_pixels; ++p) {
+        for (size_t g = 0; g < groups; ++g) {
+          FindMinMaxValue<DType>(rows + p * total_channels + g * channels_per_group, channels_per_group,
+                                 pixel_min[g * band_size + p], pixel_max[g * band_size + p]);
+        }
+      }
+      for (size_t o_y = o_y_begin; o_y < o_y_end; ++o_y) {
+        long conv_window_y = static_cast<long>(o_y * stride_h) - static_cast<long>(pad_h);
+        for (size_t o_x = 0; o_x < output_w; ++o_x) {
+          size_t out_spatial_id = (batch * output_h + o_y) * output_w + o_x;
+          long conv_window_x = static_cast<long>(o_x * stride_w) - static_cast<long>(pad_w);
+          // taps [x_begin, x_end) of a kernel row land inside the image
+          size_t x_begin = 0;
+          while ((x_begin < kernel_w) && (conv_window_x + static_cast<long>(x_begin * dilation_w) < 0)) {
+            ++x_begin;
           }
-          DType scale = sw_threshold / (local_max - local_min);
-          min[g][out_spatial_id] = local_min;
-          max[g][out_spatial_id] = local_max;
-          ratio[g][out_spatial_id] = 1.0f / scale;
-          /* why here shift doesn't plusto 0.5
-          * It seems that when converting sse/simd FP32 to Int32, the default mode is round to nearest. So there's no
-          * need to plus 0.5 here
-          */
-          DType shift = -local_min * scale;
-          uint8_t zerofill = static_cast<uint8_t>(shift);
-          uint8_t *addr = data_col[g] + base_offset;
-          size_t src_base_index = batch * input_feature_size_per_batch;
-          SIMDPSTYPE simdscale = SET1_PS(scale);
-          SIMDPSTYPE simdshift = SET1_PS(shift);
-          for (size_t h = 0; h < kernel_h; ++h) {
-            int in_y = conv_window_y + h * dilation_h;
-            size_t y_offset = src_base_index + in_y * input_feature_size_per_height;
-            bool valid_row = x_ge_0_and_x_lt_bound(in_y, height);
-            if ((dilation_w == 1) && valid_row && (groups == 1) && x_ge_0_and_x_lt_bound(conv_window_x, width) &&
-                x_ge_0_and_x_lt_bound(conv_window_x + kernel_w, width)) {
-              const size_t offset_in_row = h * kernel_w * channels_per_group;
-              const size_t shuffle_col_id = offset_in_row / shuffle_cols;
-              const size_t shuffle_col_remain_index = offset_in_row % shuffle_cols;
-              size_t shuffle_offset_in_row =
-                  shuffle_col_id * (shuffle_rows * shuffle_cols) + shuffle_col_remain_index;
-              size_t src_index = y_offset + conv_window_x * input_feature_size_per_width;
-              size_t length = kernel_w * channels_per_group;
-              size_t z = 0;
-              size_t remain =
-                  (shuffle_col_remain_index == 0) ? 0 : std::min(shuffle_cols - shuffle_col_remain_index, length);
-              for (; z < remain; ++z) {
-                *(addr + shuffle_offset_in_row++) = static_cast<uint8_t>(data[src_index + z] * scale + shift);
-                if ((shuffle_offset_in_row % shuffle_cols) == 0) {
-                  shuffle_offset_in_row += (shuffle_rows - 1) * shuffle_cols;
-                }
+          size_t x_end = kernel_w;
+          while ((x_end > x_begin) &&
+                 (conv_window_x + static_cast<long>((x_end - 1) * dilation_w) >= static_cast<long>(width))) {
+            --x_end;
+          }
+          for (size_t g = 0; g < groups; ++g) {
+            uint8_t *row = data_col[g] + out_spatial_id / shuffle_rows * shuffle_rows * pad_patch_size +
+                           out_spatial_id % shuffle_rows * shuffle_cols;
+            DType local_min = FLT_MAX;
+            DType local_max = -FLT_MAX;
+            bool padded = (x_begin > 0) || (x_end < kernel_w);
+            for (size_t y = 0; y < kernel_h; ++y) {
+              long in_y = conv_window_y + static_cast<long>(y * dilation_h);
+              if (!x_ge_0_and_x_lt_bound(in_y, height)) {
+                padded = true;
+                continue;
               }
-              size_t total_kernel = (length - remain) / shuffle_cols;
-              DType *src_base = data + src_index + z;
-              uint8_t *dst_base = addr + shuffle_offset_in_row;
-              for (size_t k = 0; k < total_kernel; ++k) {
-                quantizekernel(dst_base + k * shuffle_rows * shuffle_cols, src_base + k * shuffle_cols, simdscale,
-                               simdshift);
+              size_t base = g * band_size + (in_y - row_begin) * width + conv_window_x;
+              for (size_t x = x_begin; x < x_end; ++x) {
+                local_min = fminf(pixel_min[base + x * dilation_w], local_min);
+                local_max = fmaxf(pixel_max[base + x * dilation_w], local_max);
               }
-              shuffle_offset_in_row += total_kernel * shuffle_rows * shuffle_cols;
-              z += total_kernel * shuffle_cols;
-              for (z = remain + (length - remain) / shuffle_cols * shuffle_cols; z < length; ++z) {
-                *(addr + shuffle_offset_in_row++) = static_cast<uint8_t>(data[src_index + z] * scale + shift);
+            }
+            if (padded) {
+              local_min = fminf(0, local_min);
+              local_max = fmaxf(0, local_max);
+            }
+            DType scale = sw_threshold / (local_max - local_min);
+            min[g][out_spatial_id] = local_min;
+            max[g][out_spatial_id] = local_max;
+            ratio[g][out_spatial_id] = 1.0f / scale;
+            // the SIMD kernels round to nearest, so shift doesn't add 0.5
+            DType shift = -local_min * scale;
+            uint8_t zerofill = static_cast<uint8_t>(shift);
+            SIMDPSTYPE simdscale = SET1_PS(scale);
+            SIMDPSTYPE simdshift = SET1_PS(shift);
+            size_t k = 0;
+            for (size_t y = 0; y < kernel_h; ++y) {
+              long in_y = conv_window_y + static_cast<long>(y * dilation_h);
+              if (!x_ge_0_and_x_lt_bound(in_y, height)) {
+                ShuffledRowFill<shuffle_rows, shuffle_cols>(row, k, kernel_w * tap_size, NULL, 0, zerofill);
+                k += kernel_w * tap_size;
+                continue;
               }
-            } else {
-              for (size_t w = 0; w < kernel_w; ++w) {
-                int in_x = conv_window_x + w * dilation_w;
-                size_t x_offset = y_offset + in_x * input_feature_size_per_width;
-                bool valid_col = x_ge_0_and_x_lt_bound(in_x, width);
-                const size_t offset_in_row = (h * kernel_w + w) * channels_per_group;
-                const size_t shuffle_col_id = offset_in_row / shuffle_cols;
-                const size_t shuffle_col_remain_index = offset_in_row % shuffle_cols;
-                size_t shuffle_offset_in_row =
-                    shuffle_col_id * (shuffle_rows * shuffle_cols) + shuffle_col_remain_index;
-                if (valid_row && valid_col) {
-                  size_t src_index = x_offset + g * channels_per_group;
-                  if (channels_per_group < shuffle_cols) {
-                    if ((shuffle_col_remain_index + channels_per_group) < shuffle_cols) {
-                      for (size_t c = 0; c < channels_per_group; ++c) {
-                        *(addr + shuffle_offset_in_row + c) = static_cast<uint8_t>(data[src_index + c] * scale + shift);
-                      }
-                      shuffle_offset_in_row += channels_per_group;
-                    } else {
-                      for (size_t c = 0; c < channels_per_group; ++c) {
-                        *(addr + shuffle_offset_in_row++) = static_cast<uint8_t>(data[src_index + c] * scale + shift);
-                        if ((shuffle_offset_in_row % shuffle_cols) == 0) {
-                          shuffle_offset_in_row += (shuffle_rows - 1) * shuffle_cols;
-                        }
-                      }
-                    }
-                  } else {
-                    size_t c = 0;
-                    size_t remain = (shuffle_col_remain_index == 0)
-                                        ? 0
-                                        : std::min(shuffle_cols - shuffle_col_remain_index, channels_per_group);
-                    for (; c < remain; ++c) {
-                      *(addr + shuffle_offset_in_row++) = static_cast<uint8_t>(data[src_index + c] * scale + shift);
-                      if ((shuffle_offset_in_row % shuffle_cols) == 0) {
-                        shuffle_offset_in_row += (shuffle_rows - 1) * shuffle_cols;
-                      }
-                    }
-                    size_t total_kernel = (channels_per_group - remain) / shuffle_cols;
-                    DType *src_base = data + src_index + c;
-                    uint8_t *dst_base = addr + shuffle_offset_in_row;
-                    for (size_t k = 0; k < total_kernel; ++k) {
-                      quantizekernel(dst_base + k * shuffle_rows * shuffle_cols, src_base + k * shuffle_cols, simdscale,
-                                     simdshift);
-                    }
-                    shuffle_offset_in_row += total_kernel * shuffle_rows * shuffle_cols;
-                    c += total_kernel * shuffle_cols;
-                    for (c = remain + (channels_per_group - remain) / shuffle_cols * shuffle_cols;
-                         c < channels_per_group; ++c) {
-                      *(addr + shuffle_offset_in_row++) = static_cast<uint8_t>(data[src_index + c] * scale + shift);
-                    }
-                  }
-                } else {
-                  size_t c = 0;
-                  size_t remain = (shuffle_col_remain_index == 0)
-                                      ? 0
-                                      : std::min(shuffle_cols - shuffle_col_remain_index, channels_per_group);
-                  for (; c < remain; ++c) {
-                    *(addr + shuffle_offset_in_row++) = zerofill;
-                    if ((shuffle_offset_in_row % shuffle_cols) == 0) {
-                      shuffle_offset_in_row += (shuffle_rows - 1) * shuffle_cols;
-                    }
-                  }
-                  for (; c < (channels_per_group - remain) / shuffle_cols * shuffle_cols; c += shuffle_cols) {
-                    memset(addr + shuffle_offset_in_row, zerofill, shuffle_cols);
-                    shuffle_offset_in_row += shuffle_rows * shuffle_cols;
-                  }
-                  for (c = remain + (channels_per_group - remain) / shuffle_cols * shuffle_cols; c < channels_per_group;
-                       ++c) {
-                    *(addr + shuffle_offset_in_row++) = zerofill;
-                  }
+              ShuffledRowFill<shuffle_rows, shuffle_cols>(row, k, x_begin * tap_size, NULL, 0, zerofill);
+              k += x_begin * tap_size;
+              DType *src = rows +
+                           ((in_y - row_begin) * width + conv_window_x + x_begin * dilation_w) * total_channels +
+                           g * channels_per_group;
+              if (contiguous_taps) {
+                size_t count = (x_end - x_begin) * tap_size;
+                ShuffledRowQuantize<DType, shuffle_rows, shuffle_cols>(row, k, count, src, scale, shift, simdscale,
+                                                                       simdshift, quantizekernel);
+                k += count;
+              } else {
+                for (size_t x = x_begin; x < x_end; ++x) {
+                  ShuffledRowQuantize<DType, shuffle_rows, shuffle_cols>(row, k, tap_size, src, scale, shift,
+                                                                         simdscale, simdshift, quantizekernel);
+                  src += dilation_w * total_channels;
+                  k += tap_size;
                 }
               }
+              ShuffledRowFill<shuffle_rows, shuffle_cols>(row, k, (kernel_w - x_end) * tap_size, NULL, 0, zerofill);
+              k += (kernel_w - x_end) * tap_size;
             }
+            ShuffledRowFill<shuffle_rows, shuffle_cols>(row, patch_size, pad_patch_size - patch_size, NULL, 0, 0);
           }
-          size_t shuffle_offset_in_row =
-              pad_patch_size * shuffle_rows - (shuffle_cols * shuffle_rows) + patch_size % shuffle_cols;
-          memset(data_col[g] + base_offset + shuffle_offset_in_row, 0, pad_patch_size - patch_size);
         }
       }
     }
   }
 
 #pragma omp parallel for
-  for (size_t i = batch_size * output_h * output_w; i < pad_output_spatial_size; ++i) {
+  for (size_t i = output_spatial_size; i < pad_output_spatial_size; ++i) {
     for (size_t g = 0; g < groups; ++g) {
-      size_t col_block = i / shuffle_rows;
-      size_t offset_in_block = (i % shuffle_rows) * shuffle_cols;
-      uint8_t *addr =
-          data_col[g] + col_block * shuffle_rows * pad_patch_size + offset_in_block;  // Get Destination Address
-      size_t offset = 0;
-      for (size_t j = 0; j < pad_patch_size; j += shuffle_cols) {
-        memset(addr + offset, 0, shuffle_cols);
-        offset += shuffle_cols * shuffle_rows;
+      uint8_t *row = data_col[g] + i / shuffle_rows * shuffle_rows * pad_patch_size + i % shuffle_rows * shuffle_cols;
+      ShuffledRowFill<shuffle_rows, shuffle_cols>(row, 0, pad_patch_size, NULL, 0, 0);
+    }
+  }
+}
+
+/*
+ * 1x1 / stride 1 / no pad NHWC convolution: every pixel row of the input already is a row of the GEMM B matrix, so
+ * find its extremes, quantize and scatter it into the shuffled layout in a single streaming pass, no im2col needed.
+ */
+template <typename DType, size_t shuffle_rows, size_t shuffle_cols, typename quantizekernel_function>
+void PadQuantizeShuffleNHWC1x1(DType *data, size_t spatial_size, size_t channels_per_group, size_t groups,
+                               uint8_t *data_col[], DType *min[], DType *max[], DType *ratio[], float sw_threshold,
+                               quantizekernel_function quantizekernel) {
+  size_t total_channels = groups * channels_per_group;
+  size_t pad_patch_size = GetAlignmentLength(channels_per_group, shuffle_cols);
+  size_t pad_spatial_size = GetAlignmentLength(spatial_size, shuffle_rows);
+  size_t aligned_channels = channels_per_group / shuffle_cols * shuffle_cols;
+  size_t block_size = shuffle_rows * shuffle_cols;
+#pragma omp parallel
+  {
+    TraceScope trace("im2col");
+#pragma omp for collapse(2)
+    for (size_t i = 0; i < pad_spatial_size; ++i) {
+      for (size_t g = 0; g < groups; ++g) {
+        size_t col_block = i / shuffle_rows;
+        size_t offset_in_block = (i % shuffle_rows) * shuffle_cols;
+        uint8_t *addr = data_col[g] + col_block * shuffle_rows * pad_patch_size + offset_in_block;
+        if (i >= spatial_size) {
+          for (size_t c = 0; c < pad_patch_size; c += shuffle_cols) {
+            memset(addr, 0, shuffle_cols);
+            addr += block_size;
+          }
+          continue;
+        }
+        DType *src = data + i * total_channels + g * channels_per_group;
+        DType local_min, local_max;
+        FindMinMaxValue(src, channels_per_group, local_min, local_max);
+        DType scale = sw_threshold / (local_max - local_min);
+        min[g][i] = local_min;
+        max[g][i] = local_max;
+        ratio[g][i] = 1.0f / scale;
+        DType shift = -local_min * scale;
+        SIMDPSTYPE simdscale = SET1_PS(scale);
+        SIMDPSTYPE simdshift = SET1_PS(shift);
+        size_t c = 0;
+        for (; c < aligned_channels; c += shuffle_cols) {
+          quantizekernel(addr, src + c, simdscale, simdshift);
+          addr += block_size;
+        }
+        if (c < pad_patch_size) {
+          size_t tail = channels_per_group - c;
+          for (size_t z = 0; z < tail; ++z) {
+            addr[z] = static_cast<uint8_t>(src[c + z] * scale + shift);
+          }
+          memset(addr + tail, 0, shuffle_cols - tail);
+        }
       }
     }
   }
-  for (size_t g = 0; g < groups; ++g) {
-    aligned_free(min_per_channel[g]);
-    aligned_free(max_per_channel[g]);
+}
+
+/*
+ * Implicit GEMM im2col: quantizes output pixels [begin, end) of group g into panel, the rows [begin, end) of the
+ * shuffled matrix of PadQuantizeShuffleNHWCIm2col, with begin a multiple of shuffle_rows. Rows up to pad_end are
+ * zero. min, max and ratio are indexed from begin. Every patch is gathered into patch, patch_size DType elements, so
+ * an NCHW source is read in place and padded taps are plain zeros.
+ */
+template <typename DType, size_t shuffle_rows, size_t shuffle_cols, LAYOUT layout, typename quantizekernel_function>
+void PadQuantizeShufflePanel(const DType *data, size_t channels_per_group, size_t groups, size_t g, size_t height,
+                             size_t width, size_t kernel_h, size_t kernel_w, size_t pad_h, size_t pad_w,
+                             size_t stride_h, size_t stride_w, size_t dilation_h, size_t dilation_w, size_t output_h,
+                             size_t output_w, size_t begin, size_t end, size_t pad_end, uint8_t *panel, DType *min,
+                             DType *max, DType *ratio, DType *patch, float sw_threshold,
+                             quantizekernel_function quantizekernel) {
+  size_t total_channels = groups * channels_per_group;
+  size_t patch_size = channels_per_group * kernel_h * kernel_w;
+  size_t pad_patch_size = GetAlignmentLength(patch_size, shuffle_cols);
+  for (size_t i = begin; i < pad_end; ++i) {
+    size_t r = i - begin;
+    uint8_t *row = panel + r / shuffle_rows * shuffle_rows * pad_patch_size + r % shuffle_rows * shuffle_cols;
+    if (i >= end) {
+      ShuffledRowFill<shuffle_rows, shuffle_cols>(row, 0, pad_patch_size, NULL, 0, 0);
+      continue;
+    }
+    size_t batch = i / (output_h * output_w);
+    long conv_window_y = static_cast<long>(i / output_w % output_h * stride_h) - static_cast<long>(pad_h);
+    long conv_window_x = static_cast<long>(i % output_w * stride_w) - static_cast<long>(pad_w);
+    DType *dst = patch;
+    for (size_t y = 0; y < kernel_h; ++y) {
+      long in_y = conv_window_y + static_cast<long>(y * dilation_h);
+      for (size_t x = 0; x < kernel_w; ++x) {
+        long in_x = conv_window_x + static_cast<long>(x * dilation_w);
+        if (!x_ge_0_and_x_lt_bound(in_y, height) || !x_ge_0_and_x_lt_bound(in_x, width)) {
+          memset(dst, 0, channels_per_group * sizeof(DType));
+        } else if (layout == NHWC) {
+          memcpy(dst, data + ((batch * height + in_y) * width + in_x) * total_channels + g * channels_per_group,
+                 channels_per_group * sizeof(DType));
+        } else {
+          const DType *src = data + ((batch * total_channels + g * channels_per_group) * height + in_y) * width + in_x;
+          for (size_t c = 0; c < channels_per_group; ++c) {
+            dst[c] = src[c * height * width];
+          }
+        }
+        dst += channels_per_group;
+      }
+    }
+    DType local_min, local_max;
+    FindMinMaxValue(patch, patch_size, local_min, local_max);
+    DType scale = sw_threshold / (local_max - local_min);
+    min[r] = local_min;
+    max[r] = local_max;
+    ratio[r] = 1.0f / scale;
+    DType shift = -local_min * scale;
+    SIMDPSTYPE simdscale = SET1_PS(scale);
+    SIMDPSTYPE simdshift = SET1_PS(shift);
+    ShuffledRowQuantize<DType, shuffle_rows, shuffle_cols>(row, 0, patch_size, patch, scale, shift, simdscale,
+                                                           simdshift, quantizekernel);
+    ShuffledRowFill<shuffle_rows, shuffle_cols>(row, patch_size, pad_patch_size - patch_size, NULL, 0, 0);
   }
 }
 
+// im2col of an already quantized input, so only bytes are copied. Taps in the padding read zero_point, the quantized 0.
+template <size_t shuffle_rows, size_t shuffle_cols, LAYOUT layout>
+void StaticShuffleIm2col(const uint8_t *quantized, size_t batch_size, size_t channels_per_group, size_t groups,
+                         size_t height, size_t width, size_t kernel_h, size_t kernel_w, size_t pad_h, size_t pad_w,
+                         size_t stride_h, size_t stride_w, size_t dilation_h, size_t dilation_w, uint8_t zero_point,
+                         uint8_t *data_col[]) {
+  size_t output_h = GetConvOutSize(height, kernel_h, stride_h, pad_h, dilation_h);
+  size_t output_w = GetConvOutSize(width, kernel_w, stride_w, pad_w, dilation_w);
+  size_t total_channels = groups * channels_per_group;
+  size_t patch_size = channels_per_group * kernel_h * kernel_w;
+  size_t pad_patch_size = GetAlignmentLength(patch_size, shuffle_cols);
+  size_t output_spatial_size = batch_size * output_h * output_w;
+  size_t pad_output_spatial_size = GetAlignmentLength(output_spatial_size, shuffle_rows);
+  // NHWC copies the channels of a tap at once, NCHW gathers them a feature map apart
+  size_t channel_stride = (layout == NHWC) ? 1 : height * width;
+#pragma omp parallel
+  {
+    TraceScope trace("im2col");
+#pragma omp for
+    for (size_t i = 0; i < pad_output_spatial_size; ++i) {
+      size_t batch = i / (output_h * output_w);
+      int conv_window_y = -pad_h + i / output_w % output_h * stride_h;
+      int conv_window_x = -pad_w + i % output_w * stride_w;
+      for (size_t g = 0; g < groups; ++g) {
+        uint8_t *row = data_col[g] + i / shuffle_rows * shuffle_rows * pad_patch_size + i % shuffle_rows * shuffle_cols;
+        if (i >= output_spatial_size) {
+          ShuffledRowFill<shuffle_rows, shuffle_cols>(row, 0, pad_patch_size, NULL, 0, 0);
+          continue;
+        }
+        size_t k = 0;
+        for (size_t y = 0; y < kernel_h; ++y) {
+          int in_y = conv_window_y + y * dilation_h;
+          for (size_t x = 0; x < kernel_w; ++x) {
+            int in_x = conv_window_x + x * dilation_w;
+            const uint8_t *src = NULL;
+            if (x_ge_0_and_x_lt_bound(in_y, height) && x_ge_0_and_x_lt_bound(in_x, width)) {
+              size_t channel = g * channels_per_group;
+              src = quantized +
+                    ((layout == NHWC) ? ((batch * height + in_y) * width + in_x) * total_channels + channel
+                                      : ((batch * total_channels + channel) * height + in_y) * width + in_x);
+            }
+            ShuffledRowFill<shuffle_rows, shuffle_cols>(row, k, channels_per_group, src, channel_stride, zero_point);
+            k += channels_per_group;
+          }
+        }
+        ShuffledRowFill<shuffle_rows, shuffle_cols>(row, patch_size, pad_patch_size - patch_size, NULL, 0, 0);
+      }
+    }
+  }
+}
+
+// Bytes of the shuffled im2col matrices of all groups, what PERF_IM2COL counts as quantized
+INLINE_SPECIFIER size_t ShuffleIm2colBytes(size_t batch_size, size_t channels_per_group, size_t groups, size_t height,
+                                           size_t width, size_t kernel_h, size_t kernel_w, size_t pad_h, size_t pad_w,
+                                           size_t stride_h, size_t stride_w, size_t dilation_h, size_t dilation_w) {
+  size_t output_h = GetConvOutSize(height, kernel_h, stride_h, pad_h, dilation_h);
+  size_t output_w = GetConvOutSize(width, kernel_w, stride_w, pad_w, dilation_w);
+  return groups * GetAlignmentLength(batch_size * output_h * output_w, CONV_SHUFFLE_KERNEL_N) *
+         GetAlignmentLength(channels_per_group * kernel_h * kernel_w, CONV_SHUFFLE_KERNEL_K);
+}
+
+// Static quantization of the input of a convolution with one scale and zero point, see SaturateQuantize. The input is
+// quantized once into workspace, in its own layout, before the byte im2col, so NCHW needs no float transpose. The
+// pointwise NHWC case quantizes straight into the shuffled matrix.
+template <LAYOUT layout>
+void StaticQuantizeShuffleIm2colWrapper(const float *data, size_t batch_size, size_t channels_per_group, size_t groups,
+                                        size_t height, size_t width, size_t kernel_h, size_t kernel_w, size_t pad_h,
+                                        size_t pad_w, size_t stride_h, size_t stride_w, size_t dilation_h,
+                                        size_t dilation_w, uint8_t *data_col[], float scale, float zero_point,
+                                        uint8_t *workspace, float sw_threshold) {
+  PerfScope perf(PERF_IM2COL, 0,
+                 ShuffleIm2colBytes(batch_size, channels_per_group, groups, height, width, kernel_h, kernel_w, pad_h,
+                                    pad_w, stride_h, stride_w, dilation_h, dilation_w));
+  bool pointwise = (kernel_h == 1) && (kernel_w == 1) && (stride_h == 1) && (stride_w == 1) && (pad_h == 0) &&
+                   (pad_w == 0);
+  size_t spatial_size = batch_size * height * width;
+  if ((layout == NHWC) && pointwise && (groups == 1)) {
+    StaticQuantizeShuffle2D<CONV_SHUFFLE_KERNEL_N, CONV_SHUFFLE_KERNEL_K>(
+        data_col[0], spatial_size, channels_per_group, GetAlignmentLength(spatial_size, CONV_SHUFFLE_KERNEL_N),
+        GetAlignmentLength(channels_per_group, CONV_SHUFFLE_KERNEL_K), data, scale, zero_point, sw_threshold);
+    return;
+  }
+  size_t count = spatial_size * groups * channels_per_group;
+  const size_t chunk = 4096;
+#pragma omp parallel
+  {
+    TraceScope trace("quantize");
+#pragma omp for
+    for (size_t i = 0; i < count; i += chunk) {
+      SaturateQuantize(workspace + i, data + i, std::min(chunk, count - i), scale, zero_point, sw_threshold);
+    }
+  }
+  StaticShuffleIm2col<CONV_SHUFFLE_KERNEL_N, CONV_SHUFFLE_KERNEL_K, layout>(
+      workspace, batch_size, channels_per_group, groups, height, width, kernel_h, kernel_w, pad_h, pad_w, stride_h,
+      stride_w, dilation_h, dilation_w, static_cast<uint8_t>(zero_point), data_col);
+}
+
+// The byte im2col of StaticQuantizeShuffleIm2colWrapper alone, for an input already quantized with the static range,
+// e.g. requantized by the GEMM epilogue of the convolution before it
+template <LAYOUT layout>
+void StaticShuffleIm2colWrapper(const uint8_t *quantized, size_t batch_size, size_t channels_per_group, size_t groups,
+                                size_t height, size_t width, size_t kernel_h, size_t kernel_w, size_t pad_h,
+                                size_t pad_w, size_t stride_h, size_t stride_w, size_t dilation_h, size_t dilation_w,
+                                uint8_t *data_col[], uint8_t zero_point) {
+  PerfScope perf(PERF_IM2COL, 0,
+                 ShuffleIm2colBytes(batch_size, channels_per_group, groups, height, width, kernel_h, kernel_w, pad_h,
+                                    pad_w, stride_h, stride_w, dilation_h, dilation_w));
+  StaticShuffleIm2col<CONV_SHUFFLE_KERNEL_N, CONV_SHUFFLE_KERNEL_K, layout>(
+      quantized, batch_size, channels_per_group, groups, height, width, kernel_h, kernel_w, pad_h, pad_w, stride_h,
+      stride_w, dilation_h, dilation_w, zero_point, data_col);
+}
+
+// scratch is the per-thread scratch of the NHWC paths, see PadQuantizeShuffleNHWCIm2colScratchSize, allocated here
+// when NULL. transpose reads an NCHW source into the NHWC layout.
 template <typename DType, LAYOUT layout>
 void PadQuantizeShuffleIm2colWrapper(DType *data, size_t batch_size, size_t channels_per_group, size_t groups,
                                      size_t height, size_t width, size_t kernel_h, size_t kernel_w, size_t pad_h,
                                      size_t pad_w, size_t stride_h, size_t stride_w, size_t dilation_h,
                                      size_t dilation_w, uint8_t *data_col[], DType *min[], DType *max[], DType *ratio[],
-                                     DType *workspace, float sw_threshold, bool transpose) {
+                                     DType *scratch[], float sw_threshold, bool transpose) {
+  PerfScope perf(PERF_IM2COL, 0,
+                 ShuffleIm2colBytes(batch_size, channels_per_group, groups, height, width, kernel_h, kernel_w, pad_h,
+                                    pad_w, stride_h, stride_w, dilation_h, dilation_w));
 #if defined(AVX512)
 #define QUANTIZE_KERNEL_FUNC AVX512Kernel8Quantize
 #elif defined(__AVX2__)
@@ -516,28 +788,49 @@ void PadQuantizeShuffleIm2colWrapper(DType *data, size_t batch_size, size_t chan
           stride_w, dilation_h, dilation_w, data_col, min, max, ratio, sw_threshold);
     }
   } else {
-    if (transpose == false) {
-      PadQuantizeShuffleNHWCIm2col<DType, CONV_SHUFFLE_KERNEL_N, CONV_SHUFFLE_KERNEL_K>(
-          data, batch_size, channels_per_group, groups, height, width, kernel_h, kernel_w, pad_h, pad_w, stride_h,
-          stride_w, dilation_h, dilation_w, data_col, min, max, ratio, NULL, sw_threshold,
-          FindMinMaxAlongChannel<DType, NHWC>, QUANTIZE_KERNEL_FUNC);
+    bool pointwise = (kernel_h == 1) && (kernel_w == 1) && (stride_h == 1) && (stride_w == 1) && (pad_h == 0) &&
+                     (pad_w == 0);
+    if ((transpose == false) && pointwise) {
+      PadQuantizeShuffleNHWC1x1<DType, CONV_SHUFFLE_KERNEL_N, CONV_SHUFFLE_KERNEL_K>(
+          data, batch_size * height * width, channels_per_group, groups, data_col, min, max, ratio, sw_threshold,
+          QUANTIZE_KERNEL_FUNC);
     } else {
-      DType *tmp;
-      if (workspace == NULL) {
-        aligned_malloc(reinterpret_cast<void **>(&tmp), 64,
-                       batch_size * groups * channels_per_group * height * width * sizeof(DType));
-      } else {
-        tmp = workspace;
+      size_t threads = GetThreadsNumWrapper();
+      std::vector<DType *> local_scratch;
+      if (scratch == NULL) {
+        size_t scratch_size = PadQuantizeShuffleNHWCIm2colScratchSize<DType>(
+            batch_size, channels_per_group, groups, height, width, kernel_h, pad_h, stride_h, dilation_h, transpose);
+        local_scratch.resize(threads);
+        for (size_t t = 0; t < threads; ++t) {
+          aligned_malloc(reinterpret_cast<void **>(&local_scratch[t]), 64, scratch_size * sizeof(DType));
+        }
+        scratch = local_scratch.data();
       }
       PadQuantizeShuffleNHWCIm2col<DType, CONV_SHUFFLE_KERNEL_N, CONV_SHUFFLE_KERNEL_K>(
           data, batch_size, channels_per_group, groups, height, width, kernel_h, kernel_w, pad_h, pad_w, stride_h,
-          stride_w, dilation_h, dilation_w, data_col, min, max, ratio, tmp, sw_threshold,
-          FindMinMaxAlongChannelThenTranspose<DType, NHWC>, QUANTIZE_KERNEL_FUNC);
-      if (workspace == NULL) {
-        aligned_free(tmp);
+          stride_w, dilation_h, dilation_w, data_col, min, max, ratio, scratch, sw_threshold, transpose,
+          QUANTIZE_KERNEL_FUNC);
+      for (size_t t = 0; t < local_scratch.size(); ++t) {
+        aligned_free(local_scratch[t]);
       }
     }
   }
 }
+
+// PadQuantizeShufflePanel with the quantize kernel of the build, see PadQuantizeShuffleIm2colWrapper
+template <typename DType, LAYOUT layout>
+void PadQuantizeShufflePanelWrapper(const DType *data, size_t channels_per_group, size_t groups, size_t g,
+                                    size_t height, size_t width, size_t kernel_h, size_t kernel_w, size_t pad_h,
+                                    size_t pad_w, size_t stride_h, size_t stride_w, size_t dilation_h,
+                                    size_t dilation_w, size_t output_h, size_t output_w, size_t begin, size_t end,
+                                    size_t pad_end, uint8_t *panel, DType *min, DType *max, DType *ratio,
+                                    DType *patch, float sw_threshold) {
+  TraceScope trace("panel_im2col");
+  trace.Arg("group", g).Arg("begin", begin).Arg("end", end);
+  PadQuantizeShufflePanel<DType, CONV_SHUFFLE_KERNEL_N, CONV_SHUFFLE_KERNEL_K, layout>(
+      data, channels_per_group, groups, g, height, width, kernel_h, kernel_w, pad_h, pad_w, stride_h, stride_w,
+      dilation_h, dilation_w, output_h, output_w, begin, end, pad_end, panel, min, max, ratio, patch, sw_threshold,
+      QUANTIZE_KERNEL_FUNC);
+}
 }
 #endif
@@ -0,0 +1,344 @@
+/*
+ * Copyright 2016 The BigDL Authors.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef OPS_WINOGRAD_H
+#define OPS_WINOGRAD_H
+
+#include "../base.h"
+#include "../common.h"
+#include "../trace.h"
+#include "kernel-common.h"
+#include "./quantize.h"
+
+namespace winograd {
+
+// Transform matrices of F(tile x tile, 3x3), alpha = tile + 2 points per dimension.
+template <size_t tile>
+struct Winograd3x3Matrix;
+
+template <>
+struct Winograd3x3Matrix<2> {
+  static const size_t alpha = 4;
+
+  static float BT(size_t i, size_t j) {
+    static const float m[4][4] = {{1, 0, -1, 0}, {0, 1, 1, 0}, {0, -1, 1, 0}, {0, 1, 0, -1}};
+    return m[i][j];
+  }
+
+  static float G(size_t i, size_t j) {
+    static const float m[4][3] = {{1, 0, 0}, {0.5f, 0.5f, 0.5f}, {0.5f, -0.5f, 0.5f}, {0, 0, 1}};
+    return m[i][j];
+  }
+
+  static float AT(size_t i, size_t j) {
+    static const float m[2][4] = {{1, 1, 1, 0}, {0, 1, -1, -1}};
+    return m[i][j];
+  }
+};
+
+static INLINE_SPECIFIER float Set1(float value, float) {
+  return value;
+}
+
+static INLINE_SPECIFIER SIMDPSTYPE Set1(float value, SIMDPSTYPE) {
+  return SET1_PS(value);
+}
+
+static INLINE_SPECIFIER float Add(float a, float b) {
+  return a + b;
+}
+
+static INLINE_SPECIFIER SIMDPSTYPE Add(SIMDPSTYPE a, SIMDPSTYPE b) {
+  return ADD_PS(a, b);
+}
+
+static INLINE_SPECIFIER float Fma(float a, float b, float c) {
+  return a * b + c;
+}
+
+static INLINE_SPECIFIER SIMDPSTYPE Fma(SIMDPSTYPE a, SIMDPSTYPE b, SIMDPSTYPE c) {
+  return FMA_PS(a, b, c);
+}
+
+static INLINE_SPECIFIER float Load(float *p, float) {
+  return *p;
+}
+
+static INLINE_SPECIFIER SIMDPSTYPE Load(float *p, SIMDPSTYPE) {
+  return LOADU_PS(p);
+}
+
+static INLINE_SPECIFIER void Store(float *p, float value) {
+  *p = value;
+}
+
+static INLINE_SPECIFIER void Store(float *p, SIMDPSTYPE value) {
+  STOREU_PS(p, value);
+}
+
+// out = M in M^T for a constant alpha x alpha (or tile x alpha) matrix M, on scalars or channel vectors
+template <size_t rows, size_t cols, float (*matrix)(size_t, size_t), typename VType>
+static INLINE_SPECIFIER void Sandwich(VType out[rows][rows], VType in[cols][cols]) {
+  VType tmp[rows][cols];
+  VType zero = Set1(0.0f, VType());
+  for (size_t i = 0; i < rows; ++i) {
+    for (size_t j = 0; j < cols; ++j) {
+      tmp[i][j] = zero;
+      for (size_t k = 0; k < cols; ++k) {
+        if (matrix(i, k) != 0.0f) {
+          tmp[i][j] = Fma(Set1(matrix(i, k), VType()), in[k][j], tmp[i][j]);
+        }
+      }
+    }
+  }
+  for (size_t i = 0; i < rows; ++i) {
+    for (size_t j = 0; j < rows; ++j) {
+      out[i][j] = zero;
+      for (size_t k = 0; k < cols; ++k) {
+        if (matrix(j, k) != 0.0f) {
+          out[i][j] = Fma(Set1(matrix(j, k), VType()), tmp[i][k], out[i][j]);
+        }
+      }
+    }
+  }
+}
+
+// U[xi][co][ci] = G g G^T for an NHWC weight [channel_out][3][3][channel_in].
+template <size_t tile>
+void NHWCWinograd3x3KernelProcess(float *transformed_weight, float *weight, size_t channel_out, size_t channel_in) {
+  typedef Winograd3x3Matrix<tile> Matrix;
+  const size_t alpha = Matrix::alpha;
+#pragma omp parallel for collapse(2)
+  for (size_t co = 0; co < channel_out; ++co) {
+    for (size_t ci = 0; ci < channel_in; ++ci) {
+      float g[3][3];
+      for (size_t y = 0; y < 3; ++y) {
+        for (size_t x = 0; x < 3; ++x) {
+          g[y][x] = weight[((co * 3 + y) * 3 + x) * channel_in + ci];
+        }
+      }
+      // G is alpha x 3, so the sandwich is done by hand
+      float tmp[alpha][3];
+      for (size_t i = 0; i < alpha; ++i) {
+        for (size_t j = 0; j < 3; ++j) {
+          tmp[i][j] = Matrix::G(i, 0) * g[0][j] + Matrix::G(i, 1) * g[1][j] + Matrix::G(i, 2) * g[2][j];
+        }
+      }
+      for (size_t i = 0; i < alpha; ++i) {
+        for (size_t j = 0; j < alpha; ++j) {
+          float u = Matrix::G(j, 0) * tmp[i][0] + Matrix::G(j, 1) * tmp[i][1] + Matrix::G(j, 2) * tmp[i][2];
+          transformed_weight[((i * alpha + j) * channel_out + co) * channel_in + ci] = u;
+        }
+      }
+    }
+  }
+}
+
+// Quantize and shuffle each U[xi] per output channel for the shuffle GEMM kernels.
+template <size_t tile>
+void NHWCWinogradQuantizeKernelByChannel(int8_t *quantized_kernel[], float *transformed_kernel, size_t m, size_t n,
+                                         size_t pad_m, size_t pad_n, float *min[], float *max[], float *ratio[],
+                                         float sw_threshold) {
+  const size_t alpha = Winograd3x3Matrix<tile>::alpha;
+  for (size_t xi = 0; xi < alpha * alpha; ++xi) {
+    shuffle::PadQuantizeShuffle2D<float, CONV_SHUFFLE_KERNEL_M, CONV_SHUFFLE_KERNEL_K>(
+        quantized_kernel[xi], m, n, pad_m, pad_n, transformed_kernel + xi * m * n, min[xi], max[xi], ratio[xi],
+        sw_threshold);
+  }
+}
+
+template <size_t tile, typename VType>
+static INLINE_SPECIFIER void DataTransform(float *transformed_data, float *data, size_t c, size_t channel_in,
+                                           size_t height, size_t width, long y0, long x0) {
+  typedef Winograd3x3Matrix<tile> Matrix;
+  const size_t alpha = Matrix::alpha;
+  VType d[alpha][alpha];
+  VType v[alpha][alpha];
+  for (size_t i = 0; i < alpha; ++i) {
+    for (size_t j = 0; j < alpha; ++j) {
+      long y = y0 + static_cast<long>(i);
+      long x = x0 + static_cast<long>(j);
+      bool inside = (y >= 0) && (x >= 0) && (y < static_cast<long>(height)) && (x < static_cast<long>(width));
+      d[i][j] = inside ? Load(data + (y * width + x) * channel_in + c, VType()) : Set1(0.0f, VType());
+    }
+  }
+  Sandwich<alpha, alpha, Matrix::BT>(v, d);
+  for (size_t xi = 0; xi < alpha * alpha; ++xi) {
+    Store(transformed_data + xi * channel_in + c, v[xi / alpha][xi % alpha]);
+  }
+}
+
+// V[xi][patch][ci] = B^T d B over every (tile + 2) x (tile + 2) input patch of an NHWC batch, stepping by tile. Each
+// patch is transformed into a per-thread scratch of alpha * alpha * channel_in floats and immediately quantized per
+// (xi, patch) row into the shuffled layout PadQuantizeShuffle2D<N, K> would produce, so V never goes to memory in float.
+template <size_t tile>
+void NHWCWinograd3x3DataProcess(uint8_t *quantized_data[], float *data, size_t batch_size, size_t height,
+                                size_t width, size_t channel_in, size_t pad_h, size_t pad_w, size_t patch_y_num,
+                                size_t patch_x_num, size_t pad_patches, size_t pad_channel_in, float *min[],
+                                float *max[], float *ratio[], float sw_threshold, float *scratch[]) {
+  const size_t alpha = Winograd3x3Matrix<tile>::alpha;
+  const size_t rows = CONV_SHUFFLE_KERNEL_N;
+  const size_t cols = CONV_SHUFFLE_KERNEL_K;
+  size_t patches = batch_size * patch_y_num * patch_x_num;
+  size_t full = channel_in / PS_OPERAND_WIDTH * PS_OPERAND_WIDTH;
+  size_t full_cols = channel_in / cols * cols;
+  // The padded rows of the last row block are never written below
+  if (pad_patches > patches) {
+    for (size_t xi = 0; xi < alpha * alpha; ++xi) {
+      memset(quantized_data[xi] + patches / rows * rows * pad_channel_in, 0, rows * pad_channel_in);
+    }
+  }
+#pragma omp parallel
+  {
+    TraceScope trace("winograd_input");
+#pragma omp for
+    for (size_t p = 0; p < patches; ++p) {
+  #ifdef _OPENMP
+      float *local = scratch[omp_get_thread_num()];
+  #else
+      float *local = scratch[0];
+  #endif
+      size_t n = p / (patch_y_num * patch_x_num);
+      long y0 = static_cast<long>(p / patch_x_num % patch_y_num * tile) - static_cast<long>(pad_h);
+      long x0 = static_cast<long>(p % patch_x_num * tile) - static_cast<long>(pad_w);
+      float *image = data + n * height * width * channel_in;
+      for (size_t c = 0; c < full; c += PS_OPERAND_WIDTH) {
+        DataTransform<tile, SIMDPSTYPE>(local, image, c, channel_in, height, width, y0, x0);
+      }
+      for (size_t c = full; c < channel_in; ++c) {
+        DataTransform<tile, float>(local, image, c, channel_in, height, width, y0, x0);
+      }
+      for (size_t xi = 0; xi < alpha * alpha; ++xi) {
+        float *src = local + xi * channel_in;
+        uint8_t *dst = quantized_data[xi] + p / rows * rows * pad_channel_in + p % rows * cols;
+        FindMinMaxValue(src, channel_in, min[xi][p], max[xi][p]);
+        float range = max[xi][p] - min[xi][p];
+        float scale = (range > 0.0f) ? sw_threshold / range : 1.0f;
+        float lower = min[xi][p];
+        ratio[xi][p] = 1.0f / scale;
+  #if defined(AVX512) || defined(__AVX2__)
+        SIMDPSTYPE simd_scale = SET1_PS(scale);
+        SIMDPSTYPE simd_bias = SET1_PS(-scale * lower);
+  #endif
+        size_t c;
+        // CONV_SHUFFLE_KERNEL_K is 8 on AVX2 and AVX512, one Kernel8Quantize per shuffled column block
+        for (c = 0; c < full_cols; c += cols) {
+  #if defined(AVX512)
+          AVX512Kernel8Quantize(dst, src + c, simd_scale, simd_bias);
+  #elif defined(__AVX2__)
+          AVX2Kernel8Quantize(dst, src + c, simd_scale, simd_bias);
+  #else
+          for (size_t k = 0; k < cols; ++k) {
+            dst[k] = static_cast<uint8_t>(std::round((src[c + k] - lower) * scale));
+          }
+  #endif
+          dst += rows * cols;
+        }
+        for (size_t k = 0; (c < channel_in) && (k < cols); ++k) {
+          dst[k] = (c + k < channel_in) ? static_cast<uint8_t>(std::round((src[c + k] - lower) * scale)) : 0;
+        }
+      }
+    }
+  }
+}
+
+// M[xi][co][patch] = U[xi] V[xi]^T. The alpha * alpha products run as the groups of one ConvShuffleGroupGEMM, whose
+// NCHW addressing with a single image of 1 x patches pixels is exactly the [co][patch] row-major layout.
+template <size_t tile>
+void NHWCWinograd3x3ElementWiseBatchMul(float *intermedia_out, int8_t *transformed_kernel[],
+                                        uint8_t *transformed_data[], size_t batch_size, size_t patch_y_num,
+                                        size_t patch_x_num, size_t channel_in, size_t channel_out, float *ratio_a[],
+                                        float *sum_a, float *ratio_b[], float *min_b[]) {
+  const size_t alpha = Winograd3x3Matrix<tile>::alpha;
+  size_t patches = batch_size * patch_y_num * patch_x_num;
+  size_t aligned_m = GetAlignmentLength(channel_out, CONV_SHUFFLE_KERNEL_M);
+  size_t aligned_n = GetAlignmentLength(patches, CONV_SHUFFLE_KERNEL_N);
+  size_t aligned_k = GetAlignmentLength(channel_in, CONV_SHUFFLE_KERNEL_K);
+  shuffle::ConvShuffleGroupGEMM<CONV_SHUFFLE_KERNEL_M, CONV_SHUFFLE_KERNEL_N, CONV_SHUFFLE_KERNEL_K, NCHW>(
+      transformed_kernel, transformed_data, intermedia_out, aligned_m, aligned_n, aligned_k, ratio_a, ratio_b, sum_a,
+      min_b, NULL, 1, alpha * alpha, channel_out, 1, patches, 0.5, aligned_m - channel_out, aligned_n - patches);
+}
+
+template <size_t tile, typename VType>
+static INLINE_SPECIFIER void OutputTransform(float *dst, float *src, size_t xi_stride, size_t lanes, float bias) {
+  typedef Winograd3x3Matrix<tile> Matrix;
+  const size_t alpha = Matrix::alpha;
+  VType m[alpha][alpha];
+  VType y[tile][tile];
+  for (size_t xi = 0; xi < alpha * alpha; ++xi) {
+    m[xi / alpha][xi % alpha] = Load(src + xi * xi_stride, VType());
+  }
+  Sandwich<tile, alpha, Matrix::AT>(y, m);
+  for (size_t i = 0; i < tile * tile; ++i) {
+    Store(dst + i * lanes, Add(y[i / tile][i % tile], Set1(bias, VType())));
+  }
+}
+
+// Y = A^T M A per output channel, PS_OPERAND_WIDTH patches at a time, then bias and the fused epilogue on the valid
+// outputs of each patch; patches are clipped at the border.
+template <size_t tile, LAYOUT layout>
+void NHWCWinograd3x3PostProcess(float *out, float *intermedia_out, float *bias, size_t batch_size, size_t patch_y_num,
+                                size_t patch_x_num, size_t channel_out, size_t height_out, size_t width_out,
+                                bool conv_relu_fusion, bool conv_bn_fusion, bool conv_bn_relu_fusion,
+                                float *global_mean, float *mul_variance_coeff, float *scale, float *shift,
+                                float *residual) {
+  size_t patches = batch_size * patch_y_num * patch_x_num;
+  size_t patch_blocks = (patches + PS_OPERAND_WIDTH - 1) / PS_OPERAND_WIDTH;
+  size_t xi_stride = channel_out * patches;
+#pragma omp parallel
+  {
+    TraceScope trace("epilogue");
+#pragma omp for collapse(2)
+    for (size_t co = 0; co < channel_out; ++co) {
+      for (size_t block = 0; block < patch_blocks; ++block) {
+        // the output transform, bias and fusions of Winograd
+        float y[tile * tile * PS_OPERAND_WIDTH];
+        size_t p0 = block * PS_OPERAND_WIDTH;
+        size_t lanes = std::min(static_cast<size_t>(PS_OPERAND_WIDTH), patches - p0);
+        float *src = intermedia_out + co * patches + p0;
+        float bias_value = (bias == NULL) ? 0.0f : bias[co];
+        if (lanes == PS_OPERAND_WIDTH) {
+          OutputTransform<tile, SIMDPSTYPE>(y, src, xi_stride, PS_OPERAND_WIDTH, bias_value);
+        } else {
+          for (size_t l = 0; l < lanes; ++l) {
+            OutputTransform<tile, float>(y + l, src + l, xi_stride, PS_OPERAND_WIDTH, bias_value);
+          }
+        }
+        for (size_t l = 0; l < lanes; ++l) {
+          size_t p = p0 + l;
+          size_t n = p / (patch_y_num * patch_x_num);
+          size_t y0 = p / patch_x_num % patch_y_num * tile;
+          size_t x0 = p % patch_x_num * tile;
+          for (size_t i = 0; (i < tile) && (y0 + i < height_out); ++i) {
+            for (size_t j = 0; (j < tile) && (x0 + j < width_out); ++j) {
+              size_t index = (layout == NCHW) ? ((n * channel_out + co) * height_out + y0 + i) * width_out + x0 + j
+                                              : ((n * height_out + y0 + i) * width_out + x0 + j) * channel_out + co;
+              float value = y[(i * tile + j) * PS_OPERAND_WIDTH + l];
+              ScalarChannelFusion(value, co, conv_bn_fusion, conv_bn_relu_fusion, false, global_mean,
+                                  mul_variance_coeff, scale, shift);
+              ScalarOutputFusion(value, (residual == NULL) ? NULL : residual + index, conv_relu_fusion,
+                                 conv_bn_relu_fusion);
+              out[index] = value;
+            }
+          }
+        }
+      }
+    }
+  }
+}
+}
+
+#endif
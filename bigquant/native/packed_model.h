@@ -0,0 +1,281 @@
+/*
+ * Copyright 2016 The BigDL Authors.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef PACKED_MODEL_H
+#define PACKED_MODEL_H
+
+#include <fstream>
+#include <memory>
+#include "base.h"
+#include "common.h"
+#include "tensor.h"
+#if !defined(_MSC_VER) && !defined(__MINGW32__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// Packed layers on disk. A PackedModelHeader, then the record: size_t fields as uint64, floats, and tensors as their
+// dims followed by the elements at the next PACKED_MODEL_ALIGNMENT boundary of the file. Mapped at a page boundary the
+// elements are as aligned as freshly allocated ones, so the loaded layers execute from the file in place. The
+// numbers are in native byte order; the file is only valid for the ISA build and GEMM kernel shapes that wrote it.
+#define PACKED_MODEL_VERSION 1
+#define PACKED_MODEL_ALIGNMENT 64
+
+typedef enum PACKED_RECORD { PACKED_CONV = 0, PACKED_FC = 1, PACKED_GRAPH = 2 } PACKED_RECORD;
+
+struct PackedModelHeader {
+  char magic_[8];
+  uint32_t version_;
+  uint32_t alignment_;
+  uint32_t conv_kernel_[3];
+  uint32_t fc_kernel_[3];
+  char isa_[8];
+  uint32_t record_;
+  uint32_t reserved_;
+
+  static PackedModelHeader Current(PACKED_RECORD record) {
+    PackedModelHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic_, "BQPACKED", sizeof(header.magic_));
+    header.version_ = PACKED_MODEL_VERSION;
+    header.alignment_ = PACKED_MODEL_ALIGNMENT;
+    header.conv_kernel_[0] = CONV_SHUFFLE_KERNEL_M;
+    header.conv_kernel_[1] = CONV_SHUFFLE_KERNEL_N;
+    header.conv_kernel_[2] = CONV_SHUFFLE_KERNEL_K;
+    header.fc_kernel_[0] = FC_SHUFFLE_KERNEL_M;
+    header.fc_kernel_[1] = FC_SHUFFLE_KERNEL_N;
+    header.fc_kernel_[2] = FC_SHUFFLE_KERNEL_K;
+    strncpy(header.isa_, GetISAName(), sizeof(header.isa_));
+    header.record_ = record;
+    return header;
+  }
+};
+
+struct PackedWriter {
+  PackedWriter() : offset_(0) {
+  }
+
+  PackedWriter(const PackedWriter&) = delete;
+
+  PackedWriter& operator=(const PackedWriter&) = delete;
+
+  bool Open(const char *path, PACKED_RECORD record) {
+    out_.open(path, std::ios::binary | std::ios::trunc);
+    PackedModelHeader header = PackedModelHeader::Current(record);
+    Write(&header, sizeof(header));
+    return out_.good();
+  }
+
+  // False if anything failed to write
+  bool Close() {
+    out_.close();
+    return !out_.fail();
+  }
+
+  void WriteSize(size_t value) {
+    uint64_t field = value;
+    Write(&field, sizeof(field));
+  }
+
+  void WriteFloat(float value) {
+    Write(&value, sizeof(value));
+  }
+
+  // A NULL tensor is written as one without dims and read back as NULL
+  template <typename DType>
+  void WriteTensor(Tensor<DType> *tensor) {
+    if (tensor == NULL) {
+      WriteSize(0);
+      return;
+    }
+    WriteSize(tensor->shape_.dim_);
+    for (size_t i = 0; i < tensor->shape_.dim_; ++i) {
+      WriteSize(tensor->shape_[i]);
+    }
+    static const char zeros[PACKED_MODEL_ALIGNMENT] = {0};
+    Write(zeros, GetAlignmentLength(offset_, PACKED_MODEL_ALIGNMENT) - offset_);
+    Write(tensor->data_, tensor->Size());
+  }
+
+  void Write(const void *data, size_t bytes) {
+    out_.write(reinterpret_cast<const char *>(data), bytes);
+    offset_ += bytes;
+  }
+
+  std::ofstream out_;
+  size_t offset_;
+};
+
+// A packed file mapped read only. Every process mapping the same file shares its pages through the page cache. Where
+// mmap is not available the file is read into memory instead.
+struct PackedMapping {
+  PackedMapping() : data_(NULL), size_(0) {
+  }
+
+  ~PackedMapping() {
+    if (data_ == NULL) {
+      return;
+    }
+#if !defined(_MSC_VER) && !defined(__MINGW32__)
+    munmap(data_, size_);
+#else
+    aligned_free(data_);
+#endif
+  }
+
+  PackedMapping(const PackedMapping&) = delete;
+
+  PackedMapping& operator=(const PackedMapping&) = delete;
+
+  bool Open(const char *path) {
+#if !defined(_MSC_VER) && !defined(__MINGW32__)
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+      return false;
+    }
+    struct stat st;
+    if ((fstat(fd, &st) != 0) || (st.st_size <= 0)) {
+      close(fd);
+      return false;
+    }
+    void *data = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) {
+      return false;
+    }
+    data_ = reinterpret_cast<char *>(data);
+    size_ = st.st_size;
+#else
+    std::ifstream in(path, std::ios::binary | std::ios::ate);
+    if (!in || (in.tellg() <= 0)) {
+      return false;
+    }
+    size_ = static_cast<size_t>(in.tellg());
+    aligned_malloc(reinterpret_cast<void **>(&data_), 4096, size_);
+    in.seekg(0);
+    in.read(data_, size_);
+    if (!in) {
+      return false;
+    }
+#endif
+    return true;
+  }
+
+  char *data_;
+  size_t size_;
+};
+
+// Reads a record back in the order it was written. A field past the end of the file or a tensor of another element
+// count than expected fails the reader; every later read then fails too, so callers check Ok() once at the end.
+struct PackedReader {
+  PackedReader() : offset_(0), ok_(false) {
+  }
+
+  PackedReader(const PackedReader&) = delete;
+
+  PackedReader& operator=(const PackedReader&) = delete;
+
+  bool Open(const char *path, PACKED_RECORD record) {
+    mapping_ = std::make_shared<PackedMapping>();
+    ok_ = mapping_->Open(path) && (mapping_->size_ >= sizeof(PackedModelHeader));
+    if (!ok_) {
+      return false;
+    }
+    PackedModelHeader header;
+    PackedModelHeader current = PackedModelHeader::Current(record);
+    memcpy(&header, mapping_->data_, sizeof(header));
+    offset_ = sizeof(header);
+    ok_ = (memcmp(&header, &current, sizeof(header)) == 0);
+    return ok_;
+  }
+
+  bool Ok() const {
+    return ok_;
+  }
+
+  size_t ReadSize() {
+    uint64_t field = 0;
+    Read(&field, sizeof(field));
+    return static_cast<size_t>(field);
+  }
+
+  float ReadFloat() {
+    float value = 0.0f;
+    Read(&value, sizeof(value));
+    return value;
+  }
+
+  // Points tensor at its elements in the mapping, which the caller keeps alive as long as the tensor
+  template <typename DType>
+  bool ReadTensor(Tensor<DType> &tensor, size_t count) {
+    size_t dim = ReadSize();
+    if (dim == 0) {
+      ok_ = false;
+    }
+    return ReadTensorData(tensor, dim, count);
+  }
+
+  // NULL if the tensor was written as NULL
+  template <typename DType>
+  Tensor<DType> *ReadOptionalTensor(size_t count) {
+    size_t dim = ReadSize();
+    if (!ok_ || (dim == 0)) {
+      return NULL;
+    }
+    Tensor<DType> *tensor = new Tensor<DType>(Shape());
+    ReadTensorData(*tensor, dim, count);
+    return tensor;
+  }
+
+  template <typename DType>
+  bool ReadTensorData(Tensor<DType> &tensor, size_t dim, size_t count) {
+    if (!ok_ || (dim > 4)) {
+      ok_ = false;
+      return false;
+    }
+    Shape shape(dim);
+    for (size_t i = 0; i < dim; ++i) {
+      shape.shape_[i] = ReadSize();
+    }
+    size_t offset = GetAlignmentLength(offset_, PACKED_MODEL_ALIGNMENT);
+    size_t bytes = sizeof(DType) * shape.Count();
+    if (!ok_ || (shape.Count() != count) || (offset > mapping_->size_) || (bytes > mapping_->size_ - offset)) {
+      ok_ = false;
+      return false;
+    }
+    tensor.shape_ = shape;
+    tensor.SetData(reinterpret_cast<DType *>(mapping_->data_ + offset));
+    offset_ = offset + bytes;
+    return true;
+  }
+
+  void Read(void *data, size_t bytes) {
+    if (!ok_ || (bytes > mapping_->size_ - offset_)) {
+      ok_ = false;
+      return;
+    }
+    memcpy(data, mapping_->data_ + offset_, bytes);
+    offset_ += bytes;
+  }
+
+  std::shared_ptr<PackedMapping> mapping_;
+  size_t offset_;
+  bool ok_;
+};
+
+#endif
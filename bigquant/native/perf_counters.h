@@ -0,0 +1,143 @@
+/*
+ * Copyright 2016 The BigDL Authors.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef PERF_COUNTERS_H
+#define PERF_COUNTERS_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include "base.h"
+#include "trace.h"
+
+// Process wide totals of the PERF_COUNTER ops and phases. Counting is off unless enabled through
+// BigQuantEnablePerfCounters or by setting BIGQUANT_PERF_COUNTERS=1; while off, an instrumented call only loads the
+// flag. Totals are relaxed atomics, so concurrent Executes add to them without a lock and a read taken during an
+// Execute may miss its latest call.
+struct PerfCounters {
+  static PerfCounters &Instance() {
+    static PerfCounters counters;
+    return counters;
+  }
+
+  PerfCounters(const PerfCounters&) = delete;
+
+  PerfCounters& operator=(const PerfCounters&) = delete;
+
+  bool Enabled() const {
+    return enabled_.load(std::memory_order_relaxed);
+  }
+
+  void Enable(bool enable) {
+    enabled_.store(enable, std::memory_order_relaxed);
+  }
+
+  void Reset() {
+    for (size_t i = 0; i < PERF_COUNTER_NUM; ++i) {
+      calls_[i].store(0, std::memory_order_relaxed);
+      nanoseconds_[i].store(0, std::memory_order_relaxed);
+      ops_[i].store(0, std::memory_order_relaxed);
+      bytes_[i].store(0, std::memory_order_relaxed);
+    }
+  }
+
+  void Add(PERF_COUNTER counter, uint64_t nanoseconds, uint64_t ops, uint64_t bytes) {
+    calls_[counter].fetch_add(1, std::memory_order_relaxed);
+    nanoseconds_[counter].fetch_add(nanoseconds, std::memory_order_relaxed);
+    ops_[counter].fetch_add(ops, std::memory_order_relaxed);
+    bytes_[counter].fetch_add(bytes, std::memory_order_relaxed);
+  }
+
+  // Returns false for a counter outside PERF_COUNTER
+  bool Read(int counter, PerfCounterValue *value) const {
+    if ((counter < 0) || (counter >= PERF_COUNTER_NUM)) {
+      return false;
+    }
+    value->calls = calls_[counter].load(std::memory_order_relaxed);
+    value->nanoseconds = nanoseconds_[counter].load(std::memory_order_relaxed);
+    value->ops = ops_[counter].load(std::memory_order_relaxed);
+    value->bytes = bytes_[counter].load(std::memory_order_relaxed);
+    return true;
+  }
+
+  // Metric name of a counter, NULL outside PERF_COUNTER
+  static const char *Name(int counter) {
+    static const char *names[PERF_COUNTER_NUM] = {"conv_op", "fc_op",  "graph", "mix_precision_gemm",
+                                                  "quantize", "im2col", "gemm",  "layout_transform"};
+    return ((counter < 0) || (counter >= PERF_COUNTER_NUM)) ? NULL : names[counter];
+  }
+
+ private:
+  PerfCounters() {
+    const char *enable = getenv("BIGQUANT_PERF_COUNTERS");
+    enabled_.store((enable != NULL) && (strcmp(enable, "1") == 0), std::memory_order_relaxed);
+    Reset();
+  }
+
+  std::atomic<bool> enabled_;
+  std::atomic<uint64_t> calls_[PERF_COUNTER_NUM];
+  std::atomic<uint64_t> nanoseconds_[PERF_COUNTER_NUM];
+  std::atomic<uint64_t> ops_[PERF_COUNTER_NUM];
+  std::atomic<uint64_t> bytes_[PERF_COUNTER_NUM];
+};
+
+// Adds the time its scope took, one call, ops and bytes to a counter, if the counters were enabled when it opened.
+// While tracing, the scope is also a span of the calling thread named after the counter.
+class PerfScope {
+ public:
+  explicit PerfScope(PERF_COUNTER counter, uint64_t ops = 0, uint64_t bytes = 0)
+      : counter_(counter), ops_(ops), bytes_(bytes), enabled_(PerfCounters::Instance().Enabled()),
+        trace_(PerfCounters::Name(counter), (counter < PERF_QUANTIZE) ? "op" : "phase") {
+    if (enabled_) {
+      start_ = std::chrono::steady_clock::now();
+    }
+    if (ops != 0) {
+      trace_.Arg("ops", ops);
+    }
+    if (bytes != 0) {
+      trace_.Arg("bytes", bytes);
+    }
+  }
+
+  ~PerfScope() {
+    if (enabled_) {
+      auto end = std::chrono::steady_clock::now();
+      uint64_t nanoseconds = std::chrono::duration_cast<std::chrono::nanoseconds>(end - start_).count();
+      PerfCounters::Instance().Add(counter_, nanoseconds, ops_, bytes_);
+    }
+  }
+
+  PerfScope(const PerfScope&) = delete;
+
+  PerfScope& operator=(const PerfScope&) = delete;
+
+  // An argument of the trace span, such as a dimension of the op
+  PerfScope &Arg(const char *name, uint64_t value) {
+    trace_.Arg(name, value);
+    return *this;
+  }
+
+ private:
+  PERF_COUNTER counter_;
+  uint64_t ops_;
+  uint64_t bytes_;
+  bool enabled_;
+  std::chrono::steady_clock::time_point start_;
+  TraceScope trace_;
+};
+
+#endif
@@ -18,6 +18,7 @@
 #define TENSOR_H
 
 #include "alloc.h"
+#include "common.h"
 
 struct Shape {
   size_t dim_;
@@ -161,5 +162,68 @@ struct QuantizedTensor : public Tensor<DstType> {
   }
 };
 
+// Per-node copies of a read-only buffer such as packed weights. Threads on node k then stream replica k from local
+// memory instead of the node that happened to first-touch the original.
+template <typename DType>
+struct NumaReplicas {
+  NumaReplicas() : count_(0) {
+  }
+
+  ~NumaReplicas() {
+    Release();
+  }
+
+  NumaReplicas(const NumaReplicas &) = delete;
+
+  NumaReplicas &operator=(const NumaReplicas &) = delete;
+
+  // src may be one of the current replicas, e.g. a tensor replicated again by ReplicateTensor, so the old ones are
+  // only released once it has been copied
+  void Replicate(const DType *src, size_t count) {
+    std::vector<DType *> replicas(GetSocketNum());
+    for (size_t socket = 0; socket < replicas.size(); ++socket) {
+      aligned_malloc_onnode(reinterpret_cast<void **>(&replicas[socket]), sizeof(DType) * count, GetSocketNode(socket));
+      memcpy(replicas[socket], src, sizeof(DType) * count);
+    }
+    Release();
+    replicas_.swap(replicas);
+    count_ = count;
+  }
+
+  // Replicates the data of tensor and points it at the first replica, freeing the original if it owned it, so N
+  // nodes hold N copies of the weights rather than N + 1
+  void ReplicateTensor(Tensor<DType> *tensor, size_t count) {
+    Replicate(tensor->data_, count);
+    if (tensor->data_owner_) {
+      aligned_free(tensor->data_);
+    }
+    tensor->SetData(replicas_[0]);
+  }
+
+  void Release() {
+    for (size_t node = 0; node < replicas_.size(); ++node) {
+      aligned_free_onnode(replicas_[node], sizeof(DType) * count_);
+    }
+    replicas_.clear();
+    count_ = 0;
+  }
+
+  // The replica of the calling thread's node, src itself when nothing was replicated
+  DType *Local(DType *src) const {
+    if (replicas_.empty()) {
+      return src;
+    }
+    size_t socket = GetCurrentSocket();
+    return replicas_[(socket < replicas_.size()) ? socket : 0];
+  }
+
+  size_t Size() {
+    return sizeof(DType) * count_ * replicas_.size();
+  }
+
+  std::vector<DType *> replicas_;
+  size_t count_;
+};
+
 //}
 #endif
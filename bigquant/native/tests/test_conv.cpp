@@ -2,6 +2,12 @@
 #include <array>
 #include <vector>
 #include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
 #include "bigquant.h"
 #include "CppUTest/TestHarness.h"
 #include "CppUTest/CommandLineTestRunner.h"
@@ -10,6 +16,35 @@ static size_t GetConvOutSize(size_t in, size_t kernel, size_t stride, size_t pad
   return (in + 2 * pad - (dilation * (kernel - 1) + 1)) / stride + 1;
 }
 
+// Non-constant weight and data in [-1, 1), so a wrong tap or channel shows up, and a bias cycling through 0..4
+static void FillTestData(std::vector<float>& weight, std::vector<float>& data) {
+  for (size_t i = 0; i < weight.size(); ++i) {
+    weight[i] = static_cast<float>((i * 7919) % 61) / 30.0f - 1.0f;
+  }
+  for (size_t i = 0; i < data.size(); ++i) {
+    data[i] = static_cast<float>((i * 104729) % 97) / 48.0f - 1.0f;
+  }
+}
+
+static void FillTestData(std::vector<float>& weight, std::vector<float>& data, std::vector<float>& bias) {
+  FillTestData(weight, data);
+  for (size_t i = 0; i < bias.size(); ++i) {
+    bias[i] = static_cast<float>(i % 5);
+  }
+}
+
+// Checks actual against expected within tolerance times the largest expected magnitude, which is returned
+static double CheckRelative(const std::vector<float>& expected, const std::vector<float>& actual, double tolerance) {
+  double max_value = 0.0;
+  for (size_t i = 0; i < expected.size(); ++i) {
+    max_value = std::max(max_value, static_cast<double>(std::fabs(expected[i])));
+  }
+  for (size_t i = 0; i < expected.size(); ++i) {
+    DOUBLES_EQUAL(expected[i], actual[i], tolerance * max_value);
+  }
+  return max_value;
+}
+
 void TestConvolutionDesc(size_t data_batch, size_t data_channel, size_t data_height, size_t data_width, size_t group,
                          size_t filter_num, size_t filter_height, size_t filter_width, size_t stride_h, size_t stride_w,
                          size_t pad_h, size_t pad_w, size_t dilation_h, size_t dilation_w, LAYOUT layout) {
@@ -158,6 +193,1241 @@ TEST(CONVOLUTION, TEST_NCHW_CONVOLUTION_TENSOR) {
   TestConvolutionTensor(32, 128, 16, 16, 1, 1, 11, 11, 1, 1, 0, 0, 1, 1, NCHW);
 }
 
+TEST(CONVOLUTION, TEST_CONVOLUTION_WORKSPACE_REUSE) {
+  LAYOUT layouts[] = {NCHW, NHWC};
+  for (size_t l = 0; l < 2; ++l) {
+    QuantizedConvOp* desc = QuantizedConvOpCreate();
+    std::vector<float> weight(16 * 32 * 3 * 3, 1.0f);
+    std::vector<float> data(8 * 32 * 16 * 16, 1.0f);
+    std::vector<float> out(8 * 16 * 14 * 14);
+    QuantizedConvOpSetupConvParameter(desc, layouts[l], 16, 32, 1, 3, 3, 1, 1, 0, 0, 1, 1, 0, SHUFFLE_CONV);
+    QuantizedConvOpInitWeight(desc, weight.data());
+    // the first call sizes the workspace, smaller batches reuse it
+    size_t batches[] = {8, 1, 4, 8};
+    for (size_t i = 0; i < 4; ++i) {
+      std::fill(out.begin(), out.end(), 0.0f);
+      QuantizedConvOpExecute(desc, out.data(), data.data(), NULL, batches[i], 32, 16, 16);
+      for (size_t j = 0; j < batches[i] * 16 * 14 * 14; ++j) {
+        DOUBLES_EQUAL(out[j], 32 * 3 * 3, 1e-6);
+      }
+    }
+    CHECK(QuantizedConvOpGetWorkspaceSavedBytes(desc) > 0);
+    QuantizedConvOpShrinkWorkspace(desc);
+    QuantizedConvOpExecute(desc, out.data(), data.data(), NULL, 2, 32, 16, 16);
+    for (size_t j = 0; j < 2 * 16 * 14 * 14; ++j) {
+      DOUBLES_EQUAL(out[j], 32 * 3 * 3, 1e-6);
+    }
+    QuantizedConvOpFree(desc);
+  }
+}
+
+// 13x13 outputs put the GEMM tiles across image boundaries in NCHW; the plan is rebuilt whenever the batch changes
+TEST(CONVOLUTION, TEST_CONVOLUTION_WARMUP) {
+  LAYOUT layouts[] = {NCHW, NHWC};
+  for (size_t l = 0; l < 2; ++l) {
+    QuantizedConvOp* desc = QuantizedConvOpCreate();
+    std::vector<float> weight(20 * 32 * 3 * 3, 1.0f);
+    std::vector<float> data(3 * 32 * 15 * 15, 1.0f);
+    std::vector<float> out(3 * 20 * 13 * 13);
+    QuantizedConvOpSetupConvParameter(desc, layouts[l], 20, 32, 1, 3, 3, 1, 1, 0, 0, 1, 1, 0, SHUFFLE_CONV);
+    QuantizedConvOpInitWeight(desc, weight.data());
+    QuantizedConvOpWarmUp(desc, 2, 32, 15, 15);
+    size_t batches[] = {2, 3, 2};
+    for (size_t i = 0; i < 3; ++i) {
+      std::fill(out.begin(), out.end(), 0.0f);
+      QuantizedConvOpExecute(desc, out.data(), data.data(), NULL, batches[i], 32, 15, 15);
+      for (size_t j = 0; j < batches[i] * 20 * 13 * 13; ++j) {
+        DOUBLES_EQUAL(out[j], 32 * 3 * 3, 1e-6);
+      }
+    }
+    QuantizedConvOpFree(desc);
+  }
+}
+
+// Several threads share one op, each with its own batch size and input value, so a context leaking between threads
+// shows up as a wrong value or shape
+TEST(CONVOLUTION, TEST_CONVOLUTION_SHARED_OP) {
+  LAYOUT layouts[] = {NCHW, NHWC};
+  const size_t threads = 4, repeat = 8;
+  for (size_t l = 0; l < 2; ++l) {
+    QuantizedConvOp* desc = QuantizedConvOpCreate();
+    std::vector<float> weight(20 * 32 * 3 * 3, 1.0f);
+    QuantizedConvOpSetupConvParameter(desc, layouts[l], 20, 32, 1, 3, 3, 1, 1, 0, 0, 1, 1, 0, SHUFFLE_CONV);
+    QuantizedConvOpInitWeight(desc, weight.data());
+    std::vector<std::vector<float>> outs(threads);
+    std::vector<std::thread> workers;
+    for (size_t t = 0; t < threads; ++t) {
+      workers.push_back(std::thread([&, t] {
+        size_t batch = t + 1;
+        std::vector<float> data(batch * 32 * 15 * 15, static_cast<float>(t + 1));
+        outs[t].resize(batch * 20 * 13 * 13);
+        for (size_t r = 0; r < repeat; ++r) {
+          QuantizedConvOpExecute(desc, outs[t].data(), data.data(), NULL, batch, 32, 15, 15);
+        }
+      }));
+    }
+    for (size_t t = 0; t < threads; ++t) {
+      workers[t].join();
+    }
+    // the contexts of the workers went with them, so a new thread starts afresh even if it reuses the id of one
+    size_t saved_bytes = 1;
+    std::thread([&] { saved_bytes = QuantizedConvOpGetWorkspaceSavedBytes(desc); }).join();
+    LONGS_EQUAL(0, saved_bytes);
+    QuantizedConvOpFree(desc);
+    for (size_t t = 0; t < threads; ++t) {
+      for (size_t j = 0; j < outs[t].size(); ++j) {
+        DOUBLES_EQUAL(outs[t][j], (t + 1) * 32 * 3 * 3, 1e-3);
+      }
+    }
+  }
+}
+
+void TestConvolutionFusion(size_t fusion_mask, LAYOUT layout, bool inplace) {
+  // every output of the 3x3 convolution over ones is 16 * 3 * 3 = 144, BN maps it to (144 - 100) / 2 * 2 - 50 = -6
+  size_t batch = 2, channel_in = 16, channel_out = 12, height = 10, width = 10;
+  size_t out_count = batch * channel_out * 8 * 8;
+  QuantizedConvOp* desc = QuantizedConvOpCreate();
+  std::vector<float> weight(channel_out * channel_in * 3 * 3, 1.0f);
+  std::vector<float> data(batch * channel_in * height * width, 1.0f);
+  std::vector<float> mean(channel_out, 100.0f), variance(channel_out, 4.0f), scale(channel_out, 2.0f),
+      shift(channel_out, -50.0f);
+  std::vector<float> residual(out_count), out(out_count);
+  for (size_t i = 0; i < out_count; ++i) {
+    residual[i] = static_cast<float>(i % 13);
+  }
+  QuantizedConvOpSetupConvParameter(desc, layout, channel_out, channel_in, 1, 3, 3, 1, 1, 0, 0, 1, 1, fusion_mask,
+                                    SHUFFLE_CONV);
+  QuantizedConvOpInitWeight(desc, weight.data());
+  QuantizedConvOpSetupBNParameter(desc, mean.data(), variance.data(), scale.data(), shift.data(), 0.0f);
+  if (inplace) {
+    out = residual;
+  }
+  QuantizedConvOpExecuteWithResidual(desc, out.data(), data.data(), NULL, inplace ? out.data() : residual.data(),
+                                     batch, channel_in, height, width);
+  QuantizedConvOpFree(desc);
+  for (size_t i = 0; i < out_count; ++i) {
+    float expected = (fusion_mask & FUSION_BN) ? -6.0f : 144.0f;
+    expected += (fusion_mask & FUSION_SUM) ? residual[i] : 0.0f;
+    expected = (fusion_mask & FUSION_RELU) ? std::max(expected, 0.0f) : expected;
+    DOUBLES_EQUAL(out[i], expected, 1e-4);
+  }
+}
+
+TEST(CONVOLUTION, TEST_CONVOLUTION_FUSION) {
+  LAYOUT layouts[] = {NCHW, NHWC};
+  for (size_t l = 0; l < 2; ++l) {
+    TestConvolutionFusion(FUSION_RELU, layouts[l], false);
+    TestConvolutionFusion(FUSION_BN, layouts[l], false);
+    TestConvolutionFusion(FUSION_BN | FUSION_RELU, layouts[l], false);
+    TestConvolutionFusion(FUSION_SUM, layouts[l], false);
+    TestConvolutionFusion(FUSION_BN | FUSION_SUM, layouts[l], false);
+    TestConvolutionFusion(FUSION_BN | FUSION_SUM | FUSION_RELU, layouts[l], false);
+    TestConvolutionFusion(FUSION_BN | FUSION_SUM | FUSION_RELU, layouts[l], true);
+  }
+}
+
+// The requantized output must match quantizing the float output of the same op. Both run the same GEMM, so they may
+// only differ where the rounding is at a half step. 9x9 outputs leave partial tiles and, in NCHW, tiles across images.
+// DEPTHWISE_CONV and WINOGRAD_CONV have no requantizing epilogue and take the separate requantize pass.
+void TestConvolutionRequantized(LAYOUT layout, size_t group, size_t channel_out, size_t fusion_mask,
+                                CONV_ALGORITHM algo) {
+  size_t batch = 2, channel_in = 16, size = 9;
+  size_t out_count = batch * channel_out * size * size;
+  QuantizedConvOp* desc = QuantizedConvOpCreate();
+  std::vector<float> weight(channel_out * channel_in / group * 3 * 3), data(batch * channel_in * size * size);
+  std::vector<float> bias(channel_out), residual(out_count), out(out_count);
+  for (size_t i = 0; i < weight.size(); ++i) {
+    weight[i] = static_cast<float>(i % 7) / 7.0f - 0.4f;
+  }
+  for (size_t i = 0; i < data.size(); ++i) {
+    data[i] = static_cast<float>(i % 11) / 11.0f - 0.3f;
+  }
+  for (size_t i = 0; i < out_count; ++i) {
+    residual[i] = static_cast<float>(i % 5) - 2.0f;
+  }
+  for (size_t c = 0; c < channel_out; ++c) {
+    bias[c] = 0.1f * c - 1.0f;
+  }
+  QuantizedConvOpSetupConvParameter(desc, layout, channel_out, channel_in, group, 3, 3, 1, 1, 1, 1, 1, 1, fusion_mask,
+                                    algo);
+  QuantizedConvOpInitWeight(desc, weight.data());
+  QuantizedConvOpExecuteWithResidual(desc, out.data(), data.data(), bias.data(), residual.data(), batch, channel_in,
+                                     size, size);
+  float min = *std::min_element(out.begin(), out.end());
+  float max = *std::max_element(out.begin(), out.end());
+  float scale = (max - min) / 255.0f;
+  float zero_point = std::round(-min / scale);
+  LONGS_EQUAL(out_count, QuantizedConvOpGetRequantizedOutputSize(desc, batch, size, size));
+  std::vector<uint8_t> quantized(out_count);
+  QuantizedConvOpExecuteRequantized(desc, quantized.data(), scale, zero_point, data.data(), bias.data(),
+                                    residual.data(), batch, channel_in, size, size);
+  QuantizedConvOpFree(desc);
+  for (size_t i = 0; i < out_count; ++i) {
+    float expected = std::min(std::max(std::round(out[i] / scale) + zero_point, 0.0f), 255.0f);
+    DOUBLES_EQUAL(expected, quantized[i], 1.0);
+  }
+}
+
+TEST(CONVOLUTION, TEST_CONVOLUTION_REQUANTIZED) {
+  LAYOUT layouts[] = {NCHW, NHWC};
+  for (size_t l = 0; l < 2; ++l) {
+    TestConvolutionRequantized(layouts[l], 1, 24, FUSION_NONE, SHUFFLE_CONV);
+    TestConvolutionRequantized(layouts[l], 1, 24, FUSION_RELU, SHUFFLE_CONV);
+    TestConvolutionRequantized(layouts[l], 1, 24, FUSION_SUM | FUSION_RELU, SHUFFLE_CONV);
+    TestConvolutionRequantized(layouts[l], 2, 24, FUSION_RELU, SHUFFLE_CONV);
+    TestConvolutionRequantized(layouts[l], 16, 16, FUSION_SUM | FUSION_RELU, DEPTHWISE_CONV);
+    TestConvolutionRequantized(layouts[l], 1, 24, FUSION_SUM | FUSION_RELU, WINOGRAD_CONV);
+  }
+}
+
+// Static quantization maps the whole input with one range, so it only has to stay close to the per-pixel ranges
+void TestConvolutionStaticRange(LAYOUT layout, size_t group, size_t kernel, size_t pad) {
+  size_t batch = 2, channel_in = 16, channel_out = 24, size = 9;
+  size_t out_size = size + 2 * pad - kernel + 1;
+  QuantizedConvOp* desc = QuantizedConvOpCreate();
+  std::vector<float> weight(channel_out * channel_in / group * kernel * kernel), data(batch * channel_in * size * size);
+  std::vector<float> dynamic(batch * channel_out * out_size * out_size), out(dynamic.size());
+  for (size_t i = 0; i < weight.size(); ++i) {
+    weight[i] = static_cast<float>(i % 7) / 7.0f - 0.4f;
+  }
+  for (size_t i = 0; i < data.size(); ++i) {
+    data[i] = static_cast<float>(i % 11) / 11.0f - 0.3f;
+  }
+  QuantizedConvOpSetupConvParameter(desc, layout, channel_out, channel_in, group, kernel, kernel, 1, 1, pad, pad, 1, 1,
+                                    FUSION_NONE, SHUFFLE_CONV);
+  QuantizedConvOpInitWeight(desc, weight.data());
+  QuantizedConvOpExecute(desc, dynamic.data(), data.data(), NULL, batch, channel_in, size, size);
+  float min, max;
+  CHECK(!QuantizedConvOpGetInputRange(desc, &min, &max));
+  QuantizedConvOpStartCalibration(desc, CALIBRATION_MINMAX, 100.0f);
+  QuantizedConvOpExecute(desc, out.data(), data.data(), NULL, batch, channel_in, size, size);
+  QuantizedConvOpExecute(desc, out.data(), data.data(), NULL, 1, channel_in, size, size);
+  QuantizedConvOpFinishCalibration(desc);
+  CHECK(QuantizedConvOpGetInputRange(desc, &min, &max));
+  DOUBLES_EQUAL(-0.3f, min, 1e-6);
+  DOUBLES_EQUAL(10.0f / 11.0f - 0.3f, max, 1e-6);
+  QuantizedConvOpExecute(desc, out.data(), data.data(), NULL, batch, channel_in, size, size);
+  QuantizedConvOpSetInputRange(desc, 0.0f, 0.0f);
+  CHECK(!QuantizedConvOpGetInputRange(desc, &min, &max));
+  QuantizedConvOpFree(desc);
+  for (size_t i = 0; i < out.size(); ++i) {
+    DOUBLES_EQUAL(dynamic[i], out[i], 0.1);
+  }
+}
+
+TEST(CONVOLUTION, TEST_CONVOLUTION_STATIC_RANGE) {
+  LAYOUT layouts[] = {NCHW, NHWC};
+  for (size_t l = 0; l < 2; ++l) {
+    TestConvolutionStaticRange(layouts[l], 1, 3, 1);
+    TestConvolutionStaticRange(layouts[l], 2, 3, 1);
+    TestConvolutionStaticRange(layouts[l], 1, 1, 0);
+  }
+}
+
+// The percentile range ignores a few outliers, which then saturate
+TEST(CONVOLUTION, TEST_CONVOLUTION_CALIBRATION_PERCENTILE) {
+  size_t channel = 16, size = 16;
+  std::vector<float> weight(channel * channel, 0.1f), data(channel * size * size), out(data.size());
+  for (size_t i = 0; i < data.size(); ++i) {
+    data[i] = static_cast<float>(i % 101) / 100.0f;
+  }
+  data[7] = 1000.0f;
+  QuantizedConvOp* desc = QuantizedConvOpCreate();
+  QuantizedConvOpSetupConvParameter(desc, NHWC, channel, channel, 1, 1, 1, 1, 1, 0, 0, 1, 1, FUSION_NONE, SHUFFLE_CONV);
+  QuantizedConvOpInitWeight(desc, weight.data());
+  QuantizedConvOpStartCalibration(desc, CALIBRATION_PERCENTILE, 99.9f);
+  QuantizedConvOpExecute(desc, out.data(), data.data(), NULL, 1, channel, size, size);
+  QuantizedConvOpFinishCalibration(desc);
+  float min, max;
+  CHECK(QuantizedConvOpGetInputRange(desc, &min, &max));
+  DOUBLES_EQUAL(0.0f, min, 1e-6);
+  CHECK((max >= 0.99f) && (max < 2.0f));
+  QuantizedConvOpFree(desc);
+}
+
+// A calibration saved from one graph quantizes an identically built one the same way
+TEST(CONVOLUTION, TEST_GRAPH_CALIBRATION) {
+  size_t batch = 2, channel = 16, size = 8;
+  std::vector<float> data(batch * channel * size * size), weight(channel * channel * 9), weight_fc(10 * channel * 16);
+  for (size_t i = 0; i < data.size(); ++i) {
+    data[i] = static_cast<float>(i % 23) / 23.0f - 0.4f;
+  }
+  for (size_t i = 0; i < weight.size(); ++i) {
+    weight[i] = static_cast<float>(i % 7) / 7.0f - 0.4f;
+  }
+  for (size_t i = 0; i < weight_fc.size(); ++i) {
+    weight_fc[i] = static_cast<float>(i % 13) / 13.0f - 0.4f;
+  }
+  const char* path = "test_graph_calibration.txt";
+  std::vector<float> out[3];
+  for (size_t g = 0; g < 3; ++g) {
+    QuantizedGraph* graph = QuantizedGraphCreate(NHWC, channel, size, size);
+    size_t t1 = QuantizedGraphAddConv(graph, 0, -1, channel, 1, 3, 3, 1, 1, 1, 1, 1, 1, FUSION_RELU, weight.data(),
+                                      NULL, SHUFFLE_CONV);
+    size_t t2 = QuantizedGraphAddPool(graph, t1, MAX_POOL, 2, 2, 2, 2, 0, 0);
+    QuantizedGraphAddFC(graph, t2, 10, weight_fc.data(), NULL, SHUFFLE_FC);
+    out[g].resize(batch * 10);
+    if (g == 1) {
+      QuantizedGraphStartCalibration(graph, CALIBRATION_MINMAX, 100.0f);
+      QuantizedGraphExecute(graph, out[g].data(), data.data(), batch);
+      QuantizedGraphFinishCalibration(graph);
+      LONGS_EQUAL(2, QuantizedGraphSaveCalibration(graph, path));
+    } else if (g == 2) {
+      LONGS_EQUAL(2, QuantizedGraphLoadCalibration(graph, path));
+    }
+    QuantizedGraphExecute(graph, out[g].data(), data.data(), batch);
+    QuantizedGraphFree(graph);
+  }
+  remove(path);
+  for (size_t i = 0; i < out[0].size(); ++i) {
+    DOUBLES_EQUAL(out[1][i], out[2][i], 1e-6);
+    DOUBLES_EQUAL(out[0][i], out[1][i], 0.05f * std::max(1.0f, std::fabs(out[0][i])));
+  }
+}
+
+// A loaded op has to execute like the one that saved it, after that one is gone
+void TestConvolutionPacked(LAYOUT layout, size_t channel_in, size_t channel_out, size_t group, size_t kernel,
+                           size_t fusion_mask, CONV_ALGORITHM algo) {
+  size_t batch = 2, size = 9, pad = kernel / 2;
+  size_t out_count = batch * channel_out * size * size;
+  std::vector<float> weight(channel_out * channel_in / group * kernel * kernel), data(batch * channel_in * size * size);
+  std::vector<float> bias(channel_out), mean(channel_out), variance(channel_out, 2.0f), scale(channel_out, 0.5f);
+  for (size_t i = 0; i < weight.size(); ++i) {
+    weight[i] = static_cast<float>(i % 11) / 11.0f - 0.4f;
+  }
+  for (size_t i = 0; i < data.size(); ++i) {
+    data[i] = static_cast<float>(i % 17) / 17.0f - 0.3f;
+  }
+  for (size_t c = 0; c < channel_out; ++c) {
+    bias[c] = static_cast<float>(c % 5) - 2.0f;
+    mean[c] = static_cast<float>(c % 3);
+  }
+  const char* path = "test_conv_packed.bin";
+  std::vector<float> expected(out_count), out(out_count);
+  QuantizedConvOp* desc = QuantizedConvOpCreate();
+  QuantizedConvOpSetupConvParameter(desc, layout, channel_out, channel_in, group, kernel, kernel, 1, 1, pad, pad, 1, 1,
+                                    fusion_mask, algo);
+  QuantizedConvOpInitWeight(desc, weight.data());
+  QuantizedConvOpSetupBNParameter(desc, mean.data(), variance.data(), scale.data(), NULL, 1e-5f);
+  QuantizedConvOpSetInputRange(desc, -0.3f, 0.7f);
+  QuantizedConvOpExecute(desc, expected.data(), data.data(), bias.data(), batch, channel_in, size, size);
+  LONGS_EQUAL(0, QuantizedConvOpSavePacked(desc, path));
+  QuantizedConvOpFree(desc);
+
+  desc = QuantizedConvOpLoadPacked(path);
+  CHECK(desc != NULL);
+  float min = 0.0f, max = 0.0f;
+  CHECK(QuantizedConvOpGetInputRange(desc, &min, &max));
+  DOUBLES_EQUAL(-0.3f, min, 1e-6);
+  DOUBLES_EQUAL(0.7f, max, 1e-6);
+  QuantizedConvOpExecute(desc, out.data(), data.data(), bias.data(), batch, channel_in, size, size);
+  QuantizedConvOpFree(desc);
+  remove(path);
+  for (size_t i = 0; i < out_count; ++i) {
+    DOUBLES_EQUAL(expected[i], out[i], 1e-5 * std::max(1.0f, std::fabs(expected[i])));
+  }
+}
+
+TEST(CONVOLUTION, TEST_CONVOLUTION_PACKED_FILE) {
+  LAYOUT layouts[] = {NCHW, NHWC};
+  for (size_t l = 0; l < 2; ++l) {
+    TestConvolutionPacked(layouts[l], 16, 24, 1, 3, FUSION_BN | FUSION_RELU, SHUFFLE_CONV);
+    TestConvolutionPacked(layouts[l], 16, 24, 2, 3, FUSION_RELU, SHUFFLE_CONV);
+    TestConvolutionPacked(layouts[l], 16, 16, 16, 3, FUSION_BN, AUTO_SELECT_CONV);
+    TestConvolutionPacked(layouts[l], 16, 24, 1, 3, FUSION_BN, AUTO_SELECT_CONV);
+    TestConvolutionPacked(layouts[l], 16, 24, 1, 3, 0, WINOGRAD_CONV);
+    TestConvolutionPacked(layouts[l], 16, 24, 1, 1, 0, SHUFFLE_CONV);
+  }
+}
+
+// Files that are missing, cut short or not packed models don't load
+TEST(CONVOLUTION, TEST_CONVOLUTION_PACKED_FILE_INVALID) {
+  std::vector<float> weight(8 * 8 * 9, 0.5f);
+  const char* path = "test_conv_packed.bin";
+  const char* truncated = "test_conv_packed_truncated.bin";
+  QuantizedConvOp* desc = QuantizedConvOpCreate();
+  QuantizedConvOpSetupConvParameter(desc, NCHW, 8, 8, 1, 3, 3, 1, 1, 1, 1, 1, 1, 0, SHUFFLE_CONV);
+  QuantizedConvOpInitWeight(desc, weight.data());
+  LONGS_EQUAL(0, QuantizedConvOpSavePacked(desc, path));
+  QuantizedConvOpFree(desc);
+  CHECK(QuantizedConvOpLoadPacked("test_conv_packed_missing.bin") == NULL);
+  CHECK(QuantizedFCOpLoadPacked(path) == NULL);
+  std::vector<char> bytes(1 << 16);
+  FILE* in = fopen(path, "rb");
+  size_t count = fread(bytes.data(), 1, bytes.size(), in);
+  fclose(in);
+  FILE* out = fopen(truncated, "wb");
+  fwrite(bytes.data(), 1, count - 16, out);
+  fclose(out);
+  CHECK(QuantizedConvOpLoadPacked(truncated) == NULL);
+  remove(path);
+  remove(truncated);
+}
+
+// Topology, biases, BN and calibrated ranges all come back from the file
+TEST(CONVOLUTION, TEST_GRAPH_PACKED_FILE) {
+  size_t batch = 2, channel = 16, size = 8;
+  std::vector<float> data(batch * channel * size * size), weight(channel * channel * 9), weight_fc(10 * channel * 16);
+  std::vector<float> bias(channel), mean(channel, 0.1f), variance(channel, 2.0f);
+  for (size_t i = 0; i < data.size(); ++i) {
+    data[i] = static_cast<float>(i % 23) / 23.0f - 0.4f;
+  }
+  for (size_t i = 0; i < weight.size(); ++i) {
+    weight[i] = static_cast<float>(i % 7) / 7.0f - 0.4f;
+  }
+  for (size_t i = 0; i < weight_fc.size(); ++i) {
+    weight_fc[i] = static_cast<float>(i % 13) / 13.0f - 0.4f;
+  }
+  for (size_t c = 0; c < channel; ++c) {
+    bias[c] = static_cast<float>(c % 3) - 1.0f;
+  }
+  const char* path = "test_graph_packed.bin";
+  LAYOUT layouts[] = {NCHW, NHWC};
+  for (size_t l = 0; l < 2; ++l) {
+    QuantizedGraph* graph = QuantizedGraphCreate(layouts[l], channel, size, size);
+    size_t t1 = QuantizedGraphAddConv(graph, 0, -1, channel, 1, 3, 3, 1, 1, 1, 1, 1, 1, FUSION_BN | FUSION_RELU,
+                                      weight.data(), bias.data(), SHUFFLE_CONV);
+    QuantizedGraphSetupConvBNParameter(graph, t1, mean.data(), variance.data(), NULL, NULL, 1e-5f);
+    size_t t2 = QuantizedGraphAddConv(graph, t1, t1, channel, 1, 3, 3, 1, 1, 1, 1, 1, 1, FUSION_SUM, weight.data(),
+                                      NULL, AUTO_SELECT_CONV);
+    size_t t3 = QuantizedGraphAddReLU(graph, t2);
+    size_t t4 = QuantizedGraphAddPool(graph, t3, AVG_POOL, 2, 2, 2, 2, 0, 0);
+    size_t t5 = QuantizedGraphAddSum(graph, t4, t4, 0);
+    QuantizedGraphAddFC(graph, t5, 10, weight_fc.data(), bias.data(), SHUFFLE_FC);
+    std::vector<float> expected(batch * 10), out(batch * 10);
+    QuantizedGraphStartCalibration(graph, CALIBRATION_MINMAX, 100.0f);
+    QuantizedGraphExecute(graph, expected.data(), data.data(), batch);
+    QuantizedGraphFinishCalibration(graph);
+    QuantizedGraphExecute(graph, expected.data(), data.data(), batch);
+    LONGS_EQUAL(0, QuantizedGraphSavePacked(graph, path));
+    QuantizedGraphFree(graph);
+
+    graph = QuantizedGraphLoadPacked(path);
+    CHECK(graph != NULL);
+    LONGS_EQUAL(10, QuantizedGraphGetOutputSize(graph));
+    QuantizedGraphExecute(graph, out.data(), data.data(), batch);
+    QuantizedGraphFree(graph);
+    remove(path);
+    for (size_t i = 0; i < out.size(); ++i) {
+      DOUBLES_EQUAL(expected[i], out[i], 1e-5 * std::max(1.0f, std::fabs(expected[i])));
+    }
+  }
+}
+
+// A graph record with one field changed so that no Add* call could have built the node does not load
+TEST(CONVOLUTION, TEST_GRAPH_PACKED_FILE_INVALID) {
+  const char* path = "test_graph_packed.bin";
+  const char* patched = "test_graph_packed_patched.bin";
+  QuantizedGraph* graph = QuantizedGraphCreate(NCHW, 3, 8, 8);
+  size_t t1 = QuantizedGraphAddReLU(graph, 0);
+  size_t t2 = QuantizedGraphAddPool(graph, t1, MAX_POOL, 2, 2, 2, 2, 0, 0);
+  QuantizedGraphAddSum(graph, t2, t2, 0);
+  LONGS_EQUAL(0, QuantizedGraphSavePacked(graph, path));
+  QuantizedGraphFree(graph);
+  std::vector<char> bytes(1 << 16);
+  FILE* in = fopen(path, "rb");
+  size_t count = fread(bytes.data(), 1, bytes.size(), in);
+  fclose(in);
+  remove(path);
+  // the fields are 64-bit: a node is its type (2 pool, 3 sum), input count, inputs, output shape and no bias, then its
+  // layer, for the pool max, kernel, stride and pad
+  auto find = [&](const std::vector<uint64_t>& fields) {
+    for (size_t offset = 0; offset + fields.size() * 8 <= count; ++offset) {
+      if (memcmp(bytes.data() + offset, fields.data(), fields.size() * 8) == 0) {
+        return offset;
+      }
+    }
+    return count;
+  };
+  size_t pool = find({2, 1, t1, 3, 4, 4, 0});
+  size_t sum = find({3, 2, t2, t2, 3, 4, 4, 0});
+  CHECK(pool < count);
+  CHECK(sum < count);
+  // node, field and the value it is patched to: an unchanged type, then an unknown type, an input that is not there
+  // yet, a wrong output height, kernel 0, stride 0, pad >= kernel twice, a sum of different sizes, a wrong sum height
+  size_t patches[][3] = {{pool, 0, 2},  {pool, 0, 9},  {pool, 2, 7},  {pool, 4, 5}, {pool, 8, 0},
+                         {pool, 10, 0}, {pool, 12, 2}, {pool, 13, 3}, {sum, 3, t1}, {sum, 5, 3}};
+  for (size_t i = 0; i < sizeof(patches) / sizeof(patches[0]); ++i) {
+    std::vector<char> copy(bytes.begin(), bytes.begin() + count);
+    uint64_t value = patches[i][2];
+    memcpy(copy.data() + patches[i][0] + patches[i][1] * 8, &value, 8);
+    FILE* out = fopen(patched, "wb");
+    fwrite(copy.data(), 1, copy.size(), out);
+    fclose(out);
+    graph = QuantizedGraphLoadPacked(patched);
+    CHECK((graph != NULL) == (i == 0));
+    if (graph != NULL) {
+      QuantizedGraphFree(graph);
+    }
+  }
+  remove(patched);
+}
+
+void TestDepthwiseConvolution(size_t data_batch, size_t channel, size_t height, size_t width, size_t kernel,
+                              size_t stride, size_t pad, size_t dilation, LAYOUT layout) {
+  QuantizedConvOp* desc = QuantizedConvOpCreate();
+  std::vector<float> weight(channel * kernel * kernel, 1.0f);
+  std::vector<float> data(data_batch * channel * height * width, 1.0f);
+  size_t out_height = GetConvOutSize(height, kernel, stride, pad, dilation);
+  size_t out_width = GetConvOutSize(width, kernel, stride, pad, dilation);
+  std::vector<float> out(data_batch * channel * out_height * out_width);
+  // AUTO_SELECT_CONV may time this against the grouped SHUFFLE_CONV, so ask for DEPTHWISE_CONV explicitly
+  QuantizedConvOpSetupConvParameter(desc, layout, channel, channel, channel, kernel, kernel, stride, stride, pad, pad,
+                                    dilation, dilation, 0, DEPTHWISE_CONV);
+  QuantizedConvOpInitWeight(desc, weight.data());
+  QuantizedConvOpExecute(desc, out.data(), data.data(), NULL, data_batch, channel, height, width);
+  QuantizedConvOpFree(desc);
+  for (size_t i = 0; i < out.size(); ++i) {
+    size_t x = (layout == NCHW) ? i % out_width : i / channel % out_width;
+    size_t y = (layout == NCHW) ? i / out_width % out_height : i / channel / out_width % out_height;
+    // every tap that lands inside the image contributes 1
+    size_t taps = 0;
+    for (size_t ky = 0; ky < kernel; ++ky) {
+      for (size_t kx = 0; kx < kernel; ++kx) {
+        long iy = static_cast<long>(y * stride + ky * dilation) - static_cast<long>(pad);
+        long ix = static_cast<long>(x * stride + kx * dilation) - static_cast<long>(pad);
+        taps += (iy >= 0) && (ix >= 0) && (iy < static_cast<long>(height)) && (ix < static_cast<long>(width));
+      }
+    }
+    DOUBLES_EQUAL(out[i], taps, 1e-4);
+  }
+}
+
+TEST(CONVOLUTION, TEST_DEPTHWISE_CONVOLUTION) {
+  LAYOUT layouts[] = {NCHW, NHWC};
+  for (size_t l = 0; l < 2; ++l) {
+    TestDepthwiseConvolution(1, 32, 14, 14, 3, 1, 1, 1, layouts[l]);
+    TestDepthwiseConvolution(2, 19, 11, 9, 3, 2, 1, 1, layouts[l]);
+    TestDepthwiseConvolution(1, 8, 10, 10, 5, 1, 2, 1, layouts[l]);
+    TestDepthwiseConvolution(1, 24, 12, 12, 3, 1, 2, 2, layouts[l]);
+    TestDepthwiseConvolution(4, 64, 7, 7, 3, 2, 0, 1, layouts[l]);
+  }
+}
+
+void TestWinogradConvolution(size_t data_batch, size_t channel_in, size_t height, size_t width, size_t channel_out,
+                             size_t pad, CONV_ALGORITHM algo, LAYOUT layout) {
+  QuantizedConvOp* desc = QuantizedConvOpCreate();
+  std::vector<float> weight(channel_out * channel_in * 9, 1.0f);
+  std::vector<float> data(data_batch * channel_in * height * width, 1.0f);
+  size_t out_height = GetConvOutSize(height, 3, 1, pad, 1);
+  size_t out_width = GetConvOutSize(width, 3, 1, pad, 1);
+  std::vector<float> out(data_batch * channel_out * out_height * out_width);
+  QuantizedConvOpSetupConvParameter(desc, layout, channel_out, channel_in, 1, 3, 3, 1, 1, pad, pad, 1, 1, 0, algo);
+  QuantizedConvOpInitWeight(desc, weight.data());
+  QuantizedConvOpExecute(desc, out.data(), data.data(), NULL, data_batch, channel_in, height, width);
+  QuantizedConvOpFree(desc);
+  for (size_t i = 0; i < out.size(); ++i) {
+    size_t x = (layout == NCHW) ? i % out_width : i / channel_out % out_width;
+    size_t y = (layout == NCHW) ? i / out_width % out_height : i / channel_out / out_width % out_height;
+    // every tap that lands inside the image contributes channel_in
+    size_t taps = 0;
+    for (size_t ky = 0; ky < 3; ++ky) {
+      for (size_t kx = 0; kx < 3; ++kx) {
+        long iy = static_cast<long>(y + ky) - static_cast<long>(pad);
+        long ix = static_cast<long>(x + kx) - static_cast<long>(pad);
+        taps += (iy >= 0) && (ix >= 0) && (iy < static_cast<long>(height)) && (ix < static_cast<long>(width));
+      }
+    }
+    DOUBLES_EQUAL(out[i], taps * channel_in, 1e-3 * taps * channel_in);
+  }
+}
+
+// Compare against SHUFFLE_CONV on non-constant data; tolerance is relative to the largest output
+void TestWinogradConvolutionAccuracy(size_t data_batch, size_t channel_in, size_t size, size_t channel_out,
+                                     CONV_ALGORITHM algo, double tolerance, LAYOUT layout) {
+  std::vector<float> weight(channel_out * channel_in * 9);
+  std::vector<float> data(data_batch * channel_in * size * size);
+  std::vector<float> bias(channel_out);
+  FillTestData(weight, data, bias);
+  std::vector<float> out[2];
+  CONV_ALGORITHM algos[] = {SHUFFLE_CONV, algo};
+  for (size_t a = 0; a < 2; ++a) {
+    QuantizedConvOp* desc = QuantizedConvOpCreate();
+    out[a].resize(data_batch * channel_out * size * size);
+    QuantizedConvOpSetupConvParameter(desc, layout, channel_out, channel_in, 1, 3, 3, 1, 1, 1, 1, 1, 1, 0, algos[a]);
+    QuantizedConvOpInitWeight(desc, weight.data());
+    QuantizedConvOpExecute(desc, out[a].data(), data.data(), bias.data(), data_batch, channel_in, size, size);
+    QuantizedConvOpFree(desc);
+  }
+  CheckRelative(out[0], out[1], tolerance);
+}
+
+TEST(CONVOLUTION, TEST_WINOGRAD_CONVOLUTION) {
+  LAYOUT layouts[] = {NCHW, NHWC};
+  for (size_t l = 0; l < 2; ++l) {
+    TestWinogradConvolution(1, 32, 14, 14, 64, 1, WINOGRAD_CONV, layouts[l]);
+    TestWinogradConvolution(2, 19, 11, 9, 21, 1, WINOGRAD_CONV, layouts[l]);
+    TestWinogradConvolution(1, 8, 10, 13, 16, 0, WINOGRAD_CONV, layouts[l]);
+    TestWinogradConvolution(3, 16, 7, 7, 8, 2, WINOGRAD_CONV, layouts[l]);
+    TestWinogradConvolutionAccuracy(2, 64, 14, 64, WINOGRAD_CONV, 0.1, layouts[l]);
+    TestWinogradConvolutionAccuracy(1, 35, 9, 19, WINOGRAD_CONV, 0.1, layouts[l]);
+  }
+}
+
+// IMPLICIT_GEMM_CONV quantizes the same pixels as SHUFFLE_CONV, only panel by panel. Both are about 1% of the largest
+// output off the float result, but not in the same places: SHUFFLE_CONV truncates padded taps instead of rounding
+// them. 48x48 inputs take several panels.
+void TestImplicitGemmConvolution(LAYOUT layout, size_t batch, size_t channel_in, size_t channel_out, size_t group,
+                                 size_t kernel, size_t stride, size_t pad, size_t dilation, size_t size,
+                                 size_t fusion_mask) {
+  size_t out_size = GetConvOutSize(size, kernel, stride, pad, dilation);
+  size_t out_count = batch * channel_out * out_size * out_size;
+  std::vector<float> weight(channel_out * channel_in / group * kernel * kernel);
+  std::vector<float> data(batch * channel_in * size * size);
+  std::vector<float> bias(channel_out), residual(out_count);
+  FillTestData(weight, data, bias);
+  for (size_t i = 0; i < out_count; ++i) {
+    residual[i] = static_cast<float>(i % 7) - 3.0f;
+  }
+  std::vector<float> out[2];
+  std::vector<uint8_t> quantized[2];
+  CONV_ALGORITHM algos[] = {SHUFFLE_CONV, IMPLICIT_GEMM_CONV};
+  for (size_t a = 0; a < 2; ++a) {
+    QuantizedConvOp* desc = QuantizedConvOpCreate();
+    out[a].resize(out_count);
+    quantized[a].resize(out_count);
+    QuantizedConvOpSetupConvParameter(desc, layout, channel_out, channel_in, group, kernel, kernel, stride, stride, pad,
+                                      pad, dilation, dilation, fusion_mask, algos[a]);
+    QuantizedConvOpInitWeight(desc, weight.data());
+    QuantizedConvOpExecuteWithResidual(desc, out[a].data(), data.data(), bias.data(), residual.data(), batch,
+                                       channel_in, size, size);
+    QuantizedConvOpExecuteRequantized(desc, quantized[a].data(), 0.25f, 128.0f, data.data(), bias.data(),
+                                      residual.data(), batch, channel_in, size, size);
+    QuantizedConvOpFree(desc);
+  }
+  double max_value = CheckRelative(out[0], out[1], 3e-2);
+  for (size_t i = 0; i < out_count; ++i) {
+    DOUBLES_EQUAL(quantized[0][i], quantized[1][i], 3e-2 * max_value / 0.25 + 1.0);
+  }
+}
+
+TEST(CONVOLUTION, TEST_IMPLICIT_GEMM_CONVOLUTION) {
+  LAYOUT layouts[] = {NCHW, NHWC};
+  for (size_t l = 0; l < 2; ++l) {
+    TestImplicitGemmConvolution(layouts[l], 2, 16, 24, 1, 3, 1, 1, 1, 48, FUSION_NONE);
+    TestImplicitGemmConvolution(layouts[l], 1, 19, 21, 1, 3, 2, 1, 1, 17, FUSION_RELU);
+    TestImplicitGemmConvolution(layouts[l], 3, 8, 12, 1, 5, 1, 2, 2, 11, FUSION_SUM | FUSION_RELU);
+    TestImplicitGemmConvolution(layouts[l], 2, 16, 32, 4, 3, 1, 1, 1, 9, FUSION_RELU);
+    TestImplicitGemmConvolution(layouts[l], 2, 32, 40, 1, 1, 1, 0, 1, 13, FUSION_NONE);
+  }
+}
+
+// Convolutions, grouped or not, against a float reference. The weights are
+// [channel_out][channel_in / group][kernel][kernel] for NCHW and [channel_out][kernel][kernel][channel_in / group] for
+// NHWC; tolerance is relative to the largest output.
+void TestGroupedConvolution(LAYOUT layout, size_t batch, size_t channel_in, size_t channel_out, size_t group,
+                            size_t kernel, size_t stride, size_t pad, size_t size) {
+  size_t out_size = GetConvOutSize(size, kernel, stride, pad, 1);
+  size_t in_per_group = channel_in / group, out_per_group = channel_out / group, taps = kernel * kernel;
+  std::vector<float> weight(channel_out * in_per_group * taps), data(batch * channel_in * size * size);
+  std::vector<float> bias(channel_out);
+  FillTestData(weight, data, bias);
+  auto index = [&](size_t n, size_t c, size_t y, size_t x, size_t channels, size_t height) {
+    return (layout == NCHW) ? ((n * channels + c) * height + y) * height + x
+                            : ((n * height + y) * height + x) * channels + c;
+  };
+  // data and weight are generated in NCHW order and handed over in the layout under test
+  std::vector<float> input(data.size()), kernel_weight(weight.size());
+  for (size_t n = 0; n < batch; ++n) {
+    for (size_t c = 0; c < channel_in; ++c) {
+      for (size_t s = 0; s < size * size; ++s) {
+        input[index(n, c, s / size, s % size, channel_in, size)] = data[(n * channel_in + c) * size * size + s];
+      }
+    }
+  }
+  for (size_t o = 0; o < channel_out; ++o) {
+    for (size_t i = 0; i < in_per_group; ++i) {
+      for (size_t t = 0; t < taps; ++t) {
+        size_t dst = (layout == NCHW) ? (o * in_per_group + i) * taps + t : (o * taps + t) * in_per_group + i;
+        kernel_weight[dst] = weight[(o * in_per_group + i) * taps + t];
+      }
+    }
+  }
+  std::vector<float> out(batch * channel_out * out_size * out_size);
+  QuantizedConvOp* desc = QuantizedConvOpCreate();
+  QuantizedConvOpSetupConvParameter(desc, layout, channel_out, channel_in, group, kernel, kernel, stride, stride, pad,
+                                    pad, 1, 1, FUSION_NONE, SHUFFLE_CONV);
+  QuantizedConvOpInitWeight(desc, kernel_weight.data());
+  QuantizedConvOpExecute(desc, out.data(), input.data(), bias.data(), batch, channel_in, size, size);
+  QuantizedConvOpFree(desc);
+  std::vector<double> expected(out.size());
+  double max_value = 0.0;
+  for (size_t n = 0; n < batch; ++n) {
+    for (size_t o = 0; o < channel_out; ++o) {
+      size_t g = o / out_per_group;
+      for (size_t y = 0; y < out_size; ++y) {
+        for (size_t x = 0; x < out_size; ++x) {
+          double acc = bias[o];
+          for (size_t i = 0; i < in_per_group; ++i) {
+            for (size_t t = 0; t < taps; ++t) {
+              long iy = static_cast<long>(y * stride + t / kernel) - static_cast<long>(pad);
+              long ix = static_cast<long>(x * stride + t % kernel) - static_cast<long>(pad);
+              if ((iy < 0) || (ix < 0) || (iy >= static_cast<long>(size)) || (ix >= static_cast<long>(size))) {
+                continue;
+              }
+              acc += weight[(o * in_per_group + i) * taps + t] *
+                     data[((n * channel_in + g * in_per_group + i) * size + iy) * size + ix];
+            }
+          }
+          expected[index(n, o, y, x, channel_out, out_size)] = acc;
+          max_value = std::max(max_value, std::fabs(acc));
+        }
+      }
+    }
+  }
+  for (size_t i = 0; i < out.size(); ++i) {
+    DOUBLES_EQUAL(expected[i], out[i], 3e-2 * max_value);
+  }
+}
+
+TEST(CONVOLUTION, TEST_GROUPED_CONVOLUTION) {
+  LAYOUT layouts[] = {NCHW, NHWC};
+  for (size_t l = 0; l < 2; ++l) {
+    TestGroupedConvolution(layouts[l], 2, 16, 24, 2, 3, 1, 1, 10);
+    TestGroupedConvolution(layouts[l], 1, 32, 32, 4, 3, 2, 1, 13);
+    TestGroupedConvolution(layouts[l], 2, 64, 64, 32, 3, 1, 1, 7);
+    TestGroupedConvolution(layouts[l], 1, 64, 128, 32, 3, 2, 1, 14);
+    TestGroupedConvolution(layouts[l], 3, 8, 16, 4, 1, 1, 0, 6);
+  }
+}
+
+// With BIGQUANT_NUMA=1 a single-group SHUFFLE_CONV runs on per-node copies of its packed weights, the original freed.
+// Run with BIGQUANT_NUMA=0 and 1 the outputs must both match the reference; TEST_CONVOLUTION_PACKED_FILE and the FC
+// tests cover the loaded and the FC replicas.
+TEST(CONVOLUTION, TEST_CONVOLUTION_NUMA_REPLICAS) {
+  LAYOUT layouts[] = {NCHW, NHWC};
+  for (size_t l = 0; l < 2; ++l) {
+    TestGroupedConvolution(layouts[l], 2, 64, 96, 1, 3, 1, 1, 14);
+    TestGroupedConvolution(layouts[l], 1, 32, 48, 1, 3, 2, 1, 17);
+    TestGroupedConvolution(layouts[l], 4, 128, 64, 1, 1, 1, 0, 7);
+  }
+}
+
+// A caller workspace runs the same algorithm as the op's own one, and one byte short of the queried size is refused.
+// The workspace run comes first, so AUTO_SELECT_CONV tunes inside it and the op's own workspace grows afterwards.
+void TestConvolutionCallerWorkspace(LAYOUT layout, CONV_ALGORITHM algo, size_t channel, size_t group, size_t kernel,
+                                    size_t stride, size_t size) {
+  size_t batch = 2;
+  size_t pad = kernel / 2;
+  size_t out_size = GetConvOutSize(size, kernel, stride, pad, 1);
+  size_t out_count = batch * channel * out_size * out_size;
+  std::vector<float> weight(channel * channel / group * kernel * kernel);
+  std::vector<float> data(batch * channel * size * size);
+  std::vector<float> bias(channel);
+  FillTestData(weight, data, bias);
+  QuantizedConvOp* desc = QuantizedConvOpCreate();
+  QuantizedConvOpSetupConvParameter(desc, layout, channel, channel, group, kernel, kernel, stride, stride, pad, pad, 1,
+                                    1, FUSION_RELU, algo);
+  QuantizedConvOpInitWeight(desc, weight.data());
+  size_t workspace_size = QuantizedConvOpGetWorkspaceSize(desc, batch, channel, size, size);
+  std::vector<char> workspace(workspace_size + 1);
+  std::vector<float> out(out_count), expected(out_count);
+  LONGS_EQUAL(-1, QuantizedConvOpExecuteWithWorkspace(desc, workspace.data(), workspace_size - 1, out.data(),
+                                                      data.data(), bias.data(), NULL, batch, channel, size, size));
+  // an odd address, the op aligns it
+  LONGS_EQUAL(0, QuantizedConvOpExecuteWithWorkspace(desc, workspace.data() + 1, workspace_size, out.data(),
+                                                     data.data(), bias.data(), NULL, batch, channel, size, size));
+  QuantizedConvOpExecute(desc, expected.data(), data.data(), bias.data(), batch, channel, size, size);
+  QuantizedConvOpFree(desc);
+  for (size_t i = 0; i < out_count; ++i) {
+    DOUBLES_EQUAL(expected[i], out[i], 1e-4 * (1.0 + std::fabs(expected[i])));
+  }
+}
+
+TEST(CONVOLUTION, TEST_CONVOLUTION_CALLER_WORKSPACE) {
+  LAYOUT layouts[] = {NCHW, NHWC};
+  for (size_t l = 0; l < 2; ++l) {
+    TestConvolutionCallerWorkspace(layouts[l], SHUFFLE_CONV, 24, 1, 3, 1, 15);
+    TestConvolutionCallerWorkspace(layouts[l], SHUFFLE_CONV, 24, 4, 3, 2, 15);
+    TestConvolutionCallerWorkspace(layouts[l], IMPLICIT_GEMM_CONV, 24, 1, 3, 1, 40);
+    TestConvolutionCallerWorkspace(layouts[l], DEPTHWISE_CONV, 32, 32, 3, 1, 12);
+    TestConvolutionCallerWorkspace(layouts[l], WINOGRAD_CONV, 16, 1, 3, 1, 10);
+    TestConvolutionCallerWorkspace(layouts[l], AUTO_SELECT_CONV, 16, 1, 3, 1, 10);
+    TestConvolutionCallerWorkspace(layouts[l], AUTO_SELECT_CONV, 32, 32, 3, 1, 12);
+  }
+}
+
+// Counters only move while enabled, and the op counter holds the convolution's multiply-adds
+TEST(CONVOLUTION, TEST_CONVOLUTION_PERF_COUNTERS) {
+  size_t batch = 2, channel_in = 16, channel_out = 24, kernel = 3, size = 14;
+  std::vector<float> weight(channel_out * channel_in * kernel * kernel, 0.5f);
+  std::vector<float> data(batch * channel_in * size * size, 1.0f);
+  std::vector<float> bias(channel_out, 0.0f), out(batch * channel_out * size * size);
+  QuantizedConvOp* desc = QuantizedConvOpCreate();
+  QuantizedConvOpSetupConvParameter(desc, NCHW, channel_out, channel_in, 1, kernel, kernel, 1, 1, 1, 1, 1, 1,
+                                    FUSION_NONE, SHUFFLE_CONV);
+  QuantizedConvOpInitWeight(desc, weight.data());
+  int enabled = BigQuantPerfCountersEnabled();
+  BigQuantEnablePerfCounters(1);
+  LONGS_EQUAL(1, BigQuantPerfCountersEnabled());
+  BigQuantResetPerfCounters();
+  QuantizedConvOpExecute(desc, out.data(), data.data(), bias.data(), batch, channel_in, size, size);
+  PerfCounterValue conv, gemm, im2col;
+  LONGS_EQUAL(0, BigQuantGetPerfCounter(PERF_CONV_OP, &conv));
+  LONGS_EQUAL(0, BigQuantGetPerfCounter(PERF_GEMM, &gemm));
+  LONGS_EQUAL(0, BigQuantGetPerfCounter(PERF_IM2COL, &im2col));
+  LONGS_EQUAL(1, conv.calls);
+  CHECK(conv.ops == 2 * batch * size * size * channel_out * channel_in * kernel * kernel);
+  CHECK(gemm.calls > 0);
+  CHECK(gemm.ops == conv.ops);
+  CHECK(im2col.calls > 0);
+  CHECK(im2col.bytes > 0);
+  CHECK(std::string("conv_op") == BigQuantGetPerfCounterName(PERF_CONV_OP));
+  CHECK(std::string("gemm") == BigQuantGetPerfCounterName(PERF_GEMM));
+
+  BigQuantEnablePerfCounters(0);
+  QuantizedConvOpExecute(desc, out.data(), data.data(), bias.data(), batch, channel_in, size, size);
+  LONGS_EQUAL(0, BigQuantGetPerfCounter(PERF_CONV_OP, &conv));
+  LONGS_EQUAL(1, conv.calls);
+  BigQuantResetPerfCounters();
+  LONGS_EQUAL(0, BigQuantGetPerfCounter(PERF_CONV_OP, &conv));
+  LONGS_EQUAL(0, conv.calls);
+  LONGS_EQUAL(0, conv.nanoseconds);
+  LONGS_EQUAL(-1, BigQuantGetPerfCounter(PERF_COUNTER_NUM, &conv));
+  CHECK(BigQuantGetPerfCounterName(PERF_COUNTER_NUM) == NULL);
+  BigQuantEnablePerfCounters(enabled);
+  QuantizedConvOpFree(desc);
+}
+
+// The timeline holds the op with its shape, its phases and the spans of the threads, and nothing once stopped
+TEST(CONVOLUTION, TEST_CONVOLUTION_TRACE) {
+  size_t batch = 2, channel = 16, kernel = 3, size = 14;
+  const char* path = "test_conv_trace.json";
+  std::vector<float> weight(channel * channel * kernel * kernel, 0.5f);
+  std::vector<float> data(batch * channel * size * size, 1.0f);
+  std::vector<float> bias(channel, 0.0f), out(batch * channel * size * size);
+  QuantizedConvOp* desc = QuantizedConvOpCreate();
+  QuantizedConvOpSetupConvParameter(desc, NHWC, channel, channel, 1, kernel, kernel, 1, 1, 1, 1, 1, 1, FUSION_NONE,
+                                    SHUFFLE_CONV);
+  QuantizedConvOpInitWeight(desc, weight.data());
+  BigQuantStartTrace();
+  QuantizedConvOpExecute(desc, out.data(), data.data(), bias.data(), batch, channel, size, size);
+  CHECK(BigQuantStopTrace(path) > 0);
+  std::vector<char> bytes(1 << 20);
+  FILE* in = fopen(path, "rb");
+  size_t count = fread(bytes.data(), 1, bytes.size(), in);
+  fclose(in);
+  remove(path);
+  std::string trace(bytes.data(), count);
+  CHECK(trace.find("{\"displayTimeUnit\":\"ns\",\"traceEvents\":[") == 0);
+  CHECK(trace.rfind("]}\n") == trace.size() - 3);
+  CHECK(trace.find("\"name\":\"conv_op\",\"cat\":\"op\"") != std::string::npos);
+  CHECK(trace.find("\"channel_out\":16") != std::string::npos);
+  CHECK(trace.find("\"name\":\"im2col\",\"cat\":\"phase\"") != std::string::npos);
+  CHECK(trace.find("\"name\":\"im2col_band\",\"cat\":\"thread\"") != std::string::npos);
+  CHECK(trace.find("\"name\":\"gemm\",\"cat\":\"phase\"") != std::string::npos);
+  CHECK((trace.find("\"name\":\"gemm_block\"") != std::string::npos) ||
+        (trace.find("\"name\":\"gemm_tiles\"") != std::string::npos));
+
+  QuantizedConvOpExecute(desc, out.data(), data.data(), bias.data(), batch, channel, size, size);
+  BigQuantStartTrace();
+  LONGS_EQUAL(0, BigQuantStopTrace(NULL));
+  LONGS_EQUAL(-1, BigQuantStopTrace("test_conv_missing_dir/trace.json"));
+  QuantizedConvOpFree(desc);
+}
+
+// The kernels run with the widest ISA the CPU has, or with the narrower one BIGQUANT_ISA names
+TEST(CONVOLUTION, TEST_DISPATCH_ISA) {
+  std::string isa = BigQuantGetISA();
+  CHECK(isa == "avx512" || isa == "avx2" || isa == "sse42");
+  // every CPU the library loads on has SSE4.2
+  const char* forced = getenv("BIGQUANT_ISA");
+  if (forced != NULL && strcmp(forced, "sse42") == 0) {
+    CHECK(isa == "sse42");
+  }
+}
+
+// Descriptors placed in one caller arena hold what the allocating ones do
+TEST(CONVOLUTION, TEST_CONV_TENSOR_DESC_WORKSPACE) {
+  size_t c_out = 21, c_in = 13, kernel = 3, batch = 2, size = 9;
+  std::vector<float> weight(c_out * c_in * kernel * kernel);
+  std::vector<float> data(batch * c_in * size * size);
+  FillTestData(weight, data);
+  LAYOUT layouts[] = {NCHW, NHWC};
+  for (size_t l = 0; l < 2; ++l) {
+    QuantizedTensorDesc own[2], placed[2];
+    FPTensorDesc own_sum, placed_sum;
+    QuantizedConvKernelDescInit(&own[0], c_out, c_in, kernel, kernel);
+    QuantizedConvDataDescInit(&own[1], c_in, kernel, kernel, 1, 1, 1, 1, 1, 1, batch, size, size);
+    QuantizedConvKernelSumDescInit(&own_sum, c_out);
+    // a NULL workspace only sets the shapes to size the arena by
+    QuantizedConvKernelDescInitWithWorkspace(&placed[0], NULL, c_out, c_in, kernel, kernel);
+    QuantizedConvDataDescInitWithWorkspace(&placed[1], NULL, c_in, kernel, kernel, 1, 1, 1, 1, 1, 1, batch, size, size);
+    QuantizedConvKernelSumDescInitWithWorkspace(&placed_sum, NULL, c_out);
+    CHECK(placed[0].data == NULL);
+    size_t sizes[] = {QuantizedTensorDescGetWorkspaceSize(&placed[0]), QuantizedTensorDescGetWorkspaceSize(&placed[1]),
+                      FPTensorDescGetWorkspaceSize(&placed_sum),
+                      QuantizedConvDataInitGetWorkspaceSize(c_in, kernel, kernel, 1, 1, 1, 1, 1, 1, batch, size, size,
+                                                            layouts[l])};
+    std::vector<char> arena(sizes[0] + sizes[1] + sizes[2] + sizes[3] + 1);
+    char* p = arena.data() + 1;
+    QuantizedConvKernelDescInitWithWorkspace(&placed[0], p, c_out, c_in, kernel, kernel);
+    QuantizedConvDataDescInitWithWorkspace(&placed[1], p + sizes[0], c_in, kernel, kernel, 1, 1, 1, 1, 1, 1, batch,
+                                           size, size);
+    QuantizedConvKernelSumDescInitWithWorkspace(&placed_sum, p + sizes[0] + sizes[1], c_out);
+    for (size_t t = 0; t < 2; ++t) {
+      LONGS_EQUAL(0, reinterpret_cast<size_t>(placed[t].data) % 64);
+      CHECK((static_cast<char*>(placed[t].data) >= p) && (static_cast<char*>(placed[t].data) < p + arena.size()));
+    }
+    QuantizedConvKernelInit(&own[0], weight.data(), c_out, c_in, kernel, kernel, 127.0f, layouts[l]);
+    QuantizedConvKernelInit(&placed[0], weight.data(), c_out, c_in, kernel, kernel, 127.0f, layouts[l]);
+    QuantizedConvDataInit(&own[1], data.data(), c_in, kernel, kernel, 1, 1, 1, 1, 1, 1, batch, size, size, 255.0f,
+                          layouts[l]);
+    QuantizedConvDataInitWithWorkspace(&placed[1], p + sizes[0] + sizes[1] + sizes[2], data.data(), c_in, kernel,
+                                       kernel, 1, 1, 1, 1, 1, 1, batch, size, size, 255.0f, layouts[l]);
+    QuantizedConvKernelSumInit(&own_sum, weight.data(), c_out, c_in, kernel, kernel);
+    QuantizedConvKernelSumInit(&placed_sum, weight.data(), c_out, c_in, kernel, kernel);
+    // the kernel has meta info for its padded rows too, which are left unset
+    for (size_t t = 0; t < 2; ++t) {
+      LONGS_EQUAL(own[t].workspace_size, placed[t].workspace_size);
+      LONGS_EQUAL(0, memcmp(own[t].data, placed[t].data, own[t].workspace_size));
+      LONGS_EQUAL(0, memcmp(own[t].min, placed[t].min, sizeof(float) * own[t].ori_shape[0]));
+      LONGS_EQUAL(0, memcmp(own[t].ratio, placed[t].ratio, sizeof(float) * own[t].ori_shape[0]));
+      FreeQuantizedTensor(&own[t]);
+    }
+    LONGS_EQUAL(0, memcmp(own_sum.data, placed_sum.data, own_sum.workspace_size));
+    FreeFPTensor(&own_sum);
+  }
+}
+
+// Repacking an int8 model has to match quantizing its dequantized weights, up to rounding, see
+// TEST_FC_KERNEL_LOAD_FROM_MODEL. Every output channel is one row in both layouts, so they share the dequantization.
+void TestConvKernelLoadFromModel(LAYOUT layout) {
+  size_t c_out = 37, c_in = 13, kernel = 3;
+  size_t row = c_in * kernel * kernel;
+  float threshold = 127.0f;
+  std::vector<int8_t> model(c_out * row);
+  std::vector<float> model_min(c_out), model_max(c_out);
+  std::vector<float> weight(c_out * row);
+  for (size_t i = 0; i < model.size(); ++i) {
+    model[i] = static_cast<int8_t>(static_cast<int>((i * 7919) % 201) - 100);
+  }
+  for (size_t o = 0; o < c_out; ++o) {
+    model_min[o] = -0.5f - 0.1f * o;
+    model_max[o] = 0.25f + 0.05f * o;
+    for (size_t i = 0; i < row; ++i) {
+      weight[o * row + i] = model[o * row + i] / 127.0f * std::max(std::fabs(model_min[o]), std::fabs(model_max[o]));
+    }
+  }
+  QuantizedTensorDesc expected, loaded;
+  QuantizedConvKernelDescInit(&expected, c_out, c_in, kernel, kernel);
+  QuantizedConvKernelDescInit(&loaded, c_out, c_in, kernel, kernel);
+  QuantizedConvKernelInit(&expected, weight.data(), c_out, c_in, kernel, kernel, threshold, layout);
+  QuantizedConvKernelLoadFromModel(&loaded, model.data(), model_min.data(), model_max.data(), c_out, c_in, kernel,
+                                   kernel, threshold, layout);
+  for (size_t i = 0; i < expected.workspace_size; ++i) {
+    CHECK(std::abs(static_cast<int8_t *>(expected.data)[i] - static_cast<int8_t *>(loaded.data)[i]) <= 1);
+  }
+  for (size_t o = 0; o < c_out; ++o) {
+    DOUBLES_EQUAL(static_cast<float *>(expected.min)[o], static_cast<float *>(loaded.min)[o], 1e-5);
+    DOUBLES_EQUAL(static_cast<float *>(expected.max)[o], static_cast<float *>(loaded.max)[o], 1e-5);
+    DOUBLES_EQUAL(static_cast<float *>(expected.ratio)[o], static_cast<float *>(loaded.ratio)[o], 1e-7);
+  }
+  FreeQuantizedTensor(&expected);
+  FreeQuantizedTensor(&loaded);
+}
+
+TEST(CONVOLUTION, TEST_CONV_KERNEL_LOAD_FROM_MODEL) {
+  TestConvKernelLoadFromModel(NCHW);
+  TestConvKernelLoadFromModel(NHWC);
+}
+
+// 1x1 stride-1 NHWC input skips im2col; it must agree with the same conv fed through the NCHW path
+void TestPointwiseConvolution(size_t data_batch, size_t channel_in, size_t height, size_t width, size_t group,
+                              size_t channel_out) {
+  size_t hxw = height * width;
+  std::vector<float> weight(channel_out * channel_in / group);
+  std::vector<float> nchw(data_batch * channel_in * hxw);
+  std::vector<float> nhwc(nchw.size());
+  std::vector<float> bias(channel_out);
+  FillTestData(weight, nchw, bias);
+  for (size_t n = 0; n < data_batch; ++n) {
+    for (size_t c = 0; c < channel_in; ++c) {
+      for (size_t s = 0; s < hxw; ++s) {
+        nhwc[(n * hxw + s) * channel_in + c] = nchw[(n * channel_in + c) * hxw + s];
+      }
+    }
+  }
+  std::vector<float> out[2];
+  LAYOUT layouts[] = {NCHW, NHWC};
+  float* inputs[] = {nchw.data(), nhwc.data()};
+  for (size_t l = 0; l < 2; ++l) {
+    QuantizedConvOp* desc = QuantizedConvOpCreate();
+    out[l].resize(data_batch * channel_out * hxw);
+    QuantizedConvOpSetupConvParameter(desc, layouts[l], channel_out, channel_in, group, 1, 1, 1, 1, 0, 0, 1, 1, 0,
+                                      SHUFFLE_CONV);
+    QuantizedConvOpInitWeight(desc, weight.data());
+    QuantizedConvOpExecute(desc, out[l].data(), inputs[l], bias.data(), data_batch, channel_in, height, width);
+    QuantizedConvOpFree(desc);
+  }
+  for (size_t n = 0; n < data_batch; ++n) {
+    for (size_t c = 0; c < channel_out; ++c) {
+      for (size_t s = 0; s < hxw; ++s) {
+        DOUBLES_EQUAL(out[0][(n * channel_out + c) * hxw + s], out[1][(n * hxw + s) * channel_out + c], 1e-3);
+      }
+    }
+  }
+}
+
+TEST(CONVOLUTION, TEST_POINTWISE_NHWC_CONVOLUTION) {
+  TestPointwiseConvolution(1, 64, 14, 14, 1, 128);
+  TestPointwiseConvolution(2, 35, 7, 9, 1, 19);
+  TestPointwiseConvolution(3, 8, 5, 5, 1, 16);
+  TestPointwiseConvolution(1, 64, 6, 6, 2, 32);
+}
+
+// AUTO_SELECT_CONV with an in-place residual: candidates are timed on a scratch output, so the residual must only be
+// added once. Winograd is a candidate for this layer, hence the tolerance of the Winograd accuracy test. The second
+// shape is tuned after the first released the candidates that lost, so it runs on the survivors.
+void TestConvolutionAutotune(LAYOUT layout) {
+  size_t batch = 2, channel = 32;
+  size_t sizes[] = {14, 9};
+  // the data of the smaller shape is a prefix of that of the larger one
+  std::vector<float> weight(channel * channel * 9), data(batch * channel * sizes[0] * sizes[0]);
+  FillTestData(weight, data);
+  CONV_ALGORITHM algos[] = {SHUFFLE_CONV, AUTO_SELECT_CONV};
+  QuantizedConvOp* descs[2];
+  for (size_t a = 0; a < 2; ++a) {
+    descs[a] = QuantizedConvOpCreate();
+    QuantizedConvOpSetupConvParameter(descs[a], layout, channel, channel, 1, 3, 3, 1, 1, 1, 1, 1, 1, FUSION_SUM,
+                                      algos[a]);
+    QuantizedConvOpInitWeight(descs[a], weight.data());
+  }
+  for (size_t s = 0; s < 2; ++s) {
+    size_t size = sizes[s];
+    size_t count = batch * channel * size * size;
+    std::vector<float> residual(count);
+    for (size_t i = 0; i < count; ++i) {
+      residual[i] = static_cast<float>(i % 13);
+    }
+    std::vector<float> out[2];
+    for (size_t a = 0; a < 2; ++a) {
+      // the first call tunes, the second reuses the cached result
+      for (size_t run = 0; run < 2; ++run) {
+        out[a] = residual;
+        QuantizedConvOpExecuteWithResidual(descs[a], out[a].data(), data.data(), NULL, out[a].data(), batch, channel,
+                                           size, size);
+      }
+    }
+    double max_value = 0.0;
+    for (size_t i = 0; i < count; ++i) {
+      max_value = std::max(max_value, static_cast<double>(std::fabs(out[0][i] - residual[i])));
+    }
+    for (size_t i = 0; i < count; ++i) {
+      DOUBLES_EQUAL(out[0][i], out[1][i], 0.1 * max_value);
+    }
+  }
+  QuantizedConvOpFree(descs[0]);
+  QuantizedConvOpFree(descs[1]);
+}
+
+TEST(CONVOLUTION, TEST_CONVOLUTION_AUTOTUNE) {
+  TestConvolutionAutotune(NCHW);
+  TestConvolutionAutotune(NHWC);
+  const char* path = "bigquant_tuning_test.txt";
+  int saved = BigQuantSaveTuningFile(path);
+  CHECK(saved >= 2);
+  LONGS_EQUAL(saved, BigQuantLoadTuningFile(path));
+  std::remove(path);
+  LONGS_EQUAL(-1, BigQuantLoadTuningFile(path));
+}
+
+// Only the last line is in range: loop order, block shifts, schedule and chunk are each broken once
+TEST(CONVOLUTION, TEST_CONVOLUTION_TUNING_FILE_INVALID) {
+  const char* path = "bigquant_tuning_invalid.txt";
+  FILE* out = fopen(path, "w");
+  fputs("conv:invalid:a 0 3 0 0 0 0 0\n"
+        "conv:invalid:b 0 0 2 0 0 0 0\n"
+        "conv:invalid:c 0 0 0 0 -2 0 0\n"
+        "conv:invalid:d 0 0 0 0 0 4 0\n"
+        "conv:invalid:e 0 0 0 0 0 2 -1\n"
+        "conv:invalid:f 0 2 -1 1 0 3 4\n",
+        out);
+  fclose(out);
+  LONGS_EQUAL(1, BigQuantLoadTuningFile(path));
+  std::remove(path);
+}
+
+// Runs a residual block (conv -> conv -> conv summing the first output in place) -> max pool -> 1x1 conv -> avg pool
+// -> sum -> FC as one graph and as separate ops; both go through the same ops, so they must agree
+void TestGraph(LAYOUT layout) {
+  size_t batch = 2, channel = 16, size = 12;
+  auto ramp = [](size_t count, size_t period) {
+    std::vector<float> v(count);
+    for (size_t i = 0; i < count; ++i) {
+      v[i] = static_cast<float>(i % period) / period - 0.4f;
+    }
+    return v;
+  };
+  auto index = [&](size_t n, size_t c, size_t y, size_t x, size_t channels, size_t height, size_t width) {
+    return (layout == NCHW) ? ((n * channels + c) * height + y) * width + x
+                            : ((n * height + y) * width + x) * channels + c;
+  };
+  auto pool = [&](std::vector<float>& src, size_t channels, size_t height, size_t kernel, size_t stride, size_t pad,
+                  bool max_pool) {
+    size_t out_size = (height + 2 * pad - kernel) / stride + 1;
+    std::vector<float> dst(batch * channels * out_size * out_size);
+    for (size_t n = 0; n < batch; ++n) {
+      for (size_t c = 0; c < channels; ++c) {
+        for (size_t y = 0; y < out_size; ++y) {
+          for (size_t x = 0; x < out_size; ++x) {
+            float acc = max_pool ? -1e30f : 0.0f;
+            float count = 0.0f;
+            for (size_t ky = 0; ky < kernel; ++ky) {
+              for (size_t kx = 0; kx < kernel; ++kx) {
+                size_t yy = y * stride + ky, xx = x * stride + kx;
+                if ((yy < pad) || (xx < pad) || (yy - pad >= height) || (xx - pad >= height)) {
+                  continue;
+                }
+                float v = src[index(n, c, yy - pad, xx - pad, channels, height, height)];
+                acc = max_pool ? std::max(acc, v) : acc + v;
+                count += 1.0f;
+              }
+            }
+            dst[index(n, c, y, x, channels, out_size, out_size)] = max_pool ? acc : acc / count;
+          }
+        }
+      }
+    }
+    return dst;
+  };
+  std::vector<float> data = ramp(batch * channel * size * size, 23);
+  std::vector<float> weight0 = ramp(channel * channel * 9, 7), weight1 = ramp(channel * channel * 9, 11);
+  std::vector<float> weight2 = ramp(32 * channel, 5), weight_fc = ramp(10 * 32 * 6 * 6, 13);
+  std::vector<float> bias = ramp(32, 3);
+
+  QuantizedGraph* graph = QuantizedGraphCreate(layout, channel, size, size);
+  size_t t1 = QuantizedGraphAddConv(graph, 0, -1, channel, 1, 3, 3, 1, 1, 1, 1, 1, 1, FUSION_RELU, weight0.data(),
+                                    bias.data(), SHUFFLE_CONV);
+  size_t branch = QuantizedGraphAddConv(graph, t1, -1, channel, 1, 3, 3, 1, 1, 1, 1, 1, 1, FUSION_RELU,
+                                        weight1.data(), NULL, SHUFFLE_CONV);
+  size_t t2 = QuantizedGraphAddConv(graph, branch, t1, channel, 1, 3, 3, 1, 1, 1, 1, 1, 1, FUSION_SUM | FUSION_RELU,
+                                    weight1.data(), NULL, SHUFFLE_CONV);
+  size_t t3 = QuantizedGraphAddPool(graph, t2, MAX_POOL, 2, 2, 2, 2, 0, 0);
+  size_t t4 = QuantizedGraphAddConv(graph, t3, -1, 32, 1, 1, 1, 1, 1, 0, 0, 1, 1, 0, weight2.data(), bias.data(),
+                                    SHUFFLE_CONV);
+  size_t t5 = QuantizedGraphAddPool(graph, t4, AVG_POOL, 3, 3, 1, 1, 1, 1);
+  size_t t6 = QuantizedGraphAddSum(graph, t5, t4, 1);
+  QuantizedGraphAddFC(graph, t6, 10, weight_fc.data(), bias.data(), SHUFFLE_FC);
+  LONGS_EQUAL(10, QuantizedGraphGetOutputSize(graph));
+  size_t intermediates = sizeof(float) * batch * (3 * channel * size * size + 3 * 32 * 6 * 6 + channel * 6 * 6);
+  CHECK(QuantizedGraphGetActivationBytes(graph, batch) < intermediates / 2);
+  std::vector<float> out(batch * 10);
+  QuantizedGraphExecute(graph, out.data(), data.data(), batch);
+  QuantizedGraphFree(graph);
+
+  QuantizedConvOp* conv0 = QuantizedConvOpCreate();
+  QuantizedConvOp* conv1 = QuantizedConvOpCreate();
+  QuantizedConvOp* branch_conv = QuantizedConvOpCreate();
+  QuantizedConvOp* conv2 = QuantizedConvOpCreate();
+  QuantizedFCOp* fc = QuantizedFCOpCreate();
+  QuantizedConvOpSetupConvParameter(conv0, layout, channel, channel, 1, 3, 3, 1, 1, 1, 1, 1, 1, FUSION_RELU,
+                                    SHUFFLE_CONV);
+  QuantizedConvOpSetupConvParameter(branch_conv, layout, channel, channel, 1, 3, 3, 1, 1, 1, 1, 1, 1, FUSION_RELU,
+                                    SHUFFLE_CONV);
+  QuantizedConvOpSetupConvParameter(conv1, layout, channel, channel, 1, 3, 3, 1, 1, 1, 1, 1, 1,
+                                    FUSION_SUM | FUSION_RELU, SHUFFLE_CONV);
+  QuantizedConvOpSetupConvParameter(conv2, layout, 32, channel, 1, 1, 1, 1, 1, 0, 0, 1, 1, 0, SHUFFLE_CONV);
+  QuantizedFCOpSetupFCParameter(fc, layout, 10, 32 * 6 * 6, SHUFFLE_FC);
+  QuantizedConvOpInitWeight(conv0, weight0.data());
+  QuantizedConvOpInitWeight(branch_conv, weight1.data());
+  QuantizedConvOpInitWeight(conv1, weight1.data());
+  QuantizedConvOpInitWeight(conv2, weight2.data());
+  QuantizedFCOpInitWeight(fc, weight_fc.data());
+  std::vector<float> a1(batch * channel * size * size), a_branch(a1.size()), a2(a1.size());
+  std::vector<float> a4(batch * 32 * 6 * 6), a6(a4.size());
+  std::vector<float> expected(batch * 10);
+  QuantizedConvOpExecute(conv0, a1.data(), data.data(), bias.data(), batch, channel, size, size);
+  QuantizedConvOpExecute(branch_conv, a_branch.data(), a1.data(), NULL, batch, channel, size, size);
+  QuantizedConvOpExecuteWithResidual(conv1, a2.data(), a_branch.data(), NULL, a1.data(), batch, channel, size, size);
+  std::vector<float> a3 = pool(a2, channel, size, 2, 2, 0, true);
+  QuantizedConvOpExecute(conv2, a4.data(), a3.data(), bias.data(), batch, channel, 6, 6);
+  std::vector<float> a5 = pool(a4, 32, 6, 3, 1, 1, false);
+  for (size_t i = 0; i < a6.size(); ++i) {
+    a6[i] = std::max(a5[i] + a4[i], 0.0f);
+  }
+  QuantizedFCOpExecute(fc, expected.data(), a6.data(), bias.data(), batch, 32 * 6 * 6);
+  QuantizedConvOpFree(conv0);
+  QuantizedConvOpFree(conv1);
+  QuantizedConvOpFree(branch_conv);
+  QuantizedConvOpFree(conv2);
+  QuantizedFCOpFree(fc);
+  for (size_t i = 0; i < out.size(); ++i) {
+    DOUBLES_EQUAL(expected[i], out[i], 1e-4 * std::max(1.0f, std::fabs(expected[i])));
+  }
+}
+
+TEST(CONVOLUTION, TEST_GRAPH) {
+  TestGraph(NCHW);
+  TestGraph(NHWC);
+}
+
+// After calibration the graph passes conv -> conv edges as uint8 requantized by the epilogue; the separate ops quantize
+// the same float values with the same static ranges, so they must agree
+void TestQuantizedGraph(LAYOUT layout) {
+  size_t batch = 2, channel = 16, size = 12;
+  auto ramp = [](size_t count, size_t period) {
+    std::vector<float> v(count);
+    for (size_t i = 0; i < count; ++i) {
+      v[i] = static_cast<float>(i % period) / period - 0.4f;
+    }
+    return v;
+  };
+  std::vector<float> data = ramp(batch * channel * size * size, 23);
+  std::vector<float> weight0 = ramp(channel * channel * 9, 7), weight1 = ramp(channel * channel * 9, 11);
+  std::vector<float> weight2 = ramp(32 * channel, 5), bias = ramp(32, 3);
+
+  QuantizedGraph* graph = QuantizedGraphCreate(layout, channel, size, size);
+  size_t t1 = QuantizedGraphAddConv(graph, 0, -1, channel, 1, 3, 3, 1, 1, 1, 1, 1, 1, FUSION_RELU, weight0.data(),
+                                    bias.data(), SHUFFLE_CONV);
+  size_t t2 = QuantizedGraphAddConv(graph, t1, -1, channel, 1, 3, 3, 2, 2, 1, 1, 1, 1, 0, weight1.data(), NULL,
+                                    SHUFFLE_CONV);
+  QuantizedGraphAddConv(graph, t2, -1, 32, 1, 1, 1, 1, 1, 0, 0, 1, 1, 0, weight2.data(), bias.data(), SHUFFLE_CONV);
+  std::vector<float> out(batch * 32 * 6 * 6);
+  size_t float_bytes = QuantizedGraphGetActivationBytes(graph, batch);
+  QuantizedGraphStartCalibration(graph, CALIBRATION_MINMAX, 100.0f);
+  QuantizedGraphExecute(graph, out.data(), data.data(), batch);
+  QuantizedGraphFinishCalibration(graph);
+  CHECK(QuantizedGraphGetActivationBytes(graph, batch) * 3 < float_bytes);
+  QuantizedGraphExecute(graph, out.data(), data.data(), batch);
+  QuantizedGraphFree(graph);
+
+  QuantizedConvOp* conv[3];
+  for (size_t i = 0; i < 3; ++i) {
+    conv[i] = QuantizedConvOpCreate();
+  }
+  QuantizedConvOpSetupConvParameter(conv[0], layout, channel, channel, 1, 3, 3, 1, 1, 1, 1, 1, 1, FUSION_RELU,
+                                    SHUFFLE_CONV);
+  QuantizedConvOpSetupConvParameter(conv[1], layout, channel, channel, 1, 3, 3, 2, 2, 1, 1, 1, 1, 0, SHUFFLE_CONV);
+  QuantizedConvOpSetupConvParameter(conv[2], layout, 32, channel, 1, 1, 1, 1, 1, 0, 0, 1, 1, 0, SHUFFLE_CONV);
+  QuantizedConvOpInitWeight(conv[0], weight0.data());
+  QuantizedConvOpInitWeight(conv[1], weight1.data());
+  QuantizedConvOpInitWeight(conv[2], weight2.data());
+  std::vector<float> a1(batch * channel * size * size), a2(batch * channel * 6 * 6), expected(out.size());
+  for (size_t pass = 0; pass < 2; ++pass) {
+    for (size_t i = 0; (pass == 0) && (i < 3); ++i) {
+      QuantizedConvOpStartCalibration(conv[i], CALIBRATION_MINMAX, 100.0f);
+    }
+    QuantizedConvOpExecute(conv[0], a1.data(), data.data(), bias.data(), batch, channel, size, size);
+    QuantizedConvOpExecute(conv[1], a2.data(), a1.data(), NULL, batch, channel, size, size);
+    QuantizedConvOpExecute(conv[2], expected.data(), a2.data(), bias.data(), batch, channel, 6, 6);
+    for (size_t i = 0; (pass == 0) && (i < 3); ++i) {
+      QuantizedConvOpFinishCalibration(conv[i]);
+    }
+  }
+  for (size_t i = 0; i < 3; ++i) {
+    QuantizedConvOpFree(conv[i]);
+  }
+  for (size_t i = 0; i < out.size(); ++i) {
+    DOUBLES_EQUAL(expected[i], out[i], 1e-4 * std::max(1.0f, std::fabs(expected[i])));
+  }
+}
+
+TEST(CONVOLUTION, TEST_GRAPH_QUANTIZED_EDGES) {
+  TestQuantizedGraph(NCHW);
+  TestQuantizedGraph(NHWC);
+}
+
 int main(int argc, char** argv) {
   return RUN_ALL_TESTS(argc, argv);
 }
@@ -2,10 +2,24 @@
 #include <array>
 #include <vector>
 #include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <thread>
 #include "bigquant.h"
 #include "CppUTest/TestHarness.h"
 #include "CppUTest/CommandLineTestRunner.h"
 
+// Non-constant weight and data in [-1, 1), so a wrong row or column shows up
+static void FillTestData(std::vector<float> &weight, std::vector<float> &data) {
+  for (size_t i = 0; i < weight.size(); ++i) {
+    weight[i] = static_cast<float>((i * 7919) % 61) / 30.0f - 1.0f;
+  }
+  for (size_t i = 0; i < data.size(); ++i) {
+    data[i] = static_cast<float>((i * 104729) % 97) / 48.0f - 1.0f;
+  }
+}
+
 void TestFC(size_t data_batch, size_t data_channel, size_t filter_num) {
   QuantizedFCOp *desc = QuantizedFCOpCreate();
   // init weight
@@ -60,6 +74,355 @@ TEST(FC, TEST_FC) {
   TestFC(128, 200, 10001);
 }
 
+TEST(FC, TEST_FC_WORKSPACE_REUSE) {
+  size_t data_channel = 1023;
+  size_t filter_num = 255;
+  QuantizedFCOp *desc = QuantizedFCOpCreate();
+  std::vector<float> weight(filter_num * data_channel, 1.0f);
+  std::vector<float> data(64 * data_channel, 1.0f);
+  std::vector<float> out(64 * filter_num);
+  QuantizedFCOpSetupFCParameter(desc, NCHW, filter_num, data_channel, SHUFFLE_FC);
+  QuantizedFCOpInitWeight(desc, weight.data());
+  // the first call sizes the workspace, smaller batches reuse it
+  size_t batches[] = {64, 1, 32, 64};
+  for (size_t i = 0; i < 4; ++i) {
+    std::fill(out.begin(), out.end(), 0.0f);
+    QuantizedFCOpExecute(desc, out.data(), data.data(), NULL, batches[i], data_channel);
+    for (size_t j = 0; j < batches[i] * filter_num; ++j) {
+      DOUBLES_EQUAL(out[j], data_channel, 1e-6);
+    }
+  }
+  CHECK(QuantizedFCOpGetWorkspaceSavedBytes(desc) > 0);
+  QuantizedFCOpShrinkWorkspace(desc);
+  QuantizedFCOpExecute(desc, out.data(), data.data(), NULL, 8, data_channel);
+  for (size_t j = 0; j < 8 * filter_num; ++j) {
+    DOUBLES_EQUAL(out[j], data_channel, 1e-6);
+  }
+  QuantizedFCOpFree(desc);
+}
+
+TEST(FC, TEST_FC_WARMUP) {
+  size_t data_channel = 515;
+  size_t filter_num = 129;
+  QuantizedFCOp *desc = QuantizedFCOpCreate();
+  std::vector<float> weight(filter_num * data_channel, 1.0f);
+  std::vector<float> data(33 * data_channel, 1.0f);
+  std::vector<float> out(33 * filter_num);
+  QuantizedFCOpSetupFCParameter(desc, NHWC, filter_num, data_channel, SHUFFLE_FC);
+  QuantizedFCOpInitWeight(desc, weight.data());
+  QuantizedFCOpWarmUp(desc, 33, data_channel);
+  QuantizedFCOpExecute(desc, out.data(), data.data(), NULL, 33, data_channel);
+  for (size_t j = 0; j < 33 * filter_num; ++j) {
+    DOUBLES_EQUAL(out[j], data_channel, 1e-6);
+  }
+  QuantizedFCOpFree(desc);
+}
+
+// The first thread runs the GEMV path, the others GEMMs of different batch sizes, all on one op
+TEST(FC, TEST_FC_SHARED_OP) {
+  size_t data_channel = 515;
+  size_t filter_num = 129;
+  const size_t threads = 4, repeat = 8;
+  QuantizedFCOp *desc = QuantizedFCOpCreate();
+  std::vector<float> weight(filter_num * data_channel, 1.0f);
+  QuantizedFCOpSetupFCParameter(desc, NHWC, filter_num, data_channel, SHUFFLE_FC);
+  QuantizedFCOpInitWeight(desc, weight.data());
+  std::vector<std::vector<float>> outs(threads);
+  std::vector<std::thread> workers;
+  for (size_t t = 0; t < threads; ++t) {
+    workers.push_back(std::thread([&, t] {
+      size_t batch = 2 + 11 * t;
+      std::vector<float> data(batch * data_channel, static_cast<float>(t + 1));
+      outs[t].resize(batch * filter_num);
+      for (size_t r = 0; r < repeat; ++r) {
+        QuantizedFCOpExecute(desc, outs[t].data(), data.data(), NULL, batch, data_channel);
+      }
+    }));
+  }
+  for (size_t t = 0; t < threads; ++t) {
+    workers[t].join();
+  }
+  QuantizedFCOpFree(desc);
+  for (size_t t = 0; t < threads; ++t) {
+    for (size_t j = 0; j < outs[t].size(); ++j) {
+      DOUBLES_EQUAL(outs[t][j], (t + 1) * data_channel, 1e-3);
+    }
+  }
+}
+
+TEST(FC, TEST_FC_SMALL_BATCH) {
+  size_t data_channel = 1001;
+  size_t filter_num = 37;
+  LAYOUT layouts[] = {NCHW, NHWC};
+  for (size_t l = 0; l < 2; ++l) {
+    QuantizedFCOp *desc = QuantizedFCOpCreate();
+    std::vector<float> weight(filter_num * data_channel, 1.0f);
+    std::vector<float> data(4 * data_channel, 1.0f);
+    std::vector<float> bias(filter_num, 2.0f);
+    std::vector<float> out(4 * filter_num);
+    QuantizedFCOpSetupFCParameter(desc, layouts[l], filter_num, data_channel, SHUFFLE_FC);
+    QuantizedFCOpInitWeight(desc, weight.data());
+    for (size_t batch = 1; batch <= 4; ++batch) {
+      std::fill(out.begin(), out.end(), 0.0f);
+      QuantizedFCOpExecute(desc, out.data(), data.data(), bias.data(), batch, data_channel);
+      for (size_t j = 0; j < batch * filter_num; ++j) {
+        DOUBLES_EQUAL(out[j], data_channel + 2.0f, 1e-6);
+      }
+    }
+    QuantizedFCOpFree(desc);
+  }
+}
+
+// The GEMV batches on non-constant data against a float reference; tolerance is relative to the largest output
+TEST(FC, TEST_FC_SMALL_BATCH_ACCURACY) {
+  size_t data_channel = 1001;
+  size_t filter_num = 37;
+  std::vector<float> weight(filter_num * data_channel);
+  std::vector<float> data(4 * data_channel);
+  std::vector<float> bias(filter_num);
+  FillTestData(weight, data);
+  for (size_t i = 0; i < bias.size(); ++i) {
+    bias[i] = static_cast<float>(i % 7) - 3.0f;
+  }
+  std::vector<double> expected(4 * filter_num);
+  double max_value = 0.0;
+  for (size_t b = 0; b < 4; ++b) {
+    for (size_t o = 0; o < filter_num; ++o) {
+      double acc = bias[o];
+      for (size_t i = 0; i < data_channel; ++i) {
+        acc += weight[o * data_channel + i] * data[b * data_channel + i];
+      }
+      expected[b * filter_num + o] = acc;
+      max_value = std::max(max_value, std::fabs(acc));
+    }
+  }
+  LAYOUT layouts[] = {NCHW, NHWC};
+  for (size_t l = 0; l < 2; ++l) {
+    QuantizedFCOp *desc = QuantizedFCOpCreate();
+    std::vector<float> out(4 * filter_num);
+    QuantizedFCOpSetupFCParameter(desc, layouts[l], filter_num, data_channel, SHUFFLE_FC);
+    QuantizedFCOpInitWeight(desc, weight.data());
+    for (size_t batch = 1; batch <= 4; ++batch) {
+      std::fill(out.begin(), out.end(), 0.0f);
+      QuantizedFCOpExecute(desc, out.data(), data.data(), bias.data(), batch, data_channel);
+      for (size_t j = 0; j < batch * filter_num; ++j) {
+        DOUBLES_EQUAL(expected[j], out[j], 3e-2 * max_value);
+      }
+    }
+    QuantizedFCOpFree(desc);
+  }
+}
+
+// AUTO_SELECT_FC only reorders the GEMM loop nest, so it must match SHUFFLE_FC exactly
+TEST(FC, TEST_FC_AUTOTUNE) {
+  size_t data_channel = 777;
+  size_t filter_num = 300;
+  size_t batch = 64;
+  std::vector<float> weight(filter_num * data_channel);
+  std::vector<float> data(batch * data_channel);
+  FillTestData(weight, data);
+  std::vector<float> out[2];
+  FC_ALGORITHM algos[] = {SHUFFLE_FC, AUTO_SELECT_FC};
+  for (size_t a = 0; a < 2; ++a) {
+    QuantizedFCOp *desc = QuantizedFCOpCreate();
+    out[a].resize(batch * filter_num);
+    QuantizedFCOpSetupFCParameter(desc, NCHW, filter_num, data_channel, algos[a]);
+    QuantizedFCOpInitWeight(desc, weight.data());
+    // the first call tunes, the second reuses the cached result
+    QuantizedFCOpExecute(desc, out[a].data(), data.data(), NULL, batch, data_channel);
+    QuantizedFCOpExecute(desc, out[a].data(), data.data(), NULL, batch, data_channel);
+    QuantizedFCOpFree(desc);
+  }
+  for (size_t i = 0; i < out[0].size(); ++i) {
+    DOUBLES_EQUAL(out[0][i], out[1][i], 1e-4);
+  }
+}
+
+// Static input quantization has to stay close to the per-row ranges, for the GEMV batches and the GEMM ones
+TEST(FC, TEST_FC_STATIC_RANGE) {
+  size_t data_channel = 300;
+  size_t filter_num = 40;
+  size_t batches[] = {2, 32};
+  std::vector<float> weight(filter_num * data_channel);
+  std::vector<float> data(32 * data_channel);
+  FillTestData(weight, data);
+  QuantizedFCOp *desc = QuantizedFCOpCreate();
+  QuantizedFCOpSetupFCParameter(desc, NCHW, filter_num, data_channel, SHUFFLE_FC);
+  QuantizedFCOpInitWeight(desc, weight.data());
+  QuantizedFCOpStartCalibration(desc, CALIBRATION_MINMAX, 100.0f);
+  std::vector<float> dynamic(32 * filter_num), out(32 * filter_num);
+  QuantizedFCOpExecute(desc, dynamic.data(), data.data(), NULL, 32, data_channel);
+  QuantizedFCOpFinishCalibration(desc);
+  float min, max;
+  CHECK(QuantizedFCOpGetInputRange(desc, &min, &max));
+  DOUBLES_EQUAL(-1.0f, min, 1e-6);
+  DOUBLES_EQUAL(1.0f, max, 1e-6);
+  for (size_t b = 0; b < 2; ++b) {
+    QuantizedFCOpExecute(desc, out.data(), data.data(), NULL, batches[b], data_channel);
+    for (size_t i = 0; i < batches[b] * filter_num; ++i) {
+      DOUBLES_EQUAL(dynamic[i], out[i], 0.5);
+    }
+  }
+  QuantizedFCOpFree(desc);
+}
+
+// A loaded op has to execute like the one that saved it, see TestConvolutionPacked
+TEST(FC, TEST_FC_PACKED_FILE) {
+  size_t data_channel = 300;
+  size_t filter_num = 40;
+  size_t batches[] = {2, 32};
+  std::vector<float> weight(filter_num * data_channel);
+  std::vector<float> data(32 * data_channel);
+  std::vector<float> bias(filter_num);
+  FillTestData(weight, data);
+  for (size_t i = 0; i < bias.size(); ++i) {
+    bias[i] = static_cast<float>(i % 7) - 3.0f;
+  }
+  const char *path = "test_fc_packed.bin";
+  for (size_t ranged = 0; ranged < 2; ++ranged) {
+    QuantizedFCOp *desc = QuantizedFCOpCreate();
+    QuantizedFCOpSetupFCParameter(desc, NHWC, filter_num, data_channel, AUTO_SELECT_FC);
+    QuantizedFCOpInitWeight(desc, weight.data());
+    if (ranged) {
+      QuantizedFCOpSetInputRange(desc, -1.0f, 1.0f);
+    }
+    std::vector<float> expected[2];
+    for (size_t b = 0; b < 2; ++b) {
+      expected[b].resize(batches[b] * filter_num);
+      QuantizedFCOpExecute(desc, expected[b].data(), data.data(), bias.data(), batches[b], data_channel);
+    }
+    LONGS_EQUAL(0, QuantizedFCOpSavePacked(desc, path));
+    QuantizedFCOpFree(desc);
+
+    desc = QuantizedFCOpLoadPacked(path);
+    CHECK(desc != NULL);
+    float min, max;
+    LONGS_EQUAL(ranged, QuantizedFCOpGetInputRange(desc, &min, &max));
+    for (size_t b = 0; b < 2; ++b) {
+      std::vector<float> out(batches[b] * filter_num);
+      QuantizedFCOpExecute(desc, out.data(), data.data(), bias.data(), batches[b], data_channel);
+      for (size_t i = 0; i < out.size(); ++i) {
+        DOUBLES_EQUAL(expected[b][i], out[i], 1e-5 * std::max(1.0f, std::fabs(expected[b][i])));
+      }
+    }
+    QuantizedFCOpFree(desc);
+    remove(path);
+  }
+}
+
+// Repacking an int8 model has to match quantizing its dequantized weights, up to rounding
+TEST(FC, TEST_FC_KERNEL_LOAD_FROM_MODEL) {
+  size_t c_out = 37;
+  size_t c_in = 70;
+  float threshold = 127.0f;
+  std::vector<int8_t> model(c_out * c_in);
+  std::vector<float> model_min(c_out), model_max(c_out);
+  std::vector<float> weight(c_out * c_in);
+  for (size_t i = 0; i < model.size(); ++i) {
+    model[i] = static_cast<int8_t>(static_cast<int>((i * 7919) % 201) - 100);
+  }
+  for (size_t o = 0; o < c_out; ++o) {
+    model_min[o] = -0.5f - 0.1f * o;
+    model_max[o] = 0.25f + 0.05f * o;
+    for (size_t i = 0; i < c_in; ++i) {
+      weight[o * c_in + i] = model[o * c_in + i] / 127.0f * std::max(std::fabs(model_min[o]), std::fabs(model_max[o]));
+    }
+  }
+  QuantizedTensorDesc expected, loaded;
+  QuantizedFCKernelDescInit(&expected, c_out, c_in);
+  QuantizedFCKernelDescInit(&loaded, c_out, c_in);
+  QuantizedFCKernelInit(&expected, weight.data(), c_out, c_in, threshold, NCHW);
+  QuantizedFCKernelLoadFromModel(&loaded, model.data(), model_min.data(), model_max.data(), c_out, c_in, threshold,
+                                 NCHW);
+  for (size_t i = 0; i < expected.workspace_size; ++i) {
+    CHECK(std::abs(static_cast<int8_t *>(expected.data)[i] - static_cast<int8_t *>(loaded.data)[i]) <= 1);
+  }
+  for (size_t o = 0; o < c_out; ++o) {
+    DOUBLES_EQUAL(static_cast<float *>(expected.min)[o], static_cast<float *>(loaded.min)[o], 1e-5);
+    DOUBLES_EQUAL(static_cast<float *>(expected.max)[o], static_cast<float *>(loaded.max)[o], 1e-5);
+    DOUBLES_EQUAL(static_cast<float *>(expected.ratio)[o], static_cast<float *>(loaded.ratio)[o], 1e-7);
+  }
+  FreeQuantizedTensor(&expected);
+  FreeQuantizedTensor(&loaded);
+
+  FPTensorDesc expected_sum, loaded_sum;
+  QuantizedFCKernelSumDescInit(&expected_sum, c_out);
+  QuantizedFCKernelSumDescInit(&loaded_sum, c_out);
+  QuantizedFCKernelSumInit(&expected_sum, weight.data(), c_out, c_in);
+  QuantizedFCKernelSumLoadFromModel(&loaded_sum, model.data(), model_min.data(), model_max.data(), c_out, c_in);
+  for (size_t o = 0; o < c_out; ++o) {
+    DOUBLES_EQUAL(static_cast<float *>(expected_sum.data)[o], static_cast<float *>(loaded_sum.data)[o], 1e-4);
+  }
+  FreeFPTensor(&expected_sum);
+  FreeFPTensor(&loaded_sum);
+}
+
+// See TEST_CONVOLUTION_CALLER_WORKSPACE, for the GEMV and the GEMM path
+TEST(FC, TEST_FC_CALLER_WORKSPACE) {
+  size_t data_channel = 515;
+  size_t filter_num = 129;
+  std::vector<float> weight(filter_num * data_channel);
+  std::vector<float> data(64 * data_channel);
+  FillTestData(weight, data);
+  QuantizedFCOp *desc = QuantizedFCOpCreate();
+  QuantizedFCOpSetupFCParameter(desc, NCHW, filter_num, data_channel, SHUFFLE_FC);
+  QuantizedFCOpInitWeight(desc, weight.data());
+  size_t batches[] = {3, 64};
+  for (size_t b = 0; b < 2; ++b) {
+    size_t workspace_size = QuantizedFCOpGetWorkspaceSize(desc, batches[b], data_channel);
+    std::vector<char> workspace(workspace_size + 1);
+    std::vector<float> out(batches[b] * filter_num), expected(batches[b] * filter_num);
+    LONGS_EQUAL(-1, QuantizedFCOpExecuteWithWorkspace(desc, workspace.data(), workspace_size - 1, out.data(),
+                                                      data.data(), NULL, batches[b], data_channel));
+    LONGS_EQUAL(0, QuantizedFCOpExecuteWithWorkspace(desc, workspace.data() + 1, workspace_size, out.data(),
+                                                     data.data(), NULL, batches[b], data_channel));
+    QuantizedFCOpExecute(desc, expected.data(), data.data(), NULL, batches[b], data_channel);
+    for (size_t i = 0; i < out.size(); ++i) {
+      DOUBLES_EQUAL(expected[i], out[i], 1e-4 * (1.0 + std::fabs(expected[i])));
+    }
+  }
+  QuantizedFCOpFree(desc);
+}
+
+// See TEST_CONV_TENSOR_DESC_WORKSPACE
+TEST(FC, TEST_FC_TENSOR_DESC_WORKSPACE) {
+  size_t c_out = 37, c_in = 70, batch = 5;
+  std::vector<float> weight(c_out * c_in);
+  std::vector<float> data(batch * c_in);
+  FillTestData(weight, data);
+  QuantizedTensorDesc own[2], placed[2];
+  FPTensorDesc own_sum, placed_sum;
+  QuantizedFCKernelDescInit(&own[0], c_out, c_in);
+  QuantizedFCDataDescInit(&own[1], batch, c_in);
+  QuantizedFCKernelSumDescInit(&own_sum, c_out);
+  QuantizedFCKernelDescInitWithWorkspace(&placed[0], NULL, c_out, c_in);
+  QuantizedFCDataDescInitWithWorkspace(&placed[1], NULL, batch, c_in);
+  QuantizedFCKernelSumDescInitWithWorkspace(&placed_sum, NULL, c_out);
+  size_t sizes[] = {QuantizedTensorDescGetWorkspaceSize(&placed[0]), QuantizedTensorDescGetWorkspaceSize(&placed[1]),
+                    FPTensorDescGetWorkspaceSize(&placed_sum)};
+  std::vector<char> arena(sizes[0] + sizes[1] + sizes[2] + 1);
+  char *p = arena.data() + 1;
+  QuantizedFCKernelDescInitWithWorkspace(&placed[0], p, c_out, c_in);
+  QuantizedFCDataDescInitWithWorkspace(&placed[1], p + sizes[0], batch, c_in);
+  QuantizedFCKernelSumDescInitWithWorkspace(&placed_sum, p + sizes[0] + sizes[1], c_out);
+  QuantizedFCKernelInit(&own[0], weight.data(), c_out, c_in, 127.0f, NCHW);
+  QuantizedFCKernelInit(&placed[0], weight.data(), c_out, c_in, 127.0f, NCHW);
+  QuantizedFCDataInit(&own[1], data.data(), batch, c_in, 255.0f, NCHW);
+  QuantizedFCDataInit(&placed[1], data.data(), batch, c_in, 255.0f, NCHW);
+  QuantizedFCKernelSumInit(&own_sum, weight.data(), c_out, c_in);
+  QuantizedFCKernelSumInit(&placed_sum, weight.data(), c_out, c_in);
+  for (size_t t = 0; t < 2; ++t) {
+    LONGS_EQUAL(0, reinterpret_cast<size_t>(placed[t].data) % 64);
+    LONGS_EQUAL(0, memcmp(own[t].data, placed[t].data, own[t].workspace_size));
+    LONGS_EQUAL(0, memcmp(own[t].min, placed[t].min, sizeof(float) * own[t].ori_shape[0]));
+    LONGS_EQUAL(0, memcmp(own[t].max, placed[t].max, sizeof(float) * own[t].ori_shape[0]));
+    LONGS_EQUAL(0, memcmp(own[t].ratio, placed[t].ratio, sizeof(float) * own[t].ori_shape[0]));
+    FreeQuantizedTensor(&own[t]);
+  }
+  LONGS_EQUAL(0, memcmp(own_sum.data, placed_sum.data, own_sum.workspace_size));
+  FreeFPTensor(&own_sum);
+}
+
 int main(int argc, char **argv) {
   return RUN_ALL_TESTS(argc, argv);
 }
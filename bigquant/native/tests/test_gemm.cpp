@@ -7,6 +7,7 @@
 #include "../base.h"
 #include "../common.h"
 #include "../ops/ops.h"
+#include "../tensor.h"
 #include "CppUTest/TestHarness.h"
 #include "CppUTest/CommandLineTestRunner.h"
 
@@ -248,6 +249,27 @@ TEST(GEMM, RandMixPrecisionGEMM) {
   }
 }
 
+// Replicating a tensor again copies from its current data, which is the first replica of the previous call
+TEST(GEMM, NumaReplicasReplicateAgain) {
+  const size_t count = 4096;
+  Tensor<int8_t> tensor(make_shape(count), 64);
+  for (size_t i = 0; i < count; ++i) {
+    tensor.data_[i] = static_cast<int8_t>(i % 127);
+  }
+  NumaReplicas<int8_t> replicas;
+  for (size_t r = 0; r < 2; ++r) {
+    replicas.ReplicateTensor(&tensor, count);
+    LONGS_EQUAL(GetSocketNum(), replicas.replicas_.size());
+    CHECK(tensor.data_ == replicas.replicas_[0]);
+    CHECK(replicas.Local(NULL) != NULL);
+    for (size_t socket = 0; socket < replicas.replicas_.size(); ++socket) {
+      for (size_t i = 0; i < count; ++i) {
+        LONGS_EQUAL(i % 127, replicas.replicas_[socket][i]);
+      }
+    }
+  }
+}
+
 int main(int argc, char** argv) {
   return RUN_ALL_TESTS(argc, argv);
 }
@@ -69,6 +69,42 @@ TEST(LAYOUT, NHWC2NCHW) {
   }
 }
 
+TEST(LAYOUT, TRANSFORM_LAYOUT_RAGGED) {
+  // shapes off the SIMD tile and block sizes
+  size_t shapes[][3] = {{2, 3, 224 * 13}, {3, 17, 7 * 7}, {1, 64, 56 * 56}, {2, 33, 65}, {1, 1, 10}, {4, 130, 1}};
+  for (size_t i = 0; i < sizeof(shapes) / sizeof(shapes[0]); ++i) {
+    size_t batch_size = shapes[i][0];
+    size_t channels = shapes[i][1];
+    size_t spatial_size = shapes[i][2];
+    std::vector<float> src(batch_size * spatial_size * channels);
+    std::vector<float> nhwc(src.size());
+    std::vector<float> nchw(src.size());
+    std::generate(src.begin(), src.end(), [] { return static_cast<float>(std::rand()) / RAND_MAX; });
+    TransformLayout<float>(NHWC, NCHW, nhwc.data(), src.data(), batch_size, channels, spatial_size);
+    TransformLayout<float>(NCHW, NHWC, nchw.data(), nhwc.data(), batch_size, channels, spatial_size);
+    for (size_t b = 0; b < batch_size; ++b) {
+      size_t offset = b * channels * spatial_size;
+      for (size_t c = 0; c < channels; ++c) {
+        for (size_t s = 0; s < spatial_size; ++s) {
+          DOUBLES_EQUAL(src[offset + c * spatial_size + s], nhwc[offset + s * channels + c], 0);
+        }
+      }
+    }
+    for (size_t j = 0; j < src.size(); ++j) {
+      DOUBLES_EQUAL(src[j], nchw[j], 0);
+    }
+  }
+  std::vector<float> src(37 * 53);
+  std::vector<float> dst(src.size());
+  std::generate(src.begin(), src.end(), [] { return static_cast<float>(std::rand()) / RAND_MAX; });
+  Transpose<float>(dst.data(), src.data(), 37, 53);
+  for (size_t x = 0; x < 37; ++x) {
+    for (size_t y = 0; y < 53; ++y) {
+      DOUBLES_EQUAL(src[x * 53 + y], dst[y * 37 + x], 0);
+    }
+  }
+}
+
 int main(int argc, char** argv) {
   return RUN_ALL_TESTS(argc, argv);
 }
@@ -0,0 +1,140 @@
+/*
+ * Copyright 2016 The BigDL Authors.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef THREAD_CONTEXTS_H
+#define THREAD_CONTEXTS_H
+
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// The contexts of one op, released per thread by ThreadExitHook
+struct ThreadContextSet {
+  virtual ~ThreadContextSet() {
+  }
+
+  virtual void ReleaseThread(std::thread::id id) = 0;
+};
+
+// Destroyed when its thread exits, it frees the contexts the thread has in the ops still alive, so neither do contexts
+// pile up with short-lived threads nor does a new thread inherit the state of an exited one with the same id
+struct ThreadExitHook {
+  static ThreadExitHook &Local() {
+    static thread_local ThreadExitHook hook;
+    return hook;
+  }
+
+  ThreadExitHook(const ThreadExitHook&) = delete;
+
+  ThreadExitHook& operator=(const ThreadExitHook&) = delete;
+
+  ~ThreadExitHook() {
+    std::thread::id id = std::this_thread::get_id();
+    for (size_t i = 0; i < sets_.size(); ++i) {
+      std::shared_ptr<ThreadContextSet> set = sets_[i].lock();
+      if (set) {
+        set->ReleaseThread(id);
+      }
+    }
+  }
+
+  // The sets of ops destroyed meanwhile are dropped, as is set itself if already there
+  void Add(const std::shared_ptr<ThreadContextSet> &set) {
+    size_t kept = 0;
+    for (size_t i = 0; i < sets_.size(); ++i) {
+      std::shared_ptr<ThreadContextSet> other = sets_[i].lock();
+      if (other && (other != set)) {
+        sets_[kept++] = other;
+      }
+    }
+    sets_.resize(kept);
+    sets_.push_back(set);
+  }
+
+ private:
+  ThreadExitHook() {
+  }
+
+  std::vector<std::weak_ptr<ThreadContextSet>> sets_;
+};
+
+// One Context per thread executing an op, made on the first Execute of the thread and freed when it exits, when the op
+// is destroyed or on Clear, whichever comes first. Clear must not race with Execute; the rest is thread-safe.
+template <typename Context>
+struct ThreadContexts {
+  ThreadContexts() : set_(new Set()) {
+  }
+
+  ThreadContexts(const ThreadContexts&) = delete;
+
+  ThreadContexts& operator=(const ThreadContexts&) = delete;
+
+  // create is called, without arguments, if the calling thread has no context yet
+  template <typename Create>
+  Context *Local(Create create) {
+    std::lock_guard<std::mutex> lock(set_->mutex_);
+    Context *&context = set_->contexts_[std::this_thread::get_id()];
+    if (context == NULL) {
+      context = create();
+      ThreadExitHook::Local().Add(set_);
+    }
+    return context;
+  }
+
+  // NULL if the calling thread has no context
+  Context *Find() {
+    std::lock_guard<std::mutex> lock(set_->mutex_);
+    auto it = set_->contexts_.find(std::this_thread::get_id());
+    return (it == set_->contexts_.end()) ? NULL : it->second;
+  }
+
+  void Clear() {
+    set_->Clear();
+  }
+
+ private:
+  struct Set : public ThreadContextSet {
+    ~Set() {
+      Clear();
+    }
+
+    void ReleaseThread(std::thread::id id) {
+      std::lock_guard<std::mutex> lock(mutex_);
+      auto it = contexts_.find(id);
+      if (it != contexts_.end()) {
+        delete it->second;
+        contexts_.erase(it);
+      }
+    }
+
+    void Clear() {
+      std::lock_guard<std::mutex> lock(mutex_);
+      for (auto it = contexts_.begin(); it != contexts_.end(); ++it) {
+        delete it->second;
+      }
+      contexts_.clear();
+    }
+
+    std::mutex mutex_;
+    std::map<std::thread::id, Context *> contexts_;
+  };
+
+  std::shared_ptr<Set> set_;
+};
+
+#endif
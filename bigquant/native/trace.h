@@ -0,0 +1,233 @@
+/*
+ * Copyright 2016 The BigDL Authors.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "base.h"
+
+#define TRACE_MAX_ARGS 12
+
+// A complete ("ph": "X") event of the Chrome trace format. Times are nanoseconds since the trace started.
+struct TraceEvent {
+  const char *name_;
+  const char *category_;
+  uint64_t begin_;
+  uint64_t end_;
+  size_t args_num_;
+  const char *arg_names_[TRACE_MAX_ARGS];
+  uint64_t arg_values_[TRACE_MAX_ARGS];
+};
+
+// The events of one thread. Only its thread appends, the lock is taken by the other side only when a trace starts
+// or stops.
+struct TraceBuffer {
+  std::mutex mutex_;
+  std::vector<TraceEvent> events_;
+  size_t tid_;
+  int omp_thread_;
+};
+
+// Process wide timeline of per-thread spans, written as Chrome trace JSON that chrome://tracing and Perfetto open.
+// Tracing is off unless started through BigQuantStartTrace, or by setting BIGQUANT_TRACE to the file written at exit;
+// while off, a span only loads the flag.
+struct Tracer {
+  static Tracer &Instance() {
+    static Tracer tracer;
+    return tracer;
+  }
+
+  Tracer(const Tracer&) = delete;
+
+  Tracer& operator=(const Tracer&) = delete;
+
+  ~Tracer() {
+    if (!path_.empty()) {
+      Stop(path_.c_str());
+    }
+    for (size_t i = 0; i < buffers_.size(); ++i) {
+      delete buffers_[i];
+    }
+  }
+
+  bool Enabled() const {
+    return enabled_.load(std::memory_order_relaxed);
+  }
+
+  // Drops the events recorded so far and starts the clock of the timeline
+  void Start() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (size_t i = 0; i < buffers_.size(); ++i) {
+      std::lock_guard<std::mutex> buffer_lock(buffers_[i]->mutex_);
+      buffers_[i]->events_.clear();
+    }
+    origin_.store(Clock(), std::memory_order_relaxed);
+    enabled_.store(true, std::memory_order_release);
+  }
+
+  // Stops tracing and writes the timeline to path, NULL drops it. Returns the number of events written, or -1 if the
+  // file cannot be opened.
+  int Stop(const char *path) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    enabled_.store(false, std::memory_order_relaxed);
+    int count = 0;
+    if (path != NULL) {
+      std::ofstream out(path, std::ios::trunc);
+      if (!out) {
+        count = -1;
+      } else {
+        count = Write(out);
+      }
+    }
+    for (size_t i = 0; i < buffers_.size(); ++i) {
+      std::lock_guard<std::mutex> buffer_lock(buffers_[i]->mutex_);
+      buffers_[i]->events_.clear();
+    }
+    return count;
+  }
+
+  uint64_t Now() const {
+    return Clock() - origin_.load(std::memory_order_relaxed);
+  }
+
+  // Appends a closed span to the buffer of the calling thread. Parallel loops open one span per thread around their
+  // omp for rather than one per iteration, so the buffers stay small and the timeline shows each thread's share.
+  void Record(const TraceEvent &event) {
+    TraceBuffer *buffer = LocalBuffer();
+    std::lock_guard<std::mutex> lock(buffer->mutex_);
+    // a span left open across a restart belongs to no timeline
+    if (!Enabled() || (event.end_ < event.begin_)) {
+      return;
+    }
+    buffer->events_.push_back(event);
+  }
+
+ private:
+  Tracer() {
+    origin_.store(Clock(), std::memory_order_relaxed);
+    const char *path = getenv("BIGQUANT_TRACE");
+    enabled_.store((path != NULL) && (path[0] != '\0'), std::memory_order_relaxed);
+    if (enabled_.load(std::memory_order_relaxed)) {
+      path_ = path;
+    }
+  }
+
+  static uint64_t Clock() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::steady_clock::now().time_since_epoch()).count();
+  }
+
+  TraceBuffer *LocalBuffer() {
+    static thread_local TraceBuffer *buffer = NULL;
+    if (buffer == NULL) {
+      // buffers outlive their threads, the pool threads of OpenMP come back with the next region
+      buffer = new TraceBuffer();
+#ifdef _OPENMP
+      buffer->omp_thread_ = omp_get_thread_num();
+#else
+      buffer->omp_thread_ = 0;
+#endif
+      std::lock_guard<std::mutex> lock(mutex_);
+      buffer->tid_ = buffers_.size();
+      buffers_.push_back(buffer);
+    }
+    return buffer;
+  }
+
+  int Write(std::ostream &out) {
+    int count = 0;
+    out << std::fixed << std::setprecision(3) << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[";
+    for (size_t i = 0; i < buffers_.size(); ++i) {
+      TraceBuffer *buffer = buffers_[i];
+      std::lock_guard<std::mutex> buffer_lock(buffer->mutex_);
+      if (buffer->events_.empty()) {
+        continue;
+      }
+      out << ((count == 0) ? "\n" : ",\n");
+      out << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << buffer->tid_
+          << ",\"args\":{\"name\":\"bigquant " << buffer->tid_ << " (omp " << buffer->omp_thread_ << ")\"}}";
+      for (size_t e = 0; e < buffer->events_.size(); ++e) {
+        const TraceEvent &event = buffer->events_[e];
+        // microseconds with nanosecond digits, the unit of the format
+        out << ",\n{\"name\":\"" << event.name_ << "\",\"cat\":\"" << event.category_ << "\",\"ph\":\"X\",\"ts\":"
+            << event.begin_ / 1e3 << ",\"dur\":" << (event.end_ - event.begin_) / 1e3 << ",\"pid\":1,\"tid\":"
+            << buffer->tid_ << ",\"args\":{";
+        for (size_t a = 0; a < event.args_num_; ++a) {
+          out << ((a == 0) ? "" : ",") << "\"" << event.arg_names_[a] << "\":" << event.arg_values_[a];
+        }
+        out << "}}";
+        ++count;
+      }
+    }
+    out << "\n]}\n";
+    return count;
+  }
+
+  std::atomic<bool> enabled_;
+  std::atomic<uint64_t> origin_;
+  std::string path_;
+  std::mutex mutex_;
+  std::vector<TraceBuffer *> buffers_;
+};
+
+// A span of the calling thread from construction to destruction, recorded if tracing was on when it opened. name
+// and the argument names must be string literals. Arguments beyond TRACE_MAX_ARGS are dropped.
+class TraceScope {
+ public:
+  explicit TraceScope(const char *name, const char *category = "thread")
+      : enabled_(Tracer::Instance().Enabled()) {
+    if (enabled_) {
+      event_.name_ = name;
+      event_.category_ = category;
+      event_.args_num_ = 0;
+      event_.begin_ = Tracer::Instance().Now();
+    }
+  }
+
+  ~TraceScope() {
+    if (enabled_) {
+      event_.end_ = Tracer::Instance().Now();
+      Tracer::Instance().Record(event_);
+    }
+  }
+
+  TraceScope(const TraceScope&) = delete;
+
+  TraceScope& operator=(const TraceScope&) = delete;
+
+  TraceScope &Arg(const char *name, uint64_t value) {
+    if (enabled_ && (event_.args_num_ < TRACE_MAX_ARGS)) {
+      event_.arg_names_[event_.args_num_] = name;
+      event_.arg_values_[event_.args_num_] = value;
+      ++event_.args_num_;
+    }
+    return *this;
+  }
+
+ private:
+  bool enabled_;
+  TraceEvent event_;
+};
+
+#endif
@@ -0,0 +1,130 @@
+/*
+ * Copyright 2016 The BigDL Authors.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef WORKSPACE_H
+#define WORKSPACE_H
+
+#include "alloc.h"
+#include "common.h"
+
+// Grow-only scratch buffer owned by an op. Execute() carves its temporaries (quantized data, transposed input, ...)
+// out of it instead of allocating them on every call; memory is only given back by Shrink().
+// A buffer of the caller can be attached instead, which Reserve never grows; see QuantizedConvOpExecuteWithWorkspace.
+struct Workspace {
+  Workspace() : data_(NULL), capacity_(0), offset_(0), saved_bytes_(0), attached_(false) {
+  }
+
+  ~Workspace() {
+    Shrink();
+  }
+
+  Workspace(const Workspace&) = delete;
+
+  Workspace& operator=(const Workspace&) = delete;
+
+  static size_t AlignedSize(size_t size, size_t alignment = 64) {
+    return (size + alignment - 1) / alignment * alignment;
+  }
+
+  // Make sure at least size bytes are available and rewind the carving offset.
+  void Reserve(size_t size) {
+    size = AlignedSize(size);
+    if (attached_) {
+      assert(size <= capacity_);
+    } else if (size > capacity_) {
+      if (data_) {
+        aligned_free(data_);
+      }
+      aligned_malloc(reinterpret_cast<void **>(&data_), 64, size);
+      capacity_ = size;
+      if (NumaEnabled()) {
+        FirstTouch();
+      }
+    } else {
+      saved_bytes_ += size;
+    }
+    offset_ = 0;
+  }
+
+  template <typename DType>
+  DType *Allocate(size_t count) {
+    size_t size = AlignedSize(sizeof(DType) * count);
+    assert(offset_ + size <= capacity_);
+    DType *p = reinterpret_cast<DType *>(data_ + offset_);
+    offset_ += size;
+    return p;
+  }
+
+  void Shrink() {
+    if (data_ && !attached_) {
+      aligned_free(data_);
+    }
+    data_ = NULL;
+    capacity_ = 0;
+    offset_ = 0;
+    attached_ = false;
+  }
+
+  // Carve from size bytes at data until Detach(). The owned buffer is freed first; data needs no alignment, the first
+  // 64-byte boundary in it is used, which AttachedSize accounts for.
+  void Attach(void *data, size_t size) {
+    Shrink();
+    size_t misalignment = reinterpret_cast<size_t>(data) % 64;
+    size_t skip = (misalignment == 0) ? 0 : 64 - misalignment;
+    data_ = reinterpret_cast<int8_t *>(data) + skip;
+    capacity_ = (size > skip) ? size - skip : 0;
+    attached_ = true;
+  }
+
+  void Detach() {
+    if (attached_) {
+      Shrink();
+    }
+  }
+
+  // Bytes to attach for a Reserve of size
+  static size_t AttachedSize(size_t size) {
+    return AlignedSize(size) + 64;
+  }
+
+  // Fault the pages in from the whole team in static order, so each node holds the part of the packed activations its
+  // threads produce and, with a planned GEMM, consume
+  void FirstTouch() {
+    const size_t page = 4096;
+    size_t pages = (capacity_ + page - 1) / page;
+#pragma omp parallel for schedule(static)
+    for (size_t i = 0; i < pages; ++i) {
+      data_[i * page] = 0;
+    }
+  }
+
+  size_t Capacity() {
+    return capacity_;
+  }
+
+  size_t SavedBytes() {
+    return saved_bytes_;
+  }
+
+ private:
+  int8_t *data_;
+  size_t capacity_;
+  size_t offset_;
+  size_t saved_bytes_;
+  bool attached_;
+};
+
+#endif
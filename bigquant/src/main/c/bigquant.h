@@ -22,9 +22,24 @@
 typedef enum LAYOUT { NCHW = 0, NHWC = 1 } LAYOUT;
 typedef enum CONV_ALGORITHM {
   AUTO_SELECT_CONV = 0,
-  SHUFFLE_CONV = 1
+  SHUFFLE_CONV = 1,
+  DEPTHWISE_CONV = 2,
+  WINOGRAD_CONV = 3,
+  WINOGRAD_4X4_CONV = 4,
+  IMPLICIT_GEMM_CONV = 5
 } CONV_ALGORITHM;
 typedef enum FC_ALGORITHM { AUTO_SELECT_FC = 0, SHUFFLE_FC = 1 } FC_ALGORITHM;
+typedef enum PERF_COUNTER {
+  PERF_CONV_OP = 0,
+  PERF_FC_OP = 1,
+  PERF_GRAPH = 2,
+  PERF_MIX_PRECISION_GEMM = 3,
+  PERF_QUANTIZE = 4,
+  PERF_IM2COL = 5,
+  PERF_GEMM = 6,
+  PERF_LAYOUT_TRANSFORM = 7,
+  PERF_COUNTER_NUM = 8
+} PERF_COUNTER;
 
 struct FPTensorDesc {
   void *data;
@@ -45,6 +60,13 @@ struct QuantizedTensorDesc {
   size_t workspace_size;
 };
 
+struct PerfCounterValue {
+  uint64_t calls;
+  uint64_t nanoseconds;
+  uint64_t ops;
+  uint64_t bytes;
+};
+
 struct QuantizedConvOp;
 typedef struct QuantizedConvOp QuantizedConvOp;
 
@@ -170,6 +192,23 @@ API_PREFIX void FreeFPTensor(struct FPTensorDesc *p);
 
 API_PREFIX void FreeQuantizedTensor(struct QuantizedTensorDesc *p);
 
+API_PREFIX void BigQuantEnablePerfCounters(int enable);
+
+API_PREFIX int BigQuantPerfCountersEnabled();
+
+API_PREFIX void BigQuantResetPerfCounters();
+
+API_PREFIX int BigQuantGetPerfCounter(PERF_COUNTER counter,
+                                      struct PerfCounterValue *value);
+
+API_PREFIX const char *BigQuantGetPerfCounterName(PERF_COUNTER counter);
+
+API_PREFIX void BigQuantStartTrace();
+
+API_PREFIX int BigQuantStopTrace(const char *path);
+
+API_PREFIX const char *BigQuantGetISA();
+
 #ifdef __cplusplus
 }
 #endif
@@ -158,6 +158,79 @@ Java_com_intel_analytics_bigdl_bigquant_BigQuant_FCDataInit(JNIEnv *, jclass,
                                                             jint, jint, jint,
                                                             jfloat, jint);
 
+/*
+ * Class:     com_intel_analytics_bigdl_bigquant_BigQuant
+ * Method:    EnablePerfCounters
+ * Signature: (Z)V
+ */
+JNIEXPORT void JNICALL
+Java_com_intel_analytics_bigdl_bigquant_BigQuant_EnablePerfCounters(JNIEnv *,
+                                                                    jclass,
+                                                                    jboolean);
+
+/*
+ * Class:     com_intel_analytics_bigdl_bigquant_BigQuant
+ * Method:    PerfCountersEnabled
+ * Signature: ()Z
+ */
+JNIEXPORT jboolean JNICALL
+Java_com_intel_analytics_bigdl_bigquant_BigQuant_PerfCountersEnabled(JNIEnv *,
+                                                                     jclass);
+
+/*
+ * Class:     com_intel_analytics_bigdl_bigquant_BigQuant
+ * Method:    ResetPerfCounters
+ * Signature: ()V
+ */
+JNIEXPORT void JNICALL
+Java_com_intel_analytics_bigdl_bigquant_BigQuant_ResetPerfCounters(JNIEnv *,
+                                                                   jclass);
+
+/*
+ * Class:     com_intel_analytics_bigdl_bigquant_BigQuant
+ * Method:    GetPerfCounter
+ * Signature: (I[J)I
+ */
+JNIEXPORT jint JNICALL
+Java_com_intel_analytics_bigdl_bigquant_BigQuant_GetPerfCounter(JNIEnv *,
+                                                                jclass, jint,
+                                                                jlongArray);
+
+/*
+ * Class:     com_intel_analytics_bigdl_bigquant_BigQuant
+ * Method:    GetPerfCounterName
+ * Signature: (I)Ljava/lang/String;
+ */
+JNIEXPORT jstring JNICALL
+Java_com_intel_analytics_bigdl_bigquant_BigQuant_GetPerfCounterName(JNIEnv *,
+                                                                    jclass,
+                                                                    jint);
+
+/*
+ * Class:     com_intel_analytics_bigdl_bigquant_BigQuant
+ * Method:    StartTrace
+ * Signature: ()V
+ */
+JNIEXPORT void JNICALL
+Java_com_intel_analytics_bigdl_bigquant_BigQuant_StartTrace(JNIEnv *, jclass);
+
+/*
+ * Class:     com_intel_analytics_bigdl_bigquant_BigQuant
+ * Method:    StopTrace
+ * Signature: (Ljava/lang/String;)I
+ */
+JNIEXPORT jint JNICALL
+Java_com_intel_analytics_bigdl_bigquant_BigQuant_StopTrace(JNIEnv *, jclass,
+                                                           jstring);
+
+/*
+ * Class:     com_intel_analytics_bigdl_bigquant_BigQuant
+ * Method:    GetISA
+ * Signature: ()Ljava/lang/String;
+ */
+JNIEXPORT jstring JNICALL
+Java_com_intel_analytics_bigdl_bigquant_BigQuant_GetISA(JNIEnv *, jclass);
+
 #ifdef __cplusplus
 }
 #endif
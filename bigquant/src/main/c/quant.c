@@ -298,6 +298,122 @@ Java_com_intel_analytics_bigdl_bigquant_BigQuant_loadRuntime(JNIEnv *env,
   return ret;
 }
 
+/*
+ * Class:     com_intel_analytics_bigdl_bigquant_BigQuant
+ * Method:    EnablePerfCounters
+ * Signature: (Z)V
+ */
+JNIEXPORT void JNICALL
+Java_com_intel_analytics_bigdl_bigquant_BigQuant_EnablePerfCounters(
+    JNIEnv *env, jclass cls, jboolean enable)
+{
+  BigQuantEnablePerfCounters(enable == JNI_TRUE);
+}
+
+/*
+ * Class:     com_intel_analytics_bigdl_bigquant_BigQuant
+ * Method:    PerfCountersEnabled
+ * Signature: ()Z
+ */
+JNIEXPORT jboolean JNICALL
+Java_com_intel_analytics_bigdl_bigquant_BigQuant_PerfCountersEnabled(
+    JNIEnv *env, jclass cls)
+{
+  return BigQuantPerfCountersEnabled() ? JNI_TRUE : JNI_FALSE;
+}
+
+/*
+ * Class:     com_intel_analytics_bigdl_bigquant_BigQuant
+ * Method:    ResetPerfCounters
+ * Signature: ()V
+ */
+JNIEXPORT void JNICALL
+Java_com_intel_analytics_bigdl_bigquant_BigQuant_ResetPerfCounters(JNIEnv *env,
+                                                                   jclass cls)
+{
+  BigQuantResetPerfCounters();
+}
+
+/*
+ * Class:     com_intel_analytics_bigdl_bigquant_BigQuant
+ * Method:    GetPerfCounter
+ * Signature: (I[J)I
+ */
+JNIEXPORT jint JNICALL
+Java_com_intel_analytics_bigdl_bigquant_BigQuant_GetPerfCounter(
+    JNIEnv *env, jclass cls, jint counter, jlongArray value)
+{
+  struct PerfCounterValue tmp;
+  jlong fields[4];
+  jint ret = BigQuantGetPerfCounter(counter, &tmp);
+  if (ret != 0 || (*env)->GetArrayLength(env, value) < 4) {
+    return -1;
+  }
+  fields[0] = (jlong)tmp.calls;
+  fields[1] = (jlong)tmp.nanoseconds;
+  fields[2] = (jlong)tmp.ops;
+  fields[3] = (jlong)tmp.bytes;
+  (*env)->SetLongArrayRegion(env, value, 0, 4, fields);
+  return 0;
+}
+
+/*
+ * Class:     com_intel_analytics_bigdl_bigquant_BigQuant
+ * Method:    GetPerfCounterName
+ * Signature: (I)Ljava/lang/String;
+ */
+JNIEXPORT jstring JNICALL
+Java_com_intel_analytics_bigdl_bigquant_BigQuant_GetPerfCounterName(
+    JNIEnv *env, jclass cls, jint counter)
+{
+  const char *name = BigQuantGetPerfCounterName(counter);
+  return name == NULL ? NULL : (*env)->NewStringUTF(env, name);
+}
+
+/*
+ * Class:     com_intel_analytics_bigdl_bigquant_BigQuant
+ * Method:    StartTrace
+ * Signature: ()V
+ */
+JNIEXPORT void JNICALL
+Java_com_intel_analytics_bigdl_bigquant_BigQuant_StartTrace(JNIEnv *env,
+                                                            jclass cls)
+{
+  BigQuantStartTrace();
+}
+
+/*
+ * Class:     com_intel_analytics_bigdl_bigquant_BigQuant
+ * Method:    StopTrace
+ * Signature: (Ljava/lang/String;)I
+ */
+JNIEXPORT jint JNICALL
+Java_com_intel_analytics_bigdl_bigquant_BigQuant_StopTrace(JNIEnv *env,
+                                                           jclass cls,
+                                                           jstring path)
+{
+  const char *jPath;
+  jint ret;
+  if (path == NULL) {
+    return BigQuantStopTrace(NULL);
+  }
+  jPath = (*env)->GetStringUTFChars(env, path, 0);
+  ret = BigQuantStopTrace(jPath);
+  (*env)->ReleaseStringUTFChars(env, path, jPath);
+  return ret;
+}
+
+/*
+ * Class:     com_intel_analytics_bigdl_bigquant_BigQuant
+ * Method:    GetISA
+ * Signature: ()Ljava/lang/String;
+ */
+JNIEXPORT jstring JNICALL
+Java_com_intel_analytics_bigdl_bigquant_BigQuant_GetISA(JNIEnv *env, jclass cls)
+{
+  return (*env)->NewStringUTF(env, BigQuantGetISA());
+}
+
 #ifdef __cplusplus
 }
 #endif
@@ -142,4 +142,32 @@ public class BigQuant {
                                          int channel,
                                          float threshold,
                                          int layout);
+
+    public native static void EnablePerfCounters(boolean enable);
+
+    public native static boolean PerfCountersEnabled();
+
+    public native static void ResetPerfCounters();
+
+    /**
+     * Fills value with the calls, nanoseconds, ops and bytes of a PERF_COUNTER,
+     * returns -1 for an unknown counter or an array shorter than 4
+     */
+    public native static int GetPerfCounter(int counter, long[] value);
+
+    public native static String GetPerfCounterName(int counter);
+
+    public native static void StartTrace();
+
+    /**
+     * Writes the Chrome trace JSON recorded since StartTrace to path, null drops
+     * it, returns the number of events written or -1 if the file cannot be opened
+     */
+    public native static int StopTrace(String path);
+
+    /**
+     * Instruction set the kernels run with: "avx512", "avx2" or "sse42", the
+     * widest one the CPU has unless BIGQUANT_ISA names a narrower one
+     */
+    public native static String GetISA();
 }
@@ -30,18 +30,20 @@ import java.util.List;
 public class Loader {
     private String prefix = "lib";
     private List<String> libraries = new ArrayList<String>();
+    // only a DISPATCH=DLOPEN build ships these, the default one links every ISA into bigquant_rt
+    private List<String> isaLibraries = new ArrayList<String>();
     private String os = System.getProperty("os.name").toLowerCase();
 
     public void init() throws IOException {
         libraries.add("bigquant");
         libraries.add("bigquant_rt");
-        libraries.add("bigquant_avx2");
-        libraries.add("bigquant_sse42");
+        isaLibraries.add("bigquant_avx2");
+        isaLibraries.add("bigquant_sse42");
 
         // for osx, we don't support avx512 now.
         // because the default version of gcc installed by brew doesn't enable this feature
         if (!os.contains("mac")) {
-            libraries.add("bigquant_avx512");
+            isaLibraries.add("bigquant_avx512");
         }
 
         // TODO for windows, we don't create bigquant.native dir
@@ -86,6 +88,14 @@ public class Loader {
             copyLibraryToTemp(src, library, tempDir);
             src.close();
         }
+        for (String name: isaLibraries) {
+            String library = libraryName(name);
+            if (Loader.class.getResource("/" + library) != null) {
+                ReadableByteChannel src = resource(library);
+                copyLibraryToTemp(src, library, tempDir);
+                src.close();
+            }
+        }
     }
 
     private ReadableByteChannel resource(String name) throws NullPointerException {